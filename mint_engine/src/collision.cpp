@@ -1,38 +1,140 @@
+#include <string.h>
 #include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 #include "collision.h"
 #include "gpu.h"
 
+// SIMD kernel selection for the mesh triangle tests
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define COLLISION_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COLLISION_SIMD_SSE2
+#endif
 
-class CollisionQuadTreeSpace
-{
-public:
-	void add(ColliderRef collider);
-	void remove(ColliderRef collider);
 
-	std::vector<ColliderRef> colliders;
-	CollisionQuadTreeSpace *parent;
-	CollisionQuadTreeSpace *children[4];
-	bounds_t bounds;
-};
+// slab test, returns the entry distance of the ray
+static inline bool ray_vs_bounds(const vec3 &pos, const vec3 &inv_dir, float max_distance, const vec3 &min, const vec3 &max, float *distance)
+{
+	float tx1 = (min.x - pos.x) * inv_dir.x;
+	float tx2 = (max.x - pos.x) * inv_dir.x;
+	float ty1 = (min.y - pos.y) * inv_dir.y;
+	float ty2 = (max.y - pos.y) * inv_dir.y;
+	float tz1 = (min.z - pos.z) * inv_dir.z;
+	float tz2 = (max.z - pos.z) * inv_dir.z;
+	float tmin = fmaxf(fmaxf(fminf(tx1, tx2), fminf(ty1, ty2)), fminf(tz1, tz2));
+	float tmax = fminf(fminf(fmaxf(tx1, tx2), fmaxf(ty1, ty2)), fmaxf(tz1, tz2));
+	*distance = tmin;
+	return tmax >= 0.0f && tmin <= tmax && tmin <= max_distance;
+}
 
-void CollisionQuadTreeSpace::add(ColliderRef collider)
+// reciprocal of the ray direction without infinities
+static inline vec3 safe_inv_dir(const vec3 &dir)
 {
-	colliders.push_back(collider);
-	collider->space = this;
+	return vec3(1.0f / (dir.x != 0.0f ? dir.x : FLOAT_MIN),
+				1.0f / (dir.y != 0.0f ? dir.y : FLOAT_MIN),
+				1.0f / (dir.z != 0.0f ? dir.z : FLOAT_MIN));
 }
 
-void CollisionQuadTreeSpace::remove(ColliderRef collider)
+
+// statistics
+// a public query points stats_counters at its own counters while it runs and adds them to the frame when it returns,
+// the code below only counts through the pointer, so it costs a null check while the statistics are off
+static struct collision_stats_ctx
 {
-	colliders.erase(std::remove(colliders.begin(), colliders.end(), collider), colliders.end());
+	std::atomic<bool> enabled;
+	std::mutex mutex;
+	CollisionStats current;	// the frame being collected
+	CollisionStats last;	// the last closed frame
+} stats;
+
+static thread_local CollisionQueryStats *stats_counters = nullptr;
+static thread_local int stats_scope = 0;
+
+static inline void add_query_stats(CollisionQueryStats *stats, const CollisionQueryStats &other)
+{
+	stats->queries += other.queries;
+	stats->nodes += other.nodes;
+	stats->candidates += other.candidates;
+	stats->tests += other.tests;
+	stats->hits += other.hits;
+	stats->time += other.time;
 }
 
+// records a public query from construction to destruction
+// a query made inside another one (a batch worker, a slide step) is counted by the outer one
+// only the checks are inlined in the queries, the recording itself stays out of line
+class QueryStatsRecorder
+{
+public:
+	QueryStatsRecorder(CollisionQueryType type) : type(type)
+	{
+		if(stats_counters == nullptr && stats.enabled.load(std::memory_order_relaxed)) begin();
+	}
+
+	~QueryStatsRecorder()
+	{
+		if(stats_counters == &counters) end();
+	}
+
+private:
+	void begin();
+	void end();
+
+	CollisionQueryType type;
+	CollisionQueryStats counters;
+	std::chrono::steady_clock::time_point start;
+};
 
+void QueryStatsRecorder::begin()
+{
+	counters = {};
+	counters.queries = 1;
+	stats_counters = &counters;
+	start = std::chrono::steady_clock::now();
+}
 
+void QueryStatsRecorder::end()
+{
+	stats_counters = nullptr;
+	counters.time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
+	std::lock_guard<std::mutex> lock(stats.mutex);
+	add_query_stats(&stats.current.types[(int)type], counters);
+	add_query_stats(&stats.current.scopes[stats_scope], counters);
+}
 
 
+// finite bounds in x and z, a collider moved to infinity or NaN never gets a node
+static inline bool get_collider_bounds_valid(const aabb_t &b)
+{
+	return b.max.x - b.min.x < FLOAT_MAX && b.max.z - b.min.z < FLOAT_MAX && fabsf(b.min.x) < FLOAT_MAX && fabsf(b.min.z) < FLOAT_MAX;
+}
 
+// quadtree node
+// nodes live in a flat array in linear quadtree order (level by level, morton order inside a level),
+// so the parent of node n is (n-1)/4 and its children are 4n+1 to 4n+4
+struct CollisionQuadTreeNode
+{
+	aabb_t bounds;		// bounds of the node, unbounded in y
+	u32 first;			// first slot of the collider index range in the item pool
+	u32 count;			// number of colliders in the node
+	u32 size_class;		// the range holds 1<<size_class slots
+	u32 layers;			// layer bits of the colliders in this node
+	u32 subtree_layers;	// layer bits of the colliders in this node and its children
+};
 
+#define QUADTREE_INVALID_INDEX 0xFFFFFFFF
+#define QUADTREE_AWAKE_NODE 0xFFFFFFFE	// tree_node of the awake colliders, they are kept out of the nodes
+#define QUADTREE_MIN_SIZE_CLASS 2
+#define QUADTREE_SIZE_CLASS_COUNT 32
+#define QUADTREE_LEAF_COLLIDERS 4	// average colliders per occupied leaf the depth is chosen for
 
 class CollisionQuadTree
 {
@@ -40,24 +142,61 @@ public:
 	void init(u32 level, const bounds_t &bounds);
 	void uninit();
 	void add(ColliderRef collider);
-	void remove(ColliderRef collider);
-	void update(ColliderRef collider);
-
-	int query_colliders(const bounds_t &bounds, std::vector<ColliderRef> *list);
-	void query_colliders_recursive(CollisionQuadTreeSpace *space, const bounds_t &bounds, std::vector<ColliderRef> *list);
+	void remove(Collider *collider);
+	void update(Collider *collider);
+	void update_layer(Collider *collider);
+	void update_sleeping(u32 sleep_frames);
+	bool sleep_rested(u32 sleep_frames);
+	void build_static();
+	void rebuild(const bounds_t &bounds, u32 level, bool sleep_all);
+	u32 choose_level(const bounds_t &bounds) const;
+	bounds_t get_bounds() const;
+	u32 get_level() const {return level;}
+
+	// queries return collider indices, get_collider maps them back to colliders
+	int query(const bounds_t &bounds, u32 layermask, std::vector<u32> *indices) const;
+	int query_colliders(const bounds_t &bounds, u32 layermask, std::vector<ColliderRef> *list) const;
+	bool cast_nearest(const ray_t &ray, float radius, bool sphere, u32 layermask, RayHit *rayhit) const;
+
+	u32 get_point_key(const vec3 &point) const;
+
+	Collider* get_collider(u32 index) const {return colliders[index].get();}
+	const ColliderRef& get_collider_ref(u32 index) const {return colliders[index];}
+	const u32* get_node_colliders(u32 node, u32 *count) const;
 
 protected:
-	bool create_new_space(u32 elem);
-	u32 bit_separete32(u32 n);
-	u32 get_morton_number(u32 x, u32 y);
+	void insert(Collider *collider, u32 elem);
+	void erase(Collider *collider);
+	u32 alloc_range(u32 size_class);
+	void free_range(u32 first, u32 size_class);
+	void insert_awake(Collider *collider);
+	void erase_awake(Collider *collider);
+	void pack();
+	void update_layers(u32 node);
+	u32 bit_separete32(u32 n) const;
+	u32 get_morton_number(u32 x, u32 y) const;
 	u32 get_point_elem(float x, float y);
 	u32 get_space_number(const bounds_t &bounds);
+	bool get_collider_bounds(bool awake_only, bounds_t *bounds) const;
 
 protected:
-	std::vector<CollisionQuadTreeSpace*> spaces;
+	std::vector<CollisionQuadTreeNode> nodes;
+	std::vector<u32> items;		// pool of the collider index ranges of the nodes
+	std::vector<aabb_t> item_bounds;	// world bounds of the colliders in items, queries test them without touching the colliders
+	std::vector<u32> free_ranges[QUADTREE_SIZE_CLASS_COUNT];	// freed ranges by size class
+	std::vector<ColliderRef> colliders;	// indexed by Collider::tree_index
+	std::vector<u32> free_colliders;
+
+	// awake colliders live in a flat list beside the nodes, moving one only rewrites its bounds
+	// they go into the nodes once they have rested long enough, so the nodes only change when a collider falls asleep or wakes up
+	std::vector<u32> awake_items;
+	std::vector<aabb_t> awake_bounds;
+	std::vector<u32> awake_moved;	// frame of the last move
+	u32 frame = 0;
+
 	const static u32 MAX_LEVEL = 8;
 	u32 level = 0;
-	u32 space_count_of_level[MAX_LEVEL+1];
+	u32 space_count_of_level[MAX_LEVEL+2];	// one past the deepest level for the node count
 	u32 space_count;
 	bounds_t bounds;
 	float width;
@@ -73,153 +212,657 @@ void CollisionQuadTree::init(u32 level, const bounds_t &bounds)
 
 	// calculate space count
 	space_count_of_level[0] = 1;
-	for(int i=1; i<MAX_LEVEL+1; i++)
+	for(u32 i=1; i<MAX_LEVEL+2; i++)
 	{
 		space_count_of_level[i] = space_count_of_level[i-1] * 4;
 	}
 
 	space_count = (space_count_of_level[this->level+1]-1)/3;
-	spaces.resize(space_count, nullptr);
-
 
 	this->bounds = bounds;
 	this->bounds.extents.y = FLOAT_MAX;
 	width = bounds.extents.x * 2.0f;
-	depth = bounds.extents.y * 2.0f;
+	depth = bounds.extents.z * 2.0f;
 	unit_w = width/(1<<this->level);
 	unit_d = depth/(1<<this->level);
+
+	// the bounds of every node are fixed, so all nodes are created up front
+	nodes.resize(space_count);
+	for(u32 i=0; i<space_count; i++)
+	{
+		CollisionQuadTreeNode &node = nodes[i];
+		node = CollisionQuadTreeNode{};
+		node.first = QUADTREE_INVALID_INDEX;
+		if(i == 0)
+		{
+			node.bounds = aabb_t(this->bounds);
+			continue;
+		}
+
+		// split the parent into left-top, right-top, left-bottom and right-bottom
+		const CollisionQuadTreeNode &parent = nodes[(i-1)>>2];
+		u32 n = (i-1)&0x3;
+		const aabb_t &p = parent.bounds;
+		float half_w = (p.max.x - p.min.x) * 0.5f;
+		float half_d = (p.max.z - p.min.z) * 0.5f;
+		node.bounds.min = vec3(p.min.x + ((n & 1) ? half_w : 0.0f), p.min.y, p.min.z + ((n & 2) ? half_d : 0.0f));
+		node.bounds.max = vec3(node.bounds.min.x + half_w, p.max.y, node.bounds.min.z + half_d);
+	}
 }
 
 void CollisionQuadTree::uninit()
 {
-	for(int i=0; i<spaces.size(); i++)
+	for(size_t i=0; i<colliders.size(); i++)
+	{
+		if(colliders[i] == nullptr) continue;
+		colliders[i]->tree_index = QUADTREE_INVALID_INDEX;
+		colliders[i]->tree_node = QUADTREE_INVALID_INDEX;
+		colliders[i]->tree_slot = QUADTREE_INVALID_INDEX;
+	}
+	colliders.clear();
+	free_colliders.clear();
+	awake_items.clear();
+	awake_bounds.clear();
+	awake_moved.clear();
+	nodes.clear();
+	items.clear();
+	item_bounds.clear();
+	for(int i=0; i<QUADTREE_SIZE_CLASS_COUNT; i++)
+	{
+		free_ranges[i].clear();
+	}
+}
+
+u32 CollisionQuadTree::alloc_range(u32 size_class)
+{
+	std::vector<u32> &list = free_ranges[size_class];
+	if(!list.empty())
+	{
+		u32 first = list.back();
+		list.pop_back();
+		return first;
+	}
+
+	u32 first = (u32)items.size();
+	items.resize(first + (1u << size_class));
+	item_bounds.resize(items.size());
+	return first;
+}
+
+void CollisionQuadTree::free_range(u32 first, u32 size_class)
+{
+	free_ranges[size_class].push_back(first);
+}
+
+void CollisionQuadTree::add(ColliderRef collider)
+{
+	if(collider->tree_index != QUADTREE_INVALID_INDEX) return;
+
+	collider->update_transform();
+
+	// take a collider slot
+	if(!free_colliders.empty())
+	{
+		collider->tree_index = free_colliders.back();
+		free_colliders.pop_back();
+		colliders[collider->tree_index] = collider;
+	}
+	else
+	{
+		collider->tree_index = (u32)colliders.size();
+		colliders.push_back(collider);
+	}
+	insert_awake(collider.get());
+}
+
+void CollisionQuadTree::remove(Collider *collider)
+{
+	u32 index = collider->tree_index;
+	if(index == QUADTREE_INVALID_INDEX) return;
+
+	if(collider->tree_node == QUADTREE_AWAKE_NODE) erase_awake(collider);
+	else erase(collider);
+	collider->tree_index = QUADTREE_INVALID_INDEX;
+	colliders[index] = nullptr;
+	free_colliders.push_back(index);
+}
+
+// refreshes the bounds of a moved collider, a sleeping collider wakes up and leaves its node
+void CollisionQuadTree::update(Collider *collider)
+{
+	collider->update_transform();
+	if(collider->tree_index == QUADTREE_INVALID_INDEX) return;
+
+	if(collider->tree_node == QUADTREE_AWAKE_NODE)
+	{
+		awake_bounds[collider->tree_slot] = collider->world_bounds;
+		awake_moved[collider->tree_slot] = frame;
+		return;
+	}
+	erase(collider);
+	insert_awake(collider);
+}
+
+void CollisionQuadTree::update_layer(Collider *collider)
+{
+	if(collider->tree_index != QUADTREE_INVALID_INDEX && collider->tree_node != QUADTREE_AWAKE_NODE)
+	{
+		update_layers(collider->tree_node);
+	}
+}
+
+// advances a frame and puts the awake colliders that have not moved for sleep_frames frames to sleep in the nodes
+// colliders resting out of the world bounds have no node, the tree is re-rooted on larger bounds for them
+void CollisionQuadTree::update_sleeping(u32 sleep_frames)
+{
+	frame++;
+	if(nodes.empty()) return;
+	if(!sleep_rested(sleep_frames)) return;
+
+	// grow by half again so a collider wandering off does not re-root the tree every frame
+	bounds_t world = get_bounds();
+	bounds_t awake;
+	if(!get_collider_bounds(true, &awake)) return;
+	world.encapsulate(awake);
+	world.extents = world.extents * 1.5f;
+	rebuild(world, choose_level(world), false);
+	sleep_rested(sleep_frames);
+}
+
+// returns true when a rested collider could not sleep because it is out of the world
+bool CollisionQuadTree::sleep_rested(u32 sleep_frames)
+{
+	bool outside = false;
+	for(u32 i=(u32)awake_items.size(); i-- > 0;)
 	{
-		if(spaces[i] == nullptr) continue;
-		for(int c=0; c<spaces[i]->colliders.size(); c++)
+		if(frame - awake_moved[i] < sleep_frames) continue;
+
+		// erase_awake swaps the last collider into the slot, it has been visited already
+		Collider *collider = colliders[awake_items[i]].get();
+		u32 elem = get_space_number(collider->get_bounds_world());
+		if(elem >= space_count)
 		{
-			free_collider(spaces[i]->colliders[c]);
+			outside = outside || get_collider_bounds_valid(collider->world_bounds);
+			continue;
 		}
-		spaces[i]->colliders.clear();
-		delete spaces[i];
-		spaces[i] = nullptr;
+		erase_awake(collider);
+		insert(collider, elem);
 	}
+	return outside;
 }
 
-void CollisionQuadTree::add(ColliderRef collider)
+// fits the world bounds to the colliders, puts every collider to sleep and packs the nodes for the queries
+void CollisionQuadTree::build_static()
+{
+	bounds_t world;
+	if(!get_collider_bounds(false, &world)) return;
+	world.extents = world.extents + vec3(1,1,1);
+	rebuild(world, choose_level(world), true);
+}
+
+// re-roots the tree on new bounds and inserts the sleeping colliders again
+// the awake colliders stay awake unless sleep_all is set, colliders out of the new bounds stay awake
+void CollisionQuadTree::rebuild(const bounds_t &bounds, u32 level, bool sleep_all)
 {
-	bounds_t bounds = collider->get_bounds_world();
-	u32 elem = get_space_number(bounds);
-	if(elem < space_count)
+	for(u32 i=0; i<(u32)colliders.size(); i++)
 	{
-		if(!spaces[elem]){create_new_space(elem);}
+		Collider *c = colliders[i].get();
+		if(c == nullptr || c->tree_node == QUADTREE_AWAKE_NODE) continue;
+		c->tree_node = QUADTREE_INVALID_INDEX;
+		c->tree_slot = QUADTREE_INVALID_INDEX;
+	}
+	items.clear();
+	item_bounds.clear();
+	for(int i=0; i<QUADTREE_SIZE_CLASS_COUNT; i++)
+	{
+		free_ranges[i].clear();
+	}
+	init(level, bounds);
+
+	for(u32 i=0; i<(u32)colliders.size(); i++)
+	{
+		Collider *c = colliders[i].get();
+		if(c == nullptr) continue;
+		bool awake = c->tree_node == QUADTREE_AWAKE_NODE;
+		if(awake && !sleep_all) continue;
 
-		// find object layer
-		auto space = spaces[elem];
-		space->add(collider);
+		u32 elem = get_space_number(c->get_bounds_world());
+		if(elem >= space_count)
+		{
+			if(!awake) insert_awake(c);
+			continue;
+		}
+		if(awake) erase_awake(c);
+		insert(c, elem);
 	}
+	pack();
 }
 
-void CollisionQuadTree::remove(ColliderRef collider)
+// picks the shallowest depth whose occupied leaves hold QUADTREE_LEAF_COLLIDERS colliders or less on average
+// colliders larger than a leaf are left out, they stay in the upper nodes whatever the depth
+u32 CollisionQuadTree::choose_level(const bounds_t &bounds) const
 {
-	if(collider->space != nullptr)
+	vec3 min = bounds.get_min();
+	float w = bounds.extents.x * 2.0f;
+	float d = bounds.extents.z * 2.0f;
+	std::vector<u32> cells;
+	for(u32 l=1; l<MAX_LEVEL; l++)
 	{
-		collider->space->remove(collider);
-		collider->space = nullptr;
+		u32 n = 1u << l;
+		float cell_w = w / n;
+		float cell_d = d / n;
+		cells.assign(n*n, 0);
+		u32 count = 0;
+		u32 occupied = 0;
+		for(u32 i=0; i<(u32)colliders.size(); i++)
+		{
+			const Collider *c = colliders[i].get();
+			if(c == nullptr) continue;
+			const aabb_t &b = c->world_bounds;
+			if(b.max.x - b.min.x > cell_w || b.max.z - b.min.z > cell_d) continue;
+
+			u32 x = (u32)clamp(((b.min.x + b.max.x) * 0.5f - min.x) / cell_w, 0.0f, (float)(n-1));
+			u32 z = (u32)clamp(((b.min.z + b.max.z) * 0.5f - min.z) / cell_d, 0.0f, (float)(n-1));
+			if(cells[z*n + x]++ == 0) occupied++;
+			count++;
+		}
+		if(count <= occupied * QUADTREE_LEAF_COLLIDERS) return l;
 	}
+	return MAX_LEVEL;
+}
+
+bounds_t CollisionQuadTree::get_bounds() const
+{
+	bounds_t b = bounds;
+	b.extents.y = 0.0f;
+	return b;
 }
 
-void CollisionQuadTree::update(ColliderRef collider)
+// bounds of the colliders (or of the awake ones) in x and z, colliders flung to infinity are left out
+bool CollisionQuadTree::get_collider_bounds(bool awake_only, bounds_t *result) const
 {
-	if(collider->space != nullptr)
+	bool found = false;
+	aabb_t box;
+	for(u32 i=0; i<(u32)colliders.size(); i++)
 	{
-		collider->space->remove(collider);
-		add(collider);
+		const Collider *c = colliders[i].get();
+		if(c == nullptr) continue;
+		if(awake_only && c->tree_node != QUADTREE_AWAKE_NODE) continue;
+		const aabb_t &b = c->world_bounds;
+		if(!get_collider_bounds_valid(b)) continue;
+		if(!found)
+		{
+			box = b;
+			found = true;
+			continue;
+		}
+		box.min = vec3(fminf(box.min.x, b.min.x), 0.0f, fminf(box.min.z, b.min.z));
+		box.max = vec3(fmaxf(box.max.x, b.max.x), 0.0f, fmaxf(box.max.z, b.max.z));
 	}
+	if(!found) return false;
+	box.min.y = 0.0f;
+	box.max.y = 0.0f;
+	*result = box.to_bounds();
+	return true;
 }
 
-int CollisionQuadTree::query_colliders(const bounds_t &bounds, std::vector<ColliderRef> *list)
+void CollisionQuadTree::insert_awake(Collider *collider)
 {
-	if(list == nullptr) return 0;
+	collider->tree_node = QUADTREE_AWAKE_NODE;
+	collider->tree_slot = (u32)awake_items.size();
+	awake_items.push_back(collider->tree_index);
+	awake_bounds.push_back(collider->world_bounds);
+	awake_moved.push_back(frame);
+}
 
-	list->clear();
-	query_colliders_recursive(spaces[0], bounds, list);
-	return (int)list->size();
+void CollisionQuadTree::erase_awake(Collider *collider)
+{
+	u32 slot = collider->tree_slot;
+	u32 last = awake_items.back();
+	awake_items[slot] = last;
+	awake_bounds[slot] = awake_bounds.back();
+	awake_moved[slot] = awake_moved.back();
+	colliders[last]->tree_slot = slot;
+	awake_items.pop_back();
+	awake_bounds.pop_back();
+	awake_moved.pop_back();
+
+	collider->tree_node = QUADTREE_INVALID_INDEX;
+	collider->tree_slot = QUADTREE_INVALID_INDEX;
+}
+
+// rebuilds the item pool in node order without free ranges, so the queries walk through one compact array
+void CollisionQuadTree::pack()
+{
+	std::vector<u32> packed_items;
+	std::vector<aabb_t> packed_bounds;
+	packed_items.reserve(items.size());
+	packed_bounds.reserve(items.size());
+	for(u32 i=0; i<space_count; i++)
+	{
+		CollisionQuadTreeNode &node = nodes[i];
+		if(node.first == QUADTREE_INVALID_INDEX) continue;
+
+		u32 size_class = QUADTREE_MIN_SIZE_CLASS;
+		while((1u << size_class) < node.count) size_class++;
+		u32 first = (u32)packed_items.size();
+		packed_items.resize(first + (1u << size_class));
+		packed_bounds.resize(packed_items.size());
+		memcpy(&packed_items[first], &items[node.first], sizeof(u32)*node.count);
+		memcpy(&packed_bounds[first], &item_bounds[node.first], sizeof(aabb_t)*node.count);
+		node.first = first;
+		node.size_class = size_class;
+	}
+	items.swap(packed_items);
+	item_bounds.swap(packed_bounds);
+	for(int i=0; i<QUADTREE_SIZE_CLASS_COUNT; i++)
+	{
+		free_ranges[i].clear();
+	}
+}
+
+// appends the collider to the range of the node
+void CollisionQuadTree::insert(Collider *collider, u32 elem)
+{
+	// grow the range of the node when it is full
+	CollisionQuadTreeNode &node = nodes[elem];
+	if(node.first == QUADTREE_INVALID_INDEX)
+	{
+		node.size_class = QUADTREE_MIN_SIZE_CLASS;
+		node.first = alloc_range(node.size_class);
+	}
+	else if(node.count == (1u << node.size_class))
+	{
+		u32 first = alloc_range(node.size_class+1);
+		memcpy(&items[first], &items[node.first], sizeof(u32)*node.count);
+		memcpy(&item_bounds[first], &item_bounds[node.first], sizeof(aabb_t)*node.count);
+		free_range(node.first, node.size_class);
+		node.first = first;
+		node.size_class++;
+	}
+	items[node.first + node.count] = collider->tree_index;
+	item_bounds[node.first + node.count] = collider->world_bounds;
+	collider->tree_node = elem;
+	collider->tree_slot = node.count;
+	node.count++;
+
+	u32 bit = 1u << collider->layer;
+	node.layers |= bit;
+	for(u32 n = elem; ; n = (n-1)>>2)
+	{
+		nodes[n].subtree_layers |= bit;
+		if(n == 0) break;
+	}
 }
 
-void CollisionQuadTree::query_colliders_recursive(CollisionQuadTreeSpace *space, const bounds_t &bounds, std::vector<ColliderRef> *list)
+// removes the collider from its node by swapping the last collider of the node into its slot
+void CollisionQuadTree::erase(Collider *collider)
 {
-	if(space == nullptr || list == nullptr) return;
+	u32 elem = collider->tree_node;
+	CollisionQuadTreeNode &node = nodes[elem];
+	u32 *range = &items[node.first];
+	u32 last = range[node.count-1];
+	range[collider->tree_slot] = last;
+	item_bounds[node.first + collider->tree_slot] = item_bounds[node.first + node.count-1];
+	colliders[last]->tree_slot = collider->tree_slot;
+	node.count--;
+
+	if(node.count == 0)
+	{
+		free_range(node.first, node.size_class);
+		node.first = QUADTREE_INVALID_INDEX;
+	}
+	update_layers(elem);
 
-	for(int i=0; i<space->colliders.size(); i++)
+	collider->tree_node = QUADTREE_INVALID_INDEX;
+	collider->tree_slot = QUADTREE_INVALID_INDEX;
+}
+
+// recalculate the layer bits of the node and its parents
+void CollisionQuadTree::update_layers(u32 elem)
+{
+	CollisionQuadTreeNode &node = nodes[elem];
+	node.layers = 0;
+	for(u32 i=0; i<node.count; i++)
 	{
-		list->push_back(space->colliders[i]);
+		node.layers |= 1u << colliders[items[node.first+i]]->layer;
 	}
 
-	for(int i=0; i<4; i++) {
-		if(space->children[i] && space->children[i]->bounds.intersects(bounds)) {
-			query_colliders_recursive(space->children[i], bounds, list);
+	for(u32 n = elem; ; n = (n-1)>>2)
+	{
+		u32 bits = nodes[n].layers;
+		u32 child = n*4+1;
+		if(child < space_count)
+		{
+			for(u32 i=0; i<4; i++)
+			{
+				bits |= nodes[child+i].subtree_layers;
+			}
 		}
+		if(nodes[n].subtree_layers == bits && n != elem) break;
+		nodes[n].subtree_layers = bits;
+		if(n == 0) break;
+	}
+}
+
+const u32* CollisionQuadTree::get_node_colliders(u32 node, u32 *count) const
+{
+	if(node >= space_count || nodes[node].count == 0)
+	{
+		*count = 0;
+		return nullptr;
 	}
+	*count = nodes[node].count;
+	return &items[nodes[node].first];
 }
 
-bool CollisionQuadTree::create_new_space(u32 elem)
+// collects the indices of enabled colliders whose layer is in the layermask and whose world bounds overlap the bounds
+int CollisionQuadTree::query(const bounds_t &bounds, u32 layermask, std::vector<u32> *indices) const
 {
-	if(elem >= space_count) return false;
+	if(indices == nullptr) return 0;
+	indices->clear();
+
+	const aabb_t box(bounds);
+
+	// the awake colliders are few, they are tested one by one
+	for(u32 i=0; i<(u32)awake_items.size(); i++)
+	{
+		if(!awake_bounds[i].intersects(box)) continue;
+		const Collider *c = colliders[awake_items[i]].get();
+		if(c->enabled && (layermask & (1u << c->layer)))
+		{
+			indices->push_back(awake_items[i]);
+		}
+	}
+	if(nodes.empty()) return (int)indices->size();
 
-	// create the space
-	if(!spaces[elem])
+	u32 stack[MAX_LEVEL*3+1];
+	int stack_count = 0;
+	u32 visited = 0;
+	stack[stack_count++] = 0;
+	while(stack_count > 0)
 	{
-		CollisionQuadTreeSpace *parent_space = nullptr;
-		CollisionQuadTreeSpace *space = nullptr;
-		spaces[elem] = new CollisionQuadTreeSpace();
-		space = spaces[elem];
+		u32 elem = stack[--stack_count];
+		const CollisionQuadTreeNode &node = nodes[elem];
+		visited++;
 
-		if(elem > 0)
+		// skip the whole subtree if it has no collider on the requested layers
+		if((node.subtree_layers & layermask) == 0) continue;
+
+		if(node.layers & layermask)
 		{
-			// create the parent space
-			u32 parent_elem = (elem-1)>>2;	// get a element of the parent space
-			create_new_space(parent_elem);
-			parent_space = spaces[parent_elem];
+			const u32 *range = &items[node.first];
+			const aabb_t *range_bounds = &item_bounds[node.first];
+			for(u32 i=0; i<node.count; i++)
+			{
+				if(!range_bounds[i].intersects(box)) continue;
+				const Collider *c = colliders[range[i]].get();
+				if(c->enabled && (layermask & (1u << c->layer)))
+				{
+					indices->push_back(range[i]);
+				}
+			}
 		}
-		space->parent = parent_space;
 
-		// set the bounds of the space
-		bounds_t bounds;
-		if(elem > 0)
-		{
-			u32 n = (elem-1)%4;
-			parent_space->children[n] = space;
-			float width = parent_space->bounds.extents.x;
-			float depth = parent_space->bounds.extents.z;
-			bounds.extents = vec3(width*0.5f, FLOAT_MAX, depth*0.5f);
-			if(n == 0)	// left-top
+		u32 child = elem*4+1;
+		if(child >= space_count) continue;
+		for(u32 i=0; i<4; i++)
+		{
+			const CollisionQuadTreeNode &c = nodes[child+i];
+			if(c.subtree_layers == 0) continue;
+			if(c.bounds.intersects(box))
 			{
-				bounds.center = parent_space->bounds.center + vec3(-width*0.5f, 0.0f, -depth*0.5f);
+				stack[stack_count++] = child+i;
 			}
-			else if(n == 1)	// right-top
+		}
+	}
+	if(stats_counters)
+	{
+		stats_counters->nodes += visited;
+		stats_counters->candidates += (u32)indices->size();
+	}
+	return (int)indices->size();
+}
+
+int CollisionQuadTree::query_colliders(const bounds_t &bounds, u32 layermask, std::vector<ColliderRef> *list) const
+{
+	if(list == nullptr) return 0;
+
+	std::vector<u32> indices;
+	query(bounds, layermask, &indices);
+	list->clear();
+	for(size_t i=0; i<indices.size(); i++)
+	{
+		list->push_back(colliders[indices[i]]);
+	}
+	return (int)list->size();
+}
+
+// finds the nearest hit along the ray (or the swept sphere when sphere is set)
+// the awake colliders are tested first, then the nodes are visited front to back and the ray is shortened
+// to the nearest hit found so far, so nodes and colliders behind it are skipped. returns on the first hit when rayhit is null
+// the bounds of the whole sweep reject most colliders and nodes before the slab test, short casts like the ball's
+// ground probe overlap few of them
+bool CollisionQuadTree::cast_nearest(const ray_t &ray, float radius, bool sphere, u32 layermask, RayHit *rayhit) const
+{
+	float length = ray.dir.len();
+	if(length <= 0.0f) return false;
+
+	vec3 dir = ray.dir / length;
+	vec3 inv_dir = safe_inv_dir(ray.dir);
+	vec3 r = sphere ? vec3(radius, radius, radius) : vec3();
+	bounds_t sweep_bounds(ray.pos, r);
+	sweep_bounds.encapsulate(bounds_t(ray.pos + ray.dir, r));
+	const aabb_t sweep(sweep_bounds);
+
+	RayHit nearest_hit = {};
+	nearest_hit.distance = length;
+	u32 nearest_index = QUADTREE_INVALID_INDEX;
+	float nearest = length;
+	CollisionQueryStats counters = {};
+
+	// tests a range of colliders against the ray up to the nearest hit, returns true on a hit when rayhit is null
+	auto cast_range = [&](const u32 *range, const aabb_t *range_bounds, u32 count) -> bool
+	{
+		float t;
+		for(u32 i=0; i<count; i++)
+		{
+			if(nearest <= 0.0f) break;
+			if(!range_bounds[i].intersects(sweep)) continue;
+			if(!ray_vs_bounds(ray.pos, inv_dir, nearest / length, range_bounds[i].min - r, range_bounds[i].max + r, &t)) continue;
+			const Collider *c = colliders[range[i]].get();
+			if(!c->enabled || (layermask & (1u << c->layer)) == 0) continue;
+
+			ray_t segment(ray.pos, dir * nearest);
+			RayHit hit = {};
+			hit.distance = nearest;
+			counters.candidates++;
+			counters.tests++;
+			bool result = sphere ? c->intersect_spherecast(segment, radius, &hit) : c->intersect_ray(segment, &hit);
+			if(!result) continue;
+			if(rayhit == nullptr) return true;
+
+			if(nearest_index == QUADTREE_INVALID_INDEX || hit.distance < nearest_hit.distance)
 			{
-				bounds.center = parent_space->bounds.center + vec3(width*0.5f, 0.0f, -depth*0.5f);
+				nearest_hit = hit;
+				nearest_index = range[i];
+				nearest = fminf(nearest, fmaxf(hit.distance, 0.0f));
 			}
-			else if(n == 2)	// left-bottom
+		}
+		return false;
+	};
+
+	bool found = cast_range(awake_items.data(), awake_bounds.data(), (u32)awake_items.size());
+
+	struct NodeEntry
+	{
+		u32 elem;
+		float t;	// entry parameter of the ray (0 to 1)
+	};
+	NodeEntry stack[MAX_LEVEL*3+1];
+	int stack_count = 0;
+
+	float t;
+	if(!found && !nodes.empty() && (nodes[0].subtree_layers & layermask) &&
+		ray_vs_bounds(ray.pos, inv_dir, 1.0f, nodes[0].bounds.min - r, nodes[0].bounds.max + r, &t))
+	{
+		stack[stack_count++] = {0, t};
+	}
+
+	while(stack_count > 0)
+	{
+		NodeEntry entry = stack[--stack_count];
+		if(entry.t * length > nearest) continue;
+
+		const CollisionQuadTreeNode &node = nodes[entry.elem];
+		counters.nodes++;
+		if(node.layers & layermask)
+		{
+			if(cast_range(&items[node.first], &item_bounds[node.first], node.count))
 			{
-				bounds.center = parent_space->bounds.center + vec3(-width*0.5f, 0.0f, depth*0.5f);
+				found = true;
+				break;
 			}
-			else if(n == 3)	// right-bottom
+		}
+		if(nearest <= 0.0f) break;	// nothing can be nearer
+
+		u32 child = entry.elem*4+1;
+		if(child >= space_count) continue;
+
+		// push the children far to near so the nearest one is visited first
+		NodeEntry children[4];
+		int child_count = 0;
+		for(u32 i=0; i<4; i++)
+		{
+			const CollisionQuadTreeNode &c = nodes[child+i];
+			if((c.subtree_layers & layermask) == 0 || !c.bounds.intersects(sweep)) continue;
+			if(!ray_vs_bounds(ray.pos, inv_dir, nearest / length, c.bounds.min - r, c.bounds.max + r, &t)) continue;
+
+			int j = child_count++;
+			for(; j > 0 && children[j-1].t < t; j--)
 			{
-				bounds.center = parent_space->bounds.center + vec3(width*0.5f, 0.0f, depth*0.5f);
+				children[j] = children[j-1];
 			}
+			children[j] = {child+i, t};
 		}
-		else
+		for(int i=0; i<child_count; i++)
 		{
-			// root space
-			bounds = this->bounds;
+			stack[stack_count++] = children[i];
 		}
-		spaces[elem]->bounds = bounds;
 	}
+
+	found = found || nearest_index != QUADTREE_INVALID_INDEX;
+	counters.hits = found ? 1 : 0;
+	if(stats_counters) add_query_stats(stats_counters, counters);
+
+	if(!found) return false;
+	if(rayhit == nullptr) return true;
+	nearest_hit.collider = colliders[nearest_index];
+	*rayhit = nearest_hit;
 	return true;
 }
 
-u32 CollisionQuadTree::bit_separete32(u32 n)
+u32 CollisionQuadTree::bit_separete32(u32 n) const
 {
 	n = (n|(n<<8)) & 0x00ff00ff;
 	n = (n|(n<<4)) & 0x0f0f0f0f;
@@ -227,22 +870,37 @@ u32 CollisionQuadTree::bit_separete32(u32 n)
 	return (n|(n<<1)) & 0x55555555;
 }
 
-u32 CollisionQuadTree::get_morton_number(u32 x, u32 y)
+u32 CollisionQuadTree::get_morton_number(u32 x, u32 y) const
 {
 	return bit_separete32(x) | (bit_separete32(y) << 1);
 }
 
+// morton number of the point on a 2048x2048 grid over the tree (22 bits), nearby points get nearby keys
+u32 CollisionQuadTree::get_point_key(const vec3 &point) const
+{
+	vec3 min = bounds.get_min();
+	float x = clamp01((point.x - min.x) / width) * 2047.0f;
+	float z = clamp01((point.z - min.z) / depth) * 2047.0f;
+	return get_morton_number((u32)x, (u32)z);
+}
+
 // woldspace to morton number
 u32 CollisionQuadTree::get_point_elem(float x, float y)
 {
 	vec3 min = bounds.get_min();
-	return get_morton_number((u32)((x-min.x)/unit_w), (u32)((y-min.z)/unit_d));
+	float last = (float)((1u << level) - 1);
+	return get_morton_number((u32)clamp((x-min.x)/unit_w, 0.0f, last), (u32)clamp((y-min.z)/unit_d, 0.0f, last));
 }
 
+// returns QUADTREE_INVALID_INDEX for bounds reaching out of the world, the morton numbers of outside cells are meaningless
 u32 CollisionQuadTree::get_space_number(const bounds_t &bounds)
 {
 	vec3 min = bounds.get_min();
 	vec3 max = bounds.get_max();
+	vec3 world_min = this->bounds.get_min();
+	bool inside = min.x >= world_min.x && min.z >= world_min.z && max.x < world_min.x + width && max.z < world_min.z + depth;
+	if(!inside) return QUADTREE_INVALID_INDEX;	// also catches NaN
+
 	u32 lt = get_point_elem(min.x, min.z);
 	u32 rb = get_point_elem(max.x, max.z);
 	u32 def = rb ^ lt;
@@ -258,8 +916,8 @@ u32 CollisionQuadTree::get_space_number(const bounds_t &bounds)
 	u32 addnum = (space_count_of_level[level - hilevel]-1)/3;
 	space_num += addnum;
 
-	if(space_num > space_count)
-		return 0xffffffff;
+	if(space_num >= space_count)
+		return QUADTREE_INVALID_INDEX;
 
 	return space_num;
 }
@@ -267,398 +925,1630 @@ u32 CollisionQuadTree::get_space_number(const bounds_t &bounds)
 
 
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// Mesh BVH
+// bounding volume hierarchy over the triangles of a mesh collider (binned SAH build)
+struct MeshBVHNode
+{
+	vec3 min;
+	vec3 max;
+	u32 first;	// first triangle if the node is a leaf, otherwise the left child index (right child is first+1)
+	u32 count;	// triangle count, 0 for inner nodes
+};
 
+#define BVH_BIN_COUNT 12
+#define BVH_MAX_LEAF_TRIANGLES 8
+#define BVH_STACK_SIZE 64
+#define BVH_MAX_DEPTH (BVH_STACK_SIZE/2)	// a traversal holds at most one entry per level plus one, so the stack never overflows
 
-static struct collision_ctx
+struct BVHBuildTriangle
 {
-	CollisionQuadTree tree;
-} ctx = {};
+	vec3 min;
+	vec3 max;
+	vec3 centroid;
+};
 
-void collision_init()
+static float bvh_half_area(const vec3 &min, const vec3 &max)
 {
-	ctx.tree.init(5, bounds_t(vec3(), vec3(500, 500, 500)));
+	vec3 e = max - min;
+	return e.x*e.y + e.y*e.z + e.z*e.x;
 }
 
-void collision_uninit()
+static void bvh_update_node_bounds(MeshBVHNode *node, const BVHBuildTriangle *tris, const u32 *order)
 {
-	ctx.tree.uninit();
+	node->min = vec3(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX);
+	node->max = vec3(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX);
+	for(u32 i=node->first; i<node->first+node->count; i++)
+	{
+		node->min = vec3::min(node->min, tris[order[i]].min);
+		node->max = vec3::max(node->max, tris[order[i]].max);
+	}
 }
 
-ColliderRef create_sphere_collider(float radius, const vec3 &offset)
+static void bvh_subdivide(std::vector<MeshBVHNode> &nodes, u32 node_index, const BVHBuildTriangle *tris, u32 *order, u32 depth)
 {
-	ColliderRef c = std::make_shared<Collider>();
-	c->enabled = true;
-	c->type = ColliderType::SPHERE;
-	c->layer = 1;
-	c->offset = offset;
-	c->sphere.radius = radius;
-	c->bounds = bounds_t(offset, vec3(radius, radius, radius));
-	ctx.tree.add(c);
-
-	return c;
-}
+	MeshBVHNode node = nodes[node_index];
+	if(node.count <= 2) return;
+	if(depth >= BVH_MAX_DEPTH) return;	// a larger leaf instead of a deeper tree
+
+	// centroid bounds of the node
+	vec3 cmin = vec3(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX);
+	vec3 cmax = vec3(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX);
+	for(u32 i=node.first; i<node.first+node.count; i++)
+	{
+		cmin = vec3::min(cmin, tris[order[i]].centroid);
+		cmax = vec3::max(cmax, tris[order[i]].centroid);
+	}
 
-ColliderRef create_box_collider(const vec3 &center, const vec3 &size)
-{
-	ColliderRef c = std::make_shared<Collider>();
-	c->enabled = true;
-	c->type = ColliderType::BOX;
-	c->layer = 1;
-	c->offset = center;
-	c->size = size;
-	c->bounds = bounds_t(center, size * 0.5f);
-	ctx.tree.add(c);
+	// find the cheapest split plane with binned SAH
+	float best_cost = FLOAT_MAX;
+	int best_axis = -1;
+	int best_split = 0;
+	for(int axis=0; axis<3; axis++)
+	{
+		float bmin = (&cmin.x)[axis];
+		float bmax = (&cmax.x)[axis];
+		if(bmax - bmin <= EPSILON) continue;
 
-	return c;
-}
+		struct {vec3 min, max; u32 count;} bins[BVH_BIN_COUNT];
+		for(int b=0; b<BVH_BIN_COUNT; b++)
+		{
+			bins[b].min = vec3(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX);
+			bins[b].max = vec3(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX);
+			bins[b].count = 0;
+		}
 
-ColliderRef create_capsule_collider(const vec3 &offset, const vec3 &dir, float radius, float height)
-{
-	ColliderRef c = std::make_shared<Collider>();
-	c->enabled = true;
-	c->type = ColliderType::CAPSULE;
-	c->layer = 1;
-	c->offset = offset;
-	c->capsule.dir = dir.normalized();
-	c->capsule.radius = radius;
-	c->capsule.height = height;
-	c->bounds = bounds_t();
-	c->bounds.encapsulate(offset + (dir * height * 0.5f) + vec3(radius, radius, radius));
-	c->bounds.encapsulate(offset - (dir * height * 0.5f) - vec3(radius, radius, radius));
-	ctx.tree.add(c);
+		float scale = BVH_BIN_COUNT / (bmax - bmin);
+		for(u32 i=node.first; i<node.first+node.count; i++)
+		{
+			const BVHBuildTriangle &tri = tris[order[i]];
+			int b = (int)(((&tri.centroid.x)[axis] - bmin) * scale);
+			b = b < BVH_BIN_COUNT-1 ? b : BVH_BIN_COUNT-1;
+			bins[b].min = vec3::min(bins[b].min, tri.min);
+			bins[b].max = vec3::max(bins[b].max, tri.max);
+			bins[b].count++;
+		}
 
-	return c;
-}
+		// sweep the bins from both sides
+		float left_area[BVH_BIN_COUNT-1], right_area[BVH_BIN_COUNT-1];
+		u32 left_count[BVH_BIN_COUNT-1], right_count[BVH_BIN_COUNT-1];
+		vec3 lmin = vec3(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX), lmax = vec3(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX);
+		vec3 rmin = lmin, rmax = lmax;
+		u32 lsum = 0, rsum = 0;
+		for(int b=0; b<BVH_BIN_COUNT-1; b++)
+		{
+			lsum += bins[b].count;
+			left_count[b] = lsum;
+			lmin = vec3::min(lmin, bins[b].min);
+			lmax = vec3::max(lmax, bins[b].max);
+			left_area[b] = lsum > 0 ? bvh_half_area(lmin, lmax) : 0.0f;
+
+			int rb = BVH_BIN_COUNT-1-b;
+			rsum += bins[rb].count;
+			right_count[rb-1] = rsum;
+			rmin = vec3::min(rmin, bins[rb].min);
+			rmax = vec3::max(rmax, bins[rb].max);
+			right_area[rb-1] = rsum > 0 ? bvh_half_area(rmin, rmax) : 0.0f;
+		}
 
-static bounds_t calc_mesh_bounds(const vec3 *vertices, u32 count)
-{
-	if(count <= 0) return bounds_t();
+		for(int b=0; b<BVH_BIN_COUNT-1; b++)
+		{
+			if(left_count[b] == 0 || right_count[b] == 0) continue;
+			float cost = left_area[b] * left_count[b] + right_area[b] * right_count[b];
+			if(cost < best_cost)
+			{
+				best_cost = cost;
+				best_axis = axis;
+				best_split = b;
+			}
+		}
+	}
 
-	bounds_t b(vertices[0], vec3(0,0,0));
-	for(u32 i=1; i<count; i++)
+	// stop if splitting is not cheaper than testing every triangle of the node
+	float leaf_cost = bvh_half_area(node.min, node.max) * node.count;
+	if(best_axis < 0) return;
+	if(best_cost >= leaf_cost && node.count <= BVH_MAX_LEAF_TRIANGLES) return;
+
+	// partition triangles
+	float bmin = (&cmin.x)[best_axis];
+	float scale = BVH_BIN_COUNT / ((&cmax.x)[best_axis] - bmin);
+	int i = (int)node.first;
+	int j = (int)(node.first + node.count) - 1;
+	while(i <= j)
 	{
-		b.encapsulate(vertices[i]);
+		int b = (int)(((&tris[order[i]].centroid.x)[best_axis] - bmin) * scale);
+		b = b < BVH_BIN_COUNT-1 ? b : BVH_BIN_COUNT-1;
+		if(b <= best_split)
+		{
+			i++;
+		}
+		else
+		{
+			u32 tmp = order[i];
+			order[i] = order[j];
+			order[j] = tmp;
+			j--;
+		}
 	}
-	return b;
-}
-
-ColliderRef create_mesh_collider(const vec3 *vertices, u32 count, const vec3 &offset)
-{
-	if(!vertices || count <= 0) return nullptr;
-
-	ColliderRef c = std::make_shared<Collider>();
-	c->enabled = true;
-	c->type = ColliderType::MESH;
-	c->layer = 1;
-	c->offset = offset;
-	c->bounds = calc_mesh_bounds(vertices, count);
-	
-	c->mesh.vertices = new vec3[count];
-	c->mesh.count = count;
-	memcpy(c->mesh.vertices, vertices, sizeof(vec3)*count);
-	ctx.tree.add(c);
 
-	return c;
+	u32 left_count = (u32)i - node.first;
+	if(left_count == 0 || left_count == node.count) return;
+
+	// create children
+	u32 left = (u32)nodes.size();
+	MeshBVHNode child = {};
+	child.first = node.first;
+	child.count = left_count;
+	bvh_update_node_bounds(&child, tris, order);
+	nodes.push_back(child);
+	child.first = (u32)i;
+	child.count = node.count - left_count;
+	bvh_update_node_bounds(&child, tris, order);
+	nodes.push_back(child);
+
+	nodes[node_index].first = left;
+	nodes[node_index].count = 0;
+
+	bvh_subdivide(nodes, left, tris, order, depth+1);
+	bvh_subdivide(nodes, left+1, tris, order, depth+1);
 }
 
-ColliderRef create_mesh_collider(const Vertex *vertices, u32 count, const vec3 &offset)
+// builds the BVH and reorders the triangles of the index array to the leaf order
+static MeshBVHNode* build_mesh_bvh(const vec3 *vertices, u32 *indices, u32 tri_count, int *node_count)
 {
-	if(!vertices || count <= 0) return nullptr;
+	*node_count = 0;
+	if(tri_count == 0) return nullptr;
 
-	vec3 *points = new vec3[count];
-	for(u32 i=0; i<count; i++)
+	std::vector<BVHBuildTriangle> tris(tri_count);
+	std::vector<u32> order(tri_count);
+	for(u32 i=0; i<tri_count; i++)
 	{
-		points[i] = vertices[i].position;
+		const vec3 &v0 = vertices[indices[i*3]];
+		const vec3 &v1 = vertices[indices[i*3+1]];
+		const vec3 &v2 = vertices[indices[i*3+2]];
+		tris[i].min = vec3::min(v0, vec3::min(v1, v2));
+		tris[i].max = vec3::max(v0, vec3::max(v1, v2));
+		tris[i].centroid = (v0 + v1 + v2) * (1.0f/3.0f);
+		order[i] = i;
 	}
-	ColliderRef c = create_mesh_collider(points, count, offset);
-	delete [] points;
 
-	return c;
+	std::vector<MeshBVHNode> nodes;
+	nodes.reserve(tri_count * 2);
+	MeshBVHNode root = {};
+	root.first = 0;
+	root.count = tri_count;
+	bvh_update_node_bounds(&root, tris.data(), order.data());
+	nodes.push_back(root);
+	bvh_subdivide(nodes, 0, tris.data(), order.data(), 0);
+
+	// reorder the triangles so each leaf references a contiguous range
+	std::vector<u32> sorted(tri_count * 3);
+	for(u32 i=0; i<tri_count; i++)
+	{
+		sorted[i*3] = indices[order[i]*3];
+		sorted[i*3+1] = indices[order[i]*3+1];
+		sorted[i*3+2] = indices[order[i]*3+2];
+	}
+	memcpy(indices, sorted.data(), sizeof(u32)*tri_count*3);
+
+	*node_count = (int)nodes.size();
+	MeshBVHNode *result = new MeshBVHNode[nodes.size()];
+	memcpy(result, nodes.data(), sizeof(MeshBVHNode)*nodes.size());
+	return result;
 }
 
-ColliderRef create_mesh_collider(MeshRef mesh, const vec3 &offset)
+static inline bool ray_vs_bvh_node(const vec3 &pos, const vec3 &inv_dir, float max_distance, const MeshBVHNode &node, float *distance)
 {
-	if(!mesh) return nullptr;
+	return ray_vs_bounds(pos, inv_dir, max_distance, node.min, node.max, distance);
+}
 
-	const Vertex *vertices = mesh->get_vertices();
-	u32 index_count = mesh->get_index_count();
-	const u16 *indices = mesh->get_indices();
-	vec3 *points = new vec3[index_count];
-	for(u32 i=0; i<index_count; i++)
-	{
-		points[i] = vertices[indices[i]].position;
-	}
 
-	ColliderRef collider = create_mesh_collider(points, index_count, offset);
-	delete [] points;
-	return collider;
-}
 
-void free_collider(ColliderRef collider)
+/////////////////////////////////////////////////////////////////////////////////////////
+// Mesh triangles
+// structure of arrays copy of the triangle soup in BVH leaf order for the batched ray and sphere tests
+#if defined(COLLISION_SIMD_AVX2)
+#define SIMD_WIDTH 8
+typedef __m256 simd_t;
+static inline simd_t simd_set(float f){return _mm256_set1_ps(f);}
+static inline simd_t simd_load(const float *p){return _mm256_loadu_ps(p);}
+static inline void simd_store(float *p, simd_t a){_mm256_storeu_ps(p, a);}
+static inline simd_t simd_add(simd_t a, simd_t b){return _mm256_add_ps(a, b);}
+static inline simd_t simd_sub(simd_t a, simd_t b){return _mm256_sub_ps(a, b);}
+static inline simd_t simd_mul(simd_t a, simd_t b){return _mm256_mul_ps(a, b);}
+static inline simd_t simd_div(simd_t a, simd_t b){return _mm256_div_ps(a, b);}
+static inline simd_t simd_and(simd_t a, simd_t b){return _mm256_and_ps(a, b);}
+static inline simd_t simd_or(simd_t a, simd_t b){return _mm256_or_ps(a, b);}
+static inline simd_t simd_ge(simd_t a, simd_t b){return _mm256_cmp_ps(a, b, _CMP_GE_OQ);}
+static inline simd_t simd_le(simd_t a, simd_t b){return _mm256_cmp_ps(a, b, _CMP_LE_OQ);}
+static inline simd_t simd_gt(simd_t a, simd_t b){return _mm256_cmp_ps(a, b, _CMP_GT_OQ);}
+static inline simd_t simd_lt(simd_t a, simd_t b){return _mm256_cmp_ps(a, b, _CMP_LT_OQ);}
+static inline simd_t simd_eq(simd_t a, simd_t b){return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);}
+static inline simd_t simd_min(simd_t a, simd_t b){return _mm256_min_ps(a, b);}
+static inline simd_t simd_max(simd_t a, simd_t b){return _mm256_max_ps(a, b);}
+static inline simd_t simd_sqrt(simd_t a){return _mm256_sqrt_ps(a);}
+static inline simd_t simd_select(simd_t mask, simd_t a, simd_t b){return _mm256_blendv_ps(b, a, mask);}
+static inline int simd_mask(simd_t a){return _mm256_movemask_ps(a);}
+#elif defined(COLLISION_SIMD_SSE2)
+#define SIMD_WIDTH 4
+typedef __m128 simd_t;
+static inline simd_t simd_set(float f){return _mm_set1_ps(f);}
+static inline simd_t simd_load(const float *p){return _mm_loadu_ps(p);}
+static inline void simd_store(float *p, simd_t a){_mm_storeu_ps(p, a);}
+static inline simd_t simd_add(simd_t a, simd_t b){return _mm_add_ps(a, b);}
+static inline simd_t simd_sub(simd_t a, simd_t b){return _mm_sub_ps(a, b);}
+static inline simd_t simd_mul(simd_t a, simd_t b){return _mm_mul_ps(a, b);}
+static inline simd_t simd_div(simd_t a, simd_t b){return _mm_div_ps(a, b);}
+static inline simd_t simd_and(simd_t a, simd_t b){return _mm_and_ps(a, b);}
+static inline simd_t simd_or(simd_t a, simd_t b){return _mm_or_ps(a, b);}
+static inline simd_t simd_ge(simd_t a, simd_t b){return _mm_cmpge_ps(a, b);}
+static inline simd_t simd_le(simd_t a, simd_t b){return _mm_cmple_ps(a, b);}
+static inline simd_t simd_gt(simd_t a, simd_t b){return _mm_cmpgt_ps(a, b);}
+static inline simd_t simd_lt(simd_t a, simd_t b){return _mm_cmplt_ps(a, b);}
+static inline simd_t simd_eq(simd_t a, simd_t b){return _mm_cmpeq_ps(a, b);}
+static inline simd_t simd_min(simd_t a, simd_t b){return _mm_min_ps(a, b);}
+static inline simd_t simd_max(simd_t a, simd_t b){return _mm_max_ps(a, b);}
+static inline simd_t simd_sqrt(simd_t a){return _mm_sqrt_ps(a);}
+static inline simd_t simd_select(simd_t mask, simd_t a, simd_t b){return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));}
+static inline int simd_mask(simd_t a){return _mm_movemask_ps(a);}
+#else
+#define SIMD_WIDTH 1
+#endif
+
+struct MeshTriangleSoA
 {
-	if(collider == nullptr) return;
+	float *data;
+	float *v0[3];
+	float *e1[3];
+	float *e2[3];
+	float *n[3];	// unit normal, zero for degenerate triangles and the padding
+	u32 count;
+};
 
-	ctx.tree.remove(collider);
+// zero for a degenerate triangle
+static vec3 triangle_unit_normal(const vec3 &v0, const vec3 &v1, const vec3 &v2)
+{
+	vec3 n = vec3::cross(v1 - v0, v2 - v0);
+	float len = n.len();
+	return len > 0.0f ? n / len : vec3();
 }
 
-
-int raycast(const ray_t &ray, RayHit *rayhit, u32 layermask)
+static MeshTriangleSoA* create_mesh_triangle_soa(const vec3 *vertices, const u32 *indices, u32 tri_count)
 {
-	const int RAYHIT_COUNT = 64;
-	RayHit rayhits[RAYHIT_COUNT] = {};
-	if(raycast_all(ray, rayhits, RAYHIT_COUNT, layermask) > 0)
+	// pad with degenerate triangles so a batch never reads past the end
+	u32 stride = tri_count + SIMD_WIDTH;
+	MeshTriangleSoA *soa = new MeshTriangleSoA();
+	soa->data = new float[stride * 12]();
+	soa->count = tri_count;
+	for(int axis=0; axis<3; axis++)
 	{
-		*rayhit = rayhits[0];
-		return 1;
+		soa->v0[axis] = soa->data + stride * axis;
+		soa->e1[axis] = soa->data + stride * (axis+3);
+		soa->e2[axis] = soa->data + stride * (axis+6);
+		soa->n[axis] = soa->data + stride * (axis+9);
 	}
 
-	return 0;
+	for(u32 i=0; i<tri_count; i++)
+	{
+		vec3 v0 = vertices[indices[i*3]];
+		vec3 e1 = vertices[indices[i*3+1]] - v0;
+		vec3 e2 = vertices[indices[i*3+2]] - v0;
+		vec3 n = triangle_unit_normal(v0, vertices[indices[i*3+1]], vertices[indices[i*3+2]]);
+		for(int axis=0; axis<3; axis++)
+		{
+			soa->v0[axis][i] = (&v0.x)[axis];
+			soa->e1[axis][i] = (&e1.x)[axis];
+			soa->e2[axis][i] = (&e2.x)[axis];
+			soa->n[axis][i] = (&n.x)[axis];
+		}
+	}
+	return soa;
 }
 
-int raycast_all(const ray_t &ray, RayHit *rayhit, int rayhit_count, u32 layermask)
+static void free_mesh_triangle_soa(MeshTriangleSoA *soa)
 {
-	int hit_count = 0;
-	static std::vector<ColliderRef> colliders;
-	colliders.clear();
+	if(soa == nullptr) return;
+	delete[] soa->data;
+	delete soa;
+}
 
-	bounds_t bounds;
-	bounds.encapsulate(ray.pos);
-	bounds.encapsulate(ray.pos + ray.dir);
+// the triangle edges are widened a little like the heightfield cells, so rays along a shared edge hit one of the triangles
+static const float TRIANGLE_EDGE_TOLERANCE = 1e-5f;
 
-	ctx.tree.query_colliders(bounds, &colliders);
-	for(int i=0; i<(int)colliders.size(); i++)
+// Moller-Trumbore test against the triangles [first, first+count), the direction must be normalized
+// updates nearest and nearest_index when a closer hit is found
+// the scalar loop is the kernel without SIMD, the kernel tests build it next to the SIMD one to compare them
+#if SIMD_WIDTH == 1 || defined(COLLISION_KERNEL_TESTS)
+static bool ray_vs_triangles_scalar(const vec3 &pos, const vec3 &dir, const MeshTriangleSoA *tris, u32 first, u32 count, float *nearest, u32 *nearest_index)
+{
+	const float edge_tolerance = TRIANGLE_EDGE_TOLERANCE;
+	bool hited = false;
+	u32 end = first + count;
+	for(u32 i=first; i<end; i++)
 	{
-		ColliderRef c = colliders[i];
-		RayHit hitinfo = {};
-		if(c->intersect_ray(ray, &hitinfo))
+		float e1x = tris->e1[0][i], e1y = tris->e1[1][i], e1z = tris->e1[2][i];
+		float e2x = tris->e2[0][i], e2y = tris->e2[1][i], e2z = tris->e2[2][i];
+
+		float px = dir.y*e2z - dir.z*e2y;
+		float py = dir.z*e2x - dir.x*e2z;
+		float pz = dir.x*e2y - dir.y*e2x;
+		float det = e1x*px + e1y*py + e1z*pz;
+		if((det > -EPSILON) && (det < EPSILON)) continue;
+		float invdet = 1.0f/det;
+
+		float tvx = pos.x - tris->v0[0][i];
+		float tvy = pos.y - tris->v0[1][i];
+		float tvz = pos.z - tris->v0[2][i];
+		float u = (tvx*px + tvy*py + tvz*pz) * invdet;
+		if((u < -edge_tolerance) || (u > 1.0f + edge_tolerance)) continue;
+
+		float qx = tvy*e1z - tvz*e1y;
+		float qy = tvz*e1x - tvx*e1z;
+		float qz = tvx*e1y - tvy*e1x;
+		float v = (dir.x*qx + dir.y*qy + dir.z*qz) * invdet;
+		if((v < -edge_tolerance) || ((u + v) > 1.0f + edge_tolerance)) continue;
+
+		float t = (e2x*qx + e2y*qy + e2z*qz) * invdet;
+		if(t > EPSILON && t < *nearest)
 		{
-			hitinfo.collider = c;
-			rayhit[hit_count] = hitinfo;
-			hit_count++;
-			if(hit_count >= rayhit_count) break;
+			*nearest = t;
+			*nearest_index = i;
+			hited = true;
 		}
 	}
-	colliders.clear();
 
-	// sort hit infomation with the hit distance
-	for(int i=0; i<hit_count; i++){
-		for(int j=i+1; j<hit_count; j++){
-			if(rayhit[i].distance > rayhit[j].distance)
+	return hited;
+}
+#endif
+
+// the same test on SIMD_WIDTH triangles at a time
+static bool ray_vs_triangles(const vec3 &pos, const vec3 &dir, const MeshTriangleSoA *tris, u32 first, u32 count, float *nearest, u32 *nearest_index)
+{
+#if SIMD_WIDTH > 1
+	const float edge_tolerance = TRIANGLE_EDGE_TOLERANCE;
+	bool hited = false;
+	u32 end = first + count;
+
+	simd_t ox = simd_set(pos.x), oy = simd_set(pos.y), oz = simd_set(pos.z);
+	simd_t dx = simd_set(dir.x), dy = simd_set(dir.y), dz = simd_set(dir.z);
+	simd_t low = simd_set(-edge_tolerance);
+	simd_t high = simd_set(1.0f + edge_tolerance);
+	simd_t one = simd_set(1.0f);
+	simd_t eps = simd_set(EPSILON);
+	simd_t neg_eps = simd_set(-EPSILON);
+	simd_t tmax = simd_set(*nearest);
+
+	// lanes past the end of the range test the following triangles or the padding, both are harmless
+	for(u32 i=first; i<end; i+=SIMD_WIDTH)
+	{
+		simd_t e1x = simd_load(tris->e1[0]+i), e1y = simd_load(tris->e1[1]+i), e1z = simd_load(tris->e1[2]+i);
+		simd_t e2x = simd_load(tris->e2[0]+i), e2y = simd_load(tris->e2[1]+i), e2z = simd_load(tris->e2[2]+i);
+
+		// p = cross(dir, e2)
+		simd_t px = simd_sub(simd_mul(dy, e2z), simd_mul(dz, e2y));
+		simd_t py = simd_sub(simd_mul(dz, e2x), simd_mul(dx, e2z));
+		simd_t pz = simd_sub(simd_mul(dx, e2y), simd_mul(dy, e2x));
+		simd_t det = simd_add(simd_add(simd_mul(e1x, px), simd_mul(e1y, py)), simd_mul(e1z, pz));
+		simd_t mask = simd_or(simd_ge(det, eps), simd_le(det, neg_eps));
+		if(simd_mask(mask) == 0) continue;
+		simd_t invdet = simd_div(one, det);
+
+		simd_t tvx = simd_sub(ox, simd_load(tris->v0[0]+i));
+		simd_t tvy = simd_sub(oy, simd_load(tris->v0[1]+i));
+		simd_t tvz = simd_sub(oz, simd_load(tris->v0[2]+i));
+		simd_t u = simd_mul(simd_add(simd_add(simd_mul(tvx, px), simd_mul(tvy, py)), simd_mul(tvz, pz)), invdet);
+		mask = simd_and(mask, simd_and(simd_ge(u, low), simd_le(u, high)));
+
+		// q = cross(tv, e1)
+		simd_t qx = simd_sub(simd_mul(tvy, e1z), simd_mul(tvz, e1y));
+		simd_t qy = simd_sub(simd_mul(tvz, e1x), simd_mul(tvx, e1z));
+		simd_t qz = simd_sub(simd_mul(tvx, e1y), simd_mul(tvy, e1x));
+		simd_t v = simd_mul(simd_add(simd_add(simd_mul(dx, qx), simd_mul(dy, qy)), simd_mul(dz, qz)), invdet);
+		mask = simd_and(mask, simd_and(simd_ge(v, low), simd_le(simd_add(u, v), high)));
+
+		simd_t t = simd_mul(simd_add(simd_add(simd_mul(e2x, qx), simd_mul(e2y, qy)), simd_mul(e2z, qz)), invdet);
+		mask = simd_and(mask, simd_and(simd_gt(t, eps), simd_lt(t, tmax)));
+
+		int bits = simd_mask(mask);
+		if(bits == 0) continue;
+
+		float ts[SIMD_WIDTH];
+		simd_store(ts, t);
+		for(int l=0; l<SIMD_WIDTH; l++)
+		{
+			if((bits & (1<<l)) && ts[l] < *nearest)
 			{
-				RayHit tmp = rayhit[i];
-				rayhit[i] = rayhit[j];
-				rayhit[j] = tmp;
+				*nearest = ts[l];
+				*nearest_index = i + l;
+				hited = true;
 			}
 		}
+		tmax = simd_set(*nearest);
 	}
+	return hited;
+#else
+	return ray_vs_triangles_scalar(pos, dir, tris, first, count, nearest, nearest_index);
+#endif
+}
 
-	return hit_count;
+#if SIMD_WIDTH > 1
+static inline simd_t simd_dot(simd_t ax, simd_t ay, simd_t az, simd_t bx, simd_t by, simd_t bz)
+{
+	return simd_add(simd_add(simd_mul(ax, bx), simd_mul(ay, by)), simd_mul(az, bz));
 }
 
-// http://marupeke296.com/COL_3D_No24_RayToSphere.html
-bool ray_vs_sphere(const ray_t &ray, const vec3 &pos, float radius, RayHit *hitinfo)
+// the components of a x b
+static inline void simd_cross(simd_t ax, simd_t ay, simd_t az, simd_t bx, simd_t by, simd_t bz, simd_t *cx, simd_t *cy, simd_t *cz)
 {
-	vec3 ray_normal = ray.dir.normalized();
-	vec3 P = pos - ray.pos;
-	float A = vec3::dot(ray_normal, ray_normal);
-	float B = vec3::dot(ray_normal, P);
-	float C = vec3::dot(P,P) - (radius*radius);
+	*cx = simd_sub(simd_mul(ay, bz), simd_mul(az, by));
+	*cy = simd_sub(simd_mul(az, bx), simd_mul(ax, bz));
+	*cz = simd_sub(simd_mul(ax, by), simd_mul(ay, bx));
+}
 
-	if(A == 0.0f) return false;	// ray distance is 0
+// entry time of the sphere into a vertex, q is the vertex relative to the sphere center
+// a starting overlap enters at 0. the discriminant is taken from the distance of the vertex to the line of motion
+// like sweep_to_point, so the filter keeps the grazing hits the scalar test finds
+static inline simd_t sphere_vertex_time(simd_t qx, simd_t qy, simd_t qz, simd_t vx, simd_t vy, simd_t vz, simd_t vv, simd_t inv_vv, simd_t rho2)
+{
+	simd_t zero = simd_set(0.0f);
+	simd_t cx, cy, cz;
+	simd_cross(vx, vy, vz, qx, qy, qz, &cx, &cy, &cz);
+	simd_t d = simd_sub(simd_mul(vv, rho2), simd_dot(cx, cy, cz, cx, cy, cz));
+	simd_t sq = simd_sqrt(simd_max(d, zero));
+	simd_t vq = simd_dot(vx, vy, vz, qx, qy, qz);
+	simd_t lo = simd_mul(simd_sub(vq, sq), inv_vv);
+	simd_t hi = simd_mul(simd_add(vq, sq), inv_vv);
+	simd_t valid = simd_and(simd_ge(d, zero), simd_gt(hi, zero));
+	return simd_select(valid, simd_max(lo, zero), simd_set(FLOAT_MAX));
+}
 
-	float s = B * B - A * C;
-	if(s < 0.0f) return false;	// not hited
+// entry time of the sphere into the edge from q along e, the hit on the infinite line has to be
+// on the segment somewhere between the entry and the limit. solved at a right angle to the edge like sweep_to_edge
+static inline simd_t sphere_edge_time(simd_t qx, simd_t qy, simd_t qz, simd_t ex, simd_t ey, simd_t ez, simd_t vx, simd_t vy, simd_t vz, simd_t rho2, simd_t limit)
+{
+	simd_t zero = simd_set(0.0f);
+	simd_t ax, ay, az, bx, by, bz;
+	simd_cross(vx, vy, vz, ex, ey, ez, &ax, &ay, &az);
+	simd_cross(qx, qy, qz, ex, ey, ez, &bx, &by, &bz);
+	simd_t ee = simd_dot(ex, ey, ez, ex, ey, ez);
+	simd_t aa = simd_dot(ax, ay, az, ax, ay, az);
+	simd_t ab = simd_dot(ax, ay, az, bx, by, bz);
+	simd_t aq = simd_dot(ax, ay, az, qx, qy, qz);
+	simd_t d = simd_mul(ee, simd_sub(simd_mul(aa, rho2), simd_mul(aq, aq)));
+	simd_t sq = simd_sqrt(simd_max(d, zero));
+	simd_t inv_aa = simd_div(simd_set(1.0f), aa);
+	simd_t r1 = simd_mul(simd_sub(ab, sq), inv_aa);
+	simd_t r2 = simd_mul(simd_add(ab, sq), inv_aa);
+
+	// moving along the edge never enters the line, it is a hit only when already inside
+	simd_t parallel = simd_eq(aa, zero);
+	simd_t inside = simd_gt(simd_sub(simd_mul(ee, rho2), simd_dot(bx, by, bz, bx, by, bz)), zero);
+	simd_t valid = simd_and(simd_ge(d, zero), simd_gt(r2, zero));
+	valid = simd_select(parallel, inside, valid);
+	simd_t t = simd_select(parallel, zero, simd_max(r1, zero));
+
+	// the position along the edge is linear in time, (ev*t - eq) / ee
+	simd_t ev = simd_dot(ex, ey, ez, vx, vy, vz);
+	simd_t eq = simd_dot(ex, ey, ez, qx, qy, qz);
+	simd_t f0 = simd_sub(simd_mul(ev, t), eq);
+	simd_t f1 = simd_sub(simd_mul(ev, limit), eq);
+	simd_t eps = simd_mul(ee, simd_set(1e-3f));
+	valid = simd_and(valid, simd_ge(simd_max(f0, f1), simd_sub(zero, eps)));
+	valid = simd_and(valid, simd_le(simd_min(f0, f1), simd_add(ee, eps)));
+	return simd_select(valid, t, simd_set(FLOAT_MAX));
+}
+#endif
 
-	s = sqrtf(s);
-	float a1 = (B - s) / A;
-	//float a2 = (B + s) / A;
+// swept sphere against the triangles [first, first+SIMD_WIDTH), a filter in front of spherecast_to_triangle
+// pos and dir are in model space, the triangles are moved to the start of the sweep and scaled to the unit sphere
+// like spherecast_mesh_triangle does it. returns a bit for every triangle the sphere may hit before max_t (along dir). the sphere is inflated by inflate and
+// sweeps within inflate of parallel to a plane pass, so the rounding of the scalar test never hits a triangle left out
+static int spherecast_vs_triangles(const vec3 &pos, const vec3 &dir, float inv_radius, float inflate, const MeshTriangleSoA *tris, u32 first, float max_t)
+{
+#if SIMD_WIDTH > 1
+	simd_t zero = simd_set(0.0f);
+	simd_t rho = simd_set(1.0f + inflate);
+	simd_t rho2 = simd_mul(rho, rho);
+	simd_t limit = simd_set(fminf(max_t, 1.0f));
+	simd_t s = simd_set(inv_radius);
+	vec3 v = dir * inv_radius;
+	simd_t vx = simd_set(v.x), vy = simd_set(v.y), vz = simd_set(v.z);
+	float v_sqrlen = v.sqrlen();
+	simd_t vv = simd_set(v_sqrlen);
+
+	// the sphere has to move toward the front face and be within the plane slab somewhere before the limit
+	// a sweep almost parallel to the plane passes, the scalar test may see it crossing
+	simd_t nx = simd_load(tris->n[0]+first), ny = simd_load(tris->n[1]+first), nz = simd_load(tris->n[2]+first);
+	simd_t qx = simd_mul(simd_sub(simd_load(tris->v0[0]+first), simd_set(pos.x)), s);
+	simd_t qy = simd_mul(simd_sub(simd_load(tris->v0[1]+first), simd_set(pos.y)), s);
+	simd_t qz = simd_mul(simd_sub(simd_load(tris->v0[2]+first), simd_set(pos.z)), s);
+	simd_t dist = simd_sub(zero, simd_dot(nx, ny, nz, qx, qy, qz));
+	simd_t ndv = simd_dot(nx, ny, nz, vx, vy, vz);
+	simd_t dist_end = simd_add(dist, simd_mul(ndv, limit));
+	simd_t mask = simd_lt(ndv, simd_set(sqrtf(v_sqrlen) * inflate));
+	mask = simd_and(mask, simd_le(simd_min(dist, dist_end), rho));
+	mask = simd_and(mask, simd_ge(simd_max(dist, dist_end), simd_sub(zero, rho)));
+	if(simd_mask(mask) == 0) return 0;
+	simd_t t0 = simd_select(simd_gt(dist, rho), simd_div(simd_sub(rho, dist), ndv), zero);
+
+	// face, where the sphere touches the plane
+	simd_t e1x = simd_mul(simd_load(tris->e1[0]+first), s), e1y = simd_mul(simd_load(tris->e1[1]+first), s), e1z = simd_mul(simd_load(tris->e1[2]+first), s);
+	simd_t e2x = simd_mul(simd_load(tris->e2[0]+first), s), e2y = simd_mul(simd_load(tris->e2[1]+first), s), e2z = simd_mul(simd_load(tris->e2[2]+first), s);
+	simd_t wx = simd_sub(simd_sub(simd_mul(vx, t0), simd_mul(rho, nx)), qx);
+	simd_t wy = simd_sub(simd_sub(simd_mul(vy, t0), simd_mul(rho, ny)), qy);
+	simd_t wz = simd_sub(simd_sub(simd_mul(vz, t0), simd_mul(rho, nz)), qz);
+	simd_t d00 = simd_dot(e1x, e1y, e1z, e1x, e1y, e1z);
+	simd_t d01 = simd_dot(e1x, e1y, e1z, e2x, e2y, e2z);
+	simd_t d11 = simd_dot(e2x, e2y, e2z, e2x, e2y, e2z);
+	simd_t d20 = simd_dot(wx, wy, wz, e1x, e1y, e1z);
+	simd_t d21 = simd_dot(wx, wy, wz, e2x, e2y, e2z);
+	simd_t den = simd_sub(simd_mul(d00, d11), simd_mul(d01, d01));
+	simd_t bu = simd_sub(simd_mul(d11, d20), simd_mul(d01, d21));
+	simd_t bv = simd_sub(simd_mul(d00, d21), simd_mul(d01, d20));
+	simd_t eps = simd_mul(den, simd_set(1e-4f));
+	simd_t inside = simd_and(simd_ge(bu, simd_sub(zero, eps)), simd_ge(bv, simd_sub(zero, eps)));
+	inside = simd_and(inside, simd_le(simd_add(bu, bv), simd_add(den, eps)));
+	simd_t t = simd_select(inside, t0, simd_set(FLOAT_MAX));
+
+	// vertices and edges
+	simd_t inv_vv = simd_set(1.0f / v_sqrlen);
+	simd_t p2x = simd_add(qx, e1x), p2y = simd_add(qy, e1y), p2z = simd_add(qz, e1z);
+	simd_t p3x = simd_add(qx, e2x), p3y = simd_add(qy, e2y), p3z = simd_add(qz, e2z);
+	t = simd_min(t, sphere_vertex_time(qx, qy, qz, vx, vy, vz, vv, inv_vv, rho2));
+	t = simd_min(t, sphere_vertex_time(p2x, p2y, p2z, vx, vy, vz, vv, inv_vv, rho2));
+	t = simd_min(t, sphere_vertex_time(p3x, p3y, p3z, vx, vy, vz, vv, inv_vv, rho2));
+	t = simd_min(t, sphere_edge_time(qx, qy, qz, e1x, e1y, e1z, vx, vy, vz, rho2, limit));
+	t = simd_min(t, sphere_edge_time(p2x, p2y, p2z, simd_sub(e2x, e1x), simd_sub(e2y, e1y), simd_sub(e2z, e1z), vx, vy, vz, rho2, limit));
+	t = simd_min(t, sphere_edge_time(p3x, p3y, p3z, simd_sub(zero, e2x), simd_sub(zero, e2y), simd_sub(zero, e2z), vx, vy, vz, rho2, limit));
+
+	return simd_mask(simd_and(mask, simd_le(t, limit)));
+#else
+	(void)pos; (void)dir; (void)inv_radius; (void)inflate; (void)tris; (void)first; (void)max_t;
+	return 1;
+#endif
+}
 
-	if(a1 < 0.0f) return false;	// the ray direction is opposite to the sphere
-	if(a1*a1 > ray.dir.sqrlen()) return false; // the hit point distance is longer than the ray
 
-	hitinfo->distance = a1;
-	hitinfo->point = ray.pos + ray.dir.normalized() * a1;
-	hitinfo->normal = -(hitinfo->point - pos).normalized();
 
-	return true;
-}
 
-static bool ray_vs_aabb(const ray_t &ray, const vec3 &pos, const vec3 &size, RayHit *hitinfo)
-{
-	vec3 ray_start = ray.pos - pos;
-	vec3 ray_normal = ray.dir.normalized();
-	vec3 t1 = (-size*0.5f) - ray_start;
-	vec3 t2 = (size*0.5f) - ray_start;
-	float nx = (ray_normal.x == 0.0f) ? FLOAT_MIN : ray_normal.x;
-	float ny = (ray_normal.y == 0.0f) ? FLOAT_MIN : ray_normal.y;
-	float nz = (ray_normal.z == 0.0f) ? FLOAT_MIN : ray_normal.z;
-	t1.x /= nx; t1.y /= ny; t1.z /= nz;
-	t2.x /= nx; t2.y /= ny; t2.z /= nz;
 
-	float min = fmaxf(fmaxf(fminf(t1.x, t2.x), fminf(t1.y, t2.y)), fminf(t1.z, t2.z));
-	float max = fminf(fminf(fmaxf(t1.x, t2.x), fmaxf(t1.y, t2.y)), fmaxf(t1.z, t2.z));
 
-	if(max < 0.0f || min > max || min > ray.dir.len()) return false;
 
-	hitinfo->point = ray.pos + ray.dir.normalized() * min;
-	hitinfo->distance = min;
+/////////////////////////////////////////////////////////////////////////////////////////
+// Collision mesh
+CollisionMesh::~CollisionMesh()
+{
+	delete[] vertices;
+	delete[] indices;
+	delete[] nodes;
+	free_mesh_triangle_soa(triangles);
+}
 
-	// calc normal
-	float min_dist = FLOAT_MAX;
-	vec3 point = hitinfo->point - pos;
-	float dist = fabsf(size.x*0.5f - fabsf(point.x));
-	if(dist < min_dist){
-		hitinfo->normal = vec3(1,0,0) * signf(point.x);
-		min_dist = dist;
-	}
-	dist = fabsf(size.y*0.5f - fabsf(point.y));
-	if(dist < min_dist){
-		hitinfo->normal = vec3(0,1,0) * signf(point.y);
-		min_dist = dist;
-	}
-	dist = fabsf(size.z*0.5f - fabsf(point.z));
-	if(dist < min_dist){
-		hitinfo->normal = vec3(0,0,1) * signf(point.z);
-		min_dist = dist;
+// takes the vertex and index arrays and builds the BVH and the triangle streams over them
+static CollisionMeshRef build_collision_mesh(vec3 *vertices, u32 vertex_count, u32 *indices, u32 index_count)
+{
+	CollisionMeshRef mesh = std::make_shared<CollisionMesh>();
+	mesh->vertices = vertices;
+	mesh->vertex_count = vertex_count;
+	mesh->indices = indices;
+	mesh->triangle_count = index_count / 3;
+	mesh->bounds = bounds_t(vertices[0], vec3(0,0,0));
+	for(u32 i=1; i<vertex_count; i++)
+	{
+		mesh->bounds.encapsulate(vertices[i]);
 	}
-
-	return true;
+	mesh->nodes = build_mesh_bvh(vertices, indices, mesh->triangle_count, &mesh->node_count);
+	mesh->triangles = create_mesh_triangle_soa(vertices, indices, mesh->triangle_count);
+	return mesh;
 }
 
-static bool ray_vs_box(const ray_t &ray, const vec3 &pos, const vec3 &size, const quat &rot, RayHit *hitinfo)
+struct WeldKey
 {
-	mat4 mat = mat4(pos, rot, size);
-	mat4 mat_inv = mat.inversed();
-	ray_t newray;
-	newray.pos = mat_inv.multiply_point(ray.pos);
-	newray.dir = mat_inv.multiply_vector(ray.dir);
-	if(ray_vs_aabb(newray, vec3(), vec3(1,1,1), hitinfo) == 0){return false;}
-	hitinfo->point = mat.multiply_point(hitinfo->point);
-	hitinfo->normal = rot * hitinfo->normal;
-	return true;
-}
+	u32 x, y, z;	// bit patterns of the position
+	bool operator==(const WeldKey &rhs) const {return x == rhs.x && y == rhs.y && z == rhs.z;}
+};
 
-static bool ray_vs_mesh(const ray_t &ray, const vec3 *vertices, u32 vertex_count, const mat4 &transform, RayHit *hitinfo)
+struct WeldKeyHash
 {
-	if(vertex_count % 3 != 0) return false; // Error vertex count is missmatch
+	size_t operator()(const WeldKey &k) const {return (size_t)(k.x * 73856093u ^ k.y * 19349663u ^ k.z * 83492791u);}
+};
 
-	mat4 inv = transform.inversed();
-	ray_t inv_ray;
-	inv_ray.dir = inv.multiply_point_3x4(ray.dir);
-	inv_ray.pos = inv.multiply_point_3x4(ray.pos);
+// merges vertices at exactly the same position, remap maps the source vertices to the welded ones
+static vec3* weld_vertices(const vec3 *positions, u32 count, u32 stride, u32 *welded_count, u32 *remap)
+{
+	std::unordered_map<WeldKey, u32, WeldKeyHash> map;
+	map.reserve(count);
+	std::vector<vec3> welded;
+	welded.reserve(count);
+	for(u32 i=0; i<count; i++)
+	{
+		const vec3 &p = *(const vec3*)((const u8*)positions + (size_t)stride * i);
+		WeldKey key;
+		memcpy(&key, &p, sizeof(key));
+		auto it = map.find(key);
+		if(it != map.end())
+		{
+			remap[i] = it->second;
+			continue;
+		}
+		remap[i] = (u32)welded.size();
+		map.emplace(key, remap[i]);
+		welded.push_back(p);
+	}
 
-	RayHit nearest_hit = {};
-	nearest_hit.distance = FLOAT_MAX;
-	bool hited = false;
+	*welded_count = (u32)welded.size();
+	vec3 *vertices = new vec3[welded.size()];
+	memcpy(vertices, welded.data(), sizeof(vec3)*welded.size());
+	return vertices;
+}
 
-	for(u32 i=0; i<=vertex_count-3; i+=3)
+CollisionMeshRef create_collision_mesh(const vec3 *vertices, u32 vertex_count, const u32 *indices, u32 index_count)
+{
+	if(!vertices || !indices || vertex_count == 0 || index_count == 0) return nullptr;
+	if(index_count % 3 != 0) return nullptr;
+	for(u32 i=0; i<index_count; i++)
 	{
-		vec3 v0 = vertices[i];
-		vec3 v1 = vertices[i+1];
-		vec3 v2 = vertices[i+2];
-		vec3 e1 = v1 - v0;
-		vec3 e2 = v2 - v0;
+		if(indices[i] >= vertex_count) return nullptr;
+	}
 
-		vec3 p = vec3::cross(inv_ray.dir.normalized(), e2);
-		float det = vec3::dot(e1, p);
-		if((det > -EPSILON) && (det < EPSILON)) continue;
+	vec3 *v = new vec3[vertex_count];
+	memcpy(v, vertices, sizeof(vec3)*vertex_count);
+	u32 *idx = new u32[index_count];
+	memcpy(idx, indices, sizeof(u32)*index_count);
+	return build_collision_mesh(v, vertex_count, idx, index_count);
+}
 
-		float invdet = 1.0f/det;
+CollisionMeshRef create_collision_mesh(const vec3 *points, u32 count)
+{
+	if(!points || count == 0) return nullptr;
+	if(count % 3 != 0) return nullptr; // Error vertex count is missmatch
 
-		vec3 tv = inv_ray.pos - v0;
-		float u = vec3::dot(tv, p) * invdet;
-		if((u < 0.0f) || (u > 1.0f)) continue;
+	u32 *indices = new u32[count];
+	u32 vertex_count = 0;
+	vec3 *vertices = weld_vertices(points, count, sizeof(vec3), &vertex_count, indices);
+	return build_collision_mesh(vertices, vertex_count, indices, count);
+}
 
-		vec3 q = vec3::cross(tv, e1);
-		float v = vec3::dot(inv_ray.dir.normalized(), q) * invdet;
-		if((v < 0.0f) || ((u + v) > 1.0f)) continue;
+CollisionMeshRef create_collision_mesh(const Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count)
+{
+	if(!vertices || !indices || vertex_count == 0 || index_count == 0 || index_count % 3 != 0) return nullptr;
 
-		float t = vec3::dot(e2, q)*invdet;
-		if(t > EPSILON && t*t < inv_ray.dir.sqrlen())
+	// the render vertices are split by normal and uv, collision only needs the positions
+	std::vector<u32> remap(vertex_count);
+	u32 welded_count = 0;
+	vec3 *welded = weld_vertices(&vertices[0].position, vertex_count, sizeof(Vertex), &welded_count, remap.data());
+	u32 *welded_indices = new u32[index_count];
+	for(u32 i=0; i<index_count; i++)
+	{
+		if(indices[i] >= vertex_count)
 		{
-			if(t < nearest_hit.distance)
-			{
-				nearest_hit.point = inv_ray.pos + inv_ray.dir.normalized() * t;
-				nearest_hit.normal = vec3::cross(e1, e2).normalized();
-				nearest_hit.distance = t;
-				hited = true;
-			}
+			delete[] welded;
+			delete[] welded_indices;
+			return nullptr;
 		}
+		welded_indices[i] = remap[indices[i]];
 	}
-
-	// transform the ray hit infomation local to world
-	hitinfo->point = transform.multiply_point_3x4(nearest_hit.point);
-	hitinfo->normal = transform.multiply_point_3x4(nearest_hit.normal).normalized();
-	hitinfo->distance = transform.multiply_point_3x4(hitinfo->point - inv_ray.pos).len();
-	return hited;
+	return build_collision_mesh(welded, welded_count, welded_indices, index_count);
 }
 
+static struct collision_ctx
+{
+	CollisionQuadTree tree;
+	u32 layer_masks[MAX_COLLISION_LAYERS];	// layer collision matrix, a bit per layer
 
+	// collision meshes built from meshes, the entry is stale once either side has been freed
+	struct MeshCacheEntry
+	{
+		std::weak_ptr<Mesh> mesh;
+		std::weak_ptr<CollisionMesh> collision_mesh;
+	};
+	std::unordered_map<const Mesh*, MeshCacheEntry> mesh_cache;
+} ctx = {};
 
-/////////////////////////////////////////////////////////////////////////////////////////
-// Spherecast
-bool spherecast_vs_sphere(const ray_t &ray, float rayradius, const vec3 &pos, float radius, RayHit *hitinfo)
+CollisionMeshRef get_collision_mesh(MeshRef mesh)
 {
-	vec3 dir = ray.dir.normalized();
-	float raylen = ray.dir.len();
-	float d = vec3::dot(dir, pos - ray.pos);
-	vec3 nearest_point;
-	d = fmaxf(0.0f, fminf(raylen, d));	// clamp
-	float h = (pos - dir * d).len();
-	if(h < rayradius + radius)
-	{
-		float slope = rayradius + radius;
-		float base = fabsf(sqrtf(slope*slope - h*h));
-		vec3 p = dir * (d - base);
-		hitinfo->normal = (p - pos).normalized();
-		hitinfo->point = pos + hitinfo->normal * radius;
-		hitinfo->distance = d - base;
-		return true;
+	if(!mesh) return nullptr;
+
+	auto it = ctx.mesh_cache.find(mesh.get());
+	if(it != ctx.mesh_cache.end() && it->second.mesh.lock() == mesh)
+	{
+		CollisionMeshRef collision_mesh = it->second.collision_mesh.lock();
+		if(collision_mesh) return collision_mesh;
 	}
-	return false;
+
+	CollisionMeshRef collision_mesh = create_collision_mesh(mesh->get_vertices(), mesh->get_vertex_count(), mesh->get_indices(), mesh->get_index_count());
+	if(!collision_mesh) return nullptr;
+
+	// drop the stale entries while here
+	for(auto e = ctx.mesh_cache.begin(); e != ctx.mesh_cache.end();)
+	{
+		if(e->second.mesh.expired() || e->second.collision_mesh.expired()) e = ctx.mesh_cache.erase(e);
+		else ++e;
+	}
+	ctx.mesh_cache[mesh.get()] = {mesh, collision_mesh};
+	return collision_mesh;
 }
 
-static bool check_point_in_triangle(const vec3& point, const vec3& p1, const vec3& p2, const vec3& p3)
+void collision_init()
 {
-	vec3 u, v, w, vw, vu, uw, uv;
+	ctx.tree.init(5, bounds_t(vec3(), vec3(500, 500, 500)));
+	for(int i=0; i<MAX_COLLISION_LAYERS; i++)
+	{
+		ctx.layer_masks[i] = 0xFFFFFFFF;
+	}
+}
 
-	u = p2 - p1;
-	v = p3 - p1;
-	w = point - p1;
+void collision_update()
+{
+	ctx.tree.update_sleeping(COLLISION_SLEEP_FRAMES);
+}
 
-	vw = vec3::cross(v, w);
-	vu = vec3::cross(v, u);
+void collision_build_static()
+{
+	ctx.tree.build_static();
+}
 
-	if(vec3::dot(vw, vu) < 0.0f) {
-		return false;
-	}
+void collision_set_world_bounds(const bounds_t &bounds, u32 level)
+{
+	bounds_t world = bounds;
+	world.extents.y = 0.0f;
+	ctx.tree.rebuild(world, level > 0 ? level : ctx.tree.choose_level(world), false);
+}
 
-	uw = vec3::cross(u, w);
-	uv = vec3::cross(u, v);
+bounds_t collision_get_world_bounds()
+{
+	return ctx.tree.get_bounds();
+}
 
-	if(vec3::dot(uw, uv) < 0.0f) {
-		return 0;
-	}
+u32 collision_get_world_level()
+{
+	return ctx.tree.get_level();
+}
 
-	float d = uv.len();
-	float r = vw.len() / d;
-	float t = uw.len() / d;
+void collision_uninit()
+{
+	ctx.tree.uninit();
+	ctx.mesh_cache.clear();
+}
 
-	return ((r + t) <= 1);
+void collision_set_layer_collision(u32 layer1, u32 layer2, bool collide)
+{
+	if(layer1 >= MAX_COLLISION_LAYERS || layer2 >= MAX_COLLISION_LAYERS) return;
 
+	if(collide)
+	{
+		ctx.layer_masks[layer1] |= 1u << layer2;
+		ctx.layer_masks[layer2] |= 1u << layer1;
+	}
+	else
+	{
+		ctx.layer_masks[layer1] &= ~(1u << layer2);
+		ctx.layer_masks[layer2] &= ~(1u << layer1);
+	}
 }
 
-bool get_lowest_root(float a, float b, float c, float maxR, float *root)
+bool collision_get_layer_collision(u32 layer1, u32 layer2)
 {
-	// Check if a solution exists
-	float determinant = b*b - 4.0f*a*c;
+	if(layer1 >= MAX_COLLISION_LAYERS || layer2 >= MAX_COLLISION_LAYERS) return false;
+	return (ctx.layer_masks[layer1] & (1u << layer2)) != 0;
+}
 
-	// If determinant is negative it means no solutions.
-	if (determinant < 0.0f) return false;
+u32 collision_get_layer_mask(u32 layer)
+{
+	if(layer >= MAX_COLLISION_LAYERS) return 0;
+	return ctx.layer_masks[layer];
+}
 
-	// calculate the two roots: (if determinant == 0 then
-	// x1==x2 but letfs disregard that slight optimization)
-	float sqrtD = sqrtf(determinant);
+ColliderRef create_sphere_collider(float radius, const vec3 &offset)
+{
+	ColliderRef c = std::make_shared<Collider>();
+	c->enabled = true;
+	c->type = ColliderType::SPHERE;
+	c->layer = 0;
+	c->offset = offset;
+	c->sphere.radius = radius;
+	c->bounds = bounds_t(vec3(), vec3(radius, radius, radius));
+	ctx.tree.add(c);
+
+	return c;
+}
+
+ColliderRef create_box_collider(const vec3 &center, const vec3 &size)
+{
+	ColliderRef c = std::make_shared<Collider>();
+	c->enabled = true;
+	c->type = ColliderType::BOX;
+	c->layer = 0;
+	c->offset = center;
+	c->size = size;
+	c->bounds = bounds_t(vec3(), size * 0.5f);
+	ctx.tree.add(c);
+
+	return c;
+}
+
+ColliderRef create_capsule_collider(const vec3 &offset, const vec3 &dir, float radius, float height)
+{
+	ColliderRef c = std::make_shared<Collider>();
+	c->enabled = true;
+	c->type = ColliderType::CAPSULE;
+	c->layer = 0;
+	c->offset = offset;
+	c->capsule.dir = dir.normalized();
+	c->capsule.radius = radius;
+	c->capsule.height = height;
+	c->bounds = bounds_t();
+	c->bounds.encapsulate((dir * height * 0.5f) + vec3(radius, radius, radius));
+	c->bounds.encapsulate(-(dir * height * 0.5f) - vec3(radius, radius, radius));
+	ctx.tree.add(c);
+
+	return c;
+}
+
+ColliderRef create_mesh_collider(CollisionMeshRef mesh, const vec3 &offset)
+{
+	if(!mesh) return nullptr;
+
+	ColliderRef c = std::make_shared<Collider>();
+	c->enabled = true;
+	c->type = ColliderType::MESH;
+	c->layer = 0;
+	c->offset = offset;
+	c->bounds = mesh->bounds;
+	c->mesh = mesh;
+	ctx.tree.add(c);
+
+	return c;
+}
+
+ColliderRef create_mesh_collider(const vec3 *vertices, u32 count, const vec3 &offset)
+{
+	return create_mesh_collider(create_collision_mesh(vertices, count), offset);
+}
+
+ColliderRef create_mesh_collider(const Vertex *vertices, u32 count, const vec3 &offset)
+{
+	if(!vertices || count <= 0) return nullptr;
+
+	vec3 *points = new vec3[count];
+	for(u32 i=0; i<count; i++)
+	{
+		points[i] = vertices[i].position;
+	}
+	ColliderRef c = create_mesh_collider(points, count, offset);
+	delete [] points;
+
+	return c;
+}
+
+ColliderRef create_mesh_collider(MeshRef mesh, const vec3 &offset)
+{
+	return create_mesh_collider(get_collision_mesh(mesh), offset);
+}
+
+CollisionHeightfieldRef create_collision_heightfield(const float *heights, u32 width, u32 depth, float cell_size, const vec3 &origin)
+{
+	if(!heights || width == 0 || depth == 0 || cell_size <= 0.0f) return nullptr;
+
+	u32 count = (width+1) * (depth+1);
+	float min_height = FLOAT_MAX;
+	float max_height = -FLOAT_MAX;
+	for(u32 i=0; i<count; i++)
+	{
+		if(heights[i] == HEIGHTFIELD_HOLE) continue;
+		min_height = fminf(min_height, heights[i]);
+		max_height = fmaxf(max_height, heights[i]);
+	}
+	if(min_height > max_height) return nullptr;	// only holes
+
+	CollisionHeightfieldRef hf = std::make_shared<CollisionHeightfield>();
+	hf->heights = new float[count];
+	memcpy(hf->heights, heights, sizeof(float)*count);
+	hf->width = width;
+	hf->depth = depth;
+	hf->cell_size = cell_size;
+	hf->origin = vec3(origin.x, 0.0f, origin.z);
+	hf->bounds.set_min_max(vec3(origin.x, min_height, origin.z), vec3(origin.x + width*cell_size, max_height, origin.z + depth*cell_size));
+	return hf;
+}
+
+static bool ray_vs_mesh(const ray_t &ray, const CollisionMesh *mesh, const mat4 &transform, const mat4 &inv, RayHit *hitinfo);
+
+CollisionHeightfieldRef create_collision_heightfield(MeshRef mesh, float cell_size)
+{
+	if(cell_size <= 0.0f) return nullptr;
+	return create_collision_heightfield(get_collision_mesh(mesh), cell_size);
+}
+
+// cast down onto the mesh at every sample of the rows [z_start, z_end), the samples on the border are pulled in a little so they still hit the mesh
+static void sample_heightfield_rows(const CollisionMesh *mesh, float cell_size, u32 width, u32 z_start, u32 z_end, float *heights)
+{
+	vec3 min = mesh->bounds.get_min();
+	vec3 max = mesh->bounds.get_max();
+	mat4 identity = mat4::identity();
+	float height = max.y - min.y + 2.0f;
+	float inset = cell_size * 1e-3f;
+	for(u32 z=z_start; z<z_end; z++)
+	{
+		for(u32 x=0; x<=width; x++)
+		{
+			vec3 p = vec3(clamp(min.x + x*cell_size, min.x + inset, max.x - inset), max.y + 1.0f, clamp(min.z + z*cell_size, min.z + inset, max.z - inset));
+			RayHit hit = {};
+			heights[z*(width+1)+x] = ray_vs_mesh(ray_t(p, vec3(0, -height, 0)), mesh, identity, identity, &hit) ? hit.point.y : HEIGHTFIELD_HOLE;
+		}
+	}
+}
+
+CollisionHeightfieldRef create_collision_heightfield(CollisionMeshRef collision_mesh, float cell_size, int thread_count)
+{
+	if(!collision_mesh || cell_size <= 0.0f) return nullptr;
+
+	vec3 min = collision_mesh->bounds.get_min();
+	vec3 max = collision_mesh->bounds.get_max();
+	u32 width = (u32)ceilf((max.x - min.x) / cell_size);
+	u32 depth = (u32)ceilf((max.z - min.z) / cell_size);
+	width = width > 0 ? width : 1;
+	depth = depth > 0 ? depth : 1;
+
+	// the rows are split in contiguous ranges, the calling thread takes the last one
+	std::vector<float> heights((width+1) * (depth+1));
+	u32 row_count = depth + 1;
+	u32 worker_count = thread_count > 1 ? (u32)thread_count : 1;
+	worker_count = worker_count < row_count ? worker_count : row_count;
+	u32 range = (row_count + worker_count - 1) / worker_count;
+	std::vector<std::thread> workers;
+	for(u32 i=0; i<worker_count; i++)
+	{
+		u32 start = range*i < row_count ? range*i : row_count;
+		u32 end = range*(i+1) < row_count ? range*(i+1) : row_count;
+		if(i+1 < worker_count)
+		{
+			workers.emplace_back(sample_heightfield_rows, collision_mesh.get(), cell_size, width, start, end, heights.data());
+		}
+		else
+		{
+			sample_heightfield_rows(collision_mesh.get(), cell_size, width, start, row_count, heights.data());
+		}
+	}
+	for(size_t i=0; i<workers.size(); i++)
+	{
+		workers[i].join();
+	}
+	return create_collision_heightfield(heights.data(), width, depth, cell_size, min);
+}
+
+ColliderRef create_heightfield_collider(CollisionHeightfieldRef heightfield, const vec3 &offset)
+{
+	if(!heightfield) return nullptr;
+
+	ColliderRef c = std::make_shared<Collider>();
+	c->enabled = true;
+	c->type = ColliderType::HEIGHTFIELD;
+	c->layer = 0;
+	c->offset = offset;
+	c->bounds = heightfield->bounds;
+	c->heightfield = heightfield;
+	ctx.tree.add(c);
+
+	return c;
+}
+
+ColliderRef create_heightfield_collider(MeshRef mesh, float cell_size, const vec3 &offset)
+{
+	return create_heightfield_collider(create_collision_heightfield(mesh, cell_size), offset);
+}
+
+void free_collider(ColliderRef collider)
+{
+	if(collider == nullptr) return;
+
+	ctx.tree.remove(collider.get());
+}
+
+
+CollisionQuery* collision_get_thread_query()
+{
+	thread_local CollisionQuery query;
+	return &query;
+}
+
+void collision_stats_enable(bool enable)
+{
+	std::lock_guard<std::mutex> lock(stats.mutex);
+	if(stats.current.scope_count == 0)
+	{
+		stats.current.scope_names[0] = "unscoped";
+		stats.current.scope_count = 1;
+	}
+	stats.enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool collision_stats_enabled()
+{
+	return stats.enabled.load(std::memory_order_relaxed);
+}
+
+void collision_stats_new_frame()
+{
+	std::lock_guard<std::mutex> lock(stats.mutex);
+	stats.last = stats.current;
+	for(int i=0; i<(int)CollisionQueryType::COUNT; i++)
+	{
+		stats.current.types[i] = {};
+	}
+	for(int i=0; i<COLLISION_STATS_MAX_SCOPES; i++)
+	{
+		stats.current.scopes[i] = {};
+	}
+}
+
+const CollisionStats* collision_get_stats()
+{
+	return &stats.last;
+}
+
+const char* collision_query_type_name(CollisionQueryType type)
+{
+	static const char *names[] = {"raycast", "raycast_all", "raycast_batch", "spherecast", "spherecast_all", "overlap", "check", "broadphase"};
+	static_assert(sizeof(names) / sizeof(names[0]) == (int)CollisionQueryType::COUNT, "a query type has no name");
+	if((int)type < 0 || (int)type >= (int)CollisionQueryType::COUNT) return "";
+	return names[(int)type];
+}
+
+// scopes are matched by name and kept across frames, the ones past COLLISION_STATS_MAX_SCOPES count as unscoped
+CollisionStatsScope::CollisionStatsScope(const char *name)
+{
+	previous = stats_scope;
+	if(!stats.enabled.load(std::memory_order_relaxed) || name == nullptr) return;
+
+	std::lock_guard<std::mutex> lock(stats.mutex);
+	CollisionStats &current = stats.current;
+	for(int i=1; i<current.scope_count; i++)
+	{
+		if(current.scope_names[i] == name || strcmp(current.scope_names[i], name) == 0)
+		{
+			stats_scope = i;
+			return;
+		}
+	}
+	if(current.scope_count < COLLISION_STATS_MAX_SCOPES)
+	{
+		current.scope_names[current.scope_count] = name;
+		stats_scope = current.scope_count++;
+	}
+}
+
+CollisionStatsScope::~CollisionStatsScope()
+{
+	stats_scope = previous;
+}
+
+static bool compare_hit_distance(const RayHit &a, const RayHit &b)
+{
+	return a.distance < b.distance;
+}
+
+// copies the nearest hits into rayhit in distance order, only the copied ones are sorted
+static int sort_hits(std::vector<RayHit> &hits, RayHit *rayhit, int rayhit_count)
+{
+	int hit_count = (int)hits.size() < rayhit_count ? (int)hits.size() : rayhit_count;
+	if(hit_count <= 0)
+	{
+		hits.clear();
+		return 0;
+	}
+
+	std::partial_sort(hits.begin(), hits.begin() + hit_count, hits.end(), compare_hit_distance);
+	for(int i=0; i<hit_count; i++)
+	{
+		rayhit[i] = hits[i];
+	}
+	hits.clear();
+	return hit_count;
+}
+
+int query_colliders(const bounds_t &bounds, ColliderRef *colliders, int collider_count, u32 layermask)
+{
+	return query_colliders(collision_get_thread_query(), bounds, colliders, collider_count, layermask);
+}
+
+int query_colliders(CollisionQuery *query, const bounds_t &bounds, ColliderRef *colliders, int collider_count, u32 layermask)
+{
+	QueryStatsRecorder recorder(CollisionQueryType::BROADPHASE);
+	std::vector<u32> &indices = query->indices;
+	ctx.tree.query(bounds, layermask, &indices);
+	int count = (int)indices.size() < collider_count ? (int)indices.size() : collider_count;
+	for(int i=0; i<count; i++)
+	{
+		colliders[i] = ctx.tree.get_collider_ref(indices[i]);
+	}
+	indices.clear();
+	return count;
+}
+
+int raycast(const ray_t &ray, RayHit *rayhit, u32 layermask)
+{
+	QueryStatsRecorder recorder(CollisionQueryType::RAYCAST);
+	return ctx.tree.cast_nearest(ray, 0.0f, false, layermask, rayhit) ? 1 : 0;
+}
+
+int raycast_all(const ray_t &ray, RayHit *rayhit, int rayhit_count, u32 layermask)
+{
+	return raycast_all(collision_get_thread_query(), ray, rayhit, rayhit_count, layermask);
+}
+
+int raycast_all(CollisionQuery *query, const ray_t &ray, RayHit *rayhit, int rayhit_count, u32 layermask)
+{
+	QueryStatsRecorder recorder(CollisionQueryType::RAYCAST_ALL);
+	std::vector<u32> &indices = query->indices;
+	std::vector<RayHit> &hits = query->hits;
+	hits.clear();
+
+	bounds_t bounds(ray.pos, vec3());
+	bounds.encapsulate(ray.pos + ray.dir);
+
+	ctx.tree.query(bounds, layermask, &indices);
+	for(int i=0; i<(int)indices.size(); i++)
+	{
+		const Collider *c = ctx.tree.get_collider(indices[i]);
+		RayHit hitinfo = {};
+		if(c->intersect_ray(ray, &hitinfo))
+		{
+			hitinfo.collider = ctx.tree.get_collider_ref(indices[i]);
+			hits.push_back(hitinfo);
+		}
+	}
+	if(stats_counters)
+	{
+		stats_counters->tests += (u32)indices.size();
+		stats_counters->hits += (u32)hits.size();
+	}
+	indices.clear();
+
+	return sort_hits(hits, rayhit, rayhit_count);
+}
+
+#define RAYCAST_BATCH_PACKET_SIZE 64
+#define RAYCAST_BATCH_PACKET_EXTENT 32.0f
+
+// casts the sorted rays [first, first+count) packet by packet
+// a packet is a run of nearby rays, the colliders around the packet are queried once and tested against each of its rays
+static int raycast_packets(CollisionQuery *query, const ray_t *rays, const u64 *keys, int first, int count, RayHit *rayhit, u32 layermask)
+{
+	std::vector<u32> &indices = query->indices;
+	std::vector<RayHit> &hits = query->hits;	// results in the sorted order
+	hits.resize(count);
+	ray_t packet[RAYCAST_BATCH_PACKET_SIZE];
+	int hit_count = 0;
+	u32 tests = 0;
+	int end = first + count;
+	int packet_first = first;
+	while(packet_first < end)
+	{
+		// gather the packet while it stays small
+		bounds_t bounds;
+		int packet_count = 0;
+		while(packet_first + packet_count < end && packet_count < RAYCAST_BATCH_PACKET_SIZE)
+		{
+			const ray_t &ray = rays[(u32)keys[packet_first + packet_count]];
+			bounds_t b = packet_count > 0 ? bounds : bounds_t(ray.pos, vec3());
+			b.encapsulate(ray.pos);
+			b.encapsulate(ray.pos + ray.dir);
+			if(packet_count > 0 && (b.extents.x > RAYCAST_BATCH_PACKET_EXTENT || b.extents.z > RAYCAST_BATCH_PACKET_EXTENT)) break;
+			bounds = b;
+			packet[packet_count++] = ray;
+		}
+
+		ctx.tree.query(bounds, layermask, &indices);
+		for(int i=0; i<packet_count; i++)
+		{
+			const ray_t &ray = packet[i];
+			RayHit &result = hits[packet_first + i - first];
+
+			float length = ray.dir.len();
+			if(length <= 0.0f) {result = {}; continue;}
+			vec3 dir = ray.dir / length;
+			vec3 inv_dir = safe_inv_dir(ray.dir);
+			RayHit nearest_hit = {};
+			u32 nearest_index = QUADTREE_INVALID_INDEX;
+			float nearest = length;
+			for(int k=0; k<(int)indices.size(); k++)
+			{
+				const Collider *c = ctx.tree.get_collider(indices[k]);
+				float t;
+				if(!ray_vs_bounds(ray.pos, inv_dir, nearest / length, c->world_bounds.min, c->world_bounds.max, &t)) continue;
+
+				tests++;
+				RayHit hit = {};
+				hit.distance = nearest;
+				if(!c->intersect_ray(ray_t(ray.pos, dir * nearest), &hit)) continue;
+				if(nearest_index == QUADTREE_INVALID_INDEX || hit.distance < nearest_hit.distance)
+				{
+					nearest_hit = hit;
+					nearest_index = indices[k];
+					nearest = fmaxf(fminf(nearest, hit.distance), EPSILON);
+				}
+			}
+			if(nearest_index != QUADTREE_INVALID_INDEX)
+			{
+				nearest_hit.collider = ctx.tree.get_collider_ref(nearest_index);
+				hit_count++;
+			}
+			result = nearest_hit;
+		}
+		indices.clear();
+		packet_first += packet_count;
+	}
+
+	if(stats_counters)
+	{
+		stats_counters->tests += tests;
+		stats_counters->hits += (u32)hit_count;
+	}
+
+	// scatter the results back in one tight pass, writing them randomly in the loop above is much slower
+	for(int i=0; i<count; i++)
+	{
+		rayhit[(u32)keys[first + i]] = std::move(hits[i]);
+	}
+	hits.clear();
+	return hit_count;
+}
+
+// sorts the rays by the morton number of their start with two 11 bit radix passes
+// the low 32 bits of a key are the ray index, keys holds the result in its first count entries
+static void sort_rays(const ray_t *rays, int count, std::vector<u64> *keys)
+{
+	keys->resize(count * 2);
+	u64 *src = keys->data();
+	u64 *dst = src + count;
+	for(int i=0; i<count; i++)
+	{
+		src[i] = ((u64)ctx.tree.get_point_key(rays[i].pos) << 32) | (u32)i;
+	}
+
+	for(int pass=0; pass<2; pass++)
+	{
+		u32 shift = 32 + pass*11;
+		u32 offsets[2048] = {};
+		for(int i=0; i<count; i++)
+		{
+			offsets[(src[i] >> shift) & 0x7FF]++;
+		}
+		u32 sum = 0;
+		for(int i=0; i<2048; i++)
+		{
+			u32 n = offsets[i];
+			offsets[i] = sum;
+			sum += n;
+		}
+		for(int i=0; i<count; i++)
+		{
+			dst[offsets[(src[i] >> shift) & 0x7FF]++] = src[i];
+		}
+		u64 *tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+}
+
+int raycast_batch(const ray_t *rays, RayHit *rayhit, int count, u32 layermask, int thread_count)
+{
+	if(thread_count <= 1 || count < thread_count * RAYCAST_BATCH_PACKET_SIZE)
+	{
+		return raycast_batch(collision_get_thread_query(), rays, rayhit, count, layermask);
+	}
+	if(rays == nullptr || rayhit == nullptr) return 0;
+
+	QueryStatsRecorder recorder(CollisionQueryType::RAYCAST_BATCH);
+	CollisionQuery *query = collision_get_thread_query();
+	sort_rays(rays, count, &query->keys);
+	const u64 *keys = query->keys.data();
+
+	// split the sorted rays in contiguous ranges, the calling thread takes the last one
+	// the workers count into their own statistics, they are added to the caller's after the join
+	std::vector<std::thread> workers;
+	std::vector<int> hit_counts(thread_count, 0);
+	std::vector<CollisionQueryStats> worker_stats(thread_count, CollisionQueryStats{});
+	bool record = stats_counters != nullptr;
+	int range = (count + thread_count - 1) / thread_count;
+	for(int i=0; i<thread_count-1; i++)
+	{
+		workers.emplace_back([=, &hit_counts, &worker_stats]() {
+			if(record) stats_counters = &worker_stats[i];
+			hit_counts[i] = raycast_packets(collision_get_thread_query(), rays, keys, range*i, range, rayhit, layermask);
+			stats_counters = nullptr;
+		});
+	}
+	int last = range * (thread_count-1);
+	hit_counts[thread_count-1] = raycast_packets(query, rays, keys, last, count - last, rayhit, layermask);
+
+	int hit_count = 0;
+	for(int i=0; i<thread_count; i++)
+	{
+		if(i < (int)workers.size()) workers[i].join();
+		hit_count += hit_counts[i];
+		if(record) add_query_stats(stats_counters, worker_stats[i]);
+	}
+	return hit_count;
+}
+
+int raycast_batch(CollisionQuery *query, const ray_t *rays, RayHit *rayhit, int count, u32 layermask)
+{
+	if(rays == nullptr || rayhit == nullptr || count <= 0) return 0;
+
+	QueryStatsRecorder recorder(CollisionQueryType::RAYCAST_BATCH);
+	sort_rays(rays, count, &query->keys);
+	return raycast_packets(query, rays, query->keys.data(), 0, count, rayhit, layermask);
+}
+
+// http://marupeke296.com/COL_3D_No24_RayToSphere.html
+bool ray_vs_sphere(const ray_t &ray, const vec3 &pos, float radius, RayHit *hitinfo)
+{
+	vec3 ray_normal = ray.dir.normalized();
+	vec3 P = pos - ray.pos;
+	float A = vec3::dot(ray_normal, ray_normal);
+	float B = vec3::dot(ray_normal, P);
+	float C = vec3::dot(P,P) - (radius*radius);
+
+	if(A == 0.0f) return false;	// ray distance is 0
+
+	float s = B * B - A * C;
+	if(s < 0.0f) return false;	// not hited
+
+	s = sqrtf(s);
+	float a1 = (B - s) / A;
+	//float a2 = (B + s) / A;
+
+	if(a1 < 0.0f) return false;	// the ray direction is opposite to the sphere
+	if(a1*a1 > ray.dir.sqrlen()) return false; // the hit point distance is longer than the ray
+
+	hitinfo->distance = a1;
+	hitinfo->point = ray.pos + ray.dir.normalized() * a1;
+	hitinfo->normal = -(hitinfo->point - pos).normalized();
+
+	return true;
+}
+
+static bool ray_vs_aabb(const ray_t &ray, const vec3 &pos, const vec3 &size, RayHit *hitinfo)
+{
+	vec3 ray_start = ray.pos - pos;
+	vec3 ray_normal = ray.dir.normalized();
+	vec3 t1 = (-size*0.5f) - ray_start;
+	vec3 t2 = (size*0.5f) - ray_start;
+	float nx = (ray_normal.x == 0.0f) ? FLOAT_MIN : ray_normal.x;
+	float ny = (ray_normal.y == 0.0f) ? FLOAT_MIN : ray_normal.y;
+	float nz = (ray_normal.z == 0.0f) ? FLOAT_MIN : ray_normal.z;
+	t1.x /= nx; t1.y /= ny; t1.z /= nz;
+	t2.x /= nx; t2.y /= ny; t2.z /= nz;
+
+	float min = fmaxf(fmaxf(fminf(t1.x, t2.x), fminf(t1.y, t2.y)), fminf(t1.z, t2.z));
+	float max = fminf(fminf(fmaxf(t1.x, t2.x), fmaxf(t1.y, t2.y)), fmaxf(t1.z, t2.z));
+
+	// a ray starting inside the box does not hit it, the same as the sphere
+	if(min < 0.0f || min > max || min > ray.dir.len()) return false;
+
+	hitinfo->point = ray.pos + ray.dir.normalized() * min;
+	hitinfo->distance = min;
+
+	// calc normal
+	float min_dist = FLOAT_MAX;
+	vec3 point = hitinfo->point - pos;
+	float dist = fabsf(size.x*0.5f - fabsf(point.x));
+	if(dist < min_dist){
+		hitinfo->normal = vec3(1,0,0) * signf(point.x);
+		min_dist = dist;
+	}
+	dist = fabsf(size.y*0.5f - fabsf(point.y));
+	if(dist < min_dist){
+		hitinfo->normal = vec3(0,1,0) * signf(point.y);
+		min_dist = dist;
+	}
+	dist = fabsf(size.z*0.5f - fabsf(point.z));
+	if(dist < min_dist){
+		hitinfo->normal = vec3(0,0,1) * signf(point.z);
+		min_dist = dist;
+	}
+
+	return true;
+}
+
+static bool ray_vs_box(const ray_t &ray, const vec3 &size, const mat4 &transform, const mat4 &inv, RayHit *hitinfo)
+{
+	ray_t newray;
+	newray.pos = inv.multiply_point_3x4(ray.pos);
+	newray.dir = inv.multiply_vector(ray.dir);
+	if(ray_vs_aabb(newray, vec3(), size, hitinfo) == 0){return false;}
+	hitinfo->point = transform.multiply_point_3x4(hitinfo->point);
+	hitinfo->normal = transform.multiply_vector(hitinfo->normal).normalized();
+	hitinfo->distance = (hitinfo->point - ray.pos).len();
+	return true;
+}
+
+static bool ray_vs_mesh(const ray_t &ray, const CollisionMesh *mesh, const mat4 &transform, const mat4 &inv, RayHit *hitinfo)
+{
+	if(mesh == nullptr || mesh->nodes == nullptr) return false;
+	const MeshBVHNode *nodes = mesh->nodes;
+
+	vec3 ray_pos = inv.multiply_point_3x4(ray.pos);
+	vec3 ray_dir = inv.multiply_vector(ray.dir);
+	float max_distance = ray_dir.len();
+	ray_dir = ray_dir.normalized();
+	vec3 inv_dir = safe_inv_dir(ray_dir);
+
+	float nearest = max_distance;
+	u32 nearest_tri = 0xffffffff;
+
+	// traverse the BVH front to back
+	u32 stack[BVH_STACK_SIZE];
+	int stack_count = 0;
+	float dist;
+	if(!ray_vs_bvh_node(ray_pos, inv_dir, nearest, nodes[0], &dist)) return false;
+	stack[stack_count++] = 0;
+	while(stack_count > 0)
+	{
+		const MeshBVHNode &node = nodes[stack[--stack_count]];
+		if(node.count > 0)
+		{
+			ray_vs_triangles(ray_pos, ray_dir, mesh->triangles, node.first, node.count, &nearest, &nearest_tri);
+			continue;
+		}
+
+		float d1, d2;
+		bool hit1 = ray_vs_bvh_node(ray_pos, inv_dir, nearest, nodes[node.first], &d1);
+		bool hit2 = ray_vs_bvh_node(ray_pos, inv_dir, nearest, nodes[node.first+1], &d2);
+		if(hit1 && hit2)
+		{
+			// push the far child first so the near one is visited first
+			if(d1 <= d2) {
+				stack[stack_count++] = node.first+1;
+				stack[stack_count++] = node.first;
+			} else {
+				stack[stack_count++] = node.first;
+				stack[stack_count++] = node.first+1;
+			}
+		}
+		else if(hit1) {
+			stack[stack_count++] = node.first;
+		}
+		else if(hit2) {
+			stack[stack_count++] = node.first+1;
+		}
+	}
+
+	if(nearest_tri == 0xffffffff) return false;
+
+	// transform the ray hit infomation local to world
+	const u32 *tri = &mesh->indices[nearest_tri*3];
+	const vec3 *vertices = mesh->vertices;
+	vec3 local_point = ray_pos + ray_dir * nearest;
+	vec3 local_normal = vec3::cross(vertices[tri[1]] - vertices[tri[0]], vertices[tri[2]] - vertices[tri[0]]);
+	hitinfo->point = transform.multiply_point_3x4(local_point);
+	hitinfo->normal = transform.multiply_vector(local_normal).normalized();
+	hitinfo->distance = (hitinfo->point - ray.pos).len();
+	return true;
+}
+
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// Spherecast
+// earliest entry distance of the ray into the sphere, the direction must be normalized
+// the ray origin must be outside of the sphere
+static bool ray_vs_sphere_distance(const vec3 &pos, const vec3 &dir, float max_distance, const vec3 &center, float radius, float *distance)
+{
+	vec3 m = pos - center;
+	float b = vec3::dot(m, dir);
+	float c = vec3::dot(m, m) - radius*radius;
+	if(b > 0.0f) return false;	// pointing away from the sphere
+	float s = b*b - c;
+	if(s < 0.0f) return false;
+	float t = -b - sqrtf(s);
+	if(t < 0.0f || t > max_distance) return false;
+	*distance = t;
+	return true;
+}
+
+// earliest entry distance of the ray into the capsule around the segment p1-p2, the direction must be normalized
+// the ray origin must be outside of the capsule
+static bool ray_vs_capsule_distance(const vec3 &pos, const vec3 &dir, float max_distance, const vec3 &p1, const vec3 &p2, float radius, float *distance)
+{
+	bool hited = false;
+	float t;
+
+	// side of the cylinder
+	vec3 axis = p2 - p1;
+	vec3 m = pos - p1;
+	float dd = vec3::dot(axis, axis);
+	float md = vec3::dot(m, axis);
+	float nd = vec3::dot(dir, axis);
+	float a = dd - nd*nd;
+	if(a > EPSILON * dd)
+	{
+		float b = dd * vec3::dot(m, dir) - nd*md;
+		float c = dd * (vec3::dot(m, m) - radius*radius) - md*md;
+		float s = b*b - a*c;
+		if(s < 0.0f) return false;	// the end spheres are inside the infinite cylinder
+		t = (-b - sqrtf(s)) / a;
+		float along = md + t*nd;
+		if(t >= 0.0f && t <= max_distance && along >= 0.0f && along <= dd)
+		{
+			max_distance = t;
+			hited = true;
+		}
+	}
+
+	// end spheres
+	if(ray_vs_sphere_distance(pos, dir, max_distance, p1, radius, &t)){max_distance = t; hited = true;}
+	if(ray_vs_sphere_distance(pos, dir, max_distance, p2, radius, &t)){max_distance = t; hited = true;}
+	if(hited) *distance = max_distance;
+	return hited;
+}
+
+bool spherecast_vs_sphere(const ray_t &ray, float rayradius, const vec3 &pos, float radius, RayHit *hitinfo)
+{
+	float raylen = ray.dir.len();
+	if(raylen <= 0.0f) return false;
+	vec3 dir = ray.dir / raylen;
+	float r = rayradius + radius;
+
+	float t = 0.0f;
+	vec3 m = ray.pos - pos;
+	if(m.sqrlen() > r*r)
+	{
+		if(!ray_vs_sphere_distance(ray.pos, dir, raylen, pos, r, &t)) return false;
+	}
+
+	// the sphere is already touching when the ray starts inside
+	vec3 center = ray.pos + dir * t;
+	hitinfo->normal = (center - pos).normalized();
+	if(hitinfo->normal.sqrlen() == 0.0f) hitinfo->normal = -dir;
+	hitinfo->point = pos + hitinfo->normal * radius;
+	hitinfo->distance = t;
+	return true;
+}
+
+static bool check_point_in_triangle(const vec3& point, const vec3& p1, const vec3& p2, const vec3& p3)
+{
+	vec3 u, v, w, vw, vu, uw, uv;
+
+	u = p2 - p1;
+	v = p3 - p1;
+	w = point - p1;
+
+	vw = vec3::cross(v, w);
+	vu = vec3::cross(v, u);
+
+	if(vec3::dot(vw, vu) < 0.0f) {
+		return false;
+	}
+
+	uw = vec3::cross(u, w);
+	uv = vec3::cross(u, v);
+
+	if(vec3::dot(uw, uv) < 0.0f) {
+		return 0;
+	}
+
+	float d = uv.len();
+	float r = vw.len() / d;
+	float t = uw.len() / d;
+
+	return ((r + t) <= 1);
+
+}
+
+bool get_lowest_root(float a, float b, float c, float maxR, float *root)
+{
+	// Check if a solution exists
+	float determinant = b*b - 4.0f*a*c;
+
+	// If determinant is negative it means no solutions.
+	if (determinant < 0.0f) return false;
+
+	// calculate the two roots: (if determinant == 0 then
+	// x1==x2 but let�fs disregard that slight optimization)
+	float sqrtD = sqrtf(determinant);
 	float r1 = (-b - sqrtD) / (2*a);
 	float r2 = (-b + sqrtD) / (2*a);
 
@@ -683,9 +2573,58 @@ bool get_lowest_root(float a, float b, float c, float maxR, float *root)
 	return false;
 }
 
-static bool spherecast_to_triangle(const ray_t &ray, const vec3 &p1, const vec3 &p2, const vec3 &p3, RayHit *hitinfo)
+// first time in (0, max_t) the unit sphere moving from base by velocity touches the point, the entry time or the exit
+// time when it starts inside like get_lowest_root. the discriminant comes from the distance of the point to the line of
+// motion, a cross product instead of the difference of two large squares, so sweeps starting many radii away keep
+// their grazing hits
+static bool sweep_to_point(const vec3 &base, const vec3 &velocity, float velocity_sqrlen, const vec3 &p, float max_t, float *t)
+{
+	vec3 q = p - base;
+	float d = velocity_sqrlen - vec3::cross(velocity, q).sqrlen();
+	if(d < 0.0f || velocity_sqrlen <= 0.0f) return false;
+	float s = sqrtf(d);
+	float vq = vec3::dot(velocity, q);
+	float r1 = (vq - s) / velocity_sqrlen;
+	float r2 = (vq + s) / velocity_sqrlen;
+	if(r1 > 0.0f && r1 < max_t){*t = r1; return true;}
+	if(r2 > 0.0f && r2 < max_t){*t = r2; return true;}
+	return false;
+}
+
+// the same for the edge from p along edge, the unit sphere touches the infinite line at a time in (0, max_t)
+// and f is where along the edge (0 to 1), a hit is only returned when f is on the edge
+static bool sweep_to_edge(const vec3 &base, const vec3 &velocity, const vec3 &p, const vec3 &edge, float max_t, float *t, float *f)
+{
+	// in the plane at a right angle to the edge the line is a point and the sphere a circle
+	vec3 q = p - base;
+	vec3 a = vec3::cross(velocity, edge);
+	vec3 b = vec3::cross(q, edge);
+	float aa = a.sqrlen();
+	float edge_sqrlen = edge.sqrlen();
+	if(aa <= 0.0f) return false;	// moving along the edge
+	float aq = vec3::dot(a, q);
+	float d = edge_sqrlen * (aa - aq*aq);
+	if(d < 0.0f) return false;
+	float s = sqrtf(d);
+	float ab = vec3::dot(a, b);
+	float r1 = (ab - s) / aa;
+	float r2 = (ab + s) / aa;
+	float root;
+	if(r1 > 0.0f && r1 < max_t) root = r1;
+	else if(r2 > 0.0f && r2 < max_t) root = r2;
+	else return false;
+
+	float along = (vec3::dot(edge, velocity) * root - vec3::dot(edge, q)) / edge_sqrlen;
+	if(along < 0.0f || along > 1.0f) return false;
+	*t = root;
+	*f = along;
+	return true;
+}
+
+// the unit sphere swept along the ray against the front face of the triangle, normal is the unit normal of the triangle
+static bool spherecast_to_triangle(const ray_t &ray, const vec3 &p1, const vec3 &p2, const vec3 &p3, const vec3 &normal, RayHit *hitinfo)
 {
-	plane_t plane(p1, p2, p3);
+	plane_t plane(p1, normal);
 
 	bool is_ray_crossing = vec3::dot(plane.normal, ray.dir.normalized()) < 0;
 	if(!is_ray_crossing) return false;
@@ -705,484 +2644,1607 @@ static bool spherecast_to_triangle(const ray_t &ray, const vec3 &p1, const vec3
 		}
 		else
 		{
-			// sphere is embedded in plane
-			embedded_in_plane = true;
-			t0 = 0.0f;
-			t1 = 1.0f;
+			// sphere is embedded in plane
+			embedded_in_plane = true;
+			t0 = 0.0f;
+			t1 = 1.0f;
+		}
+	}
+	else
+	{
+		t0 = (-1.0f - distance_to_plane) / normal_dot_velocity;
+		t1 = (1.0f - distance_to_plane) / normal_dot_velocity;
+		if(t0 > t1){
+			float tmp = t1;
+			t1 = t0;
+			t0 = tmp;
+		}
+
+		// check the range
+		if(t0 > 1.0f || t1 < 0.0f){
+			// no collision possible
+			return false;
+		}
+
+		// clamp to 01
+		t0 = clamp01(t0);
+		t1 = clamp01(t1);
+	}
+
+	vec3 collision_point;
+	bool found_collision = false;
+	float t = 1.0;
+
+	// check triangle face
+	if(!embedded_in_plane)
+	{
+		vec3 plane_intersection_point = (ray.pos - plane.normal) + ray.dir * t0;
+		if(check_point_in_triangle(plane_intersection_point, p1, p2, p3))
+		{
+			found_collision = true;
+			t = t0;
+			collision_point = plane_intersection_point;
+		}
+	}
+
+	// check collision to vertex and edges
+	if(found_collision == false)
+	{
+		vec3 velocity = ray.dir;
+		vec3 base = ray.pos;
+		float velocity_sqrlen = velocity.sqrlen();
+		float new_t;
+		const vec3 *corners[3] = {&p1, &p2, &p3};
+
+		for(int i=0; i<3; i++)
+		{
+			if(sweep_to_point(base, velocity, velocity_sqrlen, *corners[i], t, &new_t))
+			{
+				t = new_t;
+				found_collision = true;
+				collision_point = *corners[i];
+			}
+		}
+
+		// p1 -> p2, p2 -> p3 and p3 -> p1
+		for(int i=0; i<3; i++)
+		{
+			const vec3 &from = *corners[i];
+			vec3 edge = *corners[(i+1)%3] - from;
+			float f;
+			if(sweep_to_edge(base, velocity, from, edge, t, &new_t, &f))
+			{
+				t = new_t;
+				found_collision = true;
+				collision_point = from + edge * f;
+			}
+		}
+	}
+
+	// set result
+	if(found_collision)
+	{
+		float dist_to_collision = ray.dir.len() * t;
+		if(hitinfo->distance > dist_to_collision)
+		{
+			hitinfo->point = collision_point;
+			hitinfo->normal = ((ray.pos + ray.dir * t) - collision_point).normalized();
+			hitinfo->distance = dist_to_collision;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+// swept sphere against the box centered at the origin, the direction must be normalized
+// the box expanded by the radius is a rounded box, the feature region the ray enters the expanded box in
+// tells if it hits a face, or has to be tested against the capsules of the edges (real-time collision detection 5.5.7)
+static bool spherecast_vs_AABB(const vec3 &pos, const vec3 &dir, float max_distance, float radius, const vec3 &half, float *distance)
+{
+	// the ray starts touching the box
+	vec3 q = clamp(pos, -half, half);
+	if((pos - q).sqrlen() <= radius*radius)
+	{
+		*distance = 0.0f;
+		return true;
+	}
+
+	vec3 r = vec3(radius, radius, radius);
+	float t;
+	if(!ray_vs_bounds(pos, safe_inv_dir(dir), max_distance, -half - r, half + r, &t)) return false;
+	t = fmaxf(t, 0.0f);
+
+	// axes the entry point is outside of the box on
+	vec3 p = pos + dir * t;
+	int outside = 0;
+	int count = 0;
+	vec3 corner;
+	for(int axis=0; axis<3; axis++)
+	{
+		float v = (&p.x)[axis];
+		float h = (&half.x)[axis];
+		(&corner.x)[axis] = v < 0.0f ? -h : h;
+		if(v < -h || v > h)
+		{
+			outside |= 1 << axis;
+			count++;
+		}
+	}
+
+	// face region
+	if(count <= 1)
+	{
+		*distance = t;
+		return true;
+	}
+
+	// the capsules are tested from a radius before the entry point, from the start of a long cast the quadratic
+	// loses the grazing hits to cancellation and right on the entry point the root can round below zero
+	float entry = t - fminf(t, radius);
+	vec3 start = pos + dir * entry;
+	max_distance -= entry;
+
+	// edge region, the edge runs along the axis the point is inside on
+	if(count == 2)
+	{
+		int axis = (outside ^ 0x7) == 1 ? 0 : ((outside ^ 0x7) == 2 ? 1 : 2);
+		vec3 p1 = corner;
+		vec3 p2 = corner;
+		(&p1.x)[axis] = -(&half.x)[axis];
+		(&p2.x)[axis] = (&half.x)[axis];
+		if(!ray_vs_capsule_distance(start, dir, max_distance, p1, p2, radius, &t)) return false;
+		*distance = entry + t;
+		return true;
+	}
+
+	// vertex region, the three edges meeting at the corner
+	bool hited = false;
+	for(int axis=0; axis<3; axis++)
+	{
+		vec3 p2 = corner;
+		(&p2.x)[axis] = -(&corner.x)[axis];
+		if(ray_vs_capsule_distance(start, dir, max_distance, corner, p2, radius, &t))
+		{
+			max_distance = t;
+			hited = true;
+		}
+	}
+	if(hited) *distance = entry + max_distance;
+	return hited;
+}
+
+// swept sphere against an oriented box, the test runs in the rotated frame of the box without its scale
+// so the sphere stays a sphere
+bool spherecast_vs_box(const ray_t &ray, float rayradius, const mat4 &m, const mat4 &inv, const vec3 &size, const vec3 &scale, RayHit *hitinfo)
+{
+	float raylen = ray.dir.len();
+	if(raylen <= 0.0f) return false;
+
+	vec3 inv_scale = vec3(1.0f/scale.x, 1.0f/scale.y, 1.0f/scale.z);
+	vec3 pos = inv.multiply_point_3x4(ray.pos) * scale;
+	vec3 dir = (inv.multiply_vector(ray.dir) * scale) / raylen;
+	vec3 half = vec3::abs(size * scale) * 0.5f;
+
+	float t;
+	if(!spherecast_vs_AABB(pos, dir, raylen, rayradius, half, &t)) return false;
+
+	// the closest point on the box to the sphere center is the contact point
+	vec3 center = pos + dir * t;
+	vec3 point = clamp(center, -half, half);
+	vec3 normal = center - point;
+	if(normal.sqrlen() == 0.0f)
+	{
+		// the sphere center starts inside the box, push it out of the nearest face
+		vec3 d = half - vec3::abs(center);
+		int axis = (d.x < d.y && d.x < d.z) ? 0 : (d.y < d.z ? 1 : 2);
+		(&normal.x)[axis] = signf((&center.x)[axis]);
+	}
+
+	hitinfo->point = m.multiply_point_3x4(point * inv_scale);
+	hitinfo->normal = m.multiply_vector(normal.normalized() * inv_scale).normalized();
+	hitinfo->distance = t;
+	return true;
+}
+
+static bool spherecast_vs_capsule(const ray_t &ray, float radius, vec3 capsule_dir, float capsule_radius, float capsule_height, const mat4 &transform, const mat4 &inv, RayHit *hitinfo)
+{
+	float r = radius + capsule_radius;
+	ray_t inv_ray;
+	inv_ray.dir = inv.multiply_vector(ray.dir)/r;
+	inv_ray.pos = inv.multiply_point_3x4(ray.pos)/r;
+
+	vec3 p1 = capsule_dir * capsule_height * 0.5f;
+	vec3 p2 = -capsule_dir * capsule_height * 0.5f;
+	p1 = p1/r;
+	p2 = p2/r;
+
+	// check collision
+	bool found_collision = false;
+	vec3 collision_point;
+	vec3 velocity = inv_ray.dir;
+	vec3 base = inv_ray.pos;
+	float velocity_sqrlen = velocity.sqrlen();
+	float a,b,c;
+	float t = 1.0f;
+	float new_t;
+
+	a = velocity_sqrlen;
+
+	// p1
+	b = 2.0f * vec3::dot(velocity, base - p1);
+	c = vec3::dot(p1 - base, p1 - base) - 1.0f;
+	if(get_lowest_root(a, b, c, t, &new_t))
+	{
+		t = new_t;
+		found_collision = true;
+		collision_point = p1;
+	}
+
+	// p2
+	b = 2.0f * vec3::dot(velocity, base - p2);
+	c = vec3::dot(p2 - base, p2 - base) - 1.0f;
+	if(get_lowest_root(a, b, c, t, &new_t))
+	{
+		t = new_t;
+		found_collision = true;
+		collision_point = p2;
+	}
+
+
+	// p1 -> p2
+	vec3 edge = p2 - p1;
+	vec3 base_to_vertex = p1 - base;
+	float edge_sqrtlen = edge.sqrlen();
+	float edge_dot_velocity = vec3::dot(edge, velocity);
+	float edge_dot_basetovertex = vec3::dot(edge, base_to_vertex);
+
+	// calculate parameters for equation
+	a = edge_sqrtlen * -velocity_sqrlen + edge_dot_velocity * edge_dot_velocity;
+	b = edge_sqrtlen * 2 * vec3::dot(velocity, base_to_vertex) - 2.0f * edge_dot_velocity * edge_dot_basetovertex;
+	c = edge_sqrtlen * (1 - vec3::dot(base_to_vertex, base_to_vertex)) + edge_dot_basetovertex * edge_dot_basetovertex;
+	if(get_lowest_root(a, b, c, t, &new_t))
+	{
+		// check if intersection is within line segment
+		float f = (edge_dot_velocity * new_t - edge_dot_basetovertex) / edge_sqrtlen;
+		if(f >= 0.0f && f <= 1.0f)
+		{
+			t = new_t;
+			found_collision = true;
+			collision_point = p1 + edge * f;
+		}
+	}
+
+	// set result
+	if(found_collision)
+	{
+		float dist_to_collision = inv_ray.dir.len() * t;
+		hitinfo->point = transform.multiply_point_3x4(collision_point*r);
+		hitinfo->distance = dist_to_collision * r;
+		hitinfo->normal =  ((ray.pos + ray.dir.normalized() * hitinfo->distance) - hitinfo->point).normalized();
+		hitinfo->point += hitinfo->normal * capsule_radius;
+		return true;
+	}
+
+	return false;
+}
+
+// true when the collider scale is the same along every axis, spheres and boxes keep their shape in its frame
+// uniform is the smallest scale of the axes, 0 for a degenerate frame
+static bool get_uniform_scale(const vec3 &scale, float *uniform)
+{
+	vec3 s = vec3::abs(scale);
+	*uniform = fminf(fminf(s.x, s.y), s.z);
+	return *uniform > 0.0f && s.x == s.y && s.y == s.z;
+}
+
+// the filter inflates the sphere past the rounding of the scalar test, which grows with the distance to the triangles
+// unit_len is the length of the sweep in unit sphere space
+static float spherecast_filter_inflate(float unit_len)
+{
+	return 1e-3f + unit_len * 4e-6f;
+}
+
+// exact swept sphere against triangle i of the mesh, the triangle is moved to the start of the sweep before it is scaled
+// to unit sphere space like the filter does it, so both round the same way, and it faces the way of the normal the filter
+// reads, a thin triangle far from the start could flip when its normal is taken from the moved corners.
+// unit_ray starts at the origin and the hit point is relative to the start
+static bool spherecast_mesh_triangle(const CollisionMesh *mesh, u32 i, const vec3 &pos, float inv_radius, const ray_t &unit_ray, RayHit *hit)
+{
+	const vec3 *vertices = mesh->vertices;
+	const u32 *indices = mesh->indices;
+	const MeshTriangleSoA *tris = mesh->triangles;
+	vec3 p1 = (vertices[indices[i*3]] - pos) * inv_radius;
+	vec3 p2 = (vertices[indices[i*3+1]] - pos) * inv_radius;
+	vec3 p3 = (vertices[indices[i*3+2]] - pos) * inv_radius;
+	vec3 normal(tris->n[0][i], tris->n[1][i], tris->n[2][i]);
+	return spherecast_to_triangle(unit_ray, p1, p2, p3, normal, hit);
+}
+
+// the triangle moved to world space by m and swept there around pos, for frames whose scale is not uniform
+static bool spherecast_world_triangle(const vec3 &v0, const vec3 &v1, const vec3 &v2, const mat4 &m, const vec3 &pos, float inv_radius, const ray_t &unit_ray, RayHit *hit)
+{
+	vec3 w0 = m.multiply_point_3x4(v0);
+	vec3 w1 = m.multiply_point_3x4(v1);
+	vec3 w2 = m.multiply_point_3x4(v2);
+	return spherecast_to_triangle(unit_ray, (w0 - pos) * inv_radius, (w1 - pos) * inv_radius, (w2 - pos) * inv_radius, triangle_unit_normal(w0, w1, w2), hit);
+}
+
+static bool spherecast_vs_mesh(const ray_t &ray, float radius, const CollisionMesh *mesh, const mat4 &transform, const mat4 &inv, const vec3 &transform_scale, RayHit *hitinfo)
+{
+	if(mesh == nullptr || mesh->nodes == nullptr) return false;
+	const MeshBVHNode *nodes = mesh->nodes;
+
+	// convert ray to model space, a uniform scale keeps the sphere a sphere there. otherwise the BVH is walked with the
+	// sphere at the smallest scale and the triangles are swept in world space
+	float scale;
+	bool uniform = get_uniform_scale(transform_scale, &scale);
+	if(scale <= 0.0f) return false;
+	float local_radius = radius / scale;
+	vec3 ray_pos = inv.multiply_point_3x4(ray.pos);
+	vec3 ray_dir = inv.multiply_vector(ray.dir);
+	vec3 inv_dir = safe_inv_dir(ray_dir);
+	vec3 r = vec3(local_radius, local_radius, local_radius);
+
+	// and then unit sphere space around the start of the sweep
+	ray_t inv_ray;
+	inv_ray.dir = uniform ? ray_dir/local_radius : ray.dir/radius;
+	inv_ray.pos = vec3();
+	float unit_len = inv_ray.dir.len();
+	float inv_radius = 1.0f / local_radius;
+	float inflate = spherecast_filter_inflate(unit_len);
+
+	RayHit nearest_hit = {};
+	nearest_hit.distance = FLOAT_MAX;
+	bool hited = false;
+
+	// traverse the BVH with the node bounds expanded by the sphere radius
+	// the ray parameter is in the range of 0 to 1 along the velocity
+	u32 stack[BVH_STACK_SIZE];
+	int stack_count = 0;
+	stack[stack_count++] = 0;
+	while(stack_count > 0)
+	{
+		const MeshBVHNode &node = nodes[stack[--stack_count]];
+		MeshBVHNode expanded = node;
+		expanded.min -= r;
+		expanded.max += r;
+		float max_t = hited ? nearest_hit.distance / unit_len : 1.0f;
+		float dist;
+		if(!ray_vs_bvh_node(ray_pos, inv_dir, fminf(max_t, 1.0f), expanded, &dist)) continue;
+
+		if(node.count > 0 && !uniform)
+		{
+			const vec3 *vertices = mesh->vertices;
+			const u32 *indices = mesh->indices;
+			for(u32 i=node.first; i<node.first+node.count; i++)
+			{
+				RayHit hit = {};
+				hit.distance = FLOAT_MAX;
+				if(spherecast_world_triangle(vertices[indices[i*3]], vertices[indices[i*3+1]], vertices[indices[i*3+2]], transform, ray.pos, 1.0f / radius, inv_ray, &hit))
+				{
+					hited = true;
+					if(hit.distance < nearest_hit.distance)
+					{
+						nearest_hit = hit;
+					}
+				}
+			}
+		}
+		else if(node.count > 0)
+		{
+			// the batched test leaves out most triangles, the rest get the exact contact from the scalar test
+			u32 end = node.first + node.count;
+			for(u32 first=node.first; first<end; first+=SIMD_WIDTH)
+			{
+				float limit = hited ? nearest_hit.distance / unit_len : 1.0f;
+				int bits = spherecast_vs_triangles(ray_pos, ray_dir, inv_radius, inflate, mesh->triangles, first, limit);
+				for(u32 l=0; l<SIMD_WIDTH && bits != 0; l++)
+				{
+					u32 i = first + l;
+					if(!(bits & (1<<l)) || i >= end) continue;
+
+					RayHit hit = {};
+					hit.distance = FLOAT_MAX;
+					if(spherecast_mesh_triangle(mesh, i, ray_pos, inv_radius, inv_ray, &hit))
+					{
+						hited = true;
+						if(hit.distance < nearest_hit.distance)
+						{
+							nearest_hit = hit;
+						}
+					}
+				}
+			}
+		}
+		else
+		{
+			stack[stack_count++] = node.first+1;
+			stack[stack_count++] = node.first;
 		}
 	}
-	else
+
+	if(hited)
 	{
-		t0 = (-1.0f - distance_to_plane) / normal_dot_velocity;
-		t1 = (1.0f - distance_to_plane) / normal_dot_velocity;
-		if(t0 > t1){
-			float tmp = t1;
-			t1 = t0;
-			t0 = tmp;
+		// convert hit result back from unit sphere space and then back from model space
+		// the unit sphere is the same size in both spaces, so the distance only scales by the world radius
+		if(uniform)
+		{
+			hitinfo->point = transform.multiply_point_3x4(nearest_hit.point*local_radius + ray_pos);
+			hitinfo->normal = transform.multiply_vector(nearest_hit.normal).normalized();
 		}
-
-		// check the range
-		if(t0 > 1.0f || t1 < 0.0f){
-			// no collision possible
-			return false;
+		else
+		{
+			hitinfo->point = nearest_hit.point*radius + ray.pos;
+			hitinfo->normal = nearest_hit.normal;
 		}
-
-		// clamp to 01
-		t0 = clamp01(t0);
-		t1 = clamp01(t1);
+		hitinfo->distance = nearest_hit.distance * radius;
 	}
 
-	vec3 collision_point;
-	bool found_collision = false;
-	float t = 1.0;
+	return hited;
+}
 
-	// check triangle face
-	if(!embedded_in_plane)
+/////////////////////////////////////////////////////////////////////////////////////////
+// Kernel tests
+#ifdef COLLISION_KERNEL_TESTS
+int collision_simd_width()
+{
+	return SIMD_WIDTH;
+}
+
+bool collision_ray_vs_triangles(const CollisionMesh *mesh, const vec3 &pos, const vec3 &dir, bool simd, float *distance, u32 *triangle)
+{
+	if(mesh == nullptr || mesh->triangles == nullptr) return false;
+	if(simd) return ray_vs_triangles(pos, dir, mesh->triangles, 0, mesh->triangle_count, distance, triangle);
+	return ray_vs_triangles_scalar(pos, dir, mesh->triangles, 0, mesh->triangle_count, distance, triangle);
+}
+
+bool collision_spherecast_vs_triangles(const CollisionMesh *mesh, const vec3 &pos, const vec3 &dir, float radius, bool simd, float *distance, u32 *triangle)
+{
+	if(mesh == nullptr || mesh->triangles == nullptr || radius <= 0.0f) return false;
+	ray_t inv_ray;
+	inv_ray.dir = dir/radius;
+	inv_ray.pos = vec3();
+	float unit_len = inv_ray.dir.len();
+	if(unit_len <= 0.0f) return false;
+	float inv_radius = 1.0f / radius;
+	float inflate = spherecast_filter_inflate(unit_len);
+
+	// the same loop as a leaf of spherecast_vs_mesh over the whole mesh, without the filter every triangle is tested
+	RayHit nearest_hit = {};
+	nearest_hit.distance = FLOAT_MAX;
+	bool hited = false;
+	for(u32 first=0; first<mesh->triangle_count; first+=SIMD_WIDTH)
 	{
-		vec3 plane_intersection_point = (ray.pos - plane.normal) + ray.dir * t0;
-		if(check_point_in_triangle(plane_intersection_point, p1, p2, p3))
+		float limit = hited ? nearest_hit.distance / unit_len : 1.0f;
+		int bits = simd ? spherecast_vs_triangles(pos, dir, inv_radius, inflate, mesh->triangles, first, limit) : (1<<SIMD_WIDTH) - 1;
+		for(u32 l=0; l<SIMD_WIDTH && bits != 0; l++)
 		{
-			found_collision = true;
-			t = t0;
-			collision_point = plane_intersection_point;
+			u32 i = first + l;
+			if(!(bits & (1<<l)) || i >= mesh->triangle_count) continue;
+
+			RayHit hit = {};
+			hit.distance = FLOAT_MAX;
+			if(spherecast_mesh_triangle(mesh, i, pos, inv_radius, inv_ray, &hit))
+			{
+				if(!hited || hit.distance < nearest_hit.distance)
+				{
+					nearest_hit = hit;
+					*triangle = i;
+				}
+				hited = true;
+			}
 		}
 	}
 
-	// check collision to vertex and edges
-	if(found_collision == false)
-	{
-		vec3 velocity = ray.dir;
-		vec3 base = ray.pos;
-		float velocity_sqrlen = velocity.sqrlen();
-		float a,b,c;
-		float new_t;
+	if(hited) *distance = nearest_hit.distance * radius;
+	return hited;
+}
 
-		a = velocity_sqrlen;
+size_t collision_mesh_memory(const CollisionMesh *mesh)
+{
+	if(mesh == nullptr) return 0;
+	size_t size = sizeof(CollisionMesh);
+	size += sizeof(vec3) * mesh->vertex_count;
+	size += sizeof(u32) * mesh->triangle_count * 3;
+	size += sizeof(MeshBVHNode) * mesh->node_count;
+	if(mesh->triangles) size += sizeof(MeshTriangleSoA) + sizeof(float) * (mesh->triangles->count + SIMD_WIDTH) * 12;
+	return size;
+}
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// Heightfield
+// the two triangles of a cell, wound so their normals point up
+static bool get_heightfield_cell(const CollisionHeightfield *hf, u32 x, u32 z, vec3 *v, float *min_height, float *max_height)
+{
+	float h00 = hf->get_height(x, z);
+	float h01 = hf->get_height(x, z+1);
+	float h10 = hf->get_height(x+1, z);
+	float h11 = hf->get_height(x+1, z+1);
+	if(h00 == HEIGHTFIELD_HOLE || h01 == HEIGHTFIELD_HOLE || h10 == HEIGHTFIELD_HOLE || h11 == HEIGHTFIELD_HOLE) return false;
+
+	float x0 = hf->origin.x + x*hf->cell_size;
+	float z0 = hf->origin.z + z*hf->cell_size;
+	v[0] = vec3(x0, h00, z0);
+	v[1] = vec3(x0, h01, z0 + hf->cell_size);
+	v[2] = vec3(x0 + hf->cell_size, h10, z0);
+	v[3] = vec3(x0 + hf->cell_size, h11, z0 + hf->cell_size);
+	*min_height = fminf(fminf(h00, h01), fminf(h10, h11));
+	*max_height = fmaxf(fmaxf(h00, h01), fmaxf(h10, h11));
+	return true;
+}
+
+// two sided Moller-Trumbore test, the direction must be normalized
+// the edges are widened a little so rays along a cell border hit one of the neighbouring cells
+static bool ray_vs_triangle(const vec3 &pos, const vec3 &dir, const vec3 &v0, const vec3 &v1, const vec3 &v2, float *distance)
+{
+	const float edge_tolerance = 1e-5f;
+	vec3 e1 = v1 - v0;
+	vec3 e2 = v2 - v0;
+	vec3 p = vec3::cross(dir, e2);
+	float det = vec3::dot(e1, p);
+	if(det > -EPSILON && det < EPSILON) return false;
+	float invdet = 1.0f / det;
+
+	vec3 tv = pos - v0;
+	float u = vec3::dot(tv, p) * invdet;
+	if(u < -edge_tolerance || u > 1.0f + edge_tolerance) return false;
+	vec3 q = vec3::cross(tv, e1);
+	float v = vec3::dot(dir, q) * invdet;
+	if(v < -edge_tolerance || u + v > 1.0f + edge_tolerance) return false;
+
+	float t = vec3::dot(e2, q) * invdet;
+	if(t <= EPSILON || t >= *distance) return false;
+	*distance = t;
+	return true;
+}
 
-		// p1
-		b = 2.0f * vec3::dot(velocity, base - p1);
-		c = vec3::dot(p1 - base, p1 - base) - 1.0f;
-		if(get_lowest_root(a, b, c, t, &new_t))
+// walks the cells under the ray in order (amanatides-woo), the first cell with a hit has the nearest hit
+static bool ray_vs_heightfield(const ray_t &ray, const CollisionHeightfield *hf, const mat4 &transform, const mat4 &inv, RayHit *hitinfo)
+{
+	if(hf == nullptr) return false;
+
+	vec3 pos = inv.multiply_point_3x4(ray.pos);
+	vec3 dir = inv.multiply_vector(ray.dir);
+	float max_distance = dir.len();
+	if(max_distance <= 0.0f) return false;
+	dir = dir / max_distance;
+
+	float t;
+	if(!ray_vs_bounds(pos, safe_inv_dir(dir), max_distance, hf->bounds.get_min(), hf->bounds.get_max(), &t)) return false;
+	t = fmaxf(t, 0.0f);
+
+	// cell of the entry point
+	float cell = hf->cell_size;
+	vec3 entry = pos + dir * t;
+	int x = (int)floorf((entry.x - hf->origin.x) / cell);
+	int z = (int)floorf((entry.z - hf->origin.z) / cell);
+	x = x < 0 ? 0 : (x >= (int)hf->width ? (int)hf->width-1 : x);
+	z = z < 0 ? 0 : (z >= (int)hf->depth ? (int)hf->depth-1 : z);
+
+	int step_x = dir.x > 0.0f ? 1 : -1;
+	int step_z = dir.z > 0.0f ? 1 : -1;
+	float delta_x = dir.x != 0.0f ? cell / fabsf(dir.x) : FLOAT_MAX;
+	float delta_z = dir.z != 0.0f ? cell / fabsf(dir.z) : FLOAT_MAX;
+	float next_x = dir.x != 0.0f ? (hf->origin.x + (x + (step_x > 0 ? 1 : 0)) * cell - pos.x) / dir.x : FLOAT_MAX;
+	float next_z = dir.z != 0.0f ? (hf->origin.z + (z + (step_z > 0 ? 1 : 0)) * cell - pos.z) / dir.z : FLOAT_MAX;
+
+	float nearest = max_distance;
+	vec3 nearest_normal;
+	bool hited = false;
+	while(true)
+	{
+		float exit = fminf(fminf(next_x, next_z), max_distance);
+
+		// skip the cell when the ray passes above or below it
+		vec3 v[4];
+		float min_height, max_height;
+		float y0 = pos.y + dir.y * t;
+		float y1 = pos.y + dir.y * exit;
+		if(get_heightfield_cell(hf, x, z, v, &min_height, &max_height) &&
+			fminf(y0, y1) <= max_height + EPSILON && fmaxf(y0, y1) >= min_height - EPSILON)
 		{
-			t = new_t;
-			found_collision = true;
-			collision_point = p1;
+			if(ray_vs_triangle(pos, dir, v[0], v[1], v[2], &nearest))
+			{
+				nearest_normal = vec3::cross(v[1] - v[0], v[2] - v[0]);
+				hited = true;
+			}
+			if(ray_vs_triangle(pos, dir, v[2], v[1], v[3], &nearest))
+			{
+				nearest_normal = vec3::cross(v[1] - v[2], v[3] - v[2]);
+				hited = true;
+			}
+			if(hited) break;
 		}
 
-		// p2
-		b = 2.0f * vec3::dot(velocity, base - p2);
-		c = vec3::dot(p2 - base, p2 - base) - 1.0f;
-		if(get_lowest_root(a, b, c, t, &new_t))
+		if(exit >= max_distance) break;
+		t = exit;
+		if(next_x < next_z)
 		{
-			t = new_t;
-			found_collision = true;
-			collision_point = p2;
+			x += step_x;
+			next_x += delta_x;
 		}
-
-		// p3
-		b = 2.0f * vec3::dot(velocity, base - p3);
-		c = vec3::dot(p3 - base, p3 - base) - 1.0f;
-		if(get_lowest_root(a, b, c, t, &new_t))
+		else
 		{
-			t = new_t;
-			found_collision = true;
-			collision_point = p3;
+			z += step_z;
+			next_z += delta_z;
 		}
+		if(x < 0 || x >= (int)hf->width || z < 0 || z >= (int)hf->depth) break;
+	}
 
+	if(!hited) return false;
+	hitinfo->point = transform.multiply_point_3x4(pos + dir * nearest);
+	hitinfo->normal = transform.multiply_vector(nearest_normal).normalized();
+	hitinfo->distance = (hitinfo->point - ray.pos).len();
+	return true;
+}
 
-		// p1 -> p2
-		vec3 edge = p2 - p1;
-		vec3 base_to_vertex = p1 - base;
-		float edge_sqrtlen = edge.sqrlen();
-		float edge_dot_velocity = vec3::dot(edge, velocity);
-		float edge_dot_basetovertex = vec3::dot(edge, base_to_vertex);
+// tests the cells the swept sphere passes over
+static bool spherecast_vs_heightfield(const ray_t &ray, float radius, const CollisionHeightfield *hf, const mat4 &transform, const mat4 &inv, const vec3 &transform_scale, RayHit *hitinfo)
+{
+	if(hf == nullptr) return false;
+
+	// like the mesh, the cells are picked with the sphere at the smallest scale when the scale is not uniform
+	float scale;
+	bool uniform = get_uniform_scale(transform_scale, &scale);
+	if(scale <= 0.0f) return false;
+	float local_radius = radius / scale;
+	vec3 pos = inv.multiply_point_3x4(ray.pos);
+	vec3 dir = inv.multiply_vector(ray.dir);
+	vec3 end = pos + dir;
+	vec3 r = vec3(local_radius, local_radius, local_radius);
+	vec3 sweep_min = vec3::min(pos, end) - r;
+	vec3 sweep_max = vec3::max(pos, end) + r;
+	vec3 hf_min = hf->bounds.get_min();
+	vec3 hf_max = hf->bounds.get_max();
+	if(sweep_min.x > hf_max.x || sweep_max.x < hf_min.x || sweep_min.y > hf_max.y || sweep_max.y < hf_min.y || sweep_min.z > hf_max.z || sweep_max.z < hf_min.z) return false;
+
+	// cell range under the sweep
+	float cell = hf->cell_size;
+	int x0 = (int)floorf((sweep_min.x - hf->origin.x) / cell);
+	int x1 = (int)floorf((sweep_max.x - hf->origin.x) / cell);
+	int z0 = (int)floorf((sweep_min.z - hf->origin.z) / cell);
+	int z1 = (int)floorf((sweep_max.z - hf->origin.z) / cell);
+	x0 = x0 < 0 ? 0 : x0;
+	z0 = z0 < 0 ? 0 : z0;
+	x1 = x1 >= (int)hf->width ? (int)hf->width-1 : x1;
+	z1 = z1 >= (int)hf->depth ? (int)hf->depth-1 : z1;
+
+	// cells further from the sweep line than the radius plus half of the cell diagonal are not touched
+	vec2 line = vec2(dir.x, dir.z);
+	float line_sqrlen = line.sqrlen();
+	float reach = local_radius + cell * 0.7072f;
+
+	// unit sphere space around the start of the sweep like the mesh triangles, so both round the same way
+	ray_t inv_ray;
+	inv_ray.dir = uniform ? dir/local_radius : ray.dir/radius;
+	inv_ray.pos = vec3();
+	float inv_radius = 1.0f / local_radius;
 
-		// calculate parameters for equation
-		a = edge_sqrtlen * -velocity_sqrlen + edge_dot_velocity * edge_dot_velocity;
-		b = edge_sqrtlen * 2 * vec3::dot(velocity, base_to_vertex) - 2.0f * edge_dot_velocity * edge_dot_basetovertex;
-		c = edge_sqrtlen * (1 - vec3::dot(base_to_vertex, base_to_vertex)) + edge_dot_basetovertex * edge_dot_basetovertex;
-		if(get_lowest_root(a, b, c, t, &new_t))
+	RayHit nearest_hit = {};
+	nearest_hit.distance = FLOAT_MAX;
+	bool hited = false;
+	for(int z=z0; z<=z1; z++)
+	{
+		for(int x=x0; x<=x1; x++)
 		{
-			// check if intersection is within line segment
-			float f = (edge_dot_velocity * new_t - edge_dot_basetovertex) / edge_sqrtlen;
-			if(f >= 0.0f && f <= 1.0f)
+			vec2 c = vec2(hf->origin.x + (x + 0.5f)*cell - pos.x, hf->origin.z + (z + 0.5f)*cell - pos.z);
+			float s = line_sqrlen > 0.0f ? clamp01((c.x*line.x + c.y*line.y) / line_sqrlen) : 0.0f;
+			if((c - line * s).sqrlen() > reach*reach) continue;
+
+			vec3 v[4];
+			float min_height, max_height;
+			if(!get_heightfield_cell(hf, x, z, v, &min_height, &max_height)) continue;
+			if(sweep_min.y > max_height || sweep_max.y < min_height) continue;
+
+			RayHit hit = {};
+			hit.distance = FLOAT_MAX;
+			bool result;
+			if(uniform)
 			{
-				t = new_t;
-				found_collision = true;
-				collision_point = p1 + edge * f;
+				vec3 p[4];
+				for(int i=0; i<4; i++) p[i] = (v[i] - pos) * inv_radius;
+				result = spherecast_to_triangle(inv_ray, p[0], p[1], p[2], triangle_unit_normal(v[0], v[1], v[2]), &hit);
+				result |= spherecast_to_triangle(inv_ray, p[2], p[1], p[3], triangle_unit_normal(v[2], v[1], v[3]), &hit);
+			}
+			else
+			{
+				result = spherecast_world_triangle(v[0], v[1], v[2], transform, ray.pos, 1.0f / radius, inv_ray, &hit);
+				result |= spherecast_world_triangle(v[2], v[1], v[3], transform, ray.pos, 1.0f / radius, inv_ray, &hit);
+			}
+			if(result && hit.distance < nearest_hit.distance)
+			{
+				nearest_hit = hit;
+				hited = true;
 			}
 		}
+	}
 
-
-		// p2 -> p3
-		edge = p3 - p2;
-		base_to_vertex = p2 - base;
-		edge_sqrtlen = edge.sqrlen();
-		edge_dot_velocity = vec3::dot(edge, velocity);
-		edge_dot_basetovertex = vec3::dot(edge, base_to_vertex);
-
-		// calculate parameters for equation
-		a = edge_sqrtlen * -velocity_sqrlen + edge_dot_velocity * edge_dot_velocity;
-		b = edge_sqrtlen * 2 * vec3::dot(velocity, base_to_vertex) - 2.0f * edge_dot_velocity * edge_dot_basetovertex;
-		c = edge_sqrtlen * (1 - vec3::dot(base_to_vertex, base_to_vertex)) + edge_dot_basetovertex * edge_dot_basetovertex;
-		if(get_lowest_root(a, b, c, t, &new_t))
+	if(hited)
+	{
+		if(uniform)
 		{
-			// check if intersection is within line segment
-			float f = (edge_dot_velocity * new_t - edge_dot_basetovertex) / edge_sqrtlen;
-			if(f >= 0.0f && f <= 1.0f)
-			{
-				t = new_t;
-				found_collision = true;
-				collision_point = p2 + edge * f;
-			}
+			hitinfo->point = transform.multiply_point_3x4(nearest_hit.point*local_radius + pos);
+			hitinfo->normal = transform.multiply_vector(nearest_hit.normal).normalized();
+		}
+		else
+		{
+			hitinfo->point = nearest_hit.point*radius + ray.pos;
+			hitinfo->normal = nearest_hit.normal;
 		}
+		hitinfo->distance = nearest_hit.distance * radius;
+	}
+	return hited;
+}
+
+int spherecast(const ray_t &ray, float radius, RayHit *rayhit, u32 layermask)
+{
+	QueryStatsRecorder recorder(CollisionQueryType::SPHERECAST);
+	return ctx.tree.cast_nearest(ray, radius, true, layermask, rayhit) ? 1 : 0;
+}
+
+int spherecast_all(const ray_t &ray, float radius, RayHit *rayhit, int rayhit_count, u32 layermask)
+{
+	return spherecast_all(collision_get_thread_query(), ray, radius, rayhit, rayhit_count, layermask);
+}
 
+int spherecast_all(CollisionQuery *query, const ray_t &ray, float radius, RayHit *rayhit, int rayhit_count, u32 layermask)
+{
+	QueryStatsRecorder recorder(CollisionQueryType::SPHERECAST_ALL);
+	std::vector<u32> &indices = query->indices;
+	std::vector<RayHit> &hits = query->hits;
+	hits.clear();
 
-		// p3 -> p1
-		edge = p1 - p3;
-		base_to_vertex = p3 - base;
-		edge_sqrtlen = edge.sqrlen();
-		edge_dot_velocity = vec3::dot(edge, velocity);
-		edge_dot_basetovertex = vec3::dot(edge, base_to_vertex);
+	bounds_t bounds(ray.pos, vec3(radius, radius, radius));
+	bounds.encapsulate(bounds_t(ray.pos + ray.dir, vec3(radius, radius, radius)));
 
-		// calculate parameters for equation
-		a = edge_sqrtlen * -velocity_sqrlen + edge_dot_velocity * edge_dot_velocity;
-		b = edge_sqrtlen * 2 * vec3::dot(velocity, base_to_vertex) - 2.0f * edge_dot_velocity * edge_dot_basetovertex;
-		c = edge_sqrtlen * (1 - vec3::dot(base_to_vertex, base_to_vertex)) + edge_dot_basetovertex * edge_dot_basetovertex;
-		if(get_lowest_root(a, b, c, t, &new_t))
+	ctx.tree.query(bounds, layermask, &indices);
+	for(int i=0; i<(int)indices.size(); i++)
+	{
+		const Collider *c = ctx.tree.get_collider(indices[i]);
+		RayHit hitinfo = {};
+		hitinfo.distance = ray.dir.len();
+		if(c->intersect_spherecast(ray, radius, &hitinfo))
 		{
-			// check if intersection is within line segment
-			float f = (edge_dot_velocity * new_t - edge_dot_basetovertex) / edge_sqrtlen;
-			if(f >= 0.0f && f <= 1.0f)
-			{
-				t = new_t;
-				found_collision = true;
-				collision_point = p3 + edge * f;
-			}
+			hitinfo.collider = ctx.tree.get_collider_ref(indices[i]);
+			hits.push_back(hitinfo);
 		}
 	}
+	if(stats_counters)
+	{
+		stats_counters->tests += (u32)indices.size();
+		stats_counters->hits += (u32)hits.size();
+	}
+	indices.clear();
 
-	// set result
-	if(found_collision)
+	return sort_hits(hits, rayhit, rayhit_count);
+}
+
+
+vec3 spherecast_slide(const vec3 &position, const vec3 &velocity, float radius, u32 layermask, int recursion)
+{
+	return spherecast_slide(collision_get_thread_query(), position, velocity, radius, layermask, recursion);
+}
+
+vec3 spherecast_slide(CollisionQuery *query, const vec3 &position, const vec3 &velocity, float radius, u32 layermask, int recursion)
+{
+	const float close_distance = 0.005f;
+
+	// dont recurse if the new velocity is very small
+	if(velocity.len() < close_distance) {
+		return position;
+	}
+
+	if(recursion <= 0)
+		return position;
+
+	RayHit hitinfo;
+	if(!spherecast(ray_t(position, velocity), radius, &hitinfo, layermask))
 	{
-		float dist_to_collision = ray.dir.len() * t;
-		if(hitinfo->distance > dist_to_collision)
+		return position + velocity;
+	}
+
+	// found collision
+	vec3 destination_point = position + velocity;
+	vec3 new_base_point = position;
+	if(hitinfo.distance >= close_distance)
+	{
+		vec3 v = velocity.normalized() * (hitinfo.distance - close_distance);
+		new_base_point = position + v;
+	}
+
+	vec3 slide_plane_origin = hitinfo.point;
+	vec3 slide_plane_normal = (new_base_point - hitinfo.point).normalized();
+	plane_t slide_plane(slide_plane_origin, slide_plane_normal);
+	vec3 new_destination_point = destination_point - slide_plane_normal * slide_plane.signed_distance_to(destination_point);
+	vec3 new_velocity = new_destination_point - hitinfo.point;
+
+	return spherecast_slide(query, new_base_point, new_velocity, radius, layermask, recursion-1);
+}
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// Overlap
+// a contact normal points from the collider to the query shape, moving the shape by normal * depth separates them
+// the contact point is the deepest point of the query shape moved back onto the collider surface
+
+// oriented box of the box queries
+struct OverlapBox
+{
+	vec3 center;
+	vec3 axis[3];	// unit axes
+	vec3 half;		// half size along the axes
+};
+
+static OverlapBox create_overlap_box(const vec3 &center, const vec3 &size, const quat &rotation)
+{
+	mat4 m = mat4(center, rotation, vec3(1,1,1));
+	OverlapBox box;
+	box.center = center;
+	box.axis[0] = m.multiply_vector(vec3(1,0,0));
+	box.axis[1] = m.multiply_vector(vec3(0,1,0));
+	box.axis[2] = m.multiply_vector(vec3(0,0,1));
+	box.half = vec3::abs(size) * 0.5f;
+	return box;
+}
+
+// the box in the frame of a uniformly scaled collider, m is the world to local matrix and scale the scale of the frame
+// the rotation keeps the box a box, its half sizes shrink by the scale
+static OverlapBox transform_overlap_box(const OverlapBox &box, const mat4 &m, float scale)
+{
+	OverlapBox b;
+	b.center = m.multiply_point_3x4(box.center);
+	for(int i=0; i<3; i++)
+	{
+		b.axis[i] = m.multiply_vector(box.axis[i]).normalized();
+	}
+	b.half = box.half / scale;
+	return b;
+}
+
+// the box of a box collider in world space
+static OverlapBox get_collider_box(const Collider *c)
+{
+	const vec3 unit[3] = {vec3(1,0,0), vec3(0,1,0), vec3(0,0,1)};
+	OverlapBox box;
+	box.center = c->world.multiply_point_3x4(vec3());
+	vec3 half = vec3::abs(c->size) * 0.5f;
+	for(int i=0; i<3; i++)
+	{
+		vec3 axis = c->world.multiply_vector(unit[i]);
+		float len = axis.len();
+		box.axis[i] = len > 0.0f ? axis / len : unit[i];
+		(&box.half.x)[i] = (&half.x)[i] * len;
+	}
+	return box;
+}
+
+// inside is set when p is in the box, the closest point is p itself then
+static inline vec3 closest_point_on_box(const OverlapBox &box, const vec3 &p, bool *inside=nullptr)
+{
+	vec3 d = p - box.center;
+	vec3 q = box.center;
+	bool in = true;
+	for(int i=0; i<3; i++)
+	{
+		float h = (&box.half.x)[i];
+		float t = vec3::dot(d, box.axis[i]);
+		in = in && t >= -h && t <= h;
+		q += box.axis[i] * clamp(t, -h, h);
+	}
+	if(inside) *inside = in;
+	return q;
+}
+
+// the box corner furthest along the direction
+static inline vec3 get_box_support(const OverlapBox &box, const vec3 &dir)
+{
+	vec3 p = box.center;
+	for(int i=0; i<3; i++)
+	{
+		p += box.axis[i] * ((&box.half.x)[i] * signf(vec3::dot(box.axis[i], dir)));
+	}
+	return p;
+}
+
+static inline void project_box(const OverlapBox &box, const vec3 &axis, float *min, float *max)
+{
+	float c = vec3::dot(box.center, axis);
+	float r = box.half.x * fabsf(vec3::dot(box.axis[0], axis)) + box.half.y * fabsf(vec3::dot(box.axis[1], axis)) + box.half.z * fabsf(vec3::dot(box.axis[2], axis));
+	*min = c - r;
+	*max = c + r;
+}
+
+static inline void project_points(const vec3 *points, int count, const vec3 &axis, float *min, float *max)
+{
+	*min = *max = vec3::dot(points[0], axis);
+	for(int i=1; i<count; i++)
+	{
+		float d = vec3::dot(points[i], axis);
+		*min = fminf(*min, d);
+		*max = fmaxf(*max, d);
+	}
+}
+
+// one separating axis test, keeps the direction of the least penetration to push the query shape a out of b
+// a one sided axis only pushes along the axis
+static inline bool sat_axis(vec3 axis, float a_min, float a_max, float b_min, float b_max, float *depth, vec3 *normal, bool one_sided=false)
+{
+	float push_positive = b_max - a_min;
+	float push_negative = a_max - b_min;
+	if(push_positive <= 0.0f || push_negative <= 0.0f) return false;
+	if(push_positive < *depth)
+	{
+		*depth = push_positive;
+		*normal = axis;
+	}
+	if(!one_sided && push_negative < *depth)
+	{
+		*depth = push_negative;
+		*normal = -axis;
+	}
+	return true;
+}
+
+// separating axis test of the query box against a convex polygon or box given by its corners and candidate axes
+// with a front direction the box is only pushed out to the front, a surface never pushes it through itself
+static bool box_vs_convex(const OverlapBox &box, const vec3 *points, int point_count, const vec3 *axes, int axis_count, const vec3 *front, Collision *collision)
+{
+	float depth = FLOAT_MAX;
+	vec3 normal;
+	for(int i=0; i<axis_count; i++)
+	{
+		float sqrlen = axes[i].sqrlen();
+		if(sqrlen < 1e-12f) continue;	// parallel edges
+		vec3 axis = axes[i] / sqrtf(sqrlen);
+		bool one_sided = false;
+		if(front)
 		{
-			hitinfo->point = collision_point;
-			hitinfo->normal = ((ray.pos + ray.dir * t) - collision_point).normalized();
-			hitinfo->distance = dist_to_collision;
+			float d = vec3::dot(axis, *front);
+			if(d < 0.0f) axis = -axis;
+			one_sided = fabsf(d) > 1e-4f;
 		}
-		return true;
+		float a_min, a_max, b_min, b_max;
+		project_box(box, axis, &a_min, &a_max);
+		project_points(points, point_count, axis, &b_min, &b_max);
+		if(!sat_axis(axis, a_min, a_max, b_min, b_max, &depth, &normal, one_sided)) return false;
 	}
+	if(depth == FLOAT_MAX) return false;
 
-	return false;
+	collision->normal = normal;
+	collision->depth = depth;
+	collision->point = get_box_support(box, -normal) + normal * depth;
+	return true;
 }
 
-bool spherecast_vs_AABB(const ray_t &ray, float rayradius, const vec3 &pos, const vec3 &size, RayHit *hitinfo)
-{
-	//static vec3 v[] = {
-	//	vec3(-0.5f, 0.5f, 0.5f),
-	//	vec3(0.5f, 0.5f, 0.5f),
-	//	vec3(0.5f, 0.5f, -0.5f),
-	//	vec3(-0.5f, 0.5f, -0.5f),
-	//	vec3(-0.5f, -0.5f, 0.5f),
-	//	vec3(0.5f, -0.5f, 0.5f),
-	//	vec3(0.5f, -0.5f, -0.5f),
-	//	vec3(-0.5f, -0.5f, -0.5f)
-	//};
-
-	//static int indices[] = {0,1, 1,2, 2,3, 3,0,
-	//	0,4, 1,5, 2,6, 3,7,
-	//	4,5, 5,6, 6,7, 7,4
-	//};
-	//const int indices_count = 24;
-
-	//float dist = FLOAT_MAX;
-	//vec3 p1;
-	//vec3 p2;
-	//vec3 ray_start = ray.pos;
-	//vec3 ray_end = ray.pos + ray.dir;
-
-	//// find the shortest distance between a line segment and AABB edges
-	//for(int i=0; i<indices_count; i+=2)
-	//{
-	//	vec3 q1, q2;
-	//	closest_point_line_segments(v[indices[i]]*size+pos, v[indices[i+1]]*size+pos, ray_start, ray_end, &q1, &q2);
-	//	float d = (q2 - q1).sqrlen();
-	//	if(d < dist)
-	//	{
-	//		dist = d;
-	//		p1 = q1;
-	//		p2 = q2;
-	//	}
-	//}
-
-	//// find the shortest distance between a line segment and a surface
-	//vec3 q1 = clamp(ray_start, vec3(-0.5f, -0.5f, -0.5f)*size+pos, vec3(0.5f, 0.5f, 0.5f)*size+pos);
-	//float d = (q1 - ray_start).sqrlen();
-	//if(d < dist)
-	//{
-	//	p1 = q1;
-	//	p2 = ray_start;
-	//}
-	//q1 = clamp(ray_end, vec3(-0.5f, -0.5f, -0.5f)*size+pos, vec3(0.5f, 0.5f, 0.5f)*size+pos);
-	//d = (q1 - ray_end).sqrlen();
-	//if(d < dist)
-	//{
-	//	p1 = q1;
-	//	p2 = ray_end;
-	//}
-	//return 0;
-	return false;
+static bool box_vs_triangle(const OverlapBox &box, const vec3 &a, const vec3 &b, const vec3 &c, Collision *collision)
+{
+	vec3 points[3] = {a, b, c};
+	vec3 edges[3] = {b - a, c - b, a - c};
+	vec3 axes[13];
+	int n = 0;
+	// push the box out on the side of its center, like the sphere
+	vec3 normal = vec3::cross(edges[0], edges[1]).normalized();
+	if(vec3::dot(box.center - a, normal) < 0.0f) normal = -normal;
+	axes[n++] = normal;
+	axes[n++] = box.axis[0];
+	axes[n++] = box.axis[1];
+	axes[n++] = box.axis[2];
+	for(int i=0; i<3; i++)
+	{
+		for(int k=0; k<3; k++)
+		{
+			axes[n++] = vec3::cross(box.axis[i], edges[k]);
+		}
+	}
+	return box_vs_convex(box, points, 3, axes, n, &normal, collision);
 }
 
-bool spherecast_vs_box(const ray_t &ray, float rayradius, const vec3 &pos, const quat &rotation, const vec3 &size, RayHit *hitinfo)
+static bool box_vs_box(const OverlapBox &box, const OverlapBox &other, Collision *collision)
 {
-	mat4 m = mat4(pos, rotation, vec3(1,1,1));
-	mat4 inv = m.inversed().inversed();
-	vec3 ray_start = inv.multiply_point(ray.pos);
-	vec3 ray_dir = inv.multiply_vector(ray.dir);
-	hitinfo = {};
-	if(spherecast_vs_AABB(ray_t(ray_start, ray_dir), rayradius, vec3(), size, hitinfo))
+	vec3 points[8];
+	for(int i=0; i<8; i++)
+	{
+		points[i] = other.center + other.axis[0] * (i&1 ? other.half.x : -other.half.x)
+			+ other.axis[1] * (i&2 ? other.half.y : -other.half.y) + other.axis[2] * (i&4 ? other.half.z : -other.half.z);
+	}
+	vec3 axes[15];
+	int n = 0;
+	for(int i=0; i<3; i++)
+	{
+		axes[n++] = box.axis[i];
+		axes[n++] = other.axis[i];
+	}
+	for(int i=0; i<3; i++)
 	{
-		hitinfo->point = m.multiply_point(hitinfo->point);
-		hitinfo->normal = m.multiply_vector(hitinfo->normal);
-		return true;
+		for(int k=0; k<3; k++)
+		{
+			axes[n++] = vec3::cross(box.axis[i], other.axis[k]);
+		}
 	}
-	return false;
+	return box_vs_convex(box, points, 8, axes, n, nullptr, collision);
 }
 
-static bool spherecast_vs_capsule(const ray_t &ray, float radius, vec3 capsule_dir, float capsule_radius, float capsule_height, const mat4 &transform, RayHit *hitinfo)
+// closest point on triangle abc to p (Real-Time Collision Detection 5.1.5)
+static vec3 closest_point_on_triangle(const vec3 &p, const vec3 &a, const vec3 &b, const vec3 &c)
 {
-	float r = radius + capsule_radius;
-	mat4 inv = transform.inversed();
-	ray_t inv_ray;
-	inv_ray.dir = inv.multiply_vector(ray.dir)/r;
-	inv_ray.pos = inv.multiply_point_3x4(ray.pos)/r;
+	vec3 ab = b - a;
+	vec3 ac = c - a;
+	vec3 ap = p - a;
+	float d1 = vec3::dot(ab, ap);
+	float d2 = vec3::dot(ac, ap);
+	if(d1 <= 0.0f && d2 <= 0.0f) return a;
+
+	vec3 bp = p - b;
+	float d3 = vec3::dot(ab, bp);
+	float d4 = vec3::dot(ac, bp);
+	if(d3 >= 0.0f && d4 <= d3) return b;
+
+	float vc = d1*d4 - d3*d2;
+	if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+	vec3 cp = p - c;
+	float d5 = vec3::dot(ab, cp);
+	float d6 = vec3::dot(ac, cp);
+	if(d6 >= 0.0f && d5 <= d6) return c;
+
+	float vb = d5*d2 - d1*d6;
+	if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+	float va = d3*d6 - d5*d4;
+	if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	float denom = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
 
-	vec3 p1 = capsule_dir * capsule_height * 0.5f;
-	vec3 p2 = -capsule_dir * capsule_height * 0.5f;
-	p1 = p1/r;
-	p2 = p2/r;
+static inline vec3 closest_point_on_segment(const vec3 &p, const vec3 &a, const vec3 &b)
+{
+	vec3 ab = b - a;
+	float sqrlen = ab.sqrlen();
+	float t = sqrlen > 0.0f ? clamp01(vec3::dot(p - a, ab) / sqrlen) : 0.0f;
+	return a + ab * t;
+}
 
-	// check collision
-	bool found_collision = false;
-	vec3 collision_point;
-	vec3 velocity = inv_ray.dir;
-	vec3 base = inv_ray.pos;
-	float velocity_sqrlen = velocity.sqrlen();
-	float a,b,c;
-	float t = 1.0f;
-	float new_t;
+// contact of the query sphere against the closest point of a shape, fallback is the normal if the center is on the surface
+static inline bool sphere_vs_point(const vec3 &center, float radius, const vec3 &closest, const vec3 &fallback, Collision *collision)
+{
+	vec3 d = center - closest;
+	float sqrdist = d.sqrlen();
+	if(sqrdist >= radius*radius) return false;
+
+	float dist = sqrtf(sqrdist);
+	collision->normal = dist > 0.0f ? d / dist : fallback;
+	collision->depth = radius - dist;
+	collision->point = closest;
+	return true;
+}
 
-	a = velocity_sqrlen;
+static bool sphere_vs_triangle(const vec3 &center, float radius, const vec3 &a, const vec3 &b, const vec3 &c, Collision *collision)
+{
+	vec3 normal = vec3::cross(b - a, c - a).normalized();
+	if(vec3::dot(center - a, normal) < 0.0f) normal = -normal;
+	return sphere_vs_point(center, radius, closest_point_on_triangle(center, a, b, c), normal, collision);
+}
 
-	// p1
-	b = 2.0f * vec3::dot(velocity, base - p1);
-	c = vec3::dot(p1 - base, p1 - base) - 1.0f;
-	if(get_lowest_root(a, b, c, t, &new_t))
+static bool sphere_vs_box(const vec3 &center, float radius, const OverlapBox &box, Collision *collision)
+{
+	bool inside;
+	vec3 closest = closest_point_on_box(box, center, &inside);
+	if(!inside)
 	{
-		t = new_t;
-		found_collision = true;
-		collision_point = p1;
+		return sphere_vs_point(center, radius, closest, vec3(0,1,0), collision);
 	}
 
-	// p2
-	b = 2.0f * vec3::dot(velocity, base - p2);
-	c = vec3::dot(p2 - base, p2 - base) - 1.0f;
-	if(get_lowest_root(a, b, c, t, &new_t))
+	// the center is inside, push it out of the nearest face
+	vec3 d = center - box.center;
+	float depth = FLOAT_MAX;
+	vec3 normal;
+	for(int i=0; i<3; i++)
 	{
-		t = new_t;
-		found_collision = true;
-		collision_point = p2;
+		float p = vec3::dot(d, box.axis[i]);
+		float h = (&box.half.x)[i];
+		sat_axis(box.axis[i], p - radius, p + radius, -h, h, &depth, &normal);
 	}
+	collision->normal = normal;
+	collision->depth = depth;
+	collision->point = center - normal * radius + normal * depth;
+	return true;
+}
 
+// squared distance from the box space point p + d*t to the box
+static inline float segment_box_sqrdist(const float *p, const float *d, const float *h, float t)
+{
+	float sqrdist = 0.0f;
+	for(int i=0; i<3; i++)
+	{
+		float x = p[i] + d[i] * t;
+		float e = x > h[i] ? x - h[i] : (x < -h[i] ? x + h[i] : 0.0f);
+		sqrdist += e * e;
+	}
+	return sqrdist;
+}
 
-	// p1 -> p2
-	vec3 edge = p2 - p1;
-	vec3 base_to_vertex = p1 - base;
-	float edge_sqrtlen = edge.sqrlen();
-	float edge_dot_velocity = vec3::dot(edge, velocity);
-	float edge_dot_basetovertex = vec3::dot(edge, base_to_vertex);
+// closest point of the segment ab to the box
+// in box space the squared distance is a clamped quadratic per axis, so along the segment it is a convex piecewise
+// quadratic that changes pieces where the segment crosses a face plane. an axis adds nothing inside its slab and the
+// distance to the face beyond it outside, the minimum of every piece is solved exactly and the smallest one is kept.
+// one axis outside is a face, two an edge and three a corner of the box
+static vec3 closest_point_on_segment_to_box(const OverlapBox &box, const vec3 &a, const vec3 &b)
+{
+	vec3 ab = b - a;
+	vec3 da = a - box.center;
+	float p[3], d[3], h[3];
+	float breaks[8];
+	int break_count = 0;
+	breaks[break_count++] = 0.0f;
+	for(int i=0; i<3; i++)
+	{
+		p[i] = vec3::dot(da, box.axis[i]);
+		d[i] = vec3::dot(ab, box.axis[i]);
+		h[i] = (&box.half.x)[i];
+		if(d[i] == 0.0f) continue;
+		float t0 = (-h[i] - p[i]) / d[i];
+		float t1 = (h[i] - p[i]) / d[i];
+		if(t0 > 0.0f && t0 < 1.0f) breaks[break_count++] = t0;
+		if(t1 > 0.0f && t1 < 1.0f) breaks[break_count++] = t1;
+	}
+	breaks[break_count++] = 1.0f;
+	for(int i=1; i<break_count; i++)
+	{
+		float t = breaks[i];
+		int j = i;
+		for(; j>0 && breaks[j-1] > t; j--) breaks[j] = breaks[j-1];
+		breaks[j] = t;
+	}
 
-	// calculate parameters for equation
-	a = edge_sqrtlen * -velocity_sqrlen + edge_dot_velocity * edge_dot_velocity;
-	b = edge_sqrtlen * 2 * vec3::dot(velocity, base_to_vertex) - 2.0f * edge_dot_velocity * edge_dot_basetovertex;
-	c = edge_sqrtlen * (1 - vec3::dot(base_to_vertex, base_to_vertex)) + edge_dot_basetovertex * edge_dot_basetovertex;
-	if(get_lowest_root(a, b, c, t, &new_t))
+	float best_t = 0.0f;
+	float best = FLOAT_MAX;
+	for(int k=0; k+1<break_count; k++)
 	{
-		// check if intersection is within line segment
-		float f = (edge_dot_velocity * new_t - edge_dot_basetovertex) / edge_sqrtlen;
-		if(f >= 0.0f && f <= 1.0f)
+		// the axes outside their slab in the middle of the piece stay outside on the same side over the whole piece,
+		// their (p + d*t - face)^2 sum to qa*t^2 + qb*t + c
+		float t0 = breaks[k];
+		float t1 = breaks[k+1];
+		float mid = (t0 + t1) * 0.5f;
+		float qa = 0.0f;
+		float qb = 0.0f;
+		for(int i=0; i<3; i++)
 		{
-			t = new_t;
-			found_collision = true;
-			collision_point = p1 + edge * f;
+			float x = p[i] + d[i] * mid;
+			if(x >= -h[i] && x <= h[i]) continue;
+			float e = p[i] - (x > h[i] ? h[i] : -h[i]);
+			qa += d[i] * d[i];
+			qb += 2.0f * d[i] * e;
+		}
+		float t = qa > 0.0f ? clamp(-qb / (2.0f * qa), t0, t1) : t0;
+		float sqrdist = segment_box_sqrdist(p, d, h, t);
+		if(sqrdist < best)
+		{
+			best = sqrdist;
+			best_t = t;
 		}
 	}
+	return a + ab * best_t;
+}
 
-	// set result
-	if(found_collision)
+static bool box_vs_capsule(const OverlapBox &box, const vec3 &a, const vec3 &b, float radius, Collision *collision)
+{
+	vec3 p = closest_point_on_segment_to_box(box, a, b);
+	vec3 q = closest_point_on_box(box, p);
+	vec3 d = q - p;
+	float sqrdist = d.sqrlen();
+	if(sqrdist >= radius*radius) return false;
+	if(sqrdist > 1e-8f)
 	{
-		float dist_to_collision = inv_ray.dir.len() * t;
-		hitinfo->point = transform.multiply_point_3x4(collision_point*r);
-		hitinfo->distance = dist_to_collision * r;
-		hitinfo->normal =  ((ray.pos + ray.dir.normalized() * hitinfo->distance) - hitinfo->point).normalized();
-		hitinfo->point += hitinfo->normal * capsule_radius;
+		float dist = sqrtf(sqrdist);
+		collision->normal = d / dist;
+		collision->depth = radius - dist;
+		collision->point = p + collision->normal * radius;
 		return true;
 	}
 
-	return false;
+	// the core segment passes through the box
+	vec3 dir = b - a;
+	vec3 axes[6] = {box.axis[0], box.axis[1], box.axis[2], vec3::cross(dir, box.axis[0]), vec3::cross(dir, box.axis[1]), vec3::cross(dir, box.axis[2])};
+	float depth = FLOAT_MAX;
+	vec3 normal;
+	for(int i=0; i<6; i++)
+	{
+		float sqrlen = axes[i].sqrlen();
+		if(sqrlen < 1e-12f) continue;
+		vec3 axis = axes[i] / sqrtf(sqrlen);
+		float a_min, a_max;
+		project_box(box, axis, &a_min, &a_max);
+		float da = vec3::dot(a, axis);
+		float db = vec3::dot(b, axis);
+		sat_axis(axis, a_min, a_max, fminf(da, db) - radius, fmaxf(da, db) + radius, &depth, &normal);
+	}
+	collision->normal = normal;
+	collision->depth = depth;
+	collision->point = get_box_support(box, -normal) + normal * depth;
+	return true;
 }
 
-static bool spherecast_vs_mesh(const ray_t &ray, float radius, const vec3 *vertices, u32 vertex_count, const mat4 &transform, RayHit *hitinfo)
+static inline void keep_deepest(const Collision &collision, Collision *deepest, bool *found)
 {
-	if(vertex_count % 3 != 0) return false; // Error vertex count is missmatch
+	if(!*found || collision.depth > deepest->depth)
+	{
+		*deepest = collision;
+		*found = true;
+	}
+}
 
-	// convert ray to unit sphere space and then model sapce
-	mat4 inv = transform.inversed();
-	ray_t inv_ray;
-	inv_ray.dir = inv.multiply_vector(ray.dir)/radius;
-	inv_ray.pos = inv.multiply_point_3x4(ray.pos)/radius;
+// query shapes against the triangles of mesh and heightfield colliders, a box or a sphere when box is null
+// the shape is in the local frame, or in world space when to_world is set and the triangles are moved there
+struct OverlapShape
+{
+	const OverlapBox *box;
+	vec3 center;
+	float radius;
+	const mat4 *to_world;
+};
 
-	RayHit nearest_hit = {};
-	nearest_hit.distance = FLOAT_MAX;
-	bool hited = false;
+static inline bool shape_vs_triangle(const OverlapShape &shape, const vec3 &a, const vec3 &b, const vec3 &c, Collision *collision)
+{
+	if(shape.to_world)
+	{
+		const mat4 &m = *shape.to_world;
+		vec3 wa = m.multiply_point_3x4(a), wb = m.multiply_point_3x4(b), wc = m.multiply_point_3x4(c);
+		if(shape.box) return box_vs_triangle(*shape.box, wa, wb, wc, collision);
+		return sphere_vs_triangle(shape.center, shape.radius, wa, wb, wc, collision);
+	}
+	if(shape.box) return box_vs_triangle(*shape.box, a, b, c, collision);
+	return sphere_vs_triangle(shape.center, shape.radius, a, b, c, collision);
+}
 
-	for(u32 i=0; i<=vertex_count-3; i+=3)
+static bool shape_vs_mesh(const OverlapShape &shape, const vec3 &min, const vec3 &max, const CollisionMesh *mesh, Collision *collision)
+{
+	if(mesh == nullptr || mesh->nodes == nullptr) return false;
+	const MeshBVHNode *nodes = mesh->nodes;
+	const vec3 *vertices = mesh->vertices;
+	const u32 *indices = mesh->indices;
+
+	bool found = false;
+	u32 stack[BVH_STACK_SIZE];
+	int stack_count = 0;
+	stack[stack_count++] = 0;
+	while(stack_count > 0)
 	{
-		RayHit hit = {};
-		hit.distance = FLOAT_MAX;
-		// convert triagle to unit sphere space
-		if(spherecast_to_triangle(inv_ray, vertices[i]/radius, vertices[i+1]/radius, vertices[i+2]/radius, &hit))
+		const MeshBVHNode &node = nodes[stack[--stack_count]];
+		if(node.min.x > max.x || node.max.x < min.x || node.min.y > max.y || node.max.y < min.y || node.min.z > max.z || node.max.z < min.z) continue;
+
+		if(node.count > 0)
 		{
-			hited = true;
-			if(hit.distance < nearest_hit.distance)
+			for(u32 i=node.first; i<node.first+node.count; i++)
 			{
-				nearest_hit = hit;
+				Collision c;
+				if(shape_vs_triangle(shape, vertices[indices[i*3]], vertices[indices[i*3+1]], vertices[indices[i*3+2]], &c))
+				{
+					keep_deepest(c, collision, &found);
+				}
 			}
 		}
+		else
+		{
+			stack[stack_count++] = node.first+1;
+			stack[stack_count++] = node.first;
+		}
 	}
+	return found;
+}
 
-	if(hited)
+static bool shape_vs_heightfield(const OverlapShape &shape, const vec3 &min, const vec3 &max, const CollisionHeightfield *hf, Collision *collision)
+{
+	if(hf == nullptr) return false;
+	vec3 hf_min = hf->bounds.get_min();
+	vec3 hf_max = hf->bounds.get_max();
+	if(min.x > hf_max.x || max.x < hf_min.x || min.y > hf_max.y || max.y < hf_min.y || min.z > hf_max.z || max.z < hf_min.z) return false;
+
+	float cell = hf->cell_size;
+	int x0 = (int)floorf((min.x - hf->origin.x) / cell);
+	int x1 = (int)floorf((max.x - hf->origin.x) / cell);
+	int z0 = (int)floorf((min.z - hf->origin.z) / cell);
+	int z1 = (int)floorf((max.z - hf->origin.z) / cell);
+	x0 = x0 < 0 ? 0 : x0;
+	z0 = z0 < 0 ? 0 : z0;
+	x1 = x1 >= (int)hf->width ? (int)hf->width-1 : x1;
+	z1 = z1 >= (int)hf->depth ? (int)hf->depth-1 : z1;
+
+	bool found = false;
+	for(int z=z0; z<=z1; z++)
 	{
-		// convert hit result back from unit sphere space and then back from model space
-		hitinfo->point = transform.multiply_point_3x4(nearest_hit.point*radius);
-		hitinfo->normal = transform.multiply_point_3x4(nearest_hit.normal).normalized();
-		hitinfo->distance = nearest_hit.distance * radius;
+		for(int x=x0; x<=x1; x++)
+		{
+			vec3 v[4];
+			float min_height, max_height;
+			if(!get_heightfield_cell(hf, x, z, v, &min_height, &max_height)) continue;
+			if(min.y > max_height || max.y < min_height) continue;
+
+			Collision c;
+			if(shape_vs_triangle(shape, v[0], v[1], v[2], &c)) keep_deepest(c, collision, &found);
+			if(shape_vs_triangle(shape, v[2], v[1], v[3], &c)) keep_deepest(c, collision, &found);
+		}
 	}
+	return found;
+}
 
-	return hited;
+// the local bounds of world bounds, m is the world to local matrix
+static bounds_t transform_bounds(const mat4 &m, const bounds_t &bounds)
+{
+	vec3 e = bounds.extents;
+	vec3 extents;
+	extents.x = fabsf(m.m11) * e.x + fabsf(m.m21) * e.y + fabsf(m.m31) * e.z;
+	extents.y = fabsf(m.m12) * e.x + fabsf(m.m22) * e.y + fabsf(m.m32) * e.z;
+	extents.z = fabsf(m.m13) * e.x + fabsf(m.m23) * e.y + fabsf(m.m33) * e.z;
+	return bounds_t(m.multiply_point_3x4(bounds.center), extents);
 }
 
-int spherecast(const ray_t &ray, float radius, RayHit *rayhit, u32 layermask)
+// the shape against the triangles of a mesh or heightfield collider, bounds are the bounds of the shape in the local frame
+// a shape in the local frame was divided by scale, its collision is moved back to world space and its depth scaled back
+static bool shape_vs_collider(const Collider *c, const OverlapShape &shape, const bounds_t &bounds, float scale, Collision *collision)
 {
-	const int RAYHIT_COUNT = 64;
-	RayHit rayhits[RAYHIT_COUNT] = {};
-	if(spherecast_all(ray, radius, rayhits, RAYHIT_COUNT, layermask) > 0)
+	vec3 min = bounds.get_min();
+	vec3 max = bounds.get_max();
+	bool result = c->type == ColliderType::MESH ?
+		shape_vs_mesh(shape, min, max, c->mesh.get(), collision) :
+		shape_vs_heightfield(shape, min, max, c->heightfield.get(), collision);
+	if(result && shape.to_world == nullptr)
 	{
-		if(rayhit)
-			*rayhit = rayhits[0];
-		return 1;
+		collision->point = c->world.multiply_point_3x4(collision->point);
+		collision->normal = c->world.multiply_vector(collision->normal).normalized();
+		collision->depth *= scale;
 	}
-
-	return 0;
+	return result;
 }
 
-int spherecast_all(const ray_t &ray, float radius, RayHit *rayhit, int rayhit_count, u32 layermask)
+static inline bounds_t get_overlap_box_bounds(const OverlapBox &box)
 {
-	int hit_count = 0;
-	static std::vector<ColliderRef> colliders;
-	colliders.clear();
+	vec3 e;
+	for(int i=0; i<3; i++)
+	{
+		e += vec3::abs(box.axis[i]) * (&box.half.x)[i];
+	}
+	return bounds_t(box.center, e);
+}
 
-	bounds_t bounds;
-	bounds_t b;
-	b.center = ray.pos;
-	b.extents = vec3(radius, radius, radius);
-	bounds.encapsulate(b);
-	b.center = ray.pos + ray.dir;
-	bounds.encapsulate(b);
+static bool sphere_vs_sphere(const vec3 &center, float radius, const vec3 &other_center, float other_radius, Collision *collision)
+{
+	vec3 d = center - other_center;
+	float r = radius + other_radius;
+	float sqrdist = d.sqrlen();
+	if(sqrdist >= r*r) return false;
+
+	float dist = sqrtf(sqrdist);
+	collision->normal = dist > 0.0f ? d / dist : vec3(0,1,0);
+	collision->depth = r - dist;
+	collision->point = other_center + collision->normal * other_radius;
+	return true;
+}
 
-	ctx.tree.query_colliders(bounds, &colliders);
-	for(int i=0; i<(int)colliders.size(); i++)
+static bool sphere_vs_collider(const Collider *c, const vec3 &center, float radius, Collision *collision)
+{
+	switch(c->type)
 	{
-		ColliderRef c = colliders[i];
-		RayHit hitinfo = {};
-		hitinfo.distance = ray.dir.len();
-		if(c->intersect_spherecast(ray, radius, &hitinfo))
+	case ColliderType::SPHERE:
+		return sphere_vs_sphere(center, radius, c->position+c->offset, c->sphere.radius, collision);
+	case ColliderType::BOX:
+		return sphere_vs_box(center, radius, get_collider_box(c), collision);
+	case ColliderType::CAPSULE:
+	{
+		vec3 a = c->world.multiply_point_3x4(c->capsule.dir * c->capsule.height * 0.5f);
+		vec3 b = c->world.multiply_point_3x4(-c->capsule.dir * c->capsule.height * 0.5f);
+		return sphere_vs_sphere(center, radius, closest_point_on_segment(center, a, b), c->capsule.radius, collision);
+	}
+	case ColliderType::MESH:
+	case ColliderType::HEIGHTFIELD:
+	{
+		// a sphere stays a sphere in a uniformly scaled frame, otherwise the triangles are tested in world space
+		float scale;
+		if(get_uniform_scale(c->scale, &scale))
 		{
-			hitinfo.collider = c;
-			rayhit[hit_count] = hitinfo;
-			hit_count++;
-			if(hit_count >= rayhit_count) break;
+			OverlapShape shape = {nullptr, c->world_inv.multiply_point_3x4(center), radius / scale, nullptr};
+			vec3 e = vec3(shape.radius, shape.radius, shape.radius);
+			return shape_vs_collider(c, shape, bounds_t(shape.center, e), scale, collision);
 		}
+		OverlapShape shape = {nullptr, center, radius, &c->world};
+		return shape_vs_collider(c, shape, transform_bounds(c->world_inv, bounds_t(center, vec3(radius, radius, radius))), 1.0f, collision);
 	}
-	colliders.clear();
+	default:
+		break;
+	}
+	return false;
+}
 
-	// sort hit infomation with the hit distance
-	for(int i=0; i<hit_count; i++){
-		for(int j=i+1; j<hit_count; j++){
-			if(rayhit[i].distance > rayhit[j].distance)
-			{
-				RayHit tmp = rayhit[i];
-				rayhit[i] = rayhit[j];
-				rayhit[j] = tmp;
-			}
-		}
+static bool box_vs_sphere(const OverlapBox &box, const vec3 &center, float radius, Collision *collision)
+{
+	bool inside;
+	vec3 closest = closest_point_on_box(box, center, &inside);
+	vec3 d = closest - center;
+	float sqrdist = d.sqrlen();
+	if(sqrdist >= radius*radius) return false;
+	if(!inside && sqrdist > 0.0f)
+	{
+		float dist = sqrtf(sqrdist);
+		collision->normal = d / dist;
+		collision->depth = radius - dist;
+		collision->point = center + collision->normal * radius;
+		return true;
 	}
 
-	return hit_count;
+	// the sphere center is inside the box
+	float depth = FLOAT_MAX;
+	vec3 normal;
+	for(int i=0; i<3; i++)
+	{
+		float a_min, a_max;
+		project_box(box, box.axis[i], &a_min, &a_max);
+		float p = vec3::dot(center, box.axis[i]);
+		sat_axis(box.axis[i], a_min, a_max, p - radius, p + radius, &depth, &normal);
+	}
+	collision->normal = normal;
+	collision->depth = depth;
+	collision->point = get_box_support(box, -normal) + normal * depth;
+	return true;
 }
 
+static bool box_vs_collider(const Collider *c, const OverlapBox &box, Collision *collision)
+{
+	switch(c->type)
+	{
+	case ColliderType::SPHERE:
+		return box_vs_sphere(box, c->position+c->offset, c->sphere.radius, collision);
+	case ColliderType::BOX:
+		return box_vs_box(box, get_collider_box(c), collision);
+	case ColliderType::CAPSULE:
+	{
+		vec3 a = c->world.multiply_point_3x4(c->capsule.dir * c->capsule.height * 0.5f);
+		vec3 b = c->world.multiply_point_3x4(-c->capsule.dir * c->capsule.height * 0.5f);
+		return box_vs_capsule(box, a, b, c->capsule.radius, collision);
+	}
+	case ColliderType::MESH:
+	case ColliderType::HEIGHTFIELD:
+	{
+		// like the sphere, a non-uniform scale would shear the box in the local frame
+		float scale;
+		if(get_uniform_scale(c->scale, &scale))
+		{
+			OverlapBox local = transform_overlap_box(box, c->world_inv, scale);
+			OverlapShape shape = {&local, vec3(), 0.0f, nullptr};
+			return shape_vs_collider(c, shape, get_overlap_box_bounds(local), scale, collision);
+		}
+		OverlapShape shape = {&box, vec3(), 0.0f, &c->world};
+		return shape_vs_collider(c, shape, transform_bounds(c->world_inv, get_overlap_box_bounds(box)), 1.0f, collision);
+	}
+	default:
+		break;
+	}
+	return false;
+}
 
-vec3 spherecast_slide(const vec3 &position, const vec3 &velocity, float radius, u32 layermask, int recursion)
+static bool compare_collision_depth(const Collision &a, const Collision &b)
 {
-	const float close_distance = 0.005f;
+	return a.depth > b.depth;
+}
 
-	// dont recurse if the new velocity is very small
-	if(velocity.len() < close_distance) {
-		return position;
+// copies the deepest collisions in depth order, only the copied ones are sorted
+static int sort_collisions(std::vector<Collision> &found, Collision *collisions, int collision_count)
+{
+	int count = (int)found.size() < collision_count ? (int)found.size() : collision_count;
+	if(count <= 0)
+	{
+		found.clear();
+		return 0;
 	}
 
-	if(recursion <= 0)
-		return position;
-
-	RayHit hitinfo;
-	if(!spherecast(ray_t(position, velocity), radius, &hitinfo, layermask))
+	std::partial_sort(found.begin(), found.begin() + count, found.end(), compare_collision_depth);
+	for(int i=0; i<count; i++)
 	{
-		return position + velocity;
+		collisions[i] = found[i];
 	}
+	found.clear();
+	return count;
+}
 
-	// found collision
-	vec3 destination_point = position + velocity;
-	vec3 new_base_point = position;
-	if(hitinfo.distance >= close_distance)
+// tests the colliders around the bounds, stops at the first overlap if collisions is null
+static int overlap_colliders(CollisionQuery *query, const bounds_t &bounds, const OverlapBox *box, const vec3 &center, float radius, Collision *collisions, int collision_count, u32 layermask)
+{
+	QueryStatsRecorder recorder(collisions ? CollisionQueryType::OVERLAP : CollisionQueryType::CHECK);
+	std::vector<u32> &indices = query->indices;
+	std::vector<Collision> &found = query->collisions;
+	found.clear();
+
+	ctx.tree.query(bounds, layermask, &indices);
+	for(int i=0; i<(int)indices.size(); i++)
 	{
-		vec3 v = velocity.normalized() * (hitinfo.distance - close_distance);
-		new_base_point = position + v;
+		const Collider *c = ctx.tree.get_collider(indices[i]);
+		Collision collision;
+		if(stats_counters) stats_counters->tests++;
+		bool result = box ? box_vs_collider(c, *box, &collision) : sphere_vs_collider(c, center, radius, &collision);
+		if(!result) continue;
+		if(stats_counters) stats_counters->hits++;
+		if(collisions == nullptr)
+		{
+			indices.clear();
+			return 1;
+		}
+		collision.collider = ctx.tree.get_collider_ref(indices[i]);
+		found.push_back(collision);
 	}
+	indices.clear();
 
-	vec3 slide_plane_origin = hitinfo.point;
-	vec3 slide_plane_normal = (new_base_point - hitinfo.point).normalized();
-	plane_t slide_plane(slide_plane_origin, slide_plane_normal);
-	vec3 new_destination_point = destination_point - slide_plane_normal * slide_plane.signed_distance_to(destination_point);
-	vec3 new_velocity = new_destination_point - hitinfo.point;
+	if(collisions == nullptr) return 0;
+	return sort_collisions(found, collisions, collision_count);
+}
 
-	return spherecast_slide(new_base_point, new_velocity, radius, layermask, recursion-1);
+int overlap_sphere(const vec3 &center, float radius, Collision *collisions, int collision_count, u32 layermask)
+{
+	return overlap_sphere(collision_get_thread_query(), center, radius, collisions, collision_count, layermask);
+}
+
+int overlap_sphere(CollisionQuery *query, const vec3 &center, float radius, Collision *collisions, int collision_count, u32 layermask)
+{
+	if(collisions == nullptr || collision_count <= 0) return 0;
+	return overlap_colliders(query, bounds_t(center, vec3(radius, radius, radius)), nullptr, center, radius, collisions, collision_count, layermask);
+}
+
+int overlap_box(const vec3 &center, const vec3 &size, const quat &rotation, Collision *collisions, int collision_count, u32 layermask)
+{
+	return overlap_box(collision_get_thread_query(), center, size, rotation, collisions, collision_count, layermask);
+}
+
+int overlap_box(CollisionQuery *query, const vec3 &center, const vec3 &size, const quat &rotation, Collision *collisions, int collision_count, u32 layermask)
+{
+	if(collisions == nullptr || collision_count <= 0) return 0;
+	OverlapBox box = create_overlap_box(center, size, rotation);
+	return overlap_colliders(query, get_overlap_box_bounds(box), &box, vec3(), 0.0f, collisions, collision_count, layermask);
 }
 
+bool check_sphere(const vec3 &center, float radius, u32 layermask)
+{
+	return overlap_colliders(collision_get_thread_query(), bounds_t(center, vec3(radius, radius, radius)), nullptr, center, radius, nullptr, 0, layermask) > 0;
+}
 
+bool check_box(const vec3 &center, const vec3 &size, const quat &rotation, u32 layermask)
+{
+	OverlapBox box = create_overlap_box(center, size, rotation);
+	return overlap_colliders(collision_get_thread_query(), get_overlap_box_bounds(box), &box, vec3(), 0.0f, nullptr, 0, layermask) > 0;
+}
 
+vec3 depenetrate_sphere(const vec3 &center, float radius, u32 layermask, int iterations)
+{
+	return depenetrate_sphere(collision_get_thread_query(), center, radius, layermask, iterations);
+}
 
-Collider::~Collider()
+vec3 depenetrate_sphere(CollisionQuery *query, const vec3 &center, float radius, u32 layermask, int iterations)
 {
-	if(type == ColliderType::MESH)
+	const int max_collisions = 8;
+	Collision collisions[max_collisions];
+	vec3 position = center;
+	for(int i=0; i<iterations; i++)
 	{
-		delete[] mesh.vertices;
+		int count = overlap_sphere(query, position, radius, collisions, max_collisions, layermask);
+		if(count == 0) break;
+
+		// deepest first, the push so far already covers part of the other contacts
+		vec3 push;
+		for(int k=0; k<count; k++)
+		{
+			float depth = collisions[k].depth - vec3::dot(push, collisions[k].normal);
+			if(depth > 0.0f)
+			{
+				push += collisions[k].normal * depth;
+			}
+		}
+		position += push;
 	}
+	return position;
 }
 
-bool Collider::intersect_ray(const ray_t &ray, RayHit *hitinfo)
+bool Collider::intersect_ray(const ray_t &ray, RayHit *hitinfo) const
 {
 	switch(type)
 	{
@@ -1190,10 +4252,13 @@ bool Collider::intersect_ray(const ray_t &ray, RayHit *hitinfo)
 		return ray_vs_sphere(ray, position+offset, sphere.radius, hitinfo);
 		break;
 	case ColliderType::BOX:
-		return ray_vs_box(ray, position+offset, size, rotation, hitinfo);
+		return ray_vs_box(ray, size, world, world_inv, hitinfo);
 		break;
 	case ColliderType::MESH:
-		return ray_vs_mesh(ray, mesh.vertices, mesh.count, mat4(position, rotation, scale), hitinfo);
+		return ray_vs_mesh(ray, mesh.get(), world, world_inv, hitinfo);
+		break;
+	case ColliderType::HEIGHTFIELD:
+		return ray_vs_heightfield(ray, heightfield.get(), world, world_inv, hitinfo);
 		break;
 	default:
 		break;
@@ -1201,21 +4266,24 @@ bool Collider::intersect_ray(const ray_t &ray, RayHit *hitinfo)
 	return false;
 }
 
-bool Collider::intersect_spherecast(const ray_t &ray, float radius, RayHit *hitinfo)
+bool Collider::intersect_spherecast(const ray_t &ray, float radius, RayHit *hitinfo) const
 {
 	switch(type)
 	{
 	case ColliderType::SPHERE:
-		//return ray_vs_sphere(ray, position+offset, sphere.radius, hitinfo);
+		return spherecast_vs_sphere(ray, radius, position+offset, sphere.radius, hitinfo);
 		break;
 	case ColliderType::BOX:
-		//return ray_vs_box(ray, position+offset, size, rotation, hitinfo);
+		return spherecast_vs_box(ray, radius, world, world_inv, size, scale, hitinfo);
 		break;
 	case ColliderType::CAPSULE:
-		return spherecast_vs_capsule(ray, radius, capsule.dir, capsule.radius, capsule.height, mat4(offset+position, rotation, scale), hitinfo);
+		return spherecast_vs_capsule(ray, radius, capsule.dir, capsule.radius, capsule.height, world, world_inv, hitinfo);
 		break;
 	case ColliderType::MESH:
-		return spherecast_vs_mesh(ray, radius, mesh.vertices, mesh.count, mat4(position, rotation, scale), hitinfo);
+		return spherecast_vs_mesh(ray, radius, mesh.get(), world, world_inv, scale, hitinfo);
+		break;
+	case ColliderType::HEIGHTFIELD:
+		return spherecast_vs_heightfield(ray, radius, heightfield.get(), world, world_inv, scale, hitinfo);
 		break;
 	default:
 		break;
@@ -1223,40 +4291,72 @@ bool Collider::intersect_spherecast(const ray_t &ray, float radius, RayHit *hiti
 	return false;
 }
 
+bool Collider::intersect_sphere(const vec3 &center, float radius, Collision *collision) const
+{
+	return sphere_vs_collider(this, center, radius, collision);
+}
+
+bool Collider::intersect_box(const vec3 &center, const vec3 &size, const quat &rotation, Collision *collision) const
+{
+	return box_vs_collider(this, create_overlap_box(center, size, rotation), collision);
+}
+
+bool Collider::is_sleeping() const
+{
+	return tree_index != QUADTREE_INVALID_INDEX && tree_node != QUADTREE_AWAKE_NODE;
+}
+
 bounds_t Collider::get_bounds_world() const
 {
-	vec3 min = -bounds.extents;
-	vec3 max = bounds.extents;
-
-	vec3 v[8] = {
-		vec3(min.x, max.y, min.z),
-		vec3(min.x, max.y, max.z),
-		vec3(max.x, max.y, min.z),
-		vec3(max.x, max.y, max.z),
-		vec3(min.x, min.y, min.z),
-		vec3(min.x, min.y, max.z),
-		vec3(max.x, min.y, min.z),
-		vec3(max.x, min.y, max.z)
-	};
+	return world_bounds.to_bounds();
+}
 
-	bounds_t b;
-	for(int i=0; i<8; i++)
-	{
-		v[i] = rotation * v[i];
-		b.encapsulate(v[i]);
-	}
-	b.center = bounds.center + position;
-	return b;
+// rebuilds the cached world matrices and bounds after the transform has changed
+// the quadtree calls this whenever a collider is added or moved, so queries only read the cache
+void Collider::update_transform()
+{
+	if(!transform_dirty) return;
+
+	world = mat4(position + offset, rotation, scale);
+	world_inv = world.inversed();
+
+	// the world extents are the local extents projected on the rotated and scaled axes
+	vec3 e = bounds.extents;
+	vec3 center = world.multiply_point_3x4(bounds.center);
+	vec3 extents;
+	extents.x = fabsf(world.m11) * e.x + fabsf(world.m21) * e.y + fabsf(world.m31) * e.z;
+	extents.y = fabsf(world.m12) * e.x + fabsf(world.m22) * e.y + fabsf(world.m32) * e.z;
+	extents.z = fabsf(world.m13) * e.x + fabsf(world.m23) * e.y + fabsf(world.m33) * e.z;
+	world_bounds = aabb_t(center - extents, center + extents);
+	transform_dirty = false;
 }
 
 void Collider::set_position(const vec3 &position)
 {
 	this->position = position;
-	ctx.tree.update(shared_from_this());
+	transform_dirty = true;
+	ctx.tree.update(this);
 }
 
 void Collider::set_rotation(const quat &rotation)
 {
 	this->rotation = rotation;
-	ctx.tree.update(shared_from_this());
+	transform_dirty = true;
+	ctx.tree.update(this);
+}
+
+void Collider::set_transform(const vec3 &position, const quat &rotation)
+{
+	this->position = position;
+	this->rotation = rotation;
+	transform_dirty = true;
+	ctx.tree.update(this);
+}
+
+void Collider::set_layer(u32 layer)
+{
+	if(layer >= MAX_COLLISION_LAYERS) return;
+
+	this->layer = layer;
+	ctx.tree.update_layer(this);
 }
\ No newline at end of file
@@ -1,35 +1,91 @@
 #pragma once
 #include <memory>
+#include <vector>
 #include "mathf.h"
 
+#define MAX_COLLISION_LAYERS 32
+
 enum class ColliderType
 {
 	SPHERE,
 	BOX,
 	CAPSULE,
 	MESH,
+	HEIGHTFIELD,
 };
 
 struct RayHit;
-class CollisionQuadTreeSpace;
+struct Collision;
+struct MeshBVHNode;
+struct MeshTriangleSoA;
+
+// immutable indexed triangle mesh shared by mesh colliders
+// get_collision_mesh builds it once per Mesh, colliders keep it alive by reference
+struct CollisionMesh
+{
+	vec3 *vertices = nullptr;
+	u32 vertex_count = 0;
+	u32 *indices = nullptr;		// three per triangle, in BVH leaf order
+	u32 triangle_count = 0;
+	MeshBVHNode *nodes = nullptr;
+	int node_count = 0;
+	MeshTriangleSoA *triangles = nullptr;
+	bounds_t bounds;
+
+	CollisionMesh(){}
+	CollisionMesh(const CollisionMesh&) = delete;
+	CollisionMesh& operator=(const CollisionMesh&) = delete;
+	~CollisionMesh();
+};
+typedef std::shared_ptr<CollisionMesh> CollisionMeshRef;
+
+#define HEIGHTFIELD_HOLE (-FLOAT_MAX)
+
+// regular grid of heights for 2.5D terrain
+// every cell is split in two triangles along its diagonal, cells with a hole sample have no surface
+struct CollisionHeightfield
+{
+	float *heights = nullptr;	// (width+1) samples per row, (depth+1) rows along z
+	u32 width = 0;				// cell count along x
+	u32 depth = 0;				// cell count along z
+	float cell_size = 1.0f;
+	vec3 origin;				// local position of the first sample, y is unused
+	bounds_t bounds;
+
+	CollisionHeightfield(){}
+	CollisionHeightfield(const CollisionHeightfield&) = delete;
+	CollisionHeightfield& operator=(const CollisionHeightfield&) = delete;
+	~CollisionHeightfield(){delete[] heights;}
+
+	float get_height(u32 x, u32 z) const {return heights[z*(width+1)+x];}
+};
+typedef std::shared_ptr<CollisionHeightfield> CollisionHeightfieldRef;
+
 struct Collider : public std::enable_shared_from_this<Collider>
 {
 	u32 id;
 	ColliderType type;
-	u32 layer;
+	u32 layer;	// layer index, queries test it against their layermask
 	vec3 position;
 	quat rotation = quat::identity();
 	vec3 scale = vec3(1,1,1);
 	vec3 offset;
-	bounds_t bounds;
+	bounds_t bounds;	// local bounds
 	bool enabled;
-	CollisionQuadTreeSpace *space;
+	mat4 world;				// cached local to world matrix
+	mat4 world_inv;			// cached world to local matrix
+	aabb_t world_bounds;	// cached world AABB
+	bool transform_dirty = true;
+	u32 tree_index = 0xFFFFFFFF;	// collider slot in the quadtree
+	u32 tree_node = 0xFFFFFFFF;		// quadtree node the collider sleeps in, a marker while it is awake
+	u32 tree_slot = 0xFFFFFFFF;		// position in the collider range of the node or in the awake list
 	union {
 		vec3 size;
 		struct {float radius;} sphere;
 		struct {vec3 dir; float radius; float height;} capsule;
-		struct {vec3 *vertices; int count;} mesh;
 	};
+	CollisionMeshRef mesh;	// shared triangles of mesh colliders
+	CollisionHeightfieldRef heightfield;
 
 	struct UserData
 	{
@@ -38,13 +94,18 @@ struct Collider : public std::enable_shared_from_this<Collider>
 	} user_data;
 
 	Collider(){}
-	~Collider();
-	bool intersect_ray(const ray_t &ray, RayHit *hitinfo);
-	bool intersect_spherecast(const ray_t &ray, float radius, RayHit *hitinfo);
+	bool intersect_ray(const ray_t &ray, RayHit *hitinfo) const;
+	bool intersect_spherecast(const ray_t &ray, float radius, RayHit *hitinfo) const;
+	bool intersect_sphere(const vec3 &center, float radius, Collision *collision) const;
+	bool intersect_box(const vec3 &center, const vec3 &size, const quat &rotation, Collision *collision) const;
+	bool is_sleeping() const;
 	bounds_t get_bounds_world() const;
+	void update_transform();
 
 	void set_position(const vec3 &position);
 	void set_rotation(const quat &rotation);
+	void set_transform(const vec3 &position, const quat &rotation);
+	void set_layer(u32 layer);
 };
 typedef std::shared_ptr<Collider> ColliderRef;
 
@@ -54,10 +115,11 @@ struct RayHit
 
 	vec3 point;
 	vec3 normal;
-	float distance;
+	float distance = 0.0f;
 	ColliderRef collider;
 };
 
+// contact of an overlap query, moving the query shape by normal * depth separates it from the collider
 struct Collision
 {
 	vec3 point;
@@ -66,6 +128,64 @@ struct Collision
 	ColliderRef collider;
 };
 
+// scratch memory of collision queries
+// queries only read the shared collision world, so threads can query concurrently
+// as long as each thread passes its own CollisionQuery and no collider is created, moved, freed or put to sleep meanwhile
+struct CollisionQuery
+{
+	std::vector<u32> indices;
+	std::vector<RayHit> hits;
+	std::vector<u64> keys;
+	std::vector<Collision> collisions;
+};
+
+// collision statistics
+// opt-in counters of the queries, collected per frame by query type and by CollisionStatsScope
+enum class CollisionQueryType
+{
+	RAYCAST,
+	RAYCAST_ALL,
+	RAYCAST_BATCH,
+	SPHERECAST,
+	SPHERECAST_ALL,
+	OVERLAP,
+	CHECK,
+	BROADPHASE,
+	COUNT,
+};
+
+struct CollisionQueryStats
+{
+	u32 queries;
+	u32 nodes;		// quadtree nodes visited
+	u32 candidates;	// colliders that passed the broad phase
+	u32 tests;		// narrow phase tests against collider shapes
+	u32 hits;
+	double time;	// milliseconds
+};
+
+#define COLLISION_STATS_MAX_SCOPES 16
+
+struct CollisionStats
+{
+	CollisionQueryStats types[(int)CollisionQueryType::COUNT];
+	const char *scope_names[COLLISION_STATS_MAX_SCOPES];	// scope 0 collects the queries outside of any scope
+	CollisionQueryStats scopes[COLLISION_STATS_MAX_SCOPES];
+	int scope_count;
+};
+
+// attributes the queries of the calling thread to a named call site until it goes out of scope
+// the name must outlive the statistics, pass a string literal
+struct CollisionStatsScope
+{
+	CollisionStatsScope(const char *name);
+	~CollisionStatsScope();
+	CollisionStatsScope(const CollisionStatsScope&) = delete;
+	CollisionStatsScope& operator=(const CollisionStatsScope&) = delete;
+
+	int previous;
+};
+
 struct Vertex;
 class Mesh;
 typedef std::shared_ptr<Mesh> MeshRef;
@@ -74,6 +194,24 @@ typedef std::shared_ptr<Mesh> MeshRef;
 void collision_init();
 void collision_uninit();
 
+// sleeping
+// new and moved colliders are awake, they sit in a small list beside the quadtree where moving costs nothing
+// collision_update puts the ones that have not moved for COLLISION_SLEEP_FRAMES frames to sleep in the quadtree,
+// moving a sleeping collider wakes it up again. collision_build_static puts every collider to sleep at once and packs
+// the quadtree for the queries, call it once a map is loaded so the terrain and the foliage never pay for updates
+#define COLLISION_SLEEP_FRAMES 30
+void collision_update();
+void collision_build_static();
+
+// world bounds
+// the quadtree covers the world bounds in x and z. collision_build_static fits them to the colliders of the map and
+// picks the depth from how densely the small colliders are packed. colliders out of the bounds stay awake, the tree is
+// re-rooted on larger bounds once they come to rest. collision_set_world_bounds overrides the fitted bounds,
+// level 0 picks the depth from the colliders
+void collision_set_world_bounds(const bounds_t &bounds, u32 level=0);
+bounds_t collision_get_world_bounds();
+u32 collision_get_world_level();
+
 // create colliders
 ColliderRef create_sphere_collider(float radius, const vec3 &offset);
 ColliderRef create_box_collider(const vec3 &center, const vec3 &size);
@@ -81,13 +219,93 @@ ColliderRef create_capsule_collider(const vec3 &offset, const vec3 &dir, float r
 ColliderRef create_mesh_collider(const vec3 *vertices, u32 count, const vec3 &offset=vec3());
 ColliderRef create_mesh_collider(const Vertex *vertices, u32 count, const vec3 &offset=vec3());
 ColliderRef create_mesh_collider(MeshRef mesh, const vec3 &offset=vec3());
+ColliderRef create_mesh_collider(CollisionMeshRef mesh, const vec3 &offset=vec3());
+
+// collision meshes
+// the triangle soup and the render vertex overloads weld vertices at the same position
+// get_collision_mesh returns the collision mesh of the first submesh, built on first use and shared afterwards
+// the create functions do not touch the collision world, the loaders call them on worker threads
+CollisionMeshRef create_collision_mesh(const vec3 *vertices, u32 vertex_count, const u32 *indices, u32 index_count);
+CollisionMeshRef create_collision_mesh(const vec3 *points, u32 count);
+CollisionMeshRef create_collision_mesh(const Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count);
+CollisionMeshRef get_collision_mesh(MeshRef mesh);
+
+// heightfields
+// the mesh overloads sample the top surface of the mesh every cell_size units, samples off the mesh become holes
+// thread_count > 1 splits the rows over that many threads
+ColliderRef create_heightfield_collider(CollisionHeightfieldRef heightfield, const vec3 &offset=vec3());
+ColliderRef create_heightfield_collider(MeshRef mesh, float cell_size, const vec3 &offset=vec3());
+CollisionHeightfieldRef create_collision_heightfield(const float *heights, u32 width, u32 depth, float cell_size, const vec3 &origin);
+CollisionHeightfieldRef create_collision_heightfield(MeshRef mesh, float cell_size);
+CollisionHeightfieldRef create_collision_heightfield(CollisionMeshRef mesh, float cell_size, int thread_count=1);
 
 void free_collider(ColliderRef collider);
 
+// layer collision matrix
+// collision_get_layer_mask returns the layermask of the layers that collide with the layer
+void collision_set_layer_collision(u32 layer1, u32 layer2, bool collide);
+bool collision_get_layer_collision(u32 layer1, u32 layer2);
+u32 collision_get_layer_mask(u32 layer);
+
+// broad phase
+// collects the colliders whose world bounds overlap the bounds, their shapes are not tested
+int query_colliders(const bounds_t &bounds, ColliderRef *colliders, int collider_count, u32 layermask=0xFFFFFFFF);
+int query_colliders(CollisionQuery *query, const bounds_t &bounds, ColliderRef *colliders, int collider_count, u32 layermask=0xFFFFFFFF);
+
 // raycast
+// the overloads without a CollisionQuery use the calling thread's own query
+// raycast and spherecast walk the quadtree without scratch memory, so they take no query and are safe on any thread
 int raycast(const ray_t &ray, RayHit *rayhit, u32 layermask=0xFFFFFFFF);
 int raycast_all(const ray_t &ray, RayHit *rayhit, int rayhit_count, u32 layermask=0xFFFFFFFF);
+int raycast_all(CollisionQuery *query, const ray_t &ray, RayHit *rayhit, int rayhit_count, u32 layermask=0xFFFFFFFF);
+
+// casts count rays at once and returns how many hit, rayhit[i] is the nearest hit of rays[i] and its collider is null on a miss
+// nearby rays share one broad-phase query, thread_count > 1 splits the rays over that many threads for large batches
+int raycast_batch(const ray_t *rays, RayHit *rayhit, int count, u32 layermask=0xFFFFFFFF, int thread_count=1);
+int raycast_batch(CollisionQuery *query, const ray_t *rays, RayHit *rayhit, int count, u32 layermask=0xFFFFFFFF);
 
 int spherecast(const ray_t &ray, float radius, RayHit *rayhit, u32 layermask=0xFFFFFFFF);
 int spherecast_all(const ray_t &ray, float radius, RayHit *rayhit, int rayhit_count, u32 layermask=0xFFFFFFFF);
+int spherecast_all(CollisionQuery *query, const ray_t &ray, float radius, RayHit *rayhit, int rayhit_count, u32 layermask=0xFFFFFFFF);
 vec3 spherecast_slide(const vec3 &position, const vec3 &velocity, float radius, u32 layermask=0xFFFFFFFF, int recursion=8);
+vec3 spherecast_slide(CollisionQuery *query, const vec3 &position, const vec3 &velocity, float radius, u32 layermask=0xFFFFFFFF, int recursion=8);
+
+// overlap
+// returns one collision per overlapping collider, deepest first
+// check_sphere and check_box only tell if anything overlaps and stop at the first collider
+// depenetrate_sphere returns the nearest position around center where the sphere is free, within the iterations
+int overlap_sphere(const vec3 &center, float radius, Collision *collisions, int collision_count, u32 layermask=0xFFFFFFFF);
+int overlap_sphere(CollisionQuery *query, const vec3 &center, float radius, Collision *collisions, int collision_count, u32 layermask=0xFFFFFFFF);
+int overlap_box(const vec3 &center, const vec3 &size, const quat &rotation, Collision *collisions, int collision_count, u32 layermask=0xFFFFFFFF);
+int overlap_box(CollisionQuery *query, const vec3 &center, const vec3 &size, const quat &rotation, Collision *collisions, int collision_count, u32 layermask=0xFFFFFFFF);
+bool check_sphere(const vec3 &center, float radius, u32 layermask=0xFFFFFFFF);
+bool check_box(const vec3 &center, const vec3 &size, const quat &rotation, u32 layermask=0xFFFFFFFF);
+vec3 depenetrate_sphere(const vec3 &center, float radius, u32 layermask=0xFFFFFFFF, int iterations=4);
+vec3 depenetrate_sphere(CollisionQuery *query, const vec3 &center, float radius, u32 layermask=0xFFFFFFFF, int iterations=4);
+
+CollisionQuery* collision_get_thread_query();
+
+// statistics
+// collision_stats_new_frame closes the frame, collision_get_stats returns the last closed one
+// collision_stats_window draws them in an ImGui window, it lives in collision_debug.cpp so the headless tools do not need ImGui
+void collision_stats_enable(bool enable);
+bool collision_stats_enabled();
+void collision_stats_new_frame();
+const CollisionStats* collision_get_stats();
+const char* collision_query_type_name(CollisionQueryType type);
+void collision_stats_window(bool *open);
+
+// kernel tests
+// COLLISION_KERNEL_TESTS exposes the mesh triangle kernels with and without SIMD, the collision tests and the benchmarks
+// define it to compare the two, the game does not
+#ifdef COLLISION_KERNEL_TESTS
+int collision_simd_width();
+// nearest hit of the ray over every triangle of the mesh in model space, dir must be normalized
+// distance is the ray length on input, triangle is the index of the hit triangle in the BVH leaf order
+bool collision_ray_vs_triangles(const CollisionMesh *mesh, const vec3 &pos, const vec3 &dir, bool simd, float *distance, u32 *triangle);
+// nearest hit of the sphere swept along dir over every triangle of the mesh in model space, dir is the whole sweep
+// the SIMD filter picks the triangles for the exact test when simd is set, without it every triangle gets the exact test
+bool collision_spherecast_vs_triangles(const CollisionMesh *mesh, const vec3 &pos, const vec3 &dir, float radius, bool simd, float *distance, u32 *triangle);
+// bytes of the collision mesh, its vertices, indices, BVH nodes and triangle streams
+size_t collision_mesh_memory(const CollisionMesh *mesh);
+#endif
@@ -0,0 +1,86 @@
+// ImGui window of the collision statistics
+// kept out of collision.cpp so the headless tools can link the collision without ImGui
+#include "imgui/imgui.h"
+#include "collision.h"
+
+static void draw_stats_table(const char *id, const char *label, const char *const *names, const CollisionQueryStats *rows, int row_count)
+{
+	ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+	if(!ImGui::BeginTable(id, 7, flags)) return;
+
+	ImGui::TableSetupColumn(label);
+	ImGui::TableSetupColumn("queries");
+	ImGui::TableSetupColumn("nodes");
+	ImGui::TableSetupColumn("candidates");
+	ImGui::TableSetupColumn("tests");
+	ImGui::TableSetupColumn("hits");
+	ImGui::TableSetupColumn("ms");
+	ImGui::TableHeadersRow();
+
+	CollisionQueryStats total = {};
+	for(int i=0; i<row_count; i++)
+	{
+		const CollisionQueryStats &s = rows[i];
+		total.queries += s.queries;
+		total.nodes += s.nodes;
+		total.candidates += s.candidates;
+		total.tests += s.tests;
+		total.hits += s.hits;
+		total.time += s.time;
+		if(s.queries == 0) continue;
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(names[i]);
+		ImGui::TableNextColumn(); ImGui::Text("%u", s.queries);
+		ImGui::TableNextColumn(); ImGui::Text("%u", s.nodes);
+		ImGui::TableNextColumn(); ImGui::Text("%u", s.candidates);
+		ImGui::TableNextColumn(); ImGui::Text("%u", s.tests);
+		ImGui::TableNextColumn(); ImGui::Text("%u", s.hits);
+		ImGui::TableNextColumn(); ImGui::Text("%.3f", s.time);
+	}
+
+	ImGui::TableNextRow();
+	ImGui::TableNextColumn(); ImGui::TextUnformatted("total");
+	ImGui::TableNextColumn(); ImGui::Text("%u", total.queries);
+	ImGui::TableNextColumn(); ImGui::Text("%u", total.nodes);
+	ImGui::TableNextColumn(); ImGui::Text("%u", total.candidates);
+	ImGui::TableNextColumn(); ImGui::Text("%u", total.tests);
+	ImGui::TableNextColumn(); ImGui::Text("%u", total.hits);
+	ImGui::TableNextColumn(); ImGui::Text("%.3f", total.time);
+	ImGui::EndTable();
+}
+
+void collision_stats_window(bool *open)
+{
+	if(open && !*open) return;
+
+	if(!ImGui::Begin("Collision Stats", open))
+	{
+		ImGui::End();
+		return;
+	}
+
+	bool enabled = collision_stats_enabled();
+	if(ImGui::Checkbox("Enabled", &enabled))
+	{
+		collision_stats_enable(enabled);
+	}
+
+	if(enabled)
+	{
+		const CollisionStats *stats = collision_get_stats();
+		bounds_t world = collision_get_world_bounds();
+		ImGui::Text("world %.1f x %.1f, depth %u", world.extents.x * 2.0f, world.extents.z * 2.0f, collision_get_world_level());
+		const char *type_names[(int)CollisionQueryType::COUNT];
+		for(int i=0; i<(int)CollisionQueryType::COUNT; i++)
+		{
+			type_names[i] = collision_query_type_name((CollisionQueryType)i);
+		}
+
+		ImGui::Text("last frame by query type");
+		draw_stats_table("##collision_types", "type", type_names, stats->types, (int)CollisionQueryType::COUNT);
+		ImGui::Text("last frame by call site");
+		draw_stats_table("##collision_scopes", "scope", stats->scope_names, stats->scopes, stats->scope_count);
+	}
+	ImGui::End();
+}
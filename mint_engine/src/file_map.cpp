@@ -0,0 +1,78 @@
+#include "file_map.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+
+bool file_map_open(const char *filename, FileMap *map)
+{
+	*map = {};
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size = {};
+	if(!GetFileSizeEx(file, &size) || size.QuadPart <= 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	const void *data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if(data == nullptr)
+	{
+		if(mapping) CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	map->data = (const u8*)data;
+	map->size = (size_t)size.QuadPart;
+	map->handle = file;
+	map->mapping = mapping;
+	return true;
+}
+
+void file_map_close(FileMap *map)
+{
+	if(map->data) UnmapViewOfFile(map->data);
+	if(map->mapping) CloseHandle((HANDLE)map->mapping);
+	if(map->handle) CloseHandle((HANDLE)map->handle);
+	*map = {};
+}
+
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+bool file_map_open(const char *filename, FileMap *map)
+{
+	*map = {};
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) return false;
+
+	struct stat st = {};
+	if(fstat(fd, &st) != 0 || st.st_size <= 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	void *data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED) return false;
+
+	map->data = (const u8*)data;
+	map->size = (size_t)st.st_size;
+	return true;
+}
+
+void file_map_close(FileMap *map)
+{
+	if(map->data) munmap((void*)map->data, map->size);
+	*map = {};
+}
+
+#endif // _WIN32
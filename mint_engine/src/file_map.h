@@ -0,0 +1,15 @@
+#pragma once
+#include <stddef.h>
+#include "mathf.h"
+
+// read only view of a whole file, the pages are mapped into memory instead of read into buffers
+struct FileMap
+{
+	const u8 *data = nullptr;
+	size_t size = 0;
+	void *handle = nullptr;		// platform handles, kept for the unmap
+	void *mapping = nullptr;
+};
+
+bool file_map_open(const char *filename, FileMap *map);
+void file_map_close(FileMap *map);
@@ -202,7 +202,7 @@ std::shared_ptr<Mesh> gpu_create_mesh()
 	return mesh;
 }
 
-std::shared_ptr<Mesh> gpu_create_mesh(const Vertex *vertices, u32 vertex_count, const u16 *indices, u32 index_count)
+std::shared_ptr<Mesh> gpu_create_mesh(const Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count)
 {
 	auto mesh = std::make_shared<Mesh>(vertices, vertex_count, indices, index_count);
 	ctx.mesh_list.push_back(mesh);
@@ -251,30 +251,21 @@ std::shared_ptr<Shader> gpu_load_shader(const char *vertex_file_name, const char
 
 
 
-Mesh::Mesh(const Vertex *vertices, u32 vertex_count, const u16 *indices, u32 index_count)
+// the indices in the width of the gpu buffer, 16 bit ones are narrowed into a scratch buffer
+static const void* gpu_index_data(const u32 *indices, u32 index_count, u32 index_size)
 {
-	create(vertices, vertex_count, indices, index_count);
-}
-
-Mesh::~Mesh()
-{
-	free();
-}
-
-static bounds_t calc_bounds(const Vertex *vertices, u32 vertex_count)
-{
-	if(vertex_count <= 0) return bounds_t();
+	if(index_size == sizeof(u32)) return indices;
 
-	bounds_t b(vertices[0].position, vec3(0,0,0));
-	for(u32 i=1; i<vertex_count; i++)
+	static std::vector<u16> narrowed;
+	narrowed.resize(index_count);
+	for(u32 i=0; i<index_count; i++)
 	{
-		vec3 p = vertices[i].position;
-		b.encapsulate(p);
+		narrowed[i] = (u16)indices[i];
 	}
-	return b;
+	return narrowed.data();
 }
 
-static Submesh create_submesh(const Vertex *vertices, u32 vertex_count, const u16 *indices, u32 index_count, bool is_dynamic)
+static Submesh create_submesh(const Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count, bool is_dynamic)
 {
 	Submesh submesh = {};
 	bool skinned = false;
@@ -301,9 +292,10 @@ static Submesh create_submesh(const Vertex *vertices, u32 vertex_count, const u1
 	glBufferData(GL_ARRAY_BUFFER, vertex_count * sizeof(Vertex), vertices, usage);  
 
 
-	// indices
+	// indices, 16 bit when every vertex can be addressed with them
+	submesh.index_size = vertex_count <= 0x10000 ? sizeof(u16) : sizeof(u32);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, submesh.ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * sizeof(u16), indices, usage);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * submesh.index_size, gpu_index_data(indices, index_count, submesh.index_size), usage);
 
 
 	// vertex positions
@@ -335,16 +327,16 @@ static Submesh create_submesh(const Vertex *vertices, u32 vertex_count, const u1
 
 	// copy data
 	submesh.vertices = new Vertex[vertex_count]; memcpy(submesh.vertices, vertices, vertex_count * sizeof(Vertex));
-	submesh.indices = new u16[index_count]; memcpy(submesh.indices, indices, index_count * sizeof(u16));
+	submesh.indices = new u32[index_count]; memcpy(submesh.indices, indices, index_count * sizeof(u32));
 	submesh.vertex_count = vertex_count;
 	submesh.index_count = index_count;
-	submesh.aabb = calc_bounds(vertices, vertex_count);
+	submesh.aabb = mesh_calc_bounds(vertices, vertex_count);
 	submesh.is_dynamic = is_dynamic;
 
 	return submesh;
 }
 
-void Mesh::create(const Vertex *vertices, u32 vertex_count, const u16 *indices, u32 index_count, int index)
+void Mesh::create(const Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count, int index)
 {
 	const Submesh *old_submesh = get_submesh(index);
 	if(old_submesh != nullptr)
@@ -359,7 +351,7 @@ void Mesh::create(const Vertex *vertices, u32 vertex_count, const u16 *indices,
 	submeshes[index] = create_submesh(vertices, vertex_count, indices, index_count, false);
 }
 
-void Mesh::update(const Vertex *vertices, u32 vertex_count, const u16 *indices, u32 index_count, int index)
+void Mesh::update(const Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count, int index)
 {
 	Submesh *submesh = get_submesh(index);
 
@@ -378,9 +370,9 @@ void Mesh::update(const Vertex *vertices, u32 vertex_count, const u16 *indices,
 	// update buffer
 	glBindBuffer(GL_ARRAY_BUFFER, submesh->vbo);
 	glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_count * sizeof(Vertex), vertices);
-	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, index_count * sizeof(u16), indices);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, index_count * submesh->index_size, gpu_index_data(indices, index_count, submesh->index_size));
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	submesh->aabb = calc_bounds(vertices, vertex_count);
+	submesh->aabb = mesh_calc_bounds(vertices, vertex_count);
 }
 
 void Mesh::update(const Vertex *vertices, u32 vertex_count, u32 offset, int index)
@@ -405,15 +397,6 @@ void Mesh::update(const Vertex *vertices, u32 vertex_count, u32 offset, int inde
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void Mesh::free()
-{
-	for(int i=0; i<submeshes.size(); i++)
-	{
-		free_submesh(i);
-	}
-	submeshes.clear();
-}
-
 void Mesh::free_submesh(int index)
 {
 	if(index < 0 || index >= submeshes.size())
@@ -428,6 +411,11 @@ void Mesh::free_submesh(int index)
 	submeshes[index] = {};
 }
 
+static GLenum gl_index_type(const Submesh *submesh)
+{
+	return submesh->index_size == sizeof(u16) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
 void Mesh::draw(ShaderRef shader, int index)
 {
 	Submesh *submesh = get_submesh(index);
@@ -436,7 +424,7 @@ void Mesh::draw(ShaderRef shader, int index)
 
 	shader->use();
 	glBindVertexArray(submesh->vao);
-	glDrawElements(GL_TRIANGLES, submesh->index_count, GL_UNSIGNED_SHORT, 0);
+	glDrawElements(GL_TRIANGLES, submesh->index_count, gl_index_type(submesh), 0);
 	glBindVertexArray(0);
 }
 
@@ -448,7 +436,7 @@ void Mesh::draw_lines(ShaderRef shader, int index)
 
 	shader->use();
 	glBindVertexArray(submesh->vao);
-	glDrawElements(GL_LINES, submesh->index_count, GL_UNSIGNED_SHORT, 0);
+	glDrawElements(GL_LINES, submesh->index_count, gl_index_type(submesh), 0);
 	glBindVertexArray(0);
 }
 
@@ -488,69 +476,13 @@ void Mesh::draw(ShaderRef shader, u32 count, const mat4 *transforms, int index)
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	shader->use();
-	glDrawElementsInstanced(GL_TRIANGLES, submesh->index_count, GL_UNSIGNED_SHORT, 0, count);
+	glDrawElementsInstanced(GL_TRIANGLES, submesh->index_count, gl_index_type(submesh), 0, count);
 	glBindVertexArray(0);
 
 	// remove instanced buffer
 	glDeleteBuffers(1, &instancedVBO);
 }
 
-bounds_t Mesh::get_bounds()
-{
-	bounds_t b;
-	for(int i=0; i<submeshes.size(); i++)
-	{
-		b.encapsulate(submeshes[i].aabb);
-	}
-	return b;
-}
-
-bounds_t Mesh::get_bounds(int index)
-{
-	const Submesh *submesh = get_submesh(index);
-	if(submesh)
-		return submesh->aabb;
-
-	return bounds_t();
-}
-
-const Vertex* Mesh::get_vertices(int index)
-{
-	if(index < 0 || index >= submeshes.size())
-		return nullptr;
-	return submeshes[index].vertices;
-}
-
-u32 Mesh::get_vertex_count(int index)
-{
-	if(index < 0 || index >= submeshes.size())
-		return 0;
-	return submeshes[index].vertex_count;
-}
-
-const u16* Mesh::get_indices(int index)
-{
-	if(index < 0 || index >= submeshes.size())
-		return nullptr;
-	return submeshes[index].indices;
-}
-
-u32 Mesh::get_index_count(int index)
-{
-	if(index < 0 || index >= submeshes.size())
-		return 0;
-	return submeshes[index].index_count;
-}
-
-Submesh* Mesh::get_submesh(int index)
-{
-	if(index < 0 || index >= submeshes.size())
-		return nullptr;
-	return &submeshes[index];
-}
-
-
-
 bool Texture::load(const char *filename)
 {
 	int bpp;
@@ -58,8 +58,9 @@ struct Submesh
 {
 	Vertex *vertices;
 	u32 vertex_count;
-	u16 *indices;
+	u32 *indices;
 	u32 index_count;
+	u32 index_size;	// bytes per index in the gpu buffer, 2 when every index fits in 16 bits, otherwise 4
 	u32 vao, vbo, ebo;	
 	bool is_dynamic;
 	bounds_t aabb;
@@ -69,11 +70,11 @@ class Mesh
 {
 public:
 	Mesh(){}
-	Mesh(const Vertex *vertices, u32 vertex_count, const u16 *indices, u32 index_count);
+	Mesh(const Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count);
 	~Mesh();
 
-	void create(const Vertex *vertices, u32 vertex_count, const u16 *indices, u32 index_count, int index=0);
-	void update(const Vertex *vertices, u32 vertex_count, const u16 *indices, u32 index_count, int index=0);
+	void create(const Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count, int index=0);
+	void update(const Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count, int index=0);
 	void update(const Vertex *vertices, u32 vertex_count, u32 offset=0, int index=0);
 	void free();
 
@@ -86,7 +87,7 @@ public:
 
 	const Vertex* get_vertices(int index=0);
 	u32 get_vertex_count(int index=0);
-	const u16* get_indices(int index=0);
+	const u32* get_indices(int index=0);
 	u32 get_index_count(int index=0);
 	Submesh* get_submesh(int index);
 protected:
@@ -95,6 +96,8 @@ protected:
 	std::vector<Submesh> submeshes;
 };
 
+bounds_t mesh_calc_bounds(const Vertex *vertices, u32 vertex_count);
+
 class Texture
 {
 public:
@@ -181,7 +184,7 @@ void gpu_bind_render_target(std::shared_ptr<RenderTarget> render_texture);
 void gpu_bind_texture(u32 slot, std::shared_ptr<Texture> texture);
 
 std::shared_ptr<Mesh> gpu_create_mesh();
-std::shared_ptr<Mesh> gpu_create_mesh(const Vertex *vertices, u32 vertex_count, const u16 *indices, u32 index_count);
+std::shared_ptr<Mesh> gpu_create_mesh(const Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count);
 std::shared_ptr<Texture> gpu_load_texture(const char *filename);
 std::shared_ptr<Texture> gpu_create_texture(const u8 *data, int width, int height);
 std::shared_ptr<RenderTarget> gpu_create_render_target(int width, int height);
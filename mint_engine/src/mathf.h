@@ -2,6 +2,11 @@
 #define MATHF_H_
 #include <math.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MATHF_SIMD_SSE2
+#endif
+
 const float PI = 3.141592f;
 const float DEG2RAD = PI / 180.0f;
 const float RAD2DEG = 180.0f / PI;
@@ -200,6 +205,7 @@ struct quat
 	quat(float x, float y, float z){*this = quat::euler(x, y, z);}
 	quat(const vec3 &euler){*this = quat::euler(euler);}
 	quat(const quat &q) : x(q.x), y(q.y), z(q.z), w(q.w){}
+	quat& operator=(const quat &q) = default;
 	inline mat4 to_mat4() const;
 	inline vec3 to_euler()
 	{
@@ -883,7 +889,7 @@ struct bounds_t
 		vec3 b_min = other.get_min();
 		vec3 b_max = other.get_max();
 		return	(a_min.x <= b_max.x && a_max.x >= b_min.x &&
-				 a_min.y <= b_max.y && a_max.x >= b_min.x &&
+				 a_min.y <= b_max.y && a_max.y >= b_min.y &&
 				 a_min.z <= b_max.z && a_max.z >= b_min.z);
 	}
 
@@ -908,6 +914,41 @@ struct bounds_t
 	}
 };
 
+// min/max form of bounds_t for the broad phase, overlap tests need no conversion
+// the padding lets min and max load as four floats
+struct aabb_t
+{
+	vec3 min;
+	float pad0 = 0.0f;
+	vec3 max;
+	float pad1 = 0.0f;
+
+	aabb_t(){}
+	aabb_t(const vec3 &min, const vec3 &max) : min(min), max(max){}
+	explicit aabb_t(const bounds_t &bounds) : min(bounds.get_min()), max(bounds.get_max()){}
+
+	bounds_t to_bounds() const
+	{
+		bounds_t b;
+		b.set_min_max(min, max);
+		return b;
+	}
+
+	// branchless, touching boxes intersect
+	inline bool intersects(const aabb_t &other) const
+	{
+#if defined(MATHF_SIMD_SSE2)
+		__m128 le = _mm_cmple_ps(_mm_loadu_ps(&min.x), _mm_loadu_ps(&other.max.x));
+		__m128 ge = _mm_cmpge_ps(_mm_loadu_ps(&max.x), _mm_loadu_ps(&other.min.x));
+		return (_mm_movemask_ps(_mm_and_ps(le, ge)) & 0x7) == 0x7;
+#else
+		return	(min.x <= other.max.x) & (max.x >= other.min.x) &
+				(min.y <= other.max.y) & (max.y >= other.min.y) &
+				(min.z <= other.max.z) & (max.z >= other.min.z);
+#endif
+	}
+};
+
 
 struct plane_t
 {
@@ -0,0 +1,89 @@
+// the CPU side of Mesh, the vertices, indices and bounds kept next to the gpu buffers. create and free_submesh
+// are in gpu.cpp, the headless tools link their own ones that upload nothing
+#include "gpu.h"
+
+bounds_t mesh_calc_bounds(const Vertex *vertices, u32 vertex_count)
+{
+	if(vertex_count <= 0) return bounds_t();
+
+	bounds_t b(vertices[0].position, vec3(0,0,0));
+	for(u32 i=1; i<vertex_count; i++)
+	{
+		vec3 p = vertices[i].position;
+		b.encapsulate(p);
+	}
+	return b;
+}
+
+Mesh::Mesh(const Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count)
+{
+	create(vertices, vertex_count, indices, index_count);
+}
+
+Mesh::~Mesh()
+{
+	free();
+}
+
+void Mesh::free()
+{
+	for(int i=0; i<(int)submeshes.size(); i++)
+	{
+		free_submesh(i);
+	}
+	submeshes.clear();
+}
+
+bounds_t Mesh::get_bounds()
+{
+	bounds_t b;
+	for(size_t i=0; i<submeshes.size(); i++)
+	{
+		b.encapsulate(submeshes[i].aabb);
+	}
+	return b;
+}
+
+bounds_t Mesh::get_bounds(int index)
+{
+	const Submesh *submesh = get_submesh(index);
+	if(submesh)
+		return submesh->aabb;
+
+	return bounds_t();
+}
+
+const Vertex* Mesh::get_vertices(int index)
+{
+	if(index < 0 || index >= (int)submeshes.size())
+		return nullptr;
+	return submeshes[index].vertices;
+}
+
+u32 Mesh::get_vertex_count(int index)
+{
+	if(index < 0 || index >= (int)submeshes.size())
+		return 0;
+	return submeshes[index].vertex_count;
+}
+
+const u32* Mesh::get_indices(int index)
+{
+	if(index < 0 || index >= (int)submeshes.size())
+		return nullptr;
+	return submeshes[index].indices;
+}
+
+u32 Mesh::get_index_count(int index)
+{
+	if(index < 0 || index >= (int)submeshes.size())
+		return 0;
+	return submeshes[index].index_count;
+}
+
+Submesh* Mesh::get_submesh(int index)
+{
+	if(index < 0 || index >= (int)submeshes.size())
+		return nullptr;
+	return &submeshes[index];
+}
@@ -1,6 +1,8 @@
 #include "model.h"
 #include "external/par_shapes.h"
 #include "resource_manager.h"
+#include "file_map.h"
+#include "obj_file.h"
 
 ModelRef create_model()
 {
@@ -35,6 +37,7 @@ bool Model::load(const char *filename)
 		else if(strcmp(ext, ".smd") == 0)
 		{
 			ModelRef model = _load_smd(filename);
+			if(model == nullptr) return false;
 			*this = *(model.get());	// copy values
 			return true;
 		}
@@ -101,174 +104,147 @@ MeshRef load_mesh(const char *filename)
 	return nullptr;
 }
 
-static MeshRef _load_obj(const char *filename)
+// the file path without the "@object" suffix, meshes are registered by it
+static void _get_mesh_filepath(const char *filename, char *filepath)
 {
-	MeshRef tmp_mesh = res_get_mesh(filename);
-	if(tmp_mesh)
-		return tmp_mesh;
-
-	// get file path
-	char filepath[256] = {};
 	strcpy(filepath, filename);
 	const char *obj_name_point = strrchr(filename, '@');
 	if(obj_name_point != nullptr)
 	{
-		filepath[obj_name_point - filepath] = '\0';
+		filepath[obj_name_point - filename] = '\0';
 	}
+}
+
+bool load_mesh_data(const char *filename, MeshData *data)
+{
+	const char *ext = strrchr(filename, '.');
+	if(ext == nullptr || strcmp(ext, ".obj") != 0) return false;
+
+	char filepath[256] = {};
+	_get_mesh_filepath(filename, filepath);
+	return obj_load(filepath, &data->vertices, &data->indices);
+}
 
-	FILE* fp = nullptr;
-	fp = fopen(filepath, "r");
-	if(fp == NULL){return nullptr;}
+MeshRef create_mesh(const char *filename, const MeshData &data)
+{
+	char filepath[256] = {};
+	_get_mesh_filepath(filename, filepath);
+	MeshRef mesh = gpu_create_mesh(data.vertices.data(), (int)data.vertices.size(), data.indices.data(), (int)data.indices.size());
+	res_register(filepath, mesh);
+	return mesh;
+}
+
+static MeshRef _load_obj(const char *filename)
+{
+	MeshRef tmp_mesh = res_get_mesh(filename);
+	if(tmp_mesh)
+		return tmp_mesh;
+
+	MeshData data;
+	if(!load_mesh_data(filename, &data)) return nullptr;
+	return create_mesh(filename, data);
+}
 
-	std::vector<vec3> vertices;
-	std::vector<vec2> uvs;
-	std::vector<vec3> normals;
-	std::vector<u16> indices;
-	int offset = 0;
-	std::vector<Vertex> verts;
+#define SMD_VERTEX_COLOR	1
+#define SMD_VERTEX_UV2		2
+#define SMD_VERTEX_SKINNED	4
 
-	char line[1024];
-	char type[32];
+// reads the sections of a mapped smd file in place, a read past the end sets error and returns zeros
+// the sections are packed, so the values are copied out with memcpy instead of read through typed pointers
+struct SmdReader
+{
+	const u8 *data;
+	size_t size;
+	size_t pos;
+	bool error;
 
-	bool hasUV = false;
-	bool hasNormal = false;
-	while(fgets(line, 1024, fp) != NULL)
+	const u8* read(size_t bytes)
 	{
-		sscanf(line, "%s", &type);
-		if (strcmp(type, "v") == 0)
+		if(error || bytes > size - pos)
 		{
-			vec3 v;
-			sscanf(line, "%s %f %f %fn", &type, &v.x, &v.y, &v.z);
-			vertices.push_back(v);
+			error = true;
+			return nullptr;
 		}
-		else if (strcmp(type, "vt") == 0)
-		{
-			hasUV = true;
-			vec2 uv;
-			sscanf(line, "%s %f %fn", &type, &uv.x, &uv.y);
-			uvs.push_back(uv);
-		}
-		else if (strcmp(type, "vn") == 0)
+		const u8 *p = data + pos;
+		pos += bytes;
+		return p;
+	}
+
+	// an array of count elements of element_size bytes
+	const u8* read_array(size_t count, size_t element_size)
+	{
+		if(element_size != 0 && count > (size - pos) / element_size)
 		{
-			hasNormal = true;
-			vec3 n;
-			sscanf(line, "%s %f %f %fn", &type, &n.x, &n.y, &n.z);
-			normals.push_back(n);
+			error = true;
+			return nullptr;
 		}
-		else if (strcmp(type, "f") == 0)
-		{
-			int spaces = 0;
-			// Count the space of separater
-			for (int i = 0; i < 256; i++)
-			{
-				if (line[i] == ' ')
-					spaces++;
-				else if (line[i] == '\n')
-					break;
-			}
+		return read(count * element_size);
+	}
 
-			u32 vindex[4], uvindex[4], nindex[4];
-			int vcount = 0;
-			if (spaces == 3)
-			{
-				// read as triangle
-				vcount = 3;
-				if (hasUV && hasNormal)
-				{
-					sscanf(line, "%s %d/%d/%d %d/%d/%d %d/%d/%dn", &type,
-						&vindex[0], &uvindex[0], &nindex[0],
-						&vindex[1], &uvindex[1], &nindex[1],
-						&vindex[2], &uvindex[2], &nindex[2]);
-				}
-				else if (hasNormal)
-				{
-					sscanf(line, "%s %d//%d %d//%d %d//%dn", &type,
-						&vindex[0], &nindex[0],
-						&vindex[1], &nindex[1],
-						&vindex[2], &nindex[2]);
-				}
-			}
-			else if (spaces == 4)
-			{
-				// read as quad
-				vcount = 4;
-				if (hasUV && hasNormal)
-				{
-					sscanf(line, "%s %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%dn", &type,
-						&vindex[0], &uvindex[0], &nindex[0],
-						&vindex[1], &uvindex[1], &nindex[1],
-						&vindex[2], &uvindex[2], &nindex[2],
-						&vindex[3], &uvindex[3], &nindex[3]);
-				}
-				else if(hasNormal)
-				{
-					sscanf(line, "%s %d//%d %d//%d %d//%d %d//%dn", &type,
-						&vindex[0], &nindex[0],
-						&vindex[1], &nindex[1],
-						&vindex[2], &nindex[2],
-						&vindex[3], &nindex[3]);
-				}
-			}
-			else
-			{
-				// this file format not supported
-				printf("Error : The model must consist of triangles or rectangles.[%s]", filename);
-				return nullptr;
-			}
+	template<typename T> T read_value()
+	{
+		T value = {};
+		const u8 *p = read(sizeof(T));
+		if(p) memcpy(&value, p, sizeof(T));
+		return value;
+	}
 
-			// Add vertex formats
-			Vertex v[4];
-			for (int i = 0; i < vcount; i++)
-			{
-				v[i].position = vertices[vindex[i] - 1];
-				v[i].uv = uvs[uvindex[i] - 1];
-				v[i].color = vec4(1,1,1,1);
-				v[i].normal = (hasNormal) ? normals[nindex[i]-1] : vec3();
-				//vf.normal = (hasNormal) ? normals[nindex[i]-1] : vec3();
-			}
+	void read_string(char *str, size_t str_size, size_t count)
+	{
+		const u8 *p = read(count);
+		if(p == nullptr) return;
+		count = count < str_size ? count : str_size - 1;
+		memcpy(str, p, count);
+		str[count] = '\0';
+	}
+
+	void seek(size_t offset)
+	{
+		if(offset > size) error = true;
+		else pos = offset;
+	}
+};
 
-			// Add triangle indieces
-			if(vcount == 3)
+// the vertices of the model, the position, normal and uv sections are interleaved straight from the mapping
+static bool _read_smd_vertices(SmdReader *reader, u32 vertex_count, u8 flags, std::vector<Vertex> *vertices)
+{
+	const u8 *position = reader->read_array(vertex_count, sizeof(vec3));
+	const u8 *normal = reader->read_array(vertex_count, sizeof(vec3));
+	const u8 *uv = reader->read_array(vertex_count, sizeof(vec2));
+	const u8 *color = (flags & SMD_VERTEX_COLOR) ? reader->read_array(vertex_count, sizeof(vec4)) : nullptr;
+	const u8 *bones = (flags & SMD_VERTEX_SKINNED) ? reader->read_array(vertex_count, sizeof(u8)*4) : nullptr;
+	const u8 *weights = (flags & SMD_VERTEX_SKINNED) ? reader->read_array(vertex_count, sizeof(float)*4) : nullptr;
+	if(reader->error) return false;
+
+	vertices->resize(vertex_count);
+	for(u32 i=0; i<vertex_count; i++)
+	{
+		Vertex &v = vertices->at(i);
+		memcpy(&v.position, position + i*sizeof(vec3), sizeof(vec3));
+		memcpy(&v.normal, normal + i*sizeof(vec3), sizeof(vec3));
+		memcpy(&v.uv, uv + i*sizeof(vec2), sizeof(vec2));
+		if(color) memcpy(&v.color, color + i*sizeof(vec4), sizeof(vec4));
+		else v.color = vec4(1,1,1,1);
+
+		// read skinned vertex infomation
+		memset(v.bones, 0, sizeof(v.bones));
+		memset(v.weights, 0, sizeof(v.weights));
+		if(bones)
+		{
+			for(int k=0; k<4; k++)
 			{
-				indices.push_back(offset);
-				indices.push_back(offset + 1);
-				indices.push_back(offset + 2);
-				offset += 3;
-
-				verts.push_back(v[0]);
-				verts.push_back(v[1]);
-				verts.push_back(v[2]);
+				v.bones[k] = bones[i*4 + k];
 			}
-			else if(vcount == 4)
+			memcpy(v.weights, weights + i*sizeof(float)*4, sizeof(float)*4);
+			if(v.weights[0] <= EPSILON && v.weights[1] <= EPSILON && v.weights[2] <= EPSILON && v.weights[3] <= EPSILON)
 			{
-				indices.push_back(offset);
-				indices.push_back(offset + 1);
-				indices.push_back(offset + 2);
-
-				indices.push_back(offset);
-				indices.push_back(offset + 2);
-				indices.push_back(offset + 3);
-				offset += 4;
-
-				verts.push_back(v[0]);
-				verts.push_back(v[1]);
-				verts.push_back(v[2]);
-				verts.push_back(v[3]);
+				v.weights[0] = 1.0f;
 			}
 		}
 	}
-
-	MeshRef mesh = gpu_create_mesh(verts.data(), (int)verts.size(), indices.data(), (int)indices.size());
-	res_register(filepath, mesh);
-
-	// Cleanup
-	fclose(fp);
-	return mesh;
+	return true;
 }
 
-#define SMD_VERTEX_COLOR	1
-#define SMD_VERTEX_UV2		2
-#define SMD_VERTEX_SKINNED	4
 static ModelRef _load_smd(const char *filename)
 {
 	ModelRef model = res_get_model(filename);
@@ -277,210 +253,147 @@ static ModelRef _load_smd(const char *filename)
 
 	// get file path
 	char filepath[256] = {};
-	strcpy(filepath, filename);
-	const char *obj_name_point = strrchr(filename, '@');
-	if(obj_name_point != nullptr)
-	{
-		filepath[obj_name_point - filepath] = '\0';
-	}
+	_get_mesh_filepath(filename, filepath);
 
-	FILE *fp = fopen(filepath, "rb");
-	if(fp == nullptr) return nullptr;
+	FileMap file;
+	if(!file_map_open(filepath, &file)) return nullptr;
+	SmdReader reader = {file.data, file.size, 0, false};
 
-	char signature[4] = {};
-	u8 version = 0;
-	fread(signature, sizeof(char), 4, fp);
-	fread(&version, sizeof(u8), 1, fp);
+	// signature and version
+	reader.read(4);
+	reader.read_value<u8>();
 
-	u32 model_count = 0;
-	fread(&model_count, sizeof(u32), 1, fp);
-	fpos_t model_index_pos;
-	fgetpos(fp, &model_index_pos);
+	u32 model_count = reader.read_value<u32>();
+	const u8 *model_offsets = reader.read_array(model_count, sizeof(u32));
 
-
-	for(u32 i=0; i<model_count; i++)
+	std::vector<Vertex> vertices;
+	std::vector<u32> remap;
+	std::vector<u32> used;		// the vertices of a submesh in the order of first use
+	std::vector<Vertex> submesh_vertices;
+	std::vector<u32> submesh_indices;
+	for(u32 i=0; i<model_count && !reader.error; i++)
 	{
 		ModelRef model = std::make_shared<Model>();
 
 		// get model offset
-		fseek(fp, (long)model_index_pos + (long)(i * sizeof(u32)), 0);
-		u32 model_offset;
-		fread(&model_offset, sizeof(u32), 1, fp);
-		fseek(fp, model_offset, 0);
+		u32 model_offset = 0;
+		memcpy(&model_offset, model_offsets + i*sizeof(u32), sizeof(u32));
+		reader.seek(model_offset);
 
-		u32 model_name_count;
-		fread(&model_name_count, sizeof(u32), 1, fp);
 		char name[256] = {};
-		fread(&name, sizeof(char), model_name_count, fp);
-		u32 vertex_count;
-		fread(&vertex_count, sizeof(u32), 1, fp);
-		u32 submesh_count;
-		fread(&submesh_count, sizeof(u32), 1, fp);
-		u8 flags;
-		fread(&flags, sizeof(u8), 1, fp);
+		reader.read_string(name, sizeof(name), reader.read_value<u32>());
+		u32 vertex_count = reader.read_value<u32>();
+		u32 submesh_count = reader.read_value<u32>();
+		u8 flags = reader.read_value<u8>();
 
 		// read vertex
-		if(vertex_count > 0)
+		if(vertex_count > 0 && _read_smd_vertices(&reader, vertex_count, flags, &vertices))
 		{
-			vec3 *position = new vec3[vertex_count];
-			vec3 *normal = new vec3[vertex_count];
-			vec2 *uv = new vec2[vertex_count];
-
-			fread(position, sizeof(vec3), vertex_count, fp);
-			fread(normal, sizeof(vec3), vertex_count, fp);
-			fread(uv, sizeof(vec2), vertex_count, fp);
-
-			Vertex *vertices = new Vertex[vertex_count];
-			for(u32 vi=0; vi<vertex_count; vi++)
-			{
-				vertices[vi].position = position[vi];
-				vertices[vi].normal = normal[vi];
-				vertices[vi].uv = uv[vi];
-				vertices[vi].color = vec4(1,1,1,1);
-			}
-			delete[] position;
-			delete[] normal;
-			delete[] uv;
-
-			// read colors
-			if(flags & SMD_VERTEX_COLOR)
-			{
-				vec4 *color = new vec4[vertex_count];
-				fread(color, sizeof(vec4), vertex_count, fp);
-				for(u32 vi=0; vi<vertex_count; vi++)
-				{
-					vertices[vi].color = color[vi];
-				}
-				delete[] color;
-			}
-
-			// read skinned vertex infomation
-			if(flags & SMD_VERTEX_SKINNED)
+			// indices, each submesh gets the vertices it uses in the order of first use
+			model->mesh = gpu_create_mesh();
+			remap.assign(vertex_count, 0xFFFFFFFF);
+			for(u32 si=0; si<submesh_count && !reader.error; si++)
 			{
-				u8 *bones = new u8[vertex_count * 4];
-				float *weights = new float[vertex_count * 4];
-				fread(bones, sizeof(u8), vertex_count*4, fp);
-				fread(weights, sizeof(float), vertex_count*4, fp);
-				for(u32 j=0; j<vertex_count; j++)
+				u32 index_count = reader.read_value<u32>();
+				const u8 *indices = reader.read_array(index_count, sizeof(u32));
+				if(reader.error) break;
+
+				used.clear();
+				submesh_indices.resize(index_count);
+				bool in_order = true;
+				for(u32 n=0; n<index_count; n++)
 				{
-					for(int k=0; k<4; k++)
+					u32 index = 0;
+					memcpy(&index, indices + n*sizeof(u32), sizeof(u32));
+					if(index >= vertex_count)
 					{
-						vertices[j].bones[k] = bones[(j*4)+k];
-						vertices[j].weights[k] = weights[(j*4)+k];
+						reader.error = true;
+						break;
 					}
-					if(vertices[j].weights[0] <= EPSILON && vertices[j].weights[1] <= EPSILON && vertices[j].weights[2] <= EPSILON && vertices[j].weights[3] <= EPSILON)
+					if(remap[index] == 0xFFFFFFFF)
 					{
-						vertices[j].weights[0] = 1.0f;
+						in_order = in_order && index == (u32)used.size();
+						remap[index] = (u32)used.size();
+						used.push_back(index);
 					}
+					submesh_indices[n] = remap[index];
 				}
-				delete[] bones;
-				delete[] weights;
-			}
-
-			// indices
-			u32 *index_counts = new u32[submesh_count];
-			u16 **indices = new u16*[submesh_count];
-			Vertex **verts = new Vertex*[submesh_count];
-			for(u32 si=0; si<submesh_count; si++)
-			{
-				fread(&index_counts[si], sizeof(u32), 1, fp);
-				indices[si] = new u16[index_counts[si]];
-				verts[si] = new Vertex[index_counts[si]];
-				u32 *u32_indices = new u32[index_counts[si]];
-				fread(u32_indices, sizeof(u32), index_counts[si], fp);
-				for(u32 n=0; n<index_counts[si]; n++)
+				for(size_t n=0; n<used.size(); n++)
 				{
-					indices[si][n] = n;
-					verts[si][n] = vertices[u32_indices[n]];
+					remap[used[n]] = 0xFFFFFFFF;
 				}
-				delete [] u32_indices;
-			}
+				if(reader.error) break;
 
-		
-			// create mesh
-			model->mesh = gpu_create_mesh();
-			for(u32 si=0; si<submesh_count; si++)
-			{
-				model->mesh->create(verts[si], index_counts[si], indices[si], index_counts[si], si);
-			}
-
-
-			// free data
-			for(u32 si=0; si<submesh_count; si++)
-			{
-				delete [] verts[si];
-				delete [] indices[si];
+				// a submesh using all the vertices in order takes them as they are
+				const Vertex *submesh_vertex_data = vertices.data();
+				if(!in_order || used.size() != vertex_count)
+				{
+					submesh_vertices.resize(used.size());
+					for(size_t n=0; n<used.size(); n++)
+					{
+						submesh_vertices[n] = vertices[used[n]];
+					}
+					submesh_vertex_data = submesh_vertices.data();
+				}
+				model->mesh->create(submesh_vertex_data, (u32)used.size(), submesh_indices.data(), index_count, si);
 			}
-			delete [] vertices;
-			delete [] index_counts;
-			delete [] verts;
-			delete [] indices;
 		}
 
 
 		// Bones
-		u8 bone_count;
-		fread(&bone_count, sizeof(u8), 1, fp);
-		for(int ii=0; ii<bone_count; ii++)
+		u8 bone_count = reader.read_value<u8>();
+		for(int ii=0; ii<bone_count && !reader.error; ii++)
 		{
-			u32 name_count;
-			fread(&name_count, sizeof(u32), 1, fp);
 			char bone_name[256] = {};
-			fread(bone_name, sizeof(char), name_count, fp);
+			reader.read_string(bone_name, sizeof(bone_name), reader.read_value<u32>());
 			
 			Bone bone = {};
 			bone.parent = -1;
 			bone.name = bone_name;
-			mat4 matrix;
-			fread(&matrix, sizeof(mat4), 1, fp);
+			mat4 matrix = reader.read_value<mat4>();
 			bone.inv_matrix = matrix.inversed();
 			bone.matrix = matrix;
-			u8 children_count;
-			fread(&children_count, sizeof(u8), 1, fp);
-			for(int iii=0; iii<children_count; iii++)
+			u8 children_count = reader.read_value<u8>();
+			const u8 *children = reader.read_array(children_count, sizeof(u8));
+			for(int iii=0; iii<children_count && children; iii++)
 			{
-				u8 idx=0;
-				fread(&idx, sizeof(u8), 1, fp);
-				bone.children.push_back(idx);
+				bone.children.push_back(children[iii]);
 			}
 
 			model->bones.push_back(bone);
 		}
 		// set bone parent
-		for(int j=0; j<bone_count; j++)
+		for(int j=0; j<(int)model->bones.size(); j++)
 		{
 			for(int k=0; k<model->bones[j].children.size(); k++)
 			{
 				int child = model->bones[j].children[k];
-				model->bones[child].parent = j;
+				if(child < (int)model->bones.size())
+					model->bones[child].parent = j;
 			}
 		}
 
 
 		// animations
-		int animation_count;
-		fread(&animation_count, sizeof(int), 1, fp);
-		for(int j=0; j<animation_count; j++)
+		int animation_count = reader.read_value<int>();
+		for(int j=0; j<animation_count && !reader.error; j++)
 		{
-			int name_count;
 			char animation_name[256] = {};
-			fread(&name_count, sizeof(int), 1, fp);
-			fread(animation_name, sizeof(char), name_count, fp);
-
-			u32 frame_rate;
-			fread(&frame_rate, sizeof(u32), 1, fp);
+			reader.read_string(animation_name, sizeof(animation_name), (u32)reader.read_value<int>());
 
-			u32 frame_count;
-			fread(&frame_count, sizeof(u32), 1, fp);
+			u32 frame_rate = reader.read_value<u32>();
+			u32 frame_count = reader.read_value<u32>();
 			AnimationClipRef anim_clip = std::make_shared<AnimationClip>();
 			anim_clip->frame_count = frame_count;
 			anim_clip->frame_rate = frame_rate;
-			for(int b=0; b<bone_count; b++)
+			for(int b=0; b<(int)model->bones.size(); b++)
 			{
-				AnimationKey *keys = new AnimationKey();
-				keys->keys.resize(frame_count);
-				fread(keys->keys.data(), sizeof(transform_t), frame_count, fp);
-				anim_clip->animation_keys[model->bones[b].name] = std::unique_ptr<AnimationKey>(keys);
+				const u8 *keys = reader.read_array(frame_count, sizeof(transform_t));
+				if(keys == nullptr) break;
+				AnimationKey *key = new AnimationKey();
+				key->keys.resize(frame_count);
+				memcpy(key->keys.data(), keys, sizeof(transform_t) * frame_count);
+				anim_clip->animation_keys[model->bones[b].name] = std::unique_ptr<AnimationKey>(key);
 			}
 
 			model->animator.animations.emplace(animation_name, anim_clip);
@@ -490,6 +403,12 @@ static ModelRef _load_smd(const char *filename)
 			}
 		}
 
+		if(reader.error)
+		{
+			printf("Error : The smd file is broken.[%s]\n", filepath);
+			break;
+		}
+
 
 		// register resources
 		char res_name[512] = {};
@@ -505,7 +424,7 @@ static ModelRef _load_smd(const char *filename)
 		}
 	}
 
-	fclose(fp);
+	file_map_close(&file);
 	return res_get_model(filename);
 }
 
@@ -526,7 +445,7 @@ static MeshRef _create_mesh_with_par_shapes(par_shapes_mesh *psm)
 	}
 
 	int index_count = psm->ntriangles * 3;
-	u16 *indices = new u16[index_count];
+	u32 *indices = new u32[index_count];
 	for(int i=0; i<index_count; i++)
 	{
 		indices[i] = psm->triangles[i];
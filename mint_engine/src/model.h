@@ -44,6 +44,15 @@ ModelRef load_model(const char *filename);
 
 MeshRef load_mesh(const char *filename);
 
+// CPU side of a mesh file, it can be parsed on any thread and uploaded with create_mesh on the main thread
+struct MeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<u32> indices;
+};
+bool load_mesh_data(const char *filename, MeshData *data);
+MeshRef create_mesh(const char *filename, const MeshData &data);	// uploads and registers it like load_mesh
+
 MeshRef mesh_create_plane(float width, float depth);
 MeshRef create_box_mesh(const vec3 &size);
 MeshRef create_sphere_mesh(float radius, int slice=32, int stack=16);
\ No newline at end of file
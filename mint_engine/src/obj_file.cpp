@@ -0,0 +1,318 @@
+#include "obj_file.h"
+#include <stdio.h>
+#include <math.h>
+#include "file_map.h"
+
+// cursor over the text, the readers never step over the end of a line
+struct ObjReader
+{
+	const char *p;
+	const char *end;
+};
+
+static inline bool is_digit(char c){return (unsigned)(c - '0') < 10;}
+
+static inline void skip_spaces(ObjReader *r)
+{
+	while(r->p < r->end && (*r->p == ' ' || *r->p == '\t')) r->p++;
+}
+
+static inline bool at_line_end(const ObjReader *r)
+{
+	return r->p >= r->end || *r->p == '\n' || *r->p == '\r' || *r->p == '#';
+}
+
+static inline void skip_line(ObjReader *r)
+{
+	while(r->p < r->end && *r->p != '\n') r->p++;
+	if(r->p < r->end) r->p++;
+}
+
+static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// decimal with an optional exponent, up to 19 significant digits are kept and scaled in double
+static bool read_float(ObjReader *r, float *value)
+{
+	skip_spaces(r);
+	const char *p = r->p;
+	const char *end = r->end;
+	bool negative = false;
+	if(p < end && (*p == '-' || *p == '+')){negative = *p == '-'; p++;}
+
+	u64 mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool any = false;
+	for(; p < end && is_digit(*p); p++)
+	{
+		any = true;
+		if(digits < 19)
+		{
+			mantissa = mantissa * 10 + (u64)(*p - '0');
+			if(mantissa) digits++;
+		}
+		else
+		{
+			exponent++;
+		}
+	}
+	if(p < end && *p == '.')
+	{
+		p++;
+		for(; p < end && is_digit(*p); p++)
+		{
+			any = true;
+			if(digits < 19)
+			{
+				mantissa = mantissa * 10 + (u64)(*p - '0');
+				if(mantissa) digits++;
+				exponent--;
+			}
+		}
+	}
+	if(!any) return false;
+
+	if(p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char *q = p + 1;
+		bool negative_exponent = false;
+		if(q < end && (*q == '-' || *q == '+')){negative_exponent = *q == '-'; q++;}
+		if(q < end && is_digit(*q))
+		{
+			int e = 0;
+			for(; q < end && is_digit(*q); q++)
+			{
+				if(e < 10000) e = e * 10 + (*q - '0');
+			}
+			exponent += negative_exponent ? -e : e;
+			p = q;
+		}
+	}
+
+	double v = (double)mantissa;
+	if(mantissa != 0 && exponent != 0)
+	{
+		if(exponent < 0) v = exponent >= -22 ? v / POW10[-exponent] : v * pow(10.0, exponent);
+		else v = exponent <= 22 ? v * POW10[exponent] : v * pow(10.0, exponent);
+	}
+	*value = (float)(negative ? -v : v);
+	r->p = p;
+	return true;
+}
+
+// a 1 based index into count elements, negative indices count back from the last one, 0 is returned on error
+static u32 read_index(ObjReader *r, u32 count)
+{
+	const char *p = r->p;
+	bool negative = false;
+	if(p < r->end && *p == '-'){negative = true; p++;}
+	if(p >= r->end || !is_digit(*p)) return 0;
+
+	u64 value = 0;
+	for(; p < r->end && is_digit(*p); p++)
+	{
+		if(value <= 0xFFFFFFFF) value = value * 10 + (u64)(*p - '0');
+	}
+	if(value == 0 || value > count) return 0;
+	r->p = p;
+	return negative ? count - (u32)value + 1 : (u32)value;
+}
+
+// the v/vt/vn corners already emitted, open addressing in one flat array instead of a node per vertex
+struct ObjCornerTable
+{
+	struct Slot
+	{
+		u32 v, vt, vn;	// 1 based, 0 is none, v 0 is an empty slot
+		u32 index;
+	};
+	std::vector<Slot> slots;
+	u32 count = 0;
+
+	static u32 hash(u32 v, u32 vt, u32 vn)
+	{
+		u32 h = v * 0x9E3779B1u ^ vt * 0x85EBCA77u ^ vn * 0xC2B2AE3Du;
+		return h ^ (h >> 15);
+	}
+
+	// returns the slot of the corner, a new corner gets v == 0 on return and must be filled in
+	Slot* find(u32 v, u32 vt, u32 vn)
+	{
+		if((count + 1) * 2 > slots.size()) grow((count + 1) * 2);
+		u32 mask = (u32)slots.size() - 1;
+		for(u32 i = hash(v, vt, vn) & mask; ; i = (i + 1) & mask)
+		{
+			Slot &s = slots[i];
+			if(s.v == 0 || (s.v == v && s.vt == vt && s.vn == vn)) return &s;
+		}
+	}
+
+	void grow(u32 min_size)
+	{
+		u32 size = 1024;
+		while(size < min_size || size <= slots.size()) size *= 2;
+		std::vector<Slot> old;
+		old.swap(slots);
+		slots.assign(size, Slot{});
+		u32 mask = size - 1;
+		for(const Slot &s : old)
+		{
+			if(s.v == 0) continue;
+			u32 i = hash(s.v, s.vt, s.vn) & mask;
+			while(slots[i].v != 0) i = (i + 1) & mask;
+			slots[i] = s;
+		}
+	}
+};
+
+bool obj_parse(const char *text, size_t size, std::vector<Vertex> *vertices, std::vector<u32> *indices)
+{
+	vertices->clear();
+	indices->clear();
+	std::vector<vec3> positions;
+	std::vector<vec2> uvs;
+	std::vector<vec3> normals;
+	ObjCornerTable corners;
+	bool missing_normals = false;
+
+	ObjReader r = {text, text + size};
+	int line = 0;
+	while(r.p < r.end)
+	{
+		line++;
+		skip_spaces(&r);
+		const char *p = r.p;
+		size_t left = (size_t)(r.end - p);
+		bool ok = true;
+		if(left >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			r.p += 1;
+			vec3 v;
+			ok = read_float(&r, &v.x) && read_float(&r, &v.y) && read_float(&r, &v.z);
+			positions.push_back(v);
+		}
+		else if(left >= 3 && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t'))
+		{
+			r.p += 2;
+			vec2 uv;
+			ok = read_float(&r, &uv.x);
+			if(!read_float(&r, &uv.y)) uv.y = 0.0f;
+			uvs.push_back(uv);
+		}
+		else if(left >= 3 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+		{
+			r.p += 2;
+			vec3 n;
+			ok = read_float(&r, &n.x) && read_float(&r, &n.y) && read_float(&r, &n.z);
+			normals.push_back(n);
+		}
+		else if(left >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			r.p += 1;
+			if(corners.slots.empty())
+			{
+				// the positions usually come before the faces, every one is at least one vertex
+				corners.grow((u32)positions.size() * 2);
+				vertices->reserve(positions.size());
+			}
+			u32 first = 0, prev = 0;
+			int corner_count = 0;
+			for(;;)
+			{
+				skip_spaces(&r);
+				if(at_line_end(&r)) break;
+
+				// v, v/vt, v//vn or v/vt/vn
+				u32 v = read_index(&r, (u32)positions.size());
+				u32 vt = 0, vn = 0;
+				if(v == 0){ok = false; break;}
+				if(r.p < r.end && *r.p == '/')
+				{
+					r.p++;
+					if(r.p < r.end && *r.p != '/')
+					{
+						vt = read_index(&r, (u32)uvs.size());
+						if(vt == 0){ok = false; break;}
+					}
+					if(r.p < r.end && *r.p == '/')
+					{
+						r.p++;
+						vn = read_index(&r, (u32)normals.size());
+						if(vn == 0){ok = false; break;}
+					}
+				}
+				if(!at_line_end(&r) && *r.p != ' ' && *r.p != '\t'){ok = false; break;}
+
+				ObjCornerTable::Slot *slot = corners.find(v, vt, vn);
+				if(slot->v == 0)
+				{
+					*slot = {v, vt, vn, (u32)vertices->size()};
+					corners.count++;
+					Vertex vertex = {};
+					vertex.position = positions[v - 1];
+					if(vt) vertex.uv = uvs[vt - 1];
+					if(vn) vertex.normal = normals[vn - 1];
+					else missing_normals = true;
+					vertex.color = vec4(1, 1, 1, 1);
+					vertices->push_back(vertex);
+				}
+
+				// fan around the first corner
+				u32 index = slot->index;
+				if(corner_count == 0) first = index;
+				else if(corner_count >= 2)
+				{
+					indices->push_back(first);
+					indices->push_back(prev);
+					indices->push_back(index);
+				}
+				prev = index;
+				corner_count++;
+			}
+		}
+
+		if(!ok)
+		{
+			printf("Error : The obj file is broken at line %d.\n", line);
+			vertices->clear();
+			indices->clear();
+			return false;
+		}
+		skip_line(&r);
+	}
+
+	// smooth normals for the corners without one, the area weighted face normals are summed per position
+	if(missing_normals)
+	{
+		std::vector<u32> vertex_positions(vertices->size());
+		for(const ObjCornerTable::Slot &s : corners.slots)
+		{
+			if(s.v) vertex_positions[s.index] = s.v - 1;
+		}
+		std::vector<vec3> sums(positions.size());
+		const Vertex *vs = vertices->data();
+		for(size_t i=0; i+2<indices->size(); i+=3)
+		{
+			u32 a = (*indices)[i], b = (*indices)[i+1], c = (*indices)[i+2];
+			vec3 n = vec3::cross(vs[b].position - vs[a].position, vs[c].position - vs[a].position);
+			sums[vertex_positions[a]] += n;
+			sums[vertex_positions[b]] += n;
+			sums[vertex_positions[c]] += n;
+		}
+		for(const ObjCornerTable::Slot &s : corners.slots)
+		{
+			if(s.v && s.vn == 0) (*vertices)[s.index].normal = sums[s.v - 1].normalized();
+		}
+	}
+	return true;
+}
+
+bool obj_load(const char *filename, std::vector<Vertex> *vertices, std::vector<u32> *indices)
+{
+	FileMap file;
+	if(!file_map_open(filename, &file)) return false;
+	bool ok = obj_parse((const char*)file.data, file.size, vertices, indices);
+	if(!ok) printf("Error : Failed to load the obj file.[%s]\n", filename);
+	file_map_close(&file);
+	return ok;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+#include "gpu.h"
+
+// Wavefront obj reader
+// v, vt, vn and f are read, the other statements are skipped
+// faces of any corner count are fan triangulated, corners with the same v/vt/vn share one vertex
+// corners without a normal get the smoothed normal of the faces around their position
+bool obj_parse(const char *text, size_t size, std::vector<Vertex> *vertices, std::vector<u32> *indices);
+// maps the file and parses it in place
+bool obj_load(const char *filename, std::vector<Vertex> *vertices, std::vector<u32> *indices);
@@ -24,7 +24,7 @@ void particle_init()
 		{vec3(-0.5f, -0.5f, 0.0f), vec3(0,0,1), vec2(0,0), vec4(1,1,1,1)},
 		{vec3(-0.5f, 0.5f, 0.0f), vec3(0,0,1), vec2(0,1), vec4(1,1,1,1)}
 	};
-	u16 indices[6] = {0, 1, 3, 1, 2, 3};
+	u32 indices[6] = {0, 1, 3, 1, 2, 3};
 	ctx.quad_mesh = gpu_create_mesh(v, 4, indices, 6);
 
 	// create default material
@@ -150,7 +150,7 @@ void renderer_init()
 	ctx.sprite_shader = gpu_create_shader(sprite_shader_vs_src, sprite_shader_fs_src);
 
 	Vertex v[4]{};
-	u16 indices[6] = {0, 1, 3, 1, 2, 3};
+	u32 indices[6] = {0, 1, 3, 1, 2, 3};
 	ctx.sprite_mesh = gpu_create_mesh(v, 4, indices, 6);
 	ctx.shape_mesh = gpu_create_mesh(v, 4, indices, 6);
 
@@ -239,7 +239,7 @@ void draw_rect(const rect_t &rect, const vec4 &color)
 void draw_ring(vec2 center, float start_angle, float angle, float inner_radius, float outer_radius, const vec4 &color)
 {
 	static std::vector<Vertex> vertices;
-	static std::vector<u16> indices;
+	static std::vector<u32> indices;
 
 	int segments = 32;
 	float segment_angle = angle / segments;
@@ -260,7 +260,7 @@ void draw_ring(vec2 center, float start_angle, float angle, float inner_radius,
 
 	for(int i=0; i<segments; i++)
 	{
-		u16 base = (u16)(i*2);
+		u32 base = (u32)(i*2);
 		indices.push_back(base+1);
 		indices.push_back(base);
 		indices.push_back(base+3);
@@ -932,7 +932,7 @@ void draw_line(const LineData &data, const vec4 &color)
 	}
 
 	// line mesh indices
-	static std::vector<u16> indices;
+	static std::vector<u32> indices;
 	indices.clear();
 	for(int i=0; i<data.points.size()-1; i++)
 	{
@@ -225,6 +225,13 @@ MaterialRef load_material(const char *filename)
 	return mat;
 }
 
+std::string res_get_model_mesh_name(const char *name)
+{
+	saml::Value m = ctx.root["models"][name];
+	if(m.is_nil()) return name;
+	return m.get_string("mesh");
+}
+
 ModelRef load_model(const char *filename)
 {
 	ModelRef srcmodel = res_get_model(filename);
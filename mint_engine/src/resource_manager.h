@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include "gpu.h"
 #include "model.h"
 #include "font.h"
@@ -14,6 +15,7 @@ MeshRef res_get_mesh(const char *name);
 ShaderRef res_get_shader(const char *name);
 ModelRef res_get_model(const char *name);
 ParticleEmitterRef res_get_particle_emitter(const char *name);
+std::string res_get_model_mesh_name(const char *name);	// the mesh file load_model loads for the model
 
 void res_register(const char *name, TextureRef texture);
 void res_register(const char *name, MeshRef mesh);
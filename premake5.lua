@@ -37,4 +37,146 @@ project "Golf"
     filter "configurations:Release"
         defines{"NDEBUG"}
         optimize "On"
-        architecture "x86_64"
\ No newline at end of file
+        architecture "x86_64"
+
+-- headless ball physics simulator, collision and ball physics only, no window, gpu or audio
+project "PhysicsSim"
+    kind "ConsoleApp"
+    language "C++"
+    targetdir "bin"
+    files {
+        "mint_engine/src/collision.h", "mint_engine/src/collision.cpp",
+        "mint_engine/src/mathf.h", "mint_engine/src/mathf.cpp",
+        "src/ball_physics.h", "src/ball_physics.cpp",
+        "mint_engine/src/mesh.cpp",
+        "mint_engine/src/file_map.h", "mint_engine/src/file_map.cpp",
+        "mint_engine/src/obj_file.h", "mint_engine/src/obj_file.cpp",
+        "src/map_file.h", "src/map_file.cpp",
+        "tools/physics_sim/**.cpp",
+    }
+
+    includedirs{"mint_engine/src", "src"}
+
+    filter {"system:windows"}
+        defines{"_CRT_SECURE_NO_WARNINGS"}
+
+    filter "configurations:Debug"
+        defines{"DEBUG"}
+        symbols "On"
+        architecture "x86_64"
+
+    filter "configurations:Release"
+        defines{"NDEBUG"}
+        optimize "On"
+        architecture "x86_64"
+
+-- broad phase benchmark, quadtree queries without any narrow phase, and the query benchmarks in its other modes
+project "BroadphaseBench"
+    kind "ConsoleApp"
+    language "C++"
+    targetdir "bin"
+    files {
+        "mint_engine/src/collision.h", "mint_engine/src/collision.cpp",
+        "mint_engine/src/mathf.h", "mint_engine/src/mathf.cpp",
+        "mint_engine/src/file_map.h", "mint_engine/src/file_map.cpp",
+        "mint_engine/src/obj_file.h", "mint_engine/src/obj_file.cpp",
+        "src/map_file.h", "src/map_file.cpp",
+        "mint_engine/src/mesh.cpp", "tools/physics_sim/headless_mesh.cpp",
+        "tools/broadphase_bench/**.cpp",
+    }
+
+    includedirs{"mint_engine/src", "src"}
+    defines{"COLLISION_KERNEL_TESTS"}
+
+    filter {"system:windows"}
+        defines{"_CRT_SECURE_NO_WARNINGS"}
+
+    filter "configurations:Debug"
+        defines{"DEBUG"}
+        symbols "On"
+        architecture "x86_64"
+
+    filter "configurations:Release"
+        defines{"NDEBUG"}
+        optimize "On"
+        architecture "x86_64"
+
+-- collision tests, checks the queries against each other and against reference results
+project "CollisionTest"
+    kind "ConsoleApp"
+    language "C++"
+    targetdir "bin"
+    files {
+        "mint_engine/src/collision.h", "mint_engine/src/collision.cpp",
+        "mint_engine/src/mathf.h", "mint_engine/src/mathf.cpp",
+        "mint_engine/src/mesh.cpp", "tools/physics_sim/headless_mesh.cpp",
+        "tools/collision_test/**.cpp",
+    }
+
+    includedirs{"mint_engine/src", "src"}
+
+    filter {"system:windows"}
+        defines{"_CRT_SECURE_NO_WARNINGS"}
+
+    filter "configurations:Debug"
+        defines{"DEBUG"}
+        symbols "On"
+        architecture "x86_64"
+
+    filter "configurations:Release"
+        defines{"NDEBUG"}
+        optimize "On"
+        architecture "x86_64"
+
+-- map file converter, rewrites old map files in the current version
+project "MapConvert"
+    kind "ConsoleApp"
+    language "C++"
+    targetdir "bin"
+    files {
+        "mint_engine/src/mathf.h", "mint_engine/src/mathf.cpp",
+        "src/map_file.h", "src/map_file.cpp",
+        "tools/map_convert/**.cpp",
+    }
+
+    includedirs{"mint_engine/src", "src"}
+
+    filter {"system:windows"}
+        defines{"_CRT_SECURE_NO_WARNINGS"}
+
+    filter "configurations:Debug"
+        defines{"DEBUG"}
+        symbols "On"
+        architecture "x86_64"
+
+    filter "configurations:Release"
+        defines{"NDEBUG"}
+        optimize "On"
+        architecture "x86_64"
+
+-- obj parser benchmark, writes a large terrain obj and times obj_load
+project "ObjBench"
+    kind "ConsoleApp"
+    language "C++"
+    targetdir "bin"
+    files {
+        "mint_engine/src/mathf.h", "mint_engine/src/mathf.cpp",
+        "mint_engine/src/file_map.h", "mint_engine/src/file_map.cpp",
+        "mint_engine/src/obj_file.h", "mint_engine/src/obj_file.cpp",
+        "tools/obj_bench/**.cpp",
+    }
+
+    includedirs{"mint_engine/src", "src"}
+
+    filter {"system:windows"}
+        defines{"_CRT_SECURE_NO_WARNINGS"}
+
+    filter "configurations:Debug"
+        defines{"DEBUG"}
+        symbols "On"
+        architecture "x86_64"
+
+    filter "configurations:Release"
+        defines{"NDEBUG"}
+        optimize "On"
+        architecture "x86_64"
@@ -0,0 +1,130 @@
+#include "ball_physics.h"
+#include "common.h"
+#include "foliage_system.h"
+
+static const float BALL_BOUNCE_SPEED = 4.8f;	// slower hits slide along the surface
+static const float BALL_HIT_SOUND_SPEED = 2.4f;
+static const int BALL_MAX_IMPACTS = 4;	// time of impact iterations per step
+
+void ball_physics_step(BallBody *body, float dt, BallImpact *impact)
+{
+	if(impact) *impact = {};
+
+	bool on_ground = false;
+	bool bounced = false;
+	// chech the ground, foliage colliders are not ground
+	u32 ground_mask = COLLISION_LAYER_BIT(CollisionLayer::Ground) | COLLISION_LAYER_BIT(CollisionLayer::Entity);
+	if(check_sphere(body->position + vec3(0,-0.01f,0), BALL_RADIUS, ground_mask))
+	{
+		on_ground = true;
+	}
+
+	// apply gravity
+	vec3 gravity = vec3(0, -20, 0) * dt;
+	if(!on_ground)
+	{
+		body->velocity += gravity;
+	}
+
+	// move to the time of impact, respond and keep moving for the rest of the step
+	u32 mask = collision_get_layer_mask((u32)CollisionLayer::Ball);
+	float remaining = dt;
+	for(int i=0; i<BALL_MAX_IMPACTS && remaining > 0.0f; i++)
+	{
+		vec3 v = body->velocity * remaining;
+		float length = v.len();
+		if(length <= 0.0f) break;
+
+		RayHit hitinfo;
+		if(!spherecast(ray_t(body->position, v), BALL_RADIUS, &hitinfo, mask))
+		{
+			body->position += v;
+			break;
+		}
+
+		body->position = body->position + v / length * hitinfo.distance + hitinfo.normal * 0.001f;
+		remaining -= remaining * fminf(hitinfo.distance / length, 1.0f);
+
+		float speed = body->velocity.len();
+		float approach_angle = vec3::angle(v / length, hitinfo.normal);
+		if(approach_angle >= 95.0f && speed > BALL_BOUNCE_SPEED)
+		{
+			// Bounce
+			body->velocity = vec3::reflect(body->velocity, hitinfo.normal);
+			body->velocity -= body->velocity * 0.4f;
+			bounced = true;
+		}
+		else
+		{
+			// sliding
+			body->velocity = vec3::project_on_plane(body->velocity, hitinfo.normal);
+		}
+
+		if(impact && impact->collider == nullptr && approach_angle >= 95.0f && speed > BALL_HIT_SOUND_SPEED)
+		{
+			impact->collider = hitinfo.collider;
+			impact->speed = speed;
+		}
+	}
+
+	// damping
+	if(on_ground && !bounced)
+	{
+		body->velocity -= body->velocity * 1.8f * dt;
+	}
+
+	// spinning
+	vec3 axis = vec3::cross(body->velocity.normalized(), vec3(0,1,0));
+	body->rotation = quat::axis_angle(axis, -(body->velocity.len() / (BALL_RADIUS*PI*2.0f) * 360.0f * dt)) * body->rotation;
+}
+
+bool ball_physics_in_hole(const BallBody &body, const vec3 &hole_position)
+{
+	vec3 hole_pos = hole_position;
+	hole_pos.y = body.position.y;
+	return (hole_pos - body.position).len() <= BALL_RADIUS * 2 && body.velocity.len() <= 3;
+}
+
+void ball_physics_init_layers()
+{
+	for(u32 i=0; i<MAX_COLLISION_LAYERS; i++)
+	{
+		bool world = i == (u32)CollisionLayer::Ground || i == (u32)CollisionLayer::Foliage || i == (u32)CollisionLayer::Entity;
+		collision_set_layer_collision((u32)CollisionLayer::Ball, i, world);
+		collision_set_layer_collision((u32)CollisionLayer::Player, i, world);
+	}
+}
+
+bool foliage_collider_desc(FoliageType type, FoliageColliderDesc *desc)
+{
+	if(type == FoliageType::tree1)
+	{
+		desc->type = ColliderType::CAPSULE;
+		desc->center = vec3(0, 5, 0);
+		desc->capsule.dir = vec3(0,1,0);
+		desc->capsule.radius = 0.4f;
+		desc->capsule.height = 10.0f;
+		return true;
+	}
+	return false;
+}
+
+ColliderRef create_foliage_collider(const FoliageColliderDesc &desc, const vec3 &position)
+{
+	ColliderRef collider = nullptr;
+	if(desc.type == ColliderType::BOX)
+	{
+		collider = create_box_collider(desc.center, desc.box.size);
+	}
+	else if(desc.type == ColliderType::CAPSULE)
+	{
+		collider = create_capsule_collider(desc.center, desc.capsule.dir, desc.capsule.radius, desc.capsule.height);
+	}
+
+	if(collider)
+	{
+		collider->set_layer((u32)CollisionLayer::Foliage);
+		collider->set_position(position);
+	}
+	return collider;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "mathf.h"
+#include "collision.h"
+
+#define BALL_RADIUS 0.05f
+
+// the world the ball collides with, the game and the headless simulator build it the same way
+#define GROUND_CELL_SIZE 1.0f	// sample spacing of the terrain heightfield
+#define SEA_SIZE 500.0f
+
+enum class FoliageType;
+struct FoliageColliderDesc;
+
+// the physical state of a ball, the game and the headless simulator step it the same way
+struct BallBody
+{
+	vec3 position;
+	vec3 velocity;
+	quat rotation;
+};
+
+// the first hard hit of a step
+struct BallImpact
+{
+	ColliderRef collider;	// null when nothing was hit hard
+	float speed;
+};
+
+void ball_physics_step(BallBody *body, float dt, BallImpact *impact=nullptr);
+bool ball_physics_in_hole(const BallBody &body, const vec3 &hole_position);
+
+// layer collision matrix, balls and players only collide with the world
+void ball_physics_init_layers();
+// false for the foliage types without a collider
+bool foliage_collider_desc(FoliageType type, FoliageColliderDesc *desc);
+// null when the desc has no collider
+ColliderRef create_foliage_collider(const FoliageColliderDesc &desc, const vec3 &position);
@@ -1,5 +1,7 @@
 #include "common.h"
 #include "resource_manager.h"
+#include "collision.h"
+#include "ball_physics.h"
 
 GolfClub golf_clubs[MAX_GOLF_CLUBS];
 Global global = {};
@@ -11,6 +13,8 @@ void init_common()
 	golf_clubs[(int)ClubType::Iron] = {"Iron", ClubType::Iron, load_texture("data/ui/club_iron.png"), 30.0f, 35.0f, 4};
 	golf_clubs[(int)ClubType::Wedge] = {"Wedge", ClubType::Wedge, load_texture("data/ui/club_wedge.png"), 20.0f, 50.0f, 2};
 	golf_clubs[(int)ClubType::Putter] = {"Putter", ClubType::Putter, load_texture("data/ui/club_putter.png"), 15.0f, 0.0f, 0};
+
+	ball_physics_init_layers();
 }
 
 
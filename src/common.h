@@ -26,6 +26,17 @@ enum class ColliderUserDataType
 	FoliageObject,
 };
 
+enum class CollisionLayer
+{
+	Default,
+	Ground,
+	Foliage,
+	Entity,
+	Ball,
+	Player,
+};
+#define COLLISION_LAYER_BIT(layer) (1u << (u32)(layer))
+
 enum class GameMode
 {
 	Single,
@@ -8,9 +8,9 @@
 #include "../common.h"
 #include "../game.h"
 #include "../map.h"
+#include "../ball_physics.h"
 
 
-static const float BALL_RADIUS = 0.05f;
 static SoundRef holein_sound;
 static SoundRef hit_wood_sound;
 static SoundRef hit_ground_sound;
@@ -32,76 +32,70 @@ void Ball::init()
 void Ball::update()
 {
 	if(active == false) return;
+	CollisionStatsScope stats_scope("ball");
 
-	bool on_ground = false;
-	bool bounced = false;
-	// chech the ground
-	if(spherecast(ray_t(position, vec3(0,-0.01f,0)), BALL_RADIUS, nullptr))
+	step_time += time_dt();
+	int step_count = 0;
+	while(step_time >= step_dt && active)
 	{
-		on_ground = true;
+		if(step_count >= max_steps)
+		{
+			// over the budget, drop the time instead of piling up steps for the next frames
+			step_time = 0.0f;
+			break;
+		}
+		prev_position = position;
+		prev_rotation = rotation;
+		stepped = true;
+		step(step_dt);
+		step_time -= step_dt;
+		step_count++;
 	}
+}
+
+void Ball::draw()
+{
+	if(model == nullptr) return;
 
-	// apply gravity
-	vec3 gravity = vec3(0, -20, 0) * time_dt();
-	if(!on_ground)
+	// the steps don't line up with the frames, the ball is drawn between the last two so it moves smoothly.
+	// it lags up to one step behind the physics. a sunk ball is placed in the hole and drawn there
+	if(active && stepped)
 	{
-		velocity += gravity;
+		float t = clamp01(step_time / step_dt);
+		draw_model(model, mat4(lerp(prev_position, position, t), quat::slerp(prev_rotation, rotation, t), scale));
+		return;
 	}
+	Entity::draw();
+}
 
-	RayHit hitinfo;
-	if(spherecast(ray_t(position, velocity*time_dt()), BALL_RADIUS, &hitinfo))
+void Ball::step(float dt)
+{
+	BallBody body = {position, velocity, rotation};
+	BallImpact impact;
+	ball_physics_step(&body, dt, &impact);
+	position = body.position;
+	velocity = body.velocity;
+	rotation = body.rotation;
+
+	// hit sound
+	if(impact.collider)
 	{
-		position = position + velocity.normalized() * hitinfo.distance + hitinfo.normal * 0.001f;
-		vec3 v = velocity * time_dt();
-		float approach_angle = vec3::angle(v.normalized(), hitinfo.normal);
-		if(approach_angle >= 95.0f && v.len() > 0.08f)
+		u32 type = impact.collider->user_data.type;
+		if(type == (u32)ColliderUserDataType::Entity || type == (u32)ColliderUserDataType::FoliageObject)
 		{
-			// Bounce
-			//vec3 distination = position + v;
-			velocity = vec3::reflect(velocity, hitinfo.normal);
-			velocity -= velocity * 0.4f;
-			bounced = true;
+			hit_wood_sound->emit(0.6f);
 		}
 		else
 		{
-			// sliding
-			velocity = vec3::project_on_plane(velocity, hitinfo.normal);
-		}
-
-		// hit sound
-		if(approach_angle >= 95.0f && v.len() > 0.04f)
-		{
-			u32 type = hitinfo.collider->user_data.type;
-			if(type == (u32)ColliderUserDataType::Entity || type == (u32)ColliderUserDataType::FoliageObject)
-			{
-				hit_wood_sound->emit(0.6f);
-			}
-			else
-			{
-				hit_ground_sound->emit(0.5f);
-			}
+			hit_ground_sound->emit(0.5f);
 		}
 	}
-	else
-	{
-		position += velocity * time_dt();
-	}
-
-	// damping
-	if(on_ground && !bounced)
-	{
-		velocity -= velocity * 1.8f * time_dt();
-	}
-
-	// spinning
-	vec3 axis = vec3::cross(velocity.normalized(), vec3(0,1,0));
-	rotation = quat::axis_angle(axis, -(velocity.len() / (BALL_RADIUS*PI*2.0f) * 360.0f * time_dt())) * rotation;
 
 	// check cupin
-	vec3 hole_pos = map_get_hole_position();
-	hole_pos.y = position.y;
-	if((hole_pos - position).len() <= BALL_RADIUS * 2 && velocity.len() <= 3)
+	if(ball_physics_in_hole(body, map_get_hole_position()))
 	{
+		vec3 hole_pos = map_get_hole_position();
+		hole_pos.y = position.y;
 		// sink the ball
 		position = map_get_hole_position() + vec3(0, -0.2f, 0) + (position - hole_pos).normalized() * 0.05f;
 		holein_sound->play();
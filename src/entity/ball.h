@@ -9,6 +9,7 @@ public:
 	
 	void init() override;
 	void update() override;
+	void draw() override;
 	void set_color(int c); // 0:white 1:red 2:blue
 
 	vec3 velocity = vec3(0,0,0);
@@ -16,6 +17,20 @@ public:
 	int team_id = 0;
 
 	bool active = true;
+
+	// the physics runs in fixed steps decoupled from the frame rate
+	float step_dt = 1.0f / 120.0f;
+	int max_steps = 8;	// steps per frame, the rest of a long frame is dropped
+
+protected:
+	void step(float dt);
+
+	float step_time = 0.0f;	// frame time not simulated yet
+
+	// the state before the last step, drawn blended with the current one by step_time / step_dt
+	vec3 prev_position = vec3(0,0,0);
+	quat prev_rotation = quat::identity();
+	bool stepped = false;
 };
 typedef std::shared_ptr<Ball> BallRef;
 extern std::vector<BallRef> g_balls;
@@ -52,6 +52,15 @@ void Entity::set_rotation(const quat &rotation)
 	}
 }
 
+void Entity::set_transform(const vec3 &position, const quat &rotation)
+{
+	this->position = position;
+	this->rotation = rotation;
+	if(collider) {
+		collider->set_transform(position, rotation);
+	}
+}
+
 
 
 
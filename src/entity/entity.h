@@ -22,6 +22,7 @@ public:
 
 	void set_position(const vec3 &position);
 	void set_rotation(const quat &rotation);
+	void set_transform(const vec3 &position, const quat &rotation);
 
 	u32 id = 0;
 	vec3 position = vec3(0,0,0);
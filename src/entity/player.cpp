@@ -49,6 +49,7 @@ void Player::init()
 
 void Player::update()
 {
+	CollisionStatsScope stats_scope("player");
 	static bool mouse_lock = true;
 	input_mouse_lock(mouse_lock);
 
@@ -120,14 +121,16 @@ void Player::update()
 	const vec3 player_eye = vec3(0, 1.8f, 0);
 	bool last_frame_on_ground = on_ground;
 	RayHit s_hitinfo;
-	on_ground = spherecast(ray_t(position + player_offset, vec3(0, -0.01f, 0)), player_radius, &s_hitinfo);
+	Collision ground;
+	u32 player_mask = collision_get_layer_mask((u32)CollisionLayer::Player);
+	on_ground = overlap_sphere(position + player_offset - vec3(0, 0.01f, 0), player_radius, &ground, 1, player_mask) > 0;
 	//on_ground = true;
 
 	// landed
 	if(!last_frame_on_ground && on_ground)
 	{
 		// cancel gravity velocity
-		vec3 ground_normal = s_hitinfo.normal;
+		vec3 ground_normal = ground.normal;
 		velocity = vec3::project_on_plane(velocity, ground_normal);
 	}
 
@@ -155,7 +158,7 @@ void Player::update()
 	//{
 	//	position += velocity * time_dt();
 	//}
-	position = spherecast_slide(position + player_offset, velocity * time_dt(), player_radius) - player_offset;
+	position = spherecast_slide(position + player_offset, velocity * time_dt(), player_radius, player_mask) - player_offset;
 	rotation = quat(0, camera_angle.y, 0);
 
 	//if(velocity.y < 0.45f)
@@ -234,6 +237,7 @@ void Player::update()
 	{
 		if(shot_time >= 0.0f)
 		{
+			CollisionStatsScope shot_stats_scope("shot preview");
 			if(model->animator.get_current_animation_name() != "shot_ready")
 			{
 				model->play("shot_ready");
@@ -247,7 +251,7 @@ void Player::update()
 			{
 				RayHit ground_hit_info;
 				vec3 ground_normal(0,1,0);
-				if(raycast(ray_t(ball->position, vec3(0,-1,0)), &ground_hit_info))
+				if(raycast(ray_t(ball->position, vec3(0,-1,0)), &ground_hit_info, COLLISION_LAYER_BIT(CollisionLayer::Ground)))
 				{
 					ground_normal = ground_hit_info.normal;
 					dir = vec3::project_on_plane(dir, ground_normal).normalized();
@@ -276,7 +280,7 @@ void Player::update()
 
 					// shot line over the ground
 					RayHit ground_hit;
-					if(raycast(ray_t(pos + vec3(0,1,0), vec3(0,-1,0)), &ground_hit))
+					if(raycast(ray_t(pos + vec3(0,1,0), vec3(0,-1,0)), &ground_hit, COLLISION_LAYER_BIT(CollisionLayer::Ground)))
 					{
 						pos = ground_hit.point + vec3(0, 0.05f, 0);
 					}
@@ -17,6 +17,7 @@ void TreeLog::init()
 	collider = create_capsule_collider(vec3(), vec3(0,0.5f,0), 0.4f, 0.4f);
 	collider->user_data.data = (void*)(u64)id;
 	collider->user_data.type = (u32)ColliderUserDataType::Entity;
+	collider->set_layer((u32)CollisionLayer::Entity);
 
 	if(break_particle == nullptr)
 	{
@@ -32,19 +33,19 @@ void TreeLog::init()
 void TreeLog::update()
 {
 	if(grounded) return;
+	CollisionStatsScope stats_scope("tree log");
 
 	velocity += vec3(0,-10,0) * time_dt();
 	set_position(position + velocity * time_dt());
 
 	RayHit hit_infos[8];
-	int hits = raycast_all(ray_t(position, vec3(0, -0.4f, 0)), hit_infos, 8);
+	int hits = raycast_all(ray_t(position, vec3(0, -0.4f, 0)), hit_infos, 8, COLLISION_LAYER_BIT(CollisionLayer::Ground));
 	for(int i=0; i<hits; i++)
 	{
 		RayHit hit = hit_infos[i];
-		position = hit.point + vec3(0, 0.4f, 0);
 		velocity = vec3();
 		quat rot = rotation * quat::from_to(rotation.up(), vec3::project_on_plane(rotation.up(), hit.normal).normalized());
-		set_rotation(rot);
+		set_transform(hit.point + vec3(0, 0.4f, 0), rot);
 
 		drop_sound->emit();
 		grounded = true;
@@ -3,9 +3,11 @@
 #include <unordered_map>
 #include "mathf.h"
 #include "foliage_system.h"
+#include "map_file.h"
 #include "renderer.h"
 #include "collision.h"
 #include "common.h"
+#include "ball_physics.h"
 #include "entity/entity.h"
 #include "entity/tree.h"
 #include "particle.h"
@@ -114,7 +116,7 @@ struct FoliageQuadTreeSpace
 	std::vector<std::vector<mat4>> transforms;
 	FoliageQuadTreeSpace *parent;
 	FoliageQuadTreeSpace *children[4];
-	bounds_t bounds;
+	aabb_t bounds;
 };
 
 static struct FoliageQuadTree
@@ -166,6 +168,7 @@ static struct FoliageQuadTree
 		space_stack.clear();
 		std::vector<FoliageObject> obj_list;
 		u32 n = get_space_number(bounds);
+		const aabb_t box(bounds);
 
 		if(spaces[n]) {
 			space_stack.push_back(spaces[n]);
@@ -178,7 +181,7 @@ static struct FoliageQuadTree
 		{
 			for(int k=0; k<4; k++)
 			{
-				if(space_stack[i]->children[k] && space_stack[i]->children[k]->bounds.intersects(bounds)) {
+				if(space_stack[i]->children[k] && space_stack[i]->children[k]->bounds.intersects(box)) {
 					space_stack.push_back(space_stack[i]->children[k]);
 				}
 			}
@@ -236,7 +239,7 @@ protected:
 	u32 get_point_elem(float x, float y);
 	u32 get_space_number(const bounds_t &bounds);
 
-	void query_objects_recursive(FoliageQuadTreeSpace *space, const bounds_t &bounds, std::vector<FoliageObject>  *list)
+	void query_objects_recursive(FoliageQuadTreeSpace *space, const aabb_t &bounds, std::vector<FoliageObject>  *list)
 	{
 		if(space == nullptr) return;
 
@@ -287,7 +290,7 @@ void FoliageQuadTree::init(u32 level, const bounds_t &bounds)
 	this->bounds = bounds;
 	this->bounds.extents.y = FLOAT_MAX;
 	width = bounds.extents.x * 2.0f;
-	depth = bounds.extents.y * 2.0f;
+	depth = bounds.extents.z * 2.0f;
 	unit_w = width/(1<<this->level);
 	unit_d = depth/(1<<this->level);
 }
@@ -356,35 +359,22 @@ bool FoliageQuadTree::create_new_space(u32 elem)
 		space->parent = parent_space;
 
 		// set the bounds of the space
-		bounds_t bounds;
+		aabb_t bounds;
 		if(elem > 0)
 		{
+			// left-top, right-top, left-bottom and right-bottom quarter of the parent
 			u32 n = (elem-1)%4;
 			parent_space->children[n] = space;
-			float width = parent_space->bounds.extents.x;
-			float depth = parent_space->bounds.extents.z;
-			bounds.extents = vec3(width*0.5f, FLOAT_MAX, depth*0.5f);
-			if(n == 0)	// left-top
-			{
-				bounds.center = parent_space->bounds.center + vec3(-width*0.5f, 0.0f, -depth*0.5f);
-			}
-			else if(n == 1)	// right-top
-			{
-				bounds.center = parent_space->bounds.center + vec3(width*0.5f, 0.0f, -depth*0.5f);
-			}
-			else if(n == 2)	// left-bottom
-			{
-				bounds.center = parent_space->bounds.center + vec3(-width*0.5f, 0.0f, depth*0.5f);
-			}
-			else if(n == 3)	// right-bottom
-			{
-				bounds.center = parent_space->bounds.center + vec3(width*0.5f, 0.0f, depth*0.5f);
-			}
+			const aabb_t &p = parent_space->bounds;
+			float half_w = (p.max.x - p.min.x) * 0.5f;
+			float half_d = (p.max.z - p.min.z) * 0.5f;
+			bounds.min = vec3(p.min.x + ((n & 1) ? half_w : 0.0f), p.min.y, p.min.z + ((n & 2) ? half_d : 0.0f));
+			bounds.max = vec3(bounds.min.x + half_w, p.max.y, bounds.min.z + half_d);
 		}
 		else
 		{
 			// root space
-			bounds = this->bounds;
+			bounds = aabb_t(this->bounds);
 		}
 		spaces[elem]->bounds = bounds;
 	}
@@ -473,11 +463,7 @@ void foliage_init()
 	strcpy(desc->name, "Tree 1");
 	desc->type = FoliageType::tree1;
 	desc->radius = 2.0f;
-	desc->collider.type = ColliderType::CAPSULE;
-	desc->collider.center = vec3(0, 5, 0);
-	desc->collider.capsule.dir = vec3(0,1,0);
-	desc->collider.capsule.radius = 0.4f;
-	desc->collider.capsule.height = 10.0f;
+	foliage_collider_desc(desc->type, &desc->collider);
 	desc->health = 4.0f;
 	desc->model = load_model("tree");
 
@@ -503,61 +489,42 @@ void foliage_clear()
 	quad_tree.clear();
 }
 
-static u32 hash(float x, float y, float z)
-{
-	return ((u32)x * 92837111) ^ ((u32)y * 689287499) ^ ((u32)z * 283923481);
-}
-
-static float spacial_rand_value(vec3 position)
-{
-	static u32 table[256] = {36, 102, 45, 194, 188, 241, 32, 141, 115, 97, 117, 82, 143, 209, 1, 112, 158, 169,
-		213, 77, 223, 253, 43, 133, 238, 76, 40, 90, 222, 177, 139, 95, 83, 219, 55, 191, 144, 26,
-		203, 37, 232, 221, 0, 17, 100, 59, 138, 11, 204, 134, 38, 71, 207, 84, 114, 235, 210, 23,
-		248, 251, 130, 81, 183, 201, 145, 93, 31, 151, 9, 6, 152, 94, 127, 99, 176, 61, 54, 212,
-		51, 22, 142, 192, 33, 19, 208, 189, 74, 157, 88, 24, 60, 147, 64, 50, 202, 181, 53, 250,
-		215, 186, 228, 150, 105, 30, 69, 140, 35, 200, 224, 107, 27, 57, 185, 225, 92, 155, 226,
-		220, 78, 164, 87, 66, 172, 132, 116, 67, 126, 42, 246, 217, 146, 70, 108, 171, 2, 242,
-		166, 96, 52, 62, 44, 121, 240, 167, 89, 214, 16, 124, 129, 197, 41, 216, 49, 8, 211, 72,
-		120, 46, 170, 48, 122, 174, 153, 104, 68, 5, 125, 101, 230, 205, 187, 179, 58, 182, 21,
-		65, 249, 137, 12, 243, 252, 165, 85, 245, 86, 254, 123, 7, 154, 47, 4, 28, 136, 34, 14,
-		15, 161, 135, 79, 218, 29, 25, 131, 10, 56, 156, 234, 119, 63, 229, 233, 91, 103, 39, 190,
-		118, 3, 198, 113, 75, 244, 163, 80, 178, 160, 173, 227, 106, 196, 149, 148, 175, 255, 236,
-		18, 206, 168, 128, 231, 247, 111, 13, 110, 180, 73, 109, 162, 193, 199, 98, 184, 195, 237, 20, 239, 159};
-	u32 h = hash(position.x, position.y, position.z);
-	return (float)table[h%255] / (float)255;
-}
-
-void foliage_add(FoliageType type, const vec3 &position)
+static void add_object(FoliageType type, const transform_t &transform)
 {
 	// add collider
 	FoliageDesc *desc = &foliage_descs[(int)type];
-	ColliderRef collider = nullptr;
-	if(desc->collider.type == ColliderType::BOX)
-	{
-		collider = create_box_collider(desc->collider.center, desc->collider.box.size);
-	}
-	else if(desc->collider.type == ColliderType::CAPSULE)
-	{
-		collider = create_capsule_collider(desc->collider.center, desc->collider.capsule.dir, desc->collider.capsule.radius, desc->collider.capsule.height);
-	}
-
-	if(collider)
-	{
-		collider->set_position(position);
-	}
+	ColliderRef collider = create_foliage_collider(desc->collider, transform.pos);
 
 	// add the object to the object main list
-	float scale = (spacial_rand_value(position) * 0.5f) + 0.5f;
 	FoliageObject obj = {};
 	obj.type = type;
-	obj.transform = transform_t(position, quat::identity(), vec3(1,scale,1));
+	obj.transform = transform;
 	obj.collider = collider;
 	obj.health = desc->health;
 	quad_tree.add(obj);
 }
 
+void foliage_add(FoliageType type, const vec3 &position)
+{
+	add_object(type, foliage_transform(position));
+}
+
+void foliage_add(const FoliageData &data)
+{
+	for(size_t i=0; i<data.groups.size(); i++)
+	{
+		const FoliageData::Group &group = data.groups[i];
+		const transform_t *transforms = data.transforms.data() + group.first;
+		for(u32 k=0; k<group.count; k++)
+		{
+			add_object(group.type, transforms[k]);
+		}
+	}
+}
+
 void foliage_add(FoliageType type, const vec3 &position, float radius, float spacing_factor)
 {
+	CollisionStatsScope stats_scope("foliage");
 	const int count = 10;
 	for(int i=0; i<count; i++)
 	{
@@ -583,7 +550,7 @@ void foliage_add(FoliageType type, const vec3 &position, float radius, float spa
 		{
 			ray_t ray = ray_t(p + vec3(0,1,0), vec3(0,-2,0));
 			RayHit hitinfo;
-			if(raycast(ray, &hitinfo))
+			if(raycast(ray, &hitinfo, COLLISION_LAYER_BIT(CollisionLayer::Ground)))
 				foliage_add(type, hitinfo.point);
 		}
 	}
@@ -677,65 +644,35 @@ void foliage_draw()
 	quad_tree.draw();
 }
 
-void foliage_save(FILE *fp)
+void foliage_get_data(FoliageData *data)
 {
-	// write foliage type count
 	quad_tree.optimize_memory();
 	const std::vector<FoliageObject> *objects = quad_tree.get_objects();
-	int object_count = (int)objects->size();
 
-	// collect data
-	std::vector<FoliageObject> objlist[(int)FoliageType::max_types];
-	for(int i=0; i<object_count; i++)
+	// count the objects of each type, then place them type by type
+	u32 counts[(int)FoliageType::max_types] = {};
+	for(size_t i=0; i<objects->size(); i++)
 	{
-		FoliageObject o = objects->at(i);
-		objlist[(int)o.type].push_back(o);
+		counts[(int)objects->at(i).type]++;
 	}
 
-
-	fwrite(&object_count, sizeof(int), 1, fp);
+	data->groups.clear();
+	u32 firsts[(int)FoliageType::max_types] = {};
+	u32 first = 0;
 	for(int i=1; i<(int)FoliageType::max_types; i++)
 	{
-		int count = (int)objlist[i].size();
-		if(count == 0) continue;
-
-		// write foliage type
-		int type = i;
-		fwrite(&type, sizeof(int), 1, fp);
-		fwrite(&count, sizeof(int), 1, fp);
-
-		// write foliage object position
-		for(int k=0; k<count; k++)
-		{
-			vec3 pos = objlist[i][k].transform.pos;
-			fwrite(&pos, sizeof(vec3), 1, fp);
-		}
+		if(counts[i] == 0) continue;
+		data->groups.push_back({(FoliageType)i, counts[i], first});
+		firsts[i] = first;
+		first += counts[i];
 	}
-}
 
-void foliage_load(FILE *fp)
-{
-	foliage_clear();
-
-	// read foliage type count
-	int foliage_type_count = 0;
-	fread(&foliage_type_count, sizeof(int), 1, fp);
-
-	for(int i=0; i<foliage_type_count; i++)
+	data->transforms.resize(first);
+	for(size_t i=0; i<objects->size(); i++)
 	{
-		// write foliage type
-		int type = 0;
-		fread(&type, sizeof(int), 1, fp);
-		int count = 0;
-		fread(&count, sizeof(int), 1, fp);
-
-		// write foliage object position
-		for(int k=0; k<count; k++)
-		{
-			vec3 pos;
-			fread(&pos, sizeof(vec3), 1, fp);
-			foliage_add((FoliageType)type, pos);
-		}
+		const FoliageObject &o = objects->at(i);
+		if(o.type == FoliageType::none) continue;
+		data->transforms[firsts[(int)o.type]++] = o.transform;
 	}
 }
 
@@ -41,10 +41,13 @@ struct FoliageDesc
 	FoliageColliderDesc collider;
 };
 
+struct FoliageData;
+
 void foliage_init();
 void foliage_uninit();
 void foliage_clear();
 void foliage_add(FoliageType type, const vec3 &position);
+void foliage_add(const FoliageData &data);
 void foliage_add(FoliageType type, const vec3 &position, float radius, float spacing_factor=1.0f);
 void foliage_add_replace(FoliageType type, const vec3 &position, float radius);
 void foliage_replace(FoliageType type, const vec3 &position);
@@ -52,6 +55,5 @@ void foliage_remove(const vec3 &position, float radius);
 void foliage_take_damage(u32 id, vec3 dir, float damage);
 void foliage_mowing(const vec3 &position, float radius);
 void foliage_draw();
-void foliage_save(FILE *fp);
-void foliage_load(FILE *fp);
+void foliage_get_data(FoliageData *data);
 const FoliageDesc* foliage_get_descs();
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <string>
 #include "app.h"
 #include "input.h"
+#include "collision.h"
 #include "game.h"
 #include "map.h"
 #include "game_ui.h"
@@ -64,6 +65,8 @@ void game_init()
 
 void game_update()
 {
+	collision_stats_new_frame();
+	collision_update();
 	ctx.scene->update();
 	ui_update();
 
@@ -1,11 +1,15 @@
+#include <thread>
 #include "gpu.h"
 #include "model.h"
+#include "resource_manager.h"
 #include "material.h"
 #include "renderer.h"
 #include "foliage_system.h"
 #include "collision.h"
+#include "common.h"
 #include "map.h"
-
+#include "map_file.h"
+#include "ball_physics.h"
 
 static struct map_ctx
 {
@@ -23,6 +27,69 @@ static struct map_ctx
 	MapData data;
 } ctx = {};
 
+// the terrain is 2.5D, so it is collided as a heightfield instead of a triangle soup
+static ColliderRef create_ground_collider(MeshRef mesh)
+{
+	ColliderRef collider = create_heightfield_collider(mesh, GROUND_CELL_SIZE);
+	if(collider == nullptr)
+	{
+		collider = create_mesh_collider(mesh);
+	}
+	if(collider)
+	{
+		collider->set_layer((u32)CollisionLayer::Ground);
+	}
+	return collider;
+}
+
+static ColliderRef create_ground_collider(CollisionHeightfieldRef heightfield, CollisionMeshRef mesh)
+{
+	ColliderRef collider = heightfield ? create_heightfield_collider(heightfield) : create_mesh_collider(mesh);
+	if(collider)
+	{
+		collider->set_layer((u32)CollisionLayer::Ground);
+	}
+	return collider;
+}
+
+// CPU work of map_load, the ground job fills it on a worker thread and map_load commits it on the main thread
+struct MapLoadJobs
+{
+	std::string mesh_name;
+	MeshRef mesh;			// the mesh is loaded already, only its collision is built
+	MeshData mesh_data;		// parsed here otherwise
+	bool mesh_parsed;
+	CollisionMeshRef collision_mesh;
+	CollisionHeightfieldRef heightfield;
+};
+
+static void ground_job(MapLoadJobs *jobs)
+{
+	const Vertex *vertices = nullptr;
+	u32 vertex_count = 0;
+	const u32 *indices = nullptr;
+	u32 index_count = 0;
+	if(jobs->mesh)
+	{
+		vertices = jobs->mesh->get_vertices();
+		vertex_count = jobs->mesh->get_vertex_count();
+		indices = jobs->mesh->get_indices();
+		index_count = jobs->mesh->get_index_count();
+	}
+	else
+	{
+		jobs->mesh_parsed = load_mesh_data(jobs->mesh_name.c_str(), &jobs->mesh_data);
+		if(!jobs->mesh_parsed) return;
+		vertices = jobs->mesh_data.vertices.data();
+		vertex_count = (u32)jobs->mesh_data.vertices.size();
+		indices = jobs->mesh_data.indices.data();
+		index_count = (u32)jobs->mesh_data.indices.size();
+	}
+
+	jobs->collision_mesh = create_collision_mesh(vertices, vertex_count, indices, index_count);
+	jobs->heightfield = create_collision_heightfield(jobs->collision_mesh, GROUND_CELL_SIZE, (int)std::thread::hardware_concurrency());
+}
+
 void map_init()
 {
 	memset(&ctx, 0, sizeof(map_ctx));
@@ -31,11 +98,15 @@ void map_init()
 	// sea model
 	MaterialRef sea_mat = create_material("unlit");
 	sea_mat->color = vec4(0.3f, 0.3f, 0.6f, 1.0f);
-	ctx.sea_model = create_model(mesh_create_plane(500.0f , 500.0f), sea_mat);
+	ctx.sea_model = create_model(mesh_create_plane(SEA_SIZE, SEA_SIZE), sea_mat);
 
 	if(ctx.sea_collider == nullptr)
 	{
 		ctx.sea_collider = create_mesh_collider(ctx.sea_model->mesh);
+		if(ctx.sea_collider)
+		{
+			ctx.sea_collider->set_layer((u32)CollisionLayer::Ground);
+		}
 		//col->set_position(vec3(0,0,0));
 	}
 
@@ -56,100 +127,106 @@ void map_uninit()
 void map_load(const char *filename)
 {
 	//ctx.mesh = mesh_create_plane(50.0f , 50.0f);
-	map_init();
-
 
 	if(filename)
 	{
-		FILE *fp = fopen(filename, "rb");
-		if(!fp) return;
-
-		strcpy(ctx.data.map_name, filename);
-
-		// magic number
-		char magic[4] = {};
-		fread(&magic, 3, 1, fp);
-		if(strcmp(magic, "MAP") != 0) {
+		// the foliage transforms come in with a single read, the old files are converted while loading
+		MapFile file;
+		if(!map_file_load(filename, &file))
+		{
+			map_init();
 			return;	// the file is not map file
 		}
 
-		// read model file name
-		int model_name_count = 0;
-		fread(&model_name_count, sizeof(int), 1, fp);
-		fread(&ctx.data.model_name, sizeof(char), model_name_count, fp);
+		// the ground is loaded on a worker thread while the main thread sets up the rest of the map
+		MapLoadJobs jobs = {};
+		jobs.mesh_name = res_get_model_mesh_name(file.model_name);
+		jobs.mesh = res_get_mesh(jobs.mesh_name.c_str());
+		std::thread ground_thread(ground_job, &jobs);
+
+		map_init();
+		strcpy(ctx.data.map_name, filename);
+		strcpy(ctx.data.model_name, file.model_name);
+		ctx.data.version = (u8)file.version;
+		ctx.hole.pos = file.hole;
+		ctx.data.teeing_area = file.teeing_area;
+
+		ground_thread.join();
 
-		// load map model
+		// commit on the main thread, the gpu and the collision world are not thread safe
+		// load map model, the parsed mesh is registered first so load_model finds it
+		if(jobs.mesh_parsed)
+		{
+			create_mesh(jobs.mesh_name.c_str(), jobs.mesh_data);
+		}
 		ctx.map_model= load_model(ctx.data.model_name);
 		MaterialRef mat = create_material("unlit");
 		mat->color= vec4(0.4f, 0.7f, 0.4f, 1);
 		ctx.map_model->materials.push_back(mat);
-		ctx.collider = create_mesh_collider(ctx.map_model->mesh);
-
-		// load hole
-		fread(&ctx.hole, sizeof(ctx.hole), 1, fp);
-
-		// load teeing area
-		fread(&ctx.data.teeing_area, sizeof(ctx.data.teeing_area), 1, fp);
+		ctx.collider = create_ground_collider(jobs.heightfield, jobs.collision_mesh);
 
 		// load foliage
-		foliage_load(fp);
-		fclose(fp);
+		foliage_clear();
+		foliage_add(file.foliage);
 	}
 	else
 	{
+		map_init();
 		ctx.map_model= load_model("data/models/island.obj");
 		MaterialRef mat = create_material("unlit");
 		mat->color = vec4(0.4f, 0.7f, 0.4f, 1);
 		ctx.map_model->materials.push_back(mat);
-		ctx.collider = create_mesh_collider(ctx.map_model->mesh);
+		ctx.collider = create_ground_collider(ctx.map_model->mesh);
 
 		// foalige data
+		CollisionStatsScope stats_scope("map");
 		foliage_init();
 		const int MAX_GRASS = 3000;
 		bounds_t bounds = ctx.map_model->mesh->get_bounds();
 		vec3 min = bounds.get_min();
 		vec3 max = bounds.get_max();
-		for(int i=0; i<MAX_GRASS; i++)
+		std::vector<ray_t> rays;
+		std::vector<RayHit> hits;
+		int grass_count = 0;
+		while(grass_count < MAX_GRASS)
 		{
-			vec3 pos = vec3(rand_range(min.x,max.x), 0, rand_range(min.z,max.z));
-			RayHit hitinfo;
-			if(raycast(ray_t(pos, vec3(0,-1,0)), &hitinfo))
+			// cast the rays of the remaining grass at once and retry the misses in the next pass
+			int count = MAX_GRASS - grass_count;
+			rays.resize(count);
+			hits.resize(count);
+			for(int i=0; i<count; i++)
 			{
-				foliage_add(FoliageType::grass1, pos);
+				vec3 pos = vec3(rand_range(min.x,max.x), 0, rand_range(min.z,max.z));
+				rays[i] = ray_t(pos, vec3(0,-1,0));
 			}
-			else
+			raycast_batch(rays.data(), hits.data(), count, COLLISION_LAYER_BIT(CollisionLayer::Ground));
+			for(int i=0; i<count; i++)
 			{
-				// retry
-				i--;
+				if(hits[i].collider == nullptr) continue;
+				foliage_add(FoliageType::grass1, rays[i].pos);
+				grass_count++;
 			}
 		}
 	}
+
+	// the terrain, the sea and the foliage do not move, they sleep in the static quadtree from now on
+	collision_build_static();
 }
 
 void map_save(const char *filename)
 {
 	if(!filename) return;
-	FILE *fp;
-	fp = fopen(filename, "wb");
-	if(!fp) return;
-
-	// magic number
-	fwrite("MAP", 3, 1, fp);
 
-	// map model
-	int model_name_count = (int)strlen(ctx.data.model_name);
-	fwrite(&model_name_count, sizeof(int), 1, fp);
-	fwrite(ctx.data.model_name, sizeof(char), model_name_count, fp);
-
-	// hole
-	fwrite(&ctx.hole, sizeof(ctx.hole), 1, fp);
-
-	// teeing area
-	fwrite(&ctx.data.teeing_area, sizeof(ctx.data.teeing_area), 1, fp);
-
-	// foliage
-	foliage_save(fp);
-	fclose(fp);
+	MapFile file = {};
+	file.version = MAP_FILE_VERSION;
+	strcpy(file.model_name, ctx.data.model_name);
+	file.hole = ctx.hole.pos;
+	file.teeing_area = ctx.data.teeing_area;
+	foliage_get_data(&file.foliage);
+	if(map_file_save(filename, file))
+	{
+		ctx.data.version = (u8)file.version;
+	}
 }
 
 void map_set_model(ModelRef model)
@@ -158,7 +235,7 @@ void map_set_model(ModelRef model)
 	free_collider(ctx.collider);
 
 	ctx.map_model = model;
-	ctx.collider = create_mesh_collider(ctx.map_model->mesh);
+	ctx.collider = create_ground_collider(ctx.map_model->mesh);
 }
 
 void map_draw()
@@ -189,7 +266,7 @@ void map_load_model(const char *filename)
 	free_collider(ctx.collider);
 
 	ctx.map_model = model;
-	ctx.collider = create_mesh_collider(ctx.map_model->mesh);
+	ctx.collider = create_ground_collider(ctx.map_model->mesh);
 	strcpy(ctx.data.model_name, filename);
 }
 
@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <string.h>
+#include "map_file.h"
+
+// the foliage transforms and the teeing area are read and written as raw arrays of floats
+static_assert(sizeof(vec3) == sizeof(float) * 3, "vec3 must be 3 floats");
+static_assert(sizeof(transform_t) == sizeof(float) * 10, "transform_t must be pos, rot and scale floats");
+static_assert(sizeof(TeeingArea) == sizeof(float) * 5, "TeeingArea must be 5 floats");
+
+#define MAP_CHUNK_ID(a, b, c, d) ((u32)(a) | ((u32)(b) << 8) | ((u32)(c) << 16) | ((u32)(d) << 24))
+static const u32 MAP_CHUNK_MODEL = MAP_CHUNK_ID('M', 'O', 'D', 'L');
+static const u32 MAP_CHUNK_HOLE = MAP_CHUNK_ID('H', 'O', 'L', 'E');
+static const u32 MAP_CHUNK_TEE = MAP_CHUNK_ID('T', 'E', 'E', ' ');
+static const u32 MAP_CHUNK_FOLIAGE = MAP_CHUNK_ID('F', 'O', 'L', 'I');
+static const u32 MAP_CHUNK_ALIGNMENT = 16;
+
+// the files are little-endian and written as they are in memory
+static bool is_little_endian()
+{
+	u32 one = 1;
+	u8 first = 0;
+	memcpy(&first, &one, 1);
+	return first == 1;
+}
+
+static u32 align_chunk(u32 size)
+{
+	return (size + MAP_CHUNK_ALIGNMENT - 1) & ~(MAP_CHUNK_ALIGNMENT - 1);
+}
+
+static bool valid_foliage_type(int type)
+{
+	return type > (int)FoliageType::none && type < (int)FoliageType::max_types;
+}
+
+static u32 hash(float x, float y, float z)
+{
+	return ((u32)x * 92837111) ^ ((u32)y * 689287499) ^ ((u32)z * 283923481);
+}
+
+static float spacial_rand_value(vec3 position)
+{
+	static u32 table[256] = {36, 102, 45, 194, 188, 241, 32, 141, 115, 97, 117, 82, 143, 209, 1, 112, 158, 169,
+		213, 77, 223, 253, 43, 133, 238, 76, 40, 90, 222, 177, 139, 95, 83, 219, 55, 191, 144, 26,
+		203, 37, 232, 221, 0, 17, 100, 59, 138, 11, 204, 134, 38, 71, 207, 84, 114, 235, 210, 23,
+		248, 251, 130, 81, 183, 201, 145, 93, 31, 151, 9, 6, 152, 94, 127, 99, 176, 61, 54, 212,
+		51, 22, 142, 192, 33, 19, 208, 189, 74, 157, 88, 24, 60, 147, 64, 50, 202, 181, 53, 250,
+		215, 186, 228, 150, 105, 30, 69, 140, 35, 200, 224, 107, 27, 57, 185, 225, 92, 155, 226,
+		220, 78, 164, 87, 66, 172, 132, 116, 67, 126, 42, 246, 217, 146, 70, 108, 171, 2, 242,
+		166, 96, 52, 62, 44, 121, 240, 167, 89, 214, 16, 124, 129, 197, 41, 216, 49, 8, 211, 72,
+		120, 46, 170, 48, 122, 174, 153, 104, 68, 5, 125, 101, 230, 205, 187, 179, 58, 182, 21,
+		65, 249, 137, 12, 243, 252, 165, 85, 245, 86, 254, 123, 7, 154, 47, 4, 28, 136, 34, 14,
+		15, 161, 135, 79, 218, 29, 25, 131, 10, 56, 156, 234, 119, 63, 229, 233, 91, 103, 39, 190,
+		118, 3, 198, 113, 75, 244, 163, 80, 178, 160, 173, 227, 106, 196, 149, 148, 175, 255, 236,
+		18, 206, 168, 128, 231, 247, 111, 13, 110, 180, 73, 109, 162, 193, 199, 98, 184, 195, 237, 20, 239, 159};
+	u32 h = hash(position.x, position.y, position.z);
+	return (float)table[h%255] / (float)255;
+}
+
+transform_t foliage_transform(const vec3 &position)
+{
+	float scale = (spacial_rand_value(position) * 0.5f) + 0.5f;
+	return transform_t(position, quat::identity(), vec3(1,scale,1));
+}
+
+// version 1, the foliage count written by the old foliage_save is the object count, the old loader read it as the type count
+// both are at least the number of groups, so the groups are read until either runs out
+static bool load_version1(FILE *fp, MapFile *file)
+{
+	int model_name_count = 0;
+	if(fread(&model_name_count, sizeof(int), 1, fp) != 1) return false;
+	if(model_name_count <= 0 || model_name_count >= (int)sizeof(file->model_name)) return false;
+	if(fread(file->model_name, sizeof(char), model_name_count, fp) != (size_t)model_name_count) return false;
+	if(fread(&file->hole, sizeof(vec3), 1, fp) != 1) return false;
+	if(fread(&file->teeing_area, sizeof(TeeingArea), 1, fp) != 1) return false;
+
+	int group_count = 0;
+	fread(&group_count, sizeof(int), 1, fp);
+	for(int i=0; i<group_count; i++)
+	{
+		int type = 0;
+		int count = 0;
+		if(fread(&type, sizeof(int), 1, fp) != 1 || fread(&count, sizeof(int), 1, fp) != 1) break;
+		if(!valid_foliage_type(type) || count < 0) return false;
+
+		FoliageData::Group group = {(FoliageType)type, 0, (u32)file->foliage.transforms.size()};
+		for(int k=0; k<count; k++)
+		{
+			vec3 pos;
+			if(fread(&pos, sizeof(vec3), 1, fp) != 1) break;
+			file->foliage.transforms.push_back(foliage_transform(pos));
+			group.count++;
+		}
+		file->foliage.groups.push_back(group);
+	}
+	return true;
+}
+
+static bool load_foliage_chunk(FILE *fp, u32 size, FoliageData *foliage)
+{
+	u32 header[4] = {};
+	if(size < sizeof(header) || fread(header, sizeof(header), 1, fp) != 1) return false;
+	u32 group_count = header[0];
+	u32 transform_count = header[1];
+	u32 transform_offset = header[2];
+	if(transform_offset < sizeof(header) + (u64)group_count * sizeof(u32) * 4) return false;
+	if(transform_offset + (u64)transform_count * sizeof(transform_t) > size) return false;
+
+	foliage->groups.resize(group_count);
+	for(u32 i=0; i<group_count; i++)
+	{
+		u32 group[4] = {};
+		if(fread(group, sizeof(group), 1, fp) != 1) return false;
+		if(!valid_foliage_type((int)group[0]) || (u64)group[2] + group[1] > transform_count) return false;
+		foliage->groups[i] = {(FoliageType)group[0], group[1], group[2]};
+	}
+
+	// all transforms at once
+	if(fseek(fp, transform_offset - (long)(sizeof(header) + group_count * sizeof(u32) * 4), SEEK_CUR) != 0) return false;
+	foliage->transforms.resize(transform_count);
+	return fread(foliage->transforms.data(), sizeof(transform_t), transform_count, fp) == transform_count;
+}
+
+static bool load_version2(FILE *fp, MapFile *file)
+{
+	u32 header[3] = {};
+	if(fread(header, sizeof(header), 1, fp) != 1) return false;
+	file->version = header[0];
+	if(file->version < 2 || file->version > MAP_FILE_VERSION) return false;
+
+	u32 chunk_count = header[1];
+	for(u32 i=0; i<chunk_count; i++)
+	{
+		u32 chunk[4] = {};
+		if(fread(chunk, sizeof(chunk), 1, fp) != 1) return false;
+		u32 id = chunk[0];
+		u32 size = chunk[1];
+		long start = ftell(fp);
+
+		bool ok = true;
+		if(id == MAP_CHUNK_MODEL)
+		{
+			u32 length = 0;
+			ok = size >= sizeof(u32) && fread(&length, sizeof(u32), 1, fp) == 1;
+			ok = ok && length > 0 && length < sizeof(file->model_name) && sizeof(u32) + length <= size;
+			ok = ok && fread(file->model_name, sizeof(char), length, fp) == length;
+		}
+		else if(id == MAP_CHUNK_HOLE)
+		{
+			ok = size >= sizeof(vec3) && fread(&file->hole, sizeof(vec3), 1, fp) == 1;
+		}
+		else if(id == MAP_CHUNK_TEE)
+		{
+			ok = size >= sizeof(TeeingArea) && fread(&file->teeing_area, sizeof(TeeingArea), 1, fp) == 1;
+		}
+		else if(id == MAP_CHUNK_FOLIAGE)
+		{
+			ok = load_foliage_chunk(fp, size, &file->foliage);
+		}
+		if(!ok) return false;
+
+		if(fseek(fp, start + (long)align_chunk(size), SEEK_SET) != 0) return false;
+	}
+	return file->model_name[0] != '\0';
+}
+
+bool map_file_load(const char *filename, MapFile *file)
+{
+	*file = {};
+	if(!filename || !is_little_endian()) return false;
+	FILE *fp = fopen(filename, "rb");
+	if(!fp) return false;
+
+	// magic number
+	char magic[4] = {};
+	bool ok = false;
+	if(fread(magic, sizeof(magic), 1, fp) == 1)
+	{
+		if(memcmp(magic, "GMAP", 4) == 0)
+		{
+			ok = load_version2(fp, file);
+		}
+		else if(memcmp(magic, "MAP", 3) == 0 && fseek(fp, 3, SEEK_SET) == 0)
+		{
+			file->version = 1;
+			ok = load_version1(fp, file);
+		}
+	}
+	fclose(fp);
+
+	if(!ok) *file = {};
+	return ok;
+}
+
+static void write_chunk_header(FILE *fp, u32 id, u32 size)
+{
+	u32 chunk[4] = {id, size, 0, 0};
+	fwrite(chunk, sizeof(chunk), 1, fp);
+}
+
+static void write_chunk_padding(FILE *fp, u32 size)
+{
+	static const u8 zeros[MAP_CHUNK_ALIGNMENT] = {};
+	fwrite(zeros, 1, align_chunk(size) - size, fp);
+}
+
+static void write_chunk(FILE *fp, u32 id, const void *data, u32 size)
+{
+	write_chunk_header(fp, id, size);
+	fwrite(data, 1, size, fp);
+	write_chunk_padding(fp, size);
+}
+
+bool map_file_save(const char *filename, const MapFile &file)
+{
+	if(!filename || !is_little_endian()) return false;
+	const FoliageData &foliage = file.foliage;
+	for(size_t i=0; i<foliage.groups.size(); i++)
+	{
+		const FoliageData::Group &group = foliage.groups[i];
+		if(!valid_foliage_type((int)group.type) || (u64)group.first + group.count > foliage.transforms.size()) return false;
+	}
+
+	FILE *fp = fopen(filename, "wb");
+	if(!fp) return false;
+
+	// header
+	u32 header[3] = {MAP_FILE_VERSION, 4, 0};
+	fwrite("GMAP", 4, 1, fp);
+	fwrite(header, sizeof(header), 1, fp);
+
+	// map model
+	u32 length = (u32)strnlen(file.model_name, sizeof(file.model_name) - 1);
+	write_chunk_header(fp, MAP_CHUNK_MODEL, sizeof(u32) + length);
+	fwrite(&length, sizeof(u32), 1, fp);
+	fwrite(file.model_name, sizeof(char), length, fp);
+	write_chunk_padding(fp, sizeof(u32) + length);
+
+	write_chunk(fp, MAP_CHUNK_HOLE, &file.hole, sizeof(vec3));
+	write_chunk(fp, MAP_CHUNK_TEE, &file.teeing_area, sizeof(TeeingArea));
+
+	// foliage, the groups are compacted so their transforms follow each other
+	u32 group_count = (u32)foliage.groups.size();
+	u32 transform_count = 0;
+	for(u32 i=0; i<group_count; i++)
+	{
+		transform_count += foliage.groups[i].count;
+	}
+	u32 transform_offset = sizeof(u32) * 4 + group_count * sizeof(u32) * 4;
+	u32 size = transform_offset + transform_count * (u32)sizeof(transform_t);
+	u32 foliage_header[4] = {group_count, transform_count, transform_offset, 0};
+	write_chunk_header(fp, MAP_CHUNK_FOLIAGE, size);
+	fwrite(foliage_header, sizeof(foliage_header), 1, fp);
+	u32 first = 0;
+	for(u32 i=0; i<group_count; i++)
+	{
+		u32 group[4] = {(u32)foliage.groups[i].type, foliage.groups[i].count, first, 0};
+		fwrite(group, sizeof(group), 1, fp);
+		first += foliage.groups[i].count;
+	}
+	for(u32 i=0; i<group_count; i++)
+	{
+		fwrite(foliage.transforms.data() + foliage.groups[i].first, sizeof(transform_t), foliage.groups[i].count, fp);
+	}
+	write_chunk_padding(fp, size);
+
+	bool ok = ferror(fp) == 0;
+	fclose(fp);
+	return ok;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include "mathf.h"
+#include "map.h"
+#include "foliage_system.h"
+
+// Map file format, little-endian
+//
+// version 1 (legacy): "MAP", model name, raw hole and teeing area structs, then per type a count and a vec3 per object
+// version 2: a header and chunks, every chunk payload starts on a 16 byte boundary so the arrays can be mapped in place
+//   header   char magic[4] "GMAP", u32 version, u32 chunk count, u32 reserved
+//   chunk    u32 id, u32 payload size, u32 reserved[2], payload padded to 16 bytes
+//   "MODL"   u32 length, model name
+//   "HOLE"   vec3 position
+//   "TEE "   vec3 position, f32 angle, f32 width
+//   "FOLI"   u32 group count, u32 transform count, u32 transform offset, u32 reserved
+//            groups of u32 type, u32 count, u32 first, u32 reserved
+//            transforms of all groups at the offset, vec3 pos, quat rot, vec3 scale each
+// unknown chunks are skipped
+#define MAP_FILE_VERSION 2
+
+// foliage objects of a map, the transforms of a group are contiguous
+struct FoliageData
+{
+	struct Group
+	{
+		FoliageType type;
+		u32 count;
+		u32 first;	// index of the first transform
+	};
+	std::vector<Group> groups;
+	std::vector<transform_t> transforms;
+};
+
+struct MapFile
+{
+	u32 version;
+	char model_name[64];
+	vec3 hole;
+	TeeingArea teeing_area;
+	FoliageData foliage;
+};
+
+// reads both versions, the foliage transforms of a version 2 file are read with a single fread
+bool map_file_load(const char *filename, MapFile *file);
+// always writes MAP_FILE_VERSION
+bool map_file_save(const char *filename, const MapFile &file);
+
+// the transform of a foliage object placed at position, the height is scaled by a hash of the position
+transform_t foliage_transform(const vec3 &position);
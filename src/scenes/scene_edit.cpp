@@ -66,7 +66,7 @@ void EditScene::init()
 	const int count = 32;
 	const float d = 360.0f/ (float)count;
 	Vertex verts[count] = {};
-	u16 indices[count*2];
+	u32 indices[count*2];
 	for(int i=0; i<count; i++)
 	{
 		verts[i].position = quat(0, (float)i * d, 0) * vec3(0,0,1);
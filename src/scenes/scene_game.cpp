@@ -2,6 +2,7 @@
 #include "input.h"
 #include "gpu.h"
 #include "renderer.h"
+#include "collision.h"
 #include "ui.h"
 #include "resource_manager.h"
 #include "scene_game.h"
@@ -190,6 +191,19 @@ void GameScene::update()
 	{
 		game_cupin();
 	}
+
+	// collision statistics
+	static bool show_collision_stats = false;
+	if(input_hit(KEY_F3))
+	{
+		show_collision_stats = !show_collision_stats;
+		collision_stats_enable(show_collision_stats);
+	}
+	collision_stats_window(&show_collision_stats);
+	if(!show_collision_stats && collision_stats_enabled())
+	{
+		collision_stats_enable(false);
+	}
 }
 
 void GameScene::draw()
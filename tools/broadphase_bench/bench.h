@@ -0,0 +1,25 @@
+#pragma once
+// the benchmark modes, each takes the options after its mode name
+#include "mathf.h"
+#include "collision.h"
+
+double now_ms();
+// the triangles of an obj file as the game's collision mesh, null if the file can not be read
+CollisionMeshRef load_collision_mesh(const char *filename);
+// rolling hills over a square grid with about triangle_count triangles
+CollisionMeshRef create_terrain_mesh(int triangle_count);
+
+// raycast_batch against one raycast per ray, downward rays on a terrain
+int bench_batch(int argc, char *argv[]);
+// mesh colliders with the BVH against a pass over every triangle
+int bench_bvh(int argc, char *argv[]);
+// the SIMD ray vs triangle kernel against its scalar loop and the vec3 soup loop before it
+int bench_triangles(int argc, char *argv[]);
+// the ball's per-frame ground probe against the spherecast before the closest hit path
+int bench_probe(int argc, char *argv[]);
+// the SIMD swept sphere filter against the exact test on every triangle, fuzzed and timed
+int bench_spherecast(int argc, char *argv[]);
+// spherecasts over rotated capsules with the cached collider transforms against rebuilding them for every test
+int bench_transforms(int argc, char *argv[]);
+// collision memory of map files, the shared indexed collision meshes against a triangle soup per mesh collider
+int bench_memory(int argc, char *argv[]);
@@ -0,0 +1,101 @@
+// batched raycasts, rays straight down on a terrain like the foliage placement of map_load
+// usage: broadphase_bench batch [-n rays] [-r repeats] [-t threads] [-seed n] [terrain obj]
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+#include "bench.h"
+
+int bench_batch(int argc, char *argv[])
+{
+	int ray_count = 100000;
+	int repeats = 5;
+	int thread_count = (int)std::thread::hardware_concurrency();
+	u32 seed = 1;
+	const char *terrain = "data/models/island.obj";
+	for(int i=0; i<argc; i++)
+	{
+		if(strcmp(argv[i], "-n") == 0 && i+1 < argc){ray_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-r") == 0 && i+1 < argc){repeats = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-t") == 0 && i+1 < argc){thread_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-seed") == 0 && i+1 < argc){seed = (u32)atoi(argv[++i]);}
+		else if(argv[i][0] != '-'){terrain = argv[i];}
+		else
+		{
+			printf("usage: broadphase_bench batch [-n rays] [-r repeats] [-t threads] [-seed n] [terrain obj]\n");
+			return 1;
+		}
+	}
+	if(ray_count <= 0 || repeats <= 0)
+	{
+		printf("usage: broadphase_bench batch [-n rays] [-r repeats] [-t threads] [-seed n] [terrain obj]\n");
+		return 1;
+	}
+	if(thread_count < 2) thread_count = 2;
+
+	collision_init();
+	CollisionMeshRef mesh = load_collision_mesh(terrain);
+	if(mesh == nullptr)
+	{
+		printf("failed to load %s\n", terrain);
+		return 1;
+	}
+	ColliderRef ground = create_mesh_collider(mesh);
+	collision_build_static();
+
+	// from above the terrain to below it, spread over its bounds
+	rand_set_seed(seed);
+	vec3 min = mesh->bounds.get_min();
+	vec3 max = mesh->bounds.get_max();
+	float height = max.y - min.y + 2.0f;
+	std::vector<ray_t> rays(ray_count);
+	for(int i=0; i<ray_count; i++)
+	{
+		rays[i] = ray_t(vec3(rand_range(min.x, max.x), max.y + 1.0f, rand_range(min.z, max.z)), vec3(0, -height, 0));
+	}
+
+	std::vector<RayHit> single(ray_count);
+	std::vector<RayHit> batch(ray_count);
+	std::vector<RayHit> threaded(ray_count);
+	double single_time = 1e30, batch_time = 1e30, threaded_time = 1e30;
+	int single_hits = 0, batch_hits = 0, threaded_hits = 0;
+	for(int r=0; r<repeats; r++)
+	{
+		double start = now_ms();
+		single_hits = 0;
+		for(int i=0; i<ray_count; i++)
+		{
+			single[i] = RayHit();
+			single_hits += raycast(rays[i], &single[i]);
+		}
+		single_time = fmin(single_time, now_ms() - start);
+
+		start = now_ms();
+		batch_hits = raycast_batch(rays.data(), batch.data(), ray_count);
+		batch_time = fmin(batch_time, now_ms() - start);
+
+		start = now_ms();
+		threaded_hits = raycast_batch(rays.data(), threaded.data(), ray_count, 0xFFFFFFFF, thread_count);
+		threaded_time = fmin(threaded_time, now_ms() - start);
+	}
+
+	// the batch has to find the same hits as the single rays
+	int mismatches = 0;
+	for(int i=0; i<ray_count; i++)
+	{
+		bool hit = single[i].collider != nullptr;
+		if(hit != (batch[i].collider != nullptr) || hit != (threaded[i].collider != nullptr)) mismatches++;
+		else if(hit && (fabsf(single[i].distance - batch[i].distance) > 1e-4f || fabsf(single[i].distance - threaded[i].distance) > 1e-4f)) mismatches++;
+	}
+
+	printf("%s: %u triangles, %d rays, best of %d\n", terrain, mesh->triangle_count, ray_count, repeats);
+	printf("raycast     %8.2f ms  %7.1f ns/ray  %d hits\n", single_time, single_time * 1e6 / ray_count, single_hits);
+	printf("batch       %8.2f ms  %7.1f ns/ray  %d hits\n", batch_time, batch_time * 1e6 / ray_count, batch_hits);
+	printf("batch x%-3d  %8.2f ms  %7.1f ns/ray  %d hits\n", thread_count, threaded_time, threaded_time * 1e6 / ray_count, threaded_hits);
+	printf("mismatches %d\n", mismatches);
+
+	free_collider(ground);
+	collision_uninit();
+	return mismatches == 0 ? 0 : 1;
+}
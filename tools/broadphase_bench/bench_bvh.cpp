@@ -0,0 +1,149 @@
+// mesh BVH, rays against a terrain mesh collider and against a pass over every triangle like before the BVH
+// usage: broadphase_bench bvh [-n rays] [-b brute force rays] [-t terrain triangles] [-seed n] [terrain obj]
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "bench.h"
+
+// Moller-Trumbore over all the triangles, the edges are widened like in the kernel
+static bool brute_ray_vs_mesh(const CollisionMesh *mesh, const ray_t &ray, float *distance)
+{
+	float length = ray.dir.len();
+	vec3 dir = ray.dir / length;
+	float nearest = length;
+	bool hit = false;
+	for(u32 i=0; i<mesh->triangle_count; i++)
+	{
+		const vec3 &v0 = mesh->vertices[mesh->indices[i*3]];
+		vec3 e1 = mesh->vertices[mesh->indices[i*3+1]] - v0;
+		vec3 e2 = mesh->vertices[mesh->indices[i*3+2]] - v0;
+		vec3 p = vec3::cross(dir, e2);
+		float det = vec3::dot(e1, p);
+		if(det > -EPSILON && det < EPSILON) continue;
+		float invdet = 1.0f / det;
+		vec3 tv = ray.pos - v0;
+		float u = vec3::dot(tv, p) * invdet;
+		if(u < -1e-5f || u > 1.0f + 1e-5f) continue;
+		vec3 q = vec3::cross(tv, e1);
+		float v = vec3::dot(dir, q) * invdet;
+		if(v < -1e-5f || u + v > 1.0f + 1e-5f) continue;
+		float t = vec3::dot(e2, q) * invdet;
+		if(t > EPSILON && t < nearest)
+		{
+			nearest = t;
+			hit = true;
+		}
+	}
+	*distance = nearest;
+	return hit;
+}
+
+// half the rays come straight down like the ground probes, the others cross the terrain at a low angle like shots
+static void bench_mesh(const char *name, CollisionMeshRef mesh, double build_time, int ray_count, int brute_count)
+{
+	ColliderRef collider = create_mesh_collider(mesh);
+	collider->update_transform();
+	vec3 min = mesh->bounds.get_min();
+	vec3 max = mesh->bounds.get_max();
+	float height = max.y - min.y + 2.0f;
+	std::vector<ray_t> rays(ray_count);
+	for(int i=0; i<ray_count; i++)
+	{
+		vec3 pos(rand_range(min.x, max.x), max.y + 1.0f, rand_range(min.z, max.z));
+		if(i & 1)
+		{
+			vec3 dir = quat::euler(0, rand_range(0.0f, 360.0f), 0) * vec3(0, 0, 1);
+			rays[i] = ray_t(pos, (dir + vec3(0, -0.15f, 0)) * rand_range(5.0f, 60.0f));
+		}
+		else
+		{
+			rays[i] = ray_t(pos, vec3(0, -height, 0));
+		}
+	}
+
+	std::vector<RayHit> hits(ray_count);
+	std::vector<bool> bvh_hit(ray_count);
+	double bvh_time = now_ms();
+	int bvh_hits = 0;
+	for(int i=0; i<ray_count; i++)
+	{
+		bvh_hit[i] = collider->intersect_ray(rays[i], &hits[i]);
+		bvh_hits += bvh_hit[i] ? 1 : 0;
+	}
+	bvh_time = now_ms() - bvh_time;
+
+	if(brute_count > ray_count) brute_count = ray_count;
+	std::vector<float> distances(brute_count);
+	std::vector<bool> brute_hit(brute_count);
+	double brute_time = now_ms();
+	for(int i=0; i<brute_count; i++)
+	{
+		brute_hit[i] = brute_ray_vs_mesh(mesh.get(), rays[i], &distances[i]);
+	}
+	brute_time = now_ms() - brute_time;
+
+	int mismatches = 0;
+	for(int i=0; i<brute_count; i++)
+	{
+		bool hit = bvh_hit[i];
+		if(hit != brute_hit[i] || (hit && fabsf(hits[i].distance - distances[i]) > 1e-3f * fmaxf(1.0f, distances[i]))) mismatches++;
+	}
+
+	double bvh_ns = bvh_time * 1e6 / ray_count;
+	double brute_ns = brute_count > 0 ? brute_time * 1e6 / brute_count : 0.0;
+	printf("%s: %u triangles, %d BVH nodes, built in %.1f ms\n", name, mesh->triangle_count, mesh->node_count, build_time);
+	printf("  bvh          %10.1f ns/ray  %d rays, %d hits\n", bvh_ns, ray_count, bvh_hits);
+	printf("  brute force  %10.1f ns/ray  %d rays, %.0fx slower, %d mismatches\n", brute_ns, brute_count, bvh_ns > 0.0 ? brute_ns / bvh_ns : 0.0, mismatches);
+	free_collider(collider);
+}
+
+int bench_bvh(int argc, char *argv[])
+{
+	int ray_count = 100000;
+	int brute_count = 200;
+	int triangle_count = 1000000;
+	u32 seed = 1;
+	const char *terrain = "data/models/island.obj";
+	for(int i=0; i<argc; i++)
+	{
+		if(strcmp(argv[i], "-n") == 0 && i+1 < argc){ray_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-b") == 0 && i+1 < argc){brute_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-t") == 0 && i+1 < argc){triangle_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-seed") == 0 && i+1 < argc){seed = (u32)atoi(argv[++i]);}
+		else if(argv[i][0] != '-'){terrain = argv[i];}
+		else
+		{
+			printf("usage: broadphase_bench bvh [-n rays] [-b brute force rays] [-t terrain triangles] [-seed n] [terrain obj]\n");
+			return 1;
+		}
+	}
+	if(ray_count <= 0 || brute_count < 0 || triangle_count <= 0)
+	{
+		printf("usage: broadphase_bench bvh [-n rays] [-b brute force rays] [-t terrain triangles] [-seed n] [terrain obj]\n");
+		return 1;
+	}
+
+	collision_init();
+	rand_set_seed(seed);
+
+	double start = now_ms();
+	CollisionMeshRef island = load_collision_mesh(terrain);
+	double island_time = now_ms() - start;
+	if(island == nullptr)
+	{
+		printf("failed to load %s\n", terrain);
+		return 1;
+	}
+	// the small island is cheap enough to check every ray against the brute force pass
+	bench_mesh(terrain, island, island_time, ray_count, island->triangle_count < 10000 ? ray_count : brute_count);
+
+	start = now_ms();
+	CollisionMeshRef synthetic = create_terrain_mesh(triangle_count);
+	double synthetic_time = now_ms() - start;
+	bench_mesh("synthetic terrain", synthetic, synthetic_time, ray_count, brute_count);
+
+	collision_uninit();
+	return 0;
+}
@@ -0,0 +1,120 @@
+// collision memory of map files, the shared indexed collision meshes against the triangle soup every mesh collider
+// copied before, with its own BVH and triangle streams. the maps are loaded one after the other and stay loaded,
+// the ground models are cached by file name like the game's resources, so maps on the same model share one Mesh
+// usage: broadphase_bench memory [map files], map1 map2 map3 by default
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "bench.h"
+#include "gpu.h"
+#include "obj_file.h"
+#include "map_file.h"
+#include "ball_physics.h"
+#define SAML_IMPLEMENTATION	// impl.cpp is not linked, it pulls in miniaudio
+#include "external/saml.hpp"
+
+// a mesh collider before the shared meshes, the index expanded to a vec3 per corner and the same BVH and streams
+static size_t soup_memory(const CollisionMesh *mesh)
+{
+	size_t indexed = sizeof(vec3) * mesh->vertex_count + sizeof(u32) * mesh->triangle_count * 3;
+	return collision_mesh_memory(mesh) - indexed + sizeof(vec3) * mesh->triangle_count * 3;
+}
+
+// the collision meshes the colliders hold, each one counted once
+static size_t shared_memory(const std::vector<ColliderRef> &colliders)
+{
+	std::unordered_set<const CollisionMesh*> meshes;
+	size_t size = 0;
+	for(const ColliderRef &c : colliders)
+	{
+		if(c->mesh && meshes.insert(c->mesh.get()).second) size += collision_mesh_memory(c->mesh.get());
+	}
+	return size;
+}
+
+static size_t heightfield_memory(const CollisionHeightfield *hf)
+{
+	return sizeof(CollisionHeightfield) + sizeof(float) * (hf->width + 1) * (hf->depth + 1);
+}
+
+int bench_memory(int argc, char *argv[])
+{
+	std::vector<const char*> maps;
+	for(int i=0; i<argc; i++)
+	{
+		if(argv[i][0] == '-')
+		{
+			printf("usage: broadphase_bench memory [map files]\n");
+			return 1;
+		}
+		maps.push_back(argv[i]);
+	}
+	if(maps.empty()) maps = {"map1", "map2", "map3"};
+
+	collision_init();
+	saml::Value res = saml::parse_file("data/res.txt");
+	std::unordered_map<std::string, MeshRef> meshes;
+	std::vector<ColliderRef> colliders;
+
+	// the sea is created once by map_init
+	float s = SEA_SIZE * 0.5f;
+	vec3 sea[6] = {vec3(-s,0,-s), vec3(-s,0,s), vec3(s,0,-s), vec3(s,0,-s), vec3(-s,0,s), vec3(s,0,s)};
+	colliders.push_back(create_mesh_collider(sea, 6));
+	size_t before_total = soup_memory(colliders[0]->mesh.get());
+	size_t after_total = shared_memory(colliders);
+	printf("sea            soup %8.1f KB  shared %8.1f KB\n", before_total / 1024.0, after_total / 1024.0);
+
+	for(const char *map : maps)
+	{
+		MapFile file;
+		if(!map_file_load(map, &file))
+		{
+			printf("failed to load %s\n", map);
+			return 1;
+		}
+		std::string mesh_name = res["models"][file.model_name].get_string("mesh");
+		if(mesh_name.empty()) mesh_name = file.model_name;
+
+		MeshRef &mesh = meshes[mesh_name];
+		if(mesh == nullptr)
+		{
+			std::vector<Vertex> vertices;
+			std::vector<u32> indices;
+			if(!obj_load(mesh_name.c_str(), &vertices, &indices))
+			{
+				printf("failed to load %s\n", mesh_name.c_str());
+				return 1;
+			}
+			mesh = std::make_shared<Mesh>(vertices.data(), (u32)vertices.size(), indices.data(), (u32)indices.size());
+		}
+
+		// the ground as a mesh collider, the fallback of the game when it is not a heightfield
+		ColliderRef ground = create_mesh_collider(mesh);
+		if(ground == nullptr)
+		{
+			printf("failed to create the collision of %s\n", mesh_name.c_str());
+			return 1;
+		}
+		colliders.push_back(ground);
+		size_t before = soup_memory(ground->mesh.get());
+		size_t after = shared_memory(colliders) - after_total;
+		before_total += before;
+		after_total += after;
+
+		ColliderRef heightfield = create_heightfield_collider(mesh, GROUND_CELL_SIZE);
+		size_t heightfield_size = heightfield ? heightfield_memory(heightfield->heightfield.get()) : 0;
+		printf("%-14s soup %8.1f KB  shared %8.1f KB  %s, %u render vertices, %u triangles, heightfield %.1f KB\n", map, before / 1024.0, after / 1024.0,
+			mesh_name.c_str(), mesh->get_vertex_count(), ground->mesh->triangle_count, heightfield_size / 1024.0);
+		if(heightfield) free_collider(heightfield);
+	}
+	printf("all loaded     soup %8.1f KB  shared %8.1f KB\n", before_total / 1024.0, after_total / 1024.0);
+
+	for(ColliderRef &c : colliders) free_collider(c);
+	colliders.clear();
+	collision_uninit();
+	return 0;
+}
@@ -0,0 +1,174 @@
+// the ball's ground probe, the spherecast ball_physics_step runs every frame, against the spherecast before the
+// closest hit path: a narrow phase on every broad phase candidate into 64 hits and a swap sort to return the first
+// usage: broadphase_bench probe [-n probes] [-c colliders] [-seed n] [terrain obj]
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "bench.h"
+#include "ball_physics.h"
+
+// spherecast and spherecast_all before the closest hit path
+static int old_spherecast(const ray_t &ray, float radius, RayHit *rayhit)
+{
+	const int RAYHIT_COUNT = 64;
+	RayHit rayhits[RAYHIT_COUNT] = {};
+	ColliderRef colliders[RAYHIT_COUNT];
+	bounds_t bounds(ray.pos, vec3(radius, radius, radius));
+	bounds.encapsulate(bounds_t(ray.pos + ray.dir, vec3(radius, radius, radius)));
+	int count = query_colliders(bounds, colliders, RAYHIT_COUNT);
+
+	int hit_count = 0;
+	for(int i=0; i<count; i++)
+	{
+		RayHit hitinfo = {};
+		hitinfo.distance = ray.dir.len();
+		if(colliders[i]->intersect_spherecast(ray, radius, &hitinfo))
+		{
+			hitinfo.collider = colliders[i];
+			rayhits[hit_count++] = hitinfo;
+		}
+	}
+
+	for(int i=0; i<hit_count; i++){
+		for(int j=i+1; j<hit_count; j++){
+			if(rayhits[i].distance > rayhits[j].distance)
+			{
+				RayHit tmp = rayhits[i];
+				rayhits[i] = rayhits[j];
+				rayhits[j] = tmp;
+			}
+		}
+	}
+
+	if(hit_count == 0) return 0;
+	*rayhit = rayhits[0];
+	return 1;
+}
+
+// times the two spherecasts over the probes, the hits have to agree
+static void run_probes(const char *name, const std::vector<ray_t> &probes)
+{
+	int probe_count = (int)probes.size();
+	std::vector<RayHit> before(probe_count), after(probe_count);
+	std::vector<bool> before_hit(probe_count), after_hit(probe_count);
+	double before_time = now_ms();
+	for(int i=0; i<probe_count; i++)
+	{
+		before_hit[i] = old_spherecast(probes[i], BALL_RADIUS, &before[i]) != 0;
+	}
+	before_time = now_ms() - before_time;
+
+	double after_time = now_ms();
+	for(int i=0; i<probe_count; i++)
+	{
+		after_hit[i] = spherecast(probes[i], BALL_RADIUS, &after[i]) != 0;
+	}
+	after_time = now_ms() - after_time;
+
+	// the closest hit path casts the shortened segment, the sweeps against capsules and triangles solve their quadratics
+	// from the start of the cast, so the rounding moves the hits by up to a few 1e-4 of its length
+	// the old path stops at 64 broad phase candidates, long casts over many colliders can lose their first hit past them
+	int hits = 0, mismatches = 0, nearer = 0;
+	for(int i=0; i<probe_count; i++)
+	{
+		if(after_hit[i]) hits++;
+		float tolerance = 1e-3f * fmaxf(0.1f, probes[i].dir.len());
+		if(after_hit[i] && (!before_hit[i] || after[i].distance < before[i].distance - tolerance)) nearer++;
+		else if(before_hit[i] != after_hit[i] || (after_hit[i] && fabsf(before[i].distance - after[i].distance) > tolerance)) mismatches++;
+	}
+
+	printf("  %s: %d probes, %d hit\n", name, probe_count, hits);
+	printf("    spherecast_all and sort  %8.1f ns/probe\n", before_time * 1e6 / probe_count);
+	printf("    closest hit              %8.1f ns/probe  %.2fx the time, %d mismatches, %d nearer hits the old path lost\n", after_time * 1e6 / probe_count, after_time / before_time, mismatches, nearer);
+}
+
+int bench_probe(int argc, char *argv[])
+{
+	int probe_count = 200000;
+	int collider_count = 2000;
+	u32 seed = 1;
+	const char *terrain = "data/models/grounds/island2.obj";
+	for(int i=0; i<argc; i++)
+	{
+		if(strcmp(argv[i], "-n") == 0 && i+1 < argc){probe_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-c") == 0 && i+1 < argc){collider_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-seed") == 0 && i+1 < argc){seed = (u32)atoi(argv[++i]);}
+		else if(argv[i][0] != '-'){terrain = argv[i];}
+		else
+		{
+			printf("usage: broadphase_bench probe [-n probes] [-c colliders] [-seed n] [terrain obj]\n");
+			return 1;
+		}
+	}
+	if(probe_count <= 0 || collider_count < 0)
+	{
+		printf("usage: broadphase_bench probe [-n probes] [-c colliders] [-seed n] [terrain obj]\n");
+		return 1;
+	}
+
+	collision_init();
+	rand_set_seed(seed);
+	CollisionMeshRef mesh = load_collision_mesh(terrain);
+	if(mesh == nullptr)
+	{
+		printf("failed to load %s\n", terrain);
+		return 1;
+	}
+	std::vector<ColliderRef> colliders;
+	colliders.push_back(create_mesh_collider(mesh));
+	colliders.back()->update_transform();
+
+	// trees, rocks and crates standing on the ground
+	vec3 min = mesh->bounds.get_min();
+	vec3 max = mesh->bounds.get_max();
+	float height = max.y - min.y + 2.0f;
+	auto ground_height = [&](float x, float z, float *y)
+	{
+		RayHit hit = {};
+		if(!colliders[0]->intersect_ray(ray_t(vec3(x, max.y + 1.0f, z), vec3(0, -height, 0)), &hit)) return false;
+		*y = hit.point.y;
+		return true;
+	};
+	for(int i=0; i<collider_count; i++)
+	{
+		float x = rand_range(min.x, max.x), z = rand_range(min.z, max.z), y;
+		if(!ground_height(x, z, &y)) continue;
+		ColliderRef c;
+		int type = rand_range(0, 3);
+		if(type == 0) c = create_capsule_collider(vec3(0,2,0), vec3(0,1,0), rand_range(0.2f, 0.5f), 4.0f);
+		else if(type == 1) c = create_sphere_collider(rand_range(0.2f, 1.0f), vec3());
+		else c = create_box_collider(vec3(), vec3(rand_range(0.5f, 2.0f), rand_range(0.5f, 2.0f), rand_range(0.5f, 2.0f)));
+		c->set_transform(vec3(x, y, z), quat::euler(0, rand_range(0.0f, 360.0f), 0));
+		colliders.push_back(c);
+	}
+	collision_build_static();
+
+	// one frame of a ball rolling on the ground or landing on it at 60 fps, and whole seconds of flight for comparison,
+	// the long casts overlap many colliders and the closest hit path skips the ones behind its first hit
+	std::vector<ray_t> frames, flights;
+	while((int)frames.size() < probe_count)
+	{
+		float x = rand_range(min.x, max.x), z = rand_range(min.z, max.z), y;
+		if(!ground_height(x, z, &y)) continue;
+		vec3 velocity = quat::euler(0, rand_range(0.0f, 360.0f), 0) * vec3(0, 0, rand_range(0.0f, 20.0f));
+		if(frames.size() & 1)
+		{
+			y += rand_range(0.1f, 3.0f);
+			velocity.y = -rand_range(0.0f, 15.0f);
+		}
+		velocity.y -= 20.0f / 60.0f;
+		vec3 pos(x, y + BALL_RADIUS + 0.001f, z);
+		frames.push_back(ray_t(pos, velocity / 60.0f));
+		flights.push_back(ray_t(pos + vec3(0, 1.0f, 0), vec3(velocity.x, -2.0f, velocity.z)));
+	}
+
+	printf("%s: %u triangles, %d colliders\n", terrain, mesh->triangle_count, (int)colliders.size());
+	run_probes("frame probes", frames);
+	run_probes("1 s flights", flights);
+
+	for(ColliderRef &c : colliders) free_collider(c);
+	collision_uninit();
+	return 0;
+}
@@ -0,0 +1,229 @@
+// swept sphere vs triangle kernel, the SIMD filter in front of spherecast_to_triangle against the exact test on every
+// triangle. random sweeps over random triangles check that the filter never leaves out the nearest hit, then the
+// triangles per second of both are timed on a ground mesh and a synthetic terrain
+// usage: broadphase_bench spherecast [-n sweeps] [-f fuzz sweeps] [-t terrain triangles] [-seed n] [terrain obj]
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "bench.h"
+
+static vec3 rand_vec3(float min, float max)
+{
+	return vec3(rand_range(min, max), rand_range(min, max), rand_range(min, max));
+}
+
+static vec3 rand_direction()
+{
+	vec3 v;
+	do{ v = rand_vec3(-1.0f, 1.0f); } while(v.sqrlen() < 0.01f || v.sqrlen() > 1.0f);
+	return v.normalized();
+}
+
+// a unit vector at a right angle to n
+static vec3 perpendicular(const vec3 &n)
+{
+	vec3 a = fabsf(n.x) < 0.6f ? vec3(1, 0, 0) : vec3(0, 1, 0);
+	return vec3::cross(n, a).normalized();
+}
+
+// the sweeps of one kind, the filter and the exact test on every triangle have to find the same nearest hit
+struct FuzzCase
+{
+	const char *name;
+	int sweeps = 0;
+	int hits = 0;
+	int mismatches = 0;
+};
+
+static void fuzz_sweep(FuzzCase *fuzz, const CollisionMesh *mesh, const vec3 &pos, const vec3 &dir, float radius)
+{
+	float simd_distance = 0.0f, scalar_distance = 0.0f;
+	u32 simd_triangle = 0, scalar_triangle = 0;
+	bool simd_hit = collision_spherecast_vs_triangles(mesh, pos, dir, radius, true, &simd_distance, &simd_triangle);
+	bool scalar_hit = collision_spherecast_vs_triangles(mesh, pos, dir, radius, false, &scalar_distance, &scalar_triangle);
+	fuzz->sweeps++;
+	if(scalar_hit) fuzz->hits++;
+	if(simd_hit != scalar_hit || (scalar_hit && simd_distance != scalar_distance))
+	{
+		if(fuzz->mismatches < 4)
+		{
+			printf("    %s mismatch: pos (%.9g, %.9g, %.9g) dir (%.9g, %.9g, %.9g) radius %.9g, SIMD %s %.9g, scalar %s %.9g\n", fuzz->name,
+				pos.x, pos.y, pos.z, dir.x, dir.y, dir.z, radius, simd_hit ? "hit" : "miss", simd_distance, scalar_hit ? "hit" : "miss", scalar_distance);
+		}
+		fuzz->mismatches++;
+	}
+}
+
+// random triangles of every shape and size around the origin, including slivers and almost degenerate ones
+static CollisionMeshRef create_random_triangles(int triangle_count, float size)
+{
+	std::vector<vec3> vertices;
+	std::vector<u32> indices;
+	for(int i=0; i<triangle_count; i++)
+	{
+		vec3 center = rand_vec3(-size, size);
+		float scale = size * rand_range(0.02f, 0.5f);
+		vec3 a = center + rand_vec3(-scale, scale);
+		vec3 b = center + rand_vec3(-scale, scale);
+		vec3 c = center + rand_vec3(-scale, scale);
+		if(rand_range(0, 8) == 0) c = a + (b - a) * rand_range(0.0f, 1.0f) + rand_vec3(-1e-3f, 1e-3f) * scale;
+		vertices.push_back(a);
+		vertices.push_back(b);
+		vertices.push_back(c);
+		for(int k=0; k<3; k++) indices.push_back((u32)(i * 3 + k));
+	}
+	return create_collision_mesh(vertices.data(), (u32)vertices.size(), indices.data(), (u32)indices.size());
+}
+
+// returns false when the filter missed a hit of the exact test
+static bool fuzz_kernel(int sweep_count)
+{
+	const float SIZE = 4.0f;
+	FuzzCase random = {"random"}, parallel = {"near parallel"}, touching = {"touching"}, far = {"far start"};
+	for(int m=0; m<sweep_count/256+1; m++)
+	{
+		CollisionMeshRef mesh = create_random_triangles(rand_range(1, 96), SIZE);
+		const vec3 *vertices = mesh->vertices;
+		const u32 *indices = mesh->indices;
+		for(int q=0; q<256; q++)
+		{
+			// radii from a hair to larger than the triangles
+			float radius = powf(10.0f, rand_range(-3.0f, 0.5f));
+			u32 tri = (u32)rand_range(0, (int)mesh->triangle_count);
+			vec3 a = vertices[indices[tri*3]], b = vertices[indices[tri*3+1]], c = vertices[indices[tri*3+2]];
+			vec3 n = vec3::cross(b - a, c - a);
+			if(n.sqrlen() < 1e-12f) n = vec3(0, 1, 0);
+			n = n.normalized();
+			float u = rand_range(-0.2f, 1.2f), v = rand_range(-0.2f, 1.2f);
+			vec3 on = a + (b - a) * u + (c - a) * v;
+
+			switch(q & 3)
+			{
+			case 0:
+				fuzz_sweep(&random, mesh.get(), rand_vec3(-SIZE*2, SIZE*2), rand_direction() * rand_range(0.01f, SIZE*4), radius);
+				break;
+			case 1:
+			{
+				// within a hair of the sphere touching the plane, moving along it
+				float tilt = rand_range(-1e-3f, 1e-3f);
+				vec3 t = perpendicular(n);
+				vec3 start = on + n * (radius * (1.0f + rand_range(-1e-3f, 1e-3f))) - t * SIZE;
+				fuzz_sweep(&parallel, mesh.get(), start, (t + n * tilt).normalized() * SIZE * 2, radius);
+				break;
+			}
+			case 2:
+			{
+				// starting at or a hair off the surface, moving into it
+				vec3 start = on + n * (radius * (1.0f + rand_range(-1e-4f, 1e-4f)));
+				vec3 d = (rand_direction() - n * 1.5f).normalized();
+				fuzz_sweep(&touching, mesh.get(), start, d * rand_range(0.001f, SIZE), radius);
+				break;
+			}
+			default:
+			{
+				// long sweeps from far away, the rounding of the exact test grows with the distance
+				vec3 start = on + rand_direction() * rand_range(50.0f, 2000.0f);
+				vec3 d = on - start;
+				fuzz_sweep(&far, mesh.get(), start, d * rand_range(0.9f, 1.5f), radius);
+				break;
+			}
+			}
+		}
+	}
+
+	printf("fuzz: SIMD width %d, the filter against the exact test on every triangle\n", collision_simd_width());
+	int mismatches = 0;
+	for(const FuzzCase *fuzz : {&random, &parallel, &touching, &far})
+	{
+		printf("  %-14s %7d sweeps, %7d hits, %d mismatches\n", fuzz->name, fuzz->sweeps, fuzz->hits, fuzz->mismatches);
+		mismatches += fuzz->mismatches;
+	}
+	return mismatches == 0;
+}
+
+static void bench_kernel(const char *name, CollisionMeshRef mesh, int sweep_count)
+{
+	// ball sized spheres across the whole mesh at a low angle, most of them end on it
+	vec3 min = mesh->bounds.get_min();
+	vec3 max = mesh->bounds.get_max();
+	std::vector<ray_t> sweeps(sweep_count);
+	std::vector<float> radii(sweep_count);
+	for(int i=0; i<sweep_count; i++)
+	{
+		vec3 from(rand_range(min.x, max.x), max.y + 1.0f, rand_range(min.z, max.z));
+		vec3 to(rand_range(min.x, max.x), min.y, rand_range(min.z, max.z));
+		sweeps[i] = ray_t(from, to - from);
+		radii[i] = rand_range(0.05f, 0.5f);
+	}
+
+	std::vector<float> scalar_distances(sweep_count);
+	std::vector<float> simd_distances(sweep_count);
+	int scalar_hits = 0, simd_hits = 0;
+
+	double scalar_time = now_ms();
+	for(int i=0; i<sweep_count; i++)
+	{
+		u32 triangle = 0;
+		scalar_hits += collision_spherecast_vs_triangles(mesh.get(), sweeps[i].pos, sweeps[i].dir, radii[i], false, &scalar_distances[i], &triangle) ? 1 : 0;
+	}
+	scalar_time = now_ms() - scalar_time;
+
+	double simd_time = now_ms();
+	for(int i=0; i<sweep_count; i++)
+	{
+		u32 triangle = 0;
+		simd_hits += collision_spherecast_vs_triangles(mesh.get(), sweeps[i].pos, sweeps[i].dir, radii[i], true, &simd_distances[i], &triangle) ? 1 : 0;
+	}
+	simd_time = now_ms() - simd_time;
+
+	double tests = (double)sweep_count * mesh->triangle_count;
+	printf("%s: %u triangles, %d sweeps\n", name, mesh->triangle_count, sweep_count);
+	printf("  exact test   %8.1f Mtri/s  %d hits\n", tests / (scalar_time * 1e3), scalar_hits);
+	printf("  SIMD filter  %8.1f Mtri/s  %d hits, %.1fx the exact test on every triangle\n", tests / (simd_time * 1e3), simd_hits, scalar_time / simd_time);
+}
+
+int bench_spherecast(int argc, char *argv[])
+{
+	int sweep_count = 200;
+	int fuzz_count = 1000000;
+	int triangle_count = 65536;
+	u32 seed = 1;
+	const char *terrain = "data/models/grounds/island2.obj";
+	for(int i=0; i<argc; i++)
+	{
+		if(strcmp(argv[i], "-n") == 0 && i+1 < argc){sweep_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-f") == 0 && i+1 < argc){fuzz_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-t") == 0 && i+1 < argc){triangle_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-seed") == 0 && i+1 < argc){seed = (u32)atoi(argv[++i]);}
+		else if(argv[i][0] != '-'){terrain = argv[i];}
+		else
+		{
+			printf("usage: broadphase_bench spherecast [-n sweeps] [-f fuzz sweeps] [-t terrain triangles] [-seed n] [terrain obj]\n");
+			return 1;
+		}
+	}
+	if(sweep_count <= 0 || fuzz_count < 0 || triangle_count <= 0)
+	{
+		printf("usage: broadphase_bench spherecast [-n sweeps] [-f fuzz sweeps] [-t terrain triangles] [-seed n] [terrain obj]\n");
+		return 1;
+	}
+
+	collision_init();
+	rand_set_seed(seed);
+	bool passed = fuzz_kernel(fuzz_count);
+
+	CollisionMeshRef ground = load_collision_mesh(terrain);
+	if(ground == nullptr)
+	{
+		printf("failed to load %s\n", terrain);
+		return 1;
+	}
+	// the small ground gets more sweeps so the times are long enough to read
+	bench_kernel(terrain, ground, sweep_count * 100);
+	bench_kernel("synthetic terrain", create_terrain_mesh(triangle_count), sweep_count);
+
+	collision_uninit();
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+// the cached world matrices and bounds of the colliders against rebuilding them for every narrow phase test like the
+// collision did before, spherecasts over randomly rotated capsules. capsules have no ray test, so the rays are swept
+// usage: broadphase_bench transforms [-n casts] [-c capsules] [-l cast length] [-r repeats] [-seed n]
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "bench.h"
+
+static const float CAST_RADIUS = 0.2f;
+
+// the casts through the broad phase candidates, rebuild makes every candidate build its matrix, the inverse and its world
+// bounds again before the test, the cost each test paid before the cache
+static int cast_candidates(const std::vector<ray_t> &casts, bool rebuild, std::vector<RayHit> *hits)
+{
+	const int CANDIDATE_COUNT = 1024;
+	ColliderRef candidates[CANDIDATE_COUNT];
+	int hit_count = 0;
+	for(size_t i=0; i<casts.size(); i++)
+	{
+		const ray_t &ray = casts[i];
+		vec3 r(CAST_RADIUS, CAST_RADIUS, CAST_RADIUS);
+		bounds_t bounds(ray.pos, r);
+		bounds.encapsulate(bounds_t(ray.pos + ray.dir, r));
+		int count = query_colliders(bounds, candidates, CANDIDATE_COUNT);
+
+		RayHit nearest = {};
+		nearest.distance = FLOAT_MAX;
+		for(int k=0; k<count; k++)
+		{
+			Collider *c = candidates[k].get();
+			if(rebuild)
+			{
+				c->transform_dirty = true;
+				c->update_transform();
+			}
+			RayHit hit = {};
+			hit.distance = ray.dir.len();
+			if(c->intersect_spherecast(ray, CAST_RADIUS, &hit) && hit.distance < nearest.distance) nearest = hit;
+		}
+		(*hits)[i] = nearest;
+		if(nearest.distance < FLOAT_MAX) hit_count++;
+	}
+	for(int k=0; k<CANDIDATE_COUNT; k++) candidates[k] = nullptr;
+	return hit_count;
+}
+
+int bench_transforms(int argc, char *argv[])
+{
+	int cast_count = 10000;
+	int capsule_count = 1000;
+	float cast_length = 30.0f;
+	int repeats = 5;
+	u32 seed = 1;
+	for(int i=0; i<argc; i++)
+	{
+		if(strcmp(argv[i], "-n") == 0 && i+1 < argc){cast_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-c") == 0 && i+1 < argc){capsule_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-l") == 0 && i+1 < argc){cast_length = (float)atof(argv[++i]);}
+		else if(strcmp(argv[i], "-r") == 0 && i+1 < argc){repeats = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-seed") == 0 && i+1 < argc){seed = (u32)atoi(argv[++i]);}
+		else
+		{
+			printf("usage: broadphase_bench transforms [-n casts] [-c capsules] [-l cast length] [-r repeats] [-seed n]\n");
+			return 1;
+		}
+	}
+	if(cast_count <= 0 || capsule_count <= 0 || cast_length <= 0.0f || repeats <= 0)
+	{
+		printf("usage: broadphase_bench transforms [-n casts] [-c capsules] [-l cast length] [-r repeats] [-seed n]\n");
+		return 1;
+	}
+
+	// logs and posts lying at every angle over an area the casts cross a few of
+	const float AREA = sqrtf((float)capsule_count) * 3.0f;
+	collision_init();
+	rand_set_seed(seed);
+	std::vector<ColliderRef> capsules;
+	for(int i=0; i<capsule_count; i++)
+	{
+		ColliderRef c = create_capsule_collider(vec3(0, 1, 0), vec3(0, 1, 0), rand_range(0.2f, 0.6f), rand_range(1.5f, 4.0f));
+		vec3 pos(rand_range(-AREA, AREA), rand_range(0.0f, 4.0f), rand_range(-AREA, AREA));
+		c->set_transform(pos, quat::euler(rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f)));
+		capsules.push_back(c);
+	}
+	collision_build_static();
+
+	std::vector<ray_t> casts;
+	for(int i=0; i<cast_count; i++)
+	{
+		vec3 from(rand_range(-AREA, AREA), rand_range(0.0f, 5.0f), rand_range(-AREA, AREA));
+		vec3 dir = quat::euler(rand_range(-10.0f, 10.0f), rand_range(0.0f, 360.0f), 0) * vec3(0, 0, cast_length);
+		casts.push_back(ray_t(from, dir));
+	}
+
+	std::vector<RayHit> cached(cast_count), rebuilt(cast_count), nearest(cast_count);
+	double cached_time = 1e30, rebuilt_time = 1e30, spherecast_time = 1e30;
+	int cached_hits = 0, rebuilt_hits = 0, spherecast_hits = 0;
+	for(int r=0; r<repeats; r++)
+	{
+		double start = now_ms();
+		rebuilt_hits = cast_candidates(casts, true, &rebuilt);
+		rebuilt_time = fmin(rebuilt_time, now_ms() - start);
+
+		start = now_ms();
+		cached_hits = cast_candidates(casts, false, &cached);
+		cached_time = fmin(cached_time, now_ms() - start);
+
+		start = now_ms();
+		spherecast_hits = 0;
+		for(int i=0; i<cast_count; i++)
+		{
+			spherecast_hits += spherecast(casts[i], CAST_RADIUS, &nearest[i]);
+		}
+		spherecast_time = fmin(spherecast_time, now_ms() - start);
+	}
+
+	// the cache holds the same matrices, the hits have to be identical
+	int mismatches = 0;
+	for(int i=0; i<cast_count; i++)
+	{
+		if(cached[i].distance != rebuilt[i].distance) mismatches++;
+	}
+
+	// moving every capsule once per frame, set_transform refreshes the cache and the quadtree
+	const int frame_count = 20;
+	double move_time = 1e30;
+	for(int r=0; r<repeats; r++)
+	{
+		double start = now_ms();
+		for(int f=0; f<frame_count; f++)
+		{
+			for(ColliderRef &c : capsules)
+			{
+				c->set_transform(c->position, quat::euler(0, 1.0f, 0) * c->rotation);
+			}
+			collision_update();
+		}
+		move_time = fmin(move_time, now_ms() - start);
+	}
+
+	printf("%d capsules, %d spherecasts of length %.1f, best of %d\n", capsule_count, cast_count, cast_length, repeats);
+	printf("  rebuilt per test  %8.2f us/cast  %d hits\n", rebuilt_time * 1e3 / cast_count, rebuilt_hits);
+	printf("  cached            %8.2f us/cast  %d hits, %.2fx faster, %d mismatches\n", cached_time * 1e3 / cast_count, cached_hits, rebuilt_time / cached_time, mismatches);
+	printf("  spherecast        %8.2f us/cast  %d hits\n", spherecast_time * 1e3 / cast_count, spherecast_hits);
+	printf("  moving all        %8.1f us/frame\n", move_time * 1e3 / frame_count);
+
+	for(ColliderRef &c : capsules) free_collider(c);
+	collision_uninit();
+	return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+// ray vs triangle kernel, triangles per second of the SIMD kernel against its scalar loop and against the
+// vec3 triangle soup loop ray_vs_mesh ran before the SoA layout, every ray tests every triangle
+// usage: broadphase_bench triangles [-n rays] [-t terrain triangles] [-seed n] [terrain obj]
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "bench.h"
+
+// the loop before the SoA layout, one vec3 triangle at a time with the direction normalized twice per triangle
+static bool soup_ray_vs_triangles(const vec3 *vertices, u32 vertex_count, const ray_t &ray, float *distance)
+{
+	bool hited = false;
+	float nearest = FLOAT_MAX;
+	for(u32 i=0; i<=vertex_count-3; i+=3)
+	{
+		vec3 v0 = vertices[i];
+		vec3 v1 = vertices[i+1];
+		vec3 v2 = vertices[i+2];
+		vec3 e1 = v1 - v0;
+		vec3 e2 = v2 - v0;
+
+		vec3 p = vec3::cross(ray.dir.normalized(), e2);
+		float det = vec3::dot(e1, p);
+		if((det > -EPSILON) && (det < EPSILON)) continue;
+
+		float invdet = 1.0f/det;
+
+		vec3 tv = ray.pos - v0;
+		float u = vec3::dot(tv, p) * invdet;
+		if((u < 0.0f) || (u > 1.0f)) continue;
+
+		vec3 q = vec3::cross(tv, e1);
+		float v = vec3::dot(ray.dir.normalized(), q) * invdet;
+		if((v < 0.0f) || ((u + v) > 1.0f)) continue;
+
+		float t = vec3::dot(e2, q)*invdet;
+		if(t > EPSILON && t*t < ray.dir.sqrlen() && t < nearest)
+		{
+			nearest = t;
+			hited = true;
+		}
+	}
+	*distance = nearest;
+	return hited;
+}
+
+static void bench_kernel(const char *name, CollisionMeshRef mesh, int ray_count)
+{
+	// the soup in the BVH leaf order, like create_mesh_collider expanded it
+	std::vector<vec3> soup(mesh->triangle_count * 3);
+	for(u32 i=0; i<mesh->triangle_count * 3; i++)
+	{
+		soup[i] = mesh->vertices[mesh->indices[i]];
+	}
+
+	// rays across the whole mesh at a low angle, most of them end on it
+	vec3 min = mesh->bounds.get_min();
+	vec3 max = mesh->bounds.get_max();
+	std::vector<ray_t> rays(ray_count);
+	for(int i=0; i<ray_count; i++)
+	{
+		vec3 from(rand_range(min.x, max.x), max.y + 1.0f, rand_range(min.z, max.z));
+		vec3 to(rand_range(min.x, max.x), min.y, rand_range(min.z, max.z));
+		rays[i] = ray_t(from, to - from);
+	}
+
+	std::vector<float> soup_distances(ray_count);
+	std::vector<float> scalar_distances(ray_count);
+	std::vector<float> simd_distances(ray_count);
+	int soup_hits = 0, scalar_hits = 0, simd_hits = 0;
+
+	double soup_time = now_ms();
+	for(int i=0; i<ray_count; i++)
+	{
+		soup_hits += soup_ray_vs_triangles(soup.data(), (u32)soup.size(), rays[i], &soup_distances[i]) ? 1 : 0;
+	}
+	soup_time = now_ms() - soup_time;
+
+	double scalar_time = now_ms();
+	for(int i=0; i<ray_count; i++)
+	{
+		u32 triangle = 0;
+		scalar_distances[i] = rays[i].dir.len();
+		scalar_hits += collision_ray_vs_triangles(mesh.get(), rays[i].pos, rays[i].dir.normalized(), false, &scalar_distances[i], &triangle) ? 1 : 0;
+	}
+	scalar_time = now_ms() - scalar_time;
+
+	double simd_time = now_ms();
+	for(int i=0; i<ray_count; i++)
+	{
+		u32 triangle = 0;
+		simd_distances[i] = rays[i].dir.len();
+		simd_hits += collision_ray_vs_triangles(mesh.get(), rays[i].pos, rays[i].dir.normalized(), true, &simd_distances[i], &triangle) ? 1 : 0;
+	}
+	simd_time = now_ms() - simd_time;
+
+	int mismatches = 0;
+	for(int i=0; i<ray_count; i++)
+	{
+		if(fabsf(simd_distances[i] - scalar_distances[i]) > 1e-4f * fmaxf(1.0f, scalar_distances[i])) mismatches++;
+	}
+
+	double tests = (double)ray_count * mesh->triangle_count;
+	printf("%s: %u triangles, %d rays, SIMD width %d\n", name, mesh->triangle_count, ray_count, collision_simd_width());
+	printf("  vec3 soup    %8.1f Mtri/s  %d hits\n", tests / (soup_time * 1e3), soup_hits);
+	printf("  SoA scalar   %8.1f Mtri/s  %d hits, %.1fx the soup\n", tests / (scalar_time * 1e3), scalar_hits, soup_time / scalar_time);
+	printf("  SoA SIMD     %8.1f Mtri/s  %d hits, %.1fx the soup, %.1fx the scalar loop, %d mismatches\n", tests / (simd_time * 1e3), simd_hits, soup_time / simd_time, scalar_time / simd_time, mismatches);
+}
+
+int bench_triangles(int argc, char *argv[])
+{
+	int ray_count = 1000;
+	int triangle_count = 65536;
+	u32 seed = 1;
+	const char *terrain = "data/models/grounds/island2.obj";
+	for(int i=0; i<argc; i++)
+	{
+		if(strcmp(argv[i], "-n") == 0 && i+1 < argc){ray_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-t") == 0 && i+1 < argc){triangle_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-seed") == 0 && i+1 < argc){seed = (u32)atoi(argv[++i]);}
+		else if(argv[i][0] != '-'){terrain = argv[i];}
+		else
+		{
+			printf("usage: broadphase_bench triangles [-n rays] [-t terrain triangles] [-seed n] [terrain obj]\n");
+			return 1;
+		}
+	}
+	if(ray_count <= 0 || triangle_count <= 0)
+	{
+		printf("usage: broadphase_bench triangles [-n rays] [-t terrain triangles] [-seed n] [terrain obj]\n");
+		return 1;
+	}
+
+	collision_init();
+	rand_set_seed(seed);
+
+	CollisionMeshRef ground = load_collision_mesh(terrain);
+	if(ground == nullptr)
+	{
+		printf("failed to load %s\n", terrain);
+		return 1;
+	}
+	// the small ground gets more rays so the times are long enough to read
+	bench_kernel(terrain, ground, ray_count * 100);
+	bench_kernel("synthetic terrain", create_terrain_mesh(triangle_count), ray_count);
+
+	collision_uninit();
+	return 0;
+}
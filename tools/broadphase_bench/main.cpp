@@ -0,0 +1,264 @@
+// Broad phase benchmark
+// scatters colliders like the foliage of a map and times the quadtree queries alone, without any narrow phase
+// the other modes time a query path of the collision against the code it replaced, see bench.h
+// usage: broadphase_bench [mode] [options], the options of a mode are printed by broadphase_bench <mode> -h
+// broadphase: [-n colliders] [-q queries] [-r repeats] [-m moving colliders] [-seed n]
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "mathf.h"
+#include "collision.h"
+#include "obj_file.h"
+#include "bench.h"
+
+static const float AREA_SIZE = 240.0f;
+static const u32 LAYER_COUNT = 4;
+
+double now_ms()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CollisionMeshRef load_collision_mesh(const char *filename)
+{
+	std::vector<Vertex> vertices;
+	std::vector<u32> indices;
+	if(!obj_load(filename, &vertices, &indices)) return nullptr;
+	return create_collision_mesh(vertices.data(), (u32)vertices.size(), indices.data(), (u32)indices.size());
+}
+
+// rolling hills over a square grid with about triangle_count triangles
+CollisionMeshRef create_terrain_mesh(int triangle_count)
+{
+	int size = (int)ceilf(sqrtf(triangle_count * 0.5f));
+	std::vector<vec3> vertices;
+	std::vector<u32> indices;
+	vertices.reserve((size_t)(size + 1) * (size + 1));
+	indices.reserve((size_t)size * size * 6);
+	for(int z=0; z<=size; z++)
+	{
+		for(int x=0; x<=size; x++)
+		{
+			float h = sinf(x * 0.05f) * 8.0f + cosf(z * 0.037f) * 6.0f + sinf((x + z) * 0.21f) * 0.5f;
+			vertices.push_back(vec3((float)x, h, (float)z));
+		}
+	}
+	for(int z=0; z<size; z++)
+	{
+		for(int x=0; x<size; x++)
+		{
+			u32 i = (u32)(z * (size + 1) + x);
+			u32 quad[6] = {i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2};
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	return create_collision_mesh(vertices.data(), (u32)vertices.size(), indices.data(), (u32)indices.size());
+}
+
+static ColliderRef create_random_collider()
+{
+	ColliderRef c;
+	int type = rand_range(0, 3);
+	if(type == 0)
+	{
+		// trees
+		c = create_capsule_collider(vec3(0,5,0), vec3(0,1,0), 0.4f, 10.0f);
+	}
+	else if(type == 1)
+	{
+		c = create_sphere_collider(rand_range(0.3f, 2.0f), vec3());
+	}
+	else
+	{
+		c = create_box_collider(vec3(), vec3(rand_range(0.5f, 8.0f), rand_range(0.5f, 4.0f), rand_range(0.5f, 8.0f)));
+	}
+	c->set_layer((u32)rand_range(0, (int)LAYER_COUNT));
+	c->set_transform(vec3(rand_range(-AREA_SIZE, AREA_SIZE), rand_range(0.0f, 10.0f), rand_range(-AREA_SIZE, AREA_SIZE)), quat::euler(0, rand_range(0.0f, 360.0f), 0));
+	return c;
+}
+
+static int bench_broadphase(int argc, char *argv[])
+{
+	int collider_count = 4000;
+	int query_count = 200000;
+	int repeats = 5;
+	int mover_count = 64;
+	u32 seed = 1;
+	for(int i=0; i<argc; i++)
+	{
+		if(strcmp(argv[i], "-n") == 0 && i+1 < argc){collider_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-q") == 0 && i+1 < argc){query_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-r") == 0 && i+1 < argc){repeats = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-m") == 0 && i+1 < argc){mover_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-seed") == 0 && i+1 < argc){seed = (u32)atoi(argv[++i]);}
+		else
+		{
+			printf("usage: broadphase_bench [broadphase] [-n colliders] [-q queries] [-r repeats] [-m moving colliders] [-seed n]\n");
+			return 1;
+		}
+	}
+	if(collider_count <= 0 || query_count <= 0 || repeats <= 0 || mover_count < 0 || mover_count > collider_count)
+	{
+		printf("usage: broadphase_bench [broadphase] [-n colliders] [-q queries] [-r repeats] [-m moving colliders] [-seed n]\n");
+		return 1;
+	}
+
+	collision_init();
+	rand_set_seed(seed);
+	std::vector<ColliderRef> colliders;
+	for(int i=0; i<collider_count; i++)
+	{
+		colliders.push_back(create_random_collider());
+	}
+	collision_build_static();
+
+	// query boxes from a ball to a player sized area, on all layers or a single one
+	std::vector<bounds_t> queries;
+	std::vector<u32> masks;
+	for(int i=0; i<query_count; i++)
+	{
+		float e = rand_range(0.25f, 8.0f);
+		vec3 center(rand_range(-AREA_SIZE, AREA_SIZE), rand_range(0.0f, 10.0f), rand_range(-AREA_SIZE, AREA_SIZE));
+		queries.push_back(bounds_t(center, vec3(e, e, e)));
+		masks.push_back(rand_range(0, 2) == 0 ? 0xFFFFFFFF : 1u << (u32)rand_range(0, (int)LAYER_COUNT));
+	}
+
+	// quadtree queries
+	std::vector<ColliderRef> found(collider_count);
+	double tree_time = 1e30;
+	u64 tree_count = 0;
+	for(int r=0; r<repeats; r++)
+	{
+		tree_count = 0;
+		double start = now_ms();
+		for(int i=0; i<query_count; i++)
+		{
+			tree_count += query_colliders(queries[i], found.data(), collider_count, masks[i]);
+		}
+		tree_time = fmin(tree_time, now_ms() - start);
+	}
+
+	// the first colliders keep moving for a while like falling logs, they stay awake beside the static ones
+	const int frame_count = 100;
+	double move_time = 1e30;
+	for(int r=0; r<repeats; r++)
+	{
+		double start = now_ms();
+		for(int f=0; f<frame_count; f++)
+		{
+			for(int i=0; i<mover_count; i++)
+			{
+				vec3 p = colliders[i]->position;
+				p.x = fminf(fmaxf(p.x + rand_range(-1.0f, 1.0f), -AREA_SIZE), AREA_SIZE);
+				p.z = fminf(fmaxf(p.z + rand_range(-1.0f, 1.0f), -AREA_SIZE), AREA_SIZE);
+				colliders[i]->set_position(p);
+			}
+			collision_update();
+		}
+		move_time = fmin(move_time, now_ms() - start);
+	}
+
+	double awake_time = 1e30;
+	u64 awake_count = 0;
+	for(int r=0; r<repeats; r++)
+	{
+		awake_count = 0;
+		double start = now_ms();
+		for(int i=0; i<query_count; i++)
+		{
+			awake_count += query_colliders(queries[i], found.data(), collider_count, masks[i]);
+		}
+		awake_time = fmin(awake_time, now_ms() - start);
+	}
+	for(int i=0; i<collider_count; i++)
+	{
+		found[i] = nullptr;
+	}
+
+	// the overlap test alone, every collider against a slice of the queries
+	int test_queries = query_count < 1000 ? query_count : 1000;
+	std::vector<bounds_t> bounds;
+	std::vector<aabb_t> boxes;
+	for(int i=0; i<collider_count; i++)
+	{
+		bounds.push_back(colliders[i]->get_bounds_world());
+		boxes.push_back(colliders[i]->world_bounds);
+	}
+	double center_time = 1e30;
+	double aabb_time = 1e30;
+	u64 center_count = 0;
+	u64 aabb_count = 0;
+	for(int r=0; r<repeats; r++)
+	{
+		center_count = 0;
+		double start = now_ms();
+		for(int q=0; q<test_queries; q++)
+		{
+			for(int i=0; i<collider_count; i++)
+			{
+				center_count += bounds[i].intersects(queries[q]);
+			}
+		}
+		center_time = fmin(center_time, now_ms() - start);
+
+		aabb_count = 0;
+		start = now_ms();
+		for(int q=0; q<test_queries; q++)
+		{
+			const aabb_t box(queries[q]);
+			for(int i=0; i<collider_count; i++)
+			{
+				aabb_count += boxes[i].intersects(box);
+			}
+		}
+		aabb_time = fmin(aabb_time, now_ms() - start);
+	}
+
+	double tests = (double)test_queries * collider_count;
+	printf("colliders %d, queries %d, best of %d\n", collider_count, query_count, repeats);
+	printf("quadtree   %8.2f ms  %7.1f ns/query  %.2f colliders/query\n", tree_time, tree_time * 1e6 / query_count, (double)tree_count / query_count);
+	printf("moving     %8.2f ms  %7.1f ns/move   %d colliders for %d frames\n", move_time, mover_count > 0 ? move_time * 1e6 / ((double)mover_count * frame_count) : 0.0, mover_count, frame_count);
+	printf("awake      %8.2f ms  %7.1f ns/query  %.2f colliders/query\n", awake_time, awake_time * 1e6 / query_count, (double)awake_count / query_count);
+	printf("bounds_t   %8.2f ms  %7.2f ns/test   %llu overlaps\n", center_time, center_time * 1e6 / tests, center_count);
+	printf("aabb_t     %8.2f ms  %7.2f ns/test   %llu overlaps\n", aabb_time, aabb_time * 1e6 / tests, aabb_count);
+	printf("checksum %llu\n", tree_count);
+
+	colliders.clear();
+	collision_uninit();
+	return 0;
+}
+
+static const struct
+{
+	const char *name;
+	int (*run)(int argc, char *argv[]);
+} modes[] = {
+	{"broadphase", bench_broadphase},
+	{"batch", bench_batch},
+	{"bvh", bench_bvh},
+	{"triangles", bench_triangles},
+	{"probe", bench_probe},
+	{"spherecast", bench_spherecast},
+	{"transforms", bench_transforms},
+	{"memory", bench_memory},
+};
+
+int main(int argc, char *argv[])
+{
+	// the options follow the mode name, without a mode they belong to the broad phase benchmark
+	if(argc > 1 && argv[1][0] != '-')
+	{
+		for(const auto &mode : modes)
+		{
+			if(strcmp(argv[1], mode.name) == 0) return mode.run(argc - 2, argv + 2);
+		}
+		printf("usage: broadphase_bench [mode] [options]\nmodes:");
+		for(const auto &mode : modes) printf(" %s", mode.name);
+		printf("\n");
+		return 1;
+	}
+	return bench_broadphase(argc - 1, argv + 1);
+}
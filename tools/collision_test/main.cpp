@@ -0,0 +1,935 @@
+// Collision tests
+// builds small collision worlds and checks the queries against each other, prints FAIL and exits with 1 on a mismatch
+// usage: collision_test [-seed n] [test ...]
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <thread>
+#include <vector>
+#include "mathf.h"
+#include "collision.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do{ if(!(cond)){ printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); failures++; } }while(0)
+
+// wavy terrain grid, size x size cells of cell units each, centered on the origin
+static void create_terrain(int size, float cell, std::vector<vec3> *vertices, std::vector<u32> *indices)
+{
+	float half = size * cell * 0.5f;
+	vertices->clear();
+	indices->clear();
+	for(int z=0; z<=size; z++)
+	{
+		for(int x=0; x<=size; x++)
+		{
+			float h = sinf(x * 0.31f) * 2.0f + cosf(z * 0.23f) * 1.5f;
+			vertices->push_back(vec3(x * cell - half, h, z * cell - half));
+		}
+	}
+	for(int z=0; z<size; z++)
+	{
+		for(int x=0; x<size; x++)
+		{
+			u32 i = (u32)(z * (size + 1) + x);
+			u32 quad[6] = {i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2};
+			indices->insert(indices->end(), quad, quad + 6);
+		}
+	}
+}
+
+// trees, rocks and boxes scattered over the area
+static ColliderRef create_random_collider(float area)
+{
+	ColliderRef c;
+	int type = rand_range(0, 3);
+	if(type == 0)
+	{
+		c = create_capsule_collider(vec3(0,2,0), vec3(0,1,0), rand_range(0.2f, 0.8f), rand_range(2.0f, 6.0f));
+	}
+	else if(type == 1)
+	{
+		c = create_sphere_collider(rand_range(0.3f, 2.0f), vec3());
+	}
+	else
+	{
+		c = create_box_collider(vec3(), vec3(rand_range(0.5f, 4.0f), rand_range(0.5f, 3.0f), rand_range(0.5f, 4.0f)));
+	}
+	c->set_transform(vec3(rand_range(-area, area), rand_range(-1.0f, 4.0f), rand_range(-area, area)), quat::euler(rand_range(0.0f, 40.0f), rand_range(0.0f, 360.0f), 0));
+	return c;
+}
+
+// a terrain mesh with colliders on it, the way a map looks to the queries
+static void create_world(std::vector<ColliderRef> *colliders, int collider_count)
+{
+	std::vector<vec3> vertices;
+	std::vector<u32> indices;
+	create_terrain(96, 1.0f, &vertices, &indices);
+	colliders->push_back(create_mesh_collider(create_collision_mesh(vertices.data(), (u32)vertices.size(), indices.data(), (u32)indices.size())));
+	for(int i=0; i<collider_count; i++)
+	{
+		colliders->push_back(create_random_collider(46.0f));
+	}
+	collision_build_static();
+}
+
+static void free_world(std::vector<ColliderRef> *colliders)
+{
+	for(ColliderRef &c : *colliders)
+	{
+		free_collider(c);
+	}
+	colliders->clear();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// threads
+// every query type from 8 threads at once, each with its own CollisionQuery, against the results of one thread
+enum class StressQueryType
+{
+	RAYCAST,
+	RAYCAST_ALL,
+	SPHERECAST,
+	SPHERECAST_ALL,
+	SPHERECAST_SLIDE,
+	OVERLAP_SPHERE,
+	OVERLAP_BOX,
+	CHECK_SPHERE,
+	DEPENETRATE,
+	COUNT,
+};
+
+struct StressQuery
+{
+	StressQueryType type;
+	vec3 pos;
+	vec3 dir;
+	float radius;
+	quat rotation;
+};
+
+struct StressResult
+{
+	int count;
+	u32 id;		// collider of the first result
+	vec3 value;	// point, position or normal of the first result
+	float distance;
+};
+
+static bool operator!=(const StressResult &a, const StressResult &b)
+{
+	return a.count != b.count || a.id != b.id || a.distance != b.distance || a.value.x != b.value.x || a.value.y != b.value.y || a.value.z != b.value.z;
+}
+
+static StressResult run_stress_query(CollisionQuery *query, const StressQuery &q)
+{
+	StressResult r = {};
+	RayHit hits[8];
+	Collision collisions[8];
+	switch(q.type)
+	{
+	case StressQueryType::RAYCAST:
+		r.count = raycast(ray_t(q.pos, q.dir), hits);
+		break;
+	case StressQueryType::RAYCAST_ALL:
+		r.count = raycast_all(query, ray_t(q.pos, q.dir), hits, 8);
+		break;
+	case StressQueryType::SPHERECAST:
+		r.count = spherecast(ray_t(q.pos, q.dir), q.radius, hits);
+		break;
+	case StressQueryType::SPHERECAST_ALL:
+		r.count = spherecast_all(query, ray_t(q.pos, q.dir), q.radius, hits, 8);
+		break;
+	case StressQueryType::SPHERECAST_SLIDE:
+		r.value = spherecast_slide(query, q.pos, q.dir, q.radius);
+		return r;
+	case StressQueryType::OVERLAP_SPHERE:
+		r.count = overlap_sphere(query, q.pos, q.radius, collisions, 8);
+		break;
+	case StressQueryType::OVERLAP_BOX:
+		r.count = overlap_box(query, q.pos, q.dir, q.rotation, collisions, 8);
+		break;
+	case StressQueryType::CHECK_SPHERE:
+		r.count = check_sphere(q.pos, q.radius) ? 1 : 0;
+		return r;
+	case StressQueryType::DEPENETRATE:
+		r.value = depenetrate_sphere(query, q.pos, q.radius);
+		return r;
+	default:
+		return r;
+	}
+	if(r.count <= 0) return r;
+	if(q.type == StressQueryType::OVERLAP_SPHERE || q.type == StressQueryType::OVERLAP_BOX)
+	{
+		r.id = collisions[0].collider->id;
+		r.value = collisions[0].normal;
+		r.distance = collisions[0].depth;
+	}
+	else
+	{
+		r.id = hits[0].collider->id;
+		r.value = hits[0].point;
+		r.distance = hits[0].distance;
+	}
+	return r;
+}
+
+static void test_threads(u32 seed)
+{
+	const int THREAD_COUNT = 8;
+	const int QUERY_COUNT = 20000;
+	const int ROUNDS = 4;
+
+	collision_init();
+	rand_set_seed(seed);
+	std::vector<ColliderRef> colliders;
+	create_world(&colliders, 1500);
+
+	std::vector<StressQuery> queries(QUERY_COUNT);
+	for(StressQuery &q : queries)
+	{
+		q.type = (StressQueryType)rand_range(0, (int)StressQueryType::COUNT);
+		q.pos = vec3(rand_range(-50.0f, 50.0f), rand_range(-1.0f, 8.0f), rand_range(-50.0f, 50.0f));
+		if(q.type == StressQueryType::OVERLAP_BOX) q.dir = vec3(rand_range(0.2f, 3.0f), rand_range(0.2f, 3.0f), rand_range(0.2f, 3.0f));
+		else q.dir = rand_in_sphere(20.0f) + vec3(0, -4.0f, 0);
+		q.radius = rand_range(0.1f, 1.5f);
+		q.rotation = quat::euler(rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f), 0);
+	}
+
+	std::vector<StressResult> expected(QUERY_COUNT);
+	CollisionQuery main_query;
+	int hit_count = 0;
+	for(int i=0; i<QUERY_COUNT; i++)
+	{
+		expected[i] = run_stress_query(&main_query, queries[i]);
+		if(expected[i].count > 0) hit_count++;
+	}
+
+	// the threads run the queries from different starting points so they meet different work at the same time
+	std::vector<int> mismatches(THREAD_COUNT, 0);
+	std::vector<std::thread> threads;
+	for(int t=0; t<THREAD_COUNT; t++)
+	{
+		threads.emplace_back([&, t]()
+		{
+			CollisionQuery query;
+			for(int round=0; round<ROUNDS; round++)
+			{
+				for(int k=0; k<QUERY_COUNT; k++)
+				{
+					int i = (k + t * QUERY_COUNT / THREAD_COUNT) % QUERY_COUNT;
+					CollisionQuery *q = (k & 1) ? &query : collision_get_thread_query();
+					if(run_stress_query(q, queries[i]) != expected[i]) mismatches[t]++;
+				}
+			}
+		});
+	}
+	for(std::thread &thread : threads)
+	{
+		thread.join();
+	}
+	for(int t=0; t<THREAD_COUNT; t++)
+	{
+		CHECK(mismatches[t] == 0, "thread %d: %d of %d queries differ from the single thread results", t, mismatches[t], QUERY_COUNT * ROUNDS);
+	}
+
+	printf("threads: %d threads x %d queries x %d rounds, %d of the queries hit\n", THREAD_COUNT, QUERY_COUNT, ROUNDS, hit_count);
+	free_world(&colliders);
+	collision_uninit();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// batch
+// raycast_batch against raycast, the rays of a packet start at different points and heights
+static int count_batch_mismatches(const std::vector<ray_t> &rays, const std::vector<RayHit> &batch_hits)
+{
+	int mismatches = 0;
+	for(size_t i=0; i<rays.size(); i++)
+	{
+		RayHit hit;
+		int count = raycast(rays[i], &hit);
+		// the rays are shortened to the nearest hit in a different order, so the distances agree to rounding
+		if(count != (batch_hits[i].collider ? 1 : 0) || (count && (hit.collider != batch_hits[i].collider || fabsf(hit.distance - batch_hits[i].distance) > 1e-4f))) mismatches++;
+	}
+	return mismatches;
+}
+
+static void test_batch(u32 seed)
+{
+	collision_init();
+
+	// the second ray starts above the sphere, far from where the first one ends
+	{
+		ColliderRef sphere = create_sphere_collider(1.0f, vec3());
+		sphere->set_position(vec3(0, 15, 0));
+		std::vector<ray_t> rays = {ray_t(vec3(0, 0, 0), vec3(0, -1, 0)), ray_t(vec3(0, 20, 0), vec3(0, -10, 0))};
+		std::vector<RayHit> hits(rays.size());
+		int count = raycast_batch(rays.data(), hits.data(), (int)rays.size());
+		CHECK(count == 1 && hits[0].collider == nullptr && hits[1].collider == sphere, "two rays over a sphere: %d hits", count);
+		CHECK(fabsf(hits[1].distance - 4.0f) < 1e-4f, "two rays over a sphere: distance %f, expected 4", hits[1].distance);
+		free_collider(sphere);
+	}
+
+	rand_set_seed(seed);
+	std::vector<ColliderRef> colliders;
+	create_world(&colliders, 1500);
+
+	// short and long rays from under the ground to high above it, in all directions and straight down
+	const int RAY_COUNT = 50000;
+	std::vector<ray_t> rays;
+	for(int i=0; i<RAY_COUNT; i++)
+	{
+		vec3 pos(rand_range(-50.0f, 50.0f), rand_range(-5.0f, 40.0f), rand_range(-50.0f, 50.0f));
+		vec3 dir = (i & 1) ? rand_in_sphere(rand_range(0.5f, 30.0f)) : vec3(0, -rand_range(0.5f, 50.0f), 0);
+		rays.push_back(ray_t(pos, dir));
+	}
+	std::vector<RayHit> batch_hits(RAY_COUNT);
+	int count = raycast_batch(rays.data(), batch_hits.data(), RAY_COUNT);
+	int mismatches = count_batch_mismatches(rays, batch_hits);
+	CHECK(mismatches == 0, "%d of %d rays of the batch differ from raycast", mismatches, RAY_COUNT);
+
+	// the batch splits its rays over the threads itself
+	std::vector<RayHit> threaded_hits(RAY_COUNT);
+	raycast_batch(rays.data(), threaded_hits.data(), RAY_COUNT, 0xFFFFFFFF, 4);
+	mismatches = count_batch_mismatches(rays, threaded_hits);
+	CHECK(mismatches == 0, "%d of %d rays of the threaded batch differ from raycast", mismatches, RAY_COUNT);
+
+	printf("batch: %d rays, %d hit\n", RAY_COUNT, count);
+	free_world(&colliders);
+	collision_uninit();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// bvh
+// mesh colliders against a pass over every triangle, on meshes that give unbalanced and deep trees
+// the brute force ray widens the triangle edges by the same 1e-5 as the kernel
+static bool brute_ray_vs_mesh(const CollisionMesh *mesh, const ray_t &ray, float *distance)
+{
+	float length = ray.dir.len();
+	vec3 dir = ray.dir / length;
+	float nearest = length;
+	bool hit = false;
+	for(u32 i=0; i<mesh->triangle_count; i++)
+	{
+		const vec3 &v0 = mesh->vertices[mesh->indices[i*3]];
+		vec3 e1 = mesh->vertices[mesh->indices[i*3+1]] - v0;
+		vec3 e2 = mesh->vertices[mesh->indices[i*3+2]] - v0;
+		vec3 p = vec3::cross(dir, e2);
+		float det = vec3::dot(e1, p);
+		if(det > -EPSILON && det < EPSILON) continue;
+		float invdet = 1.0f / det;
+		vec3 tv = ray.pos - v0;
+		float u = vec3::dot(tv, p) * invdet;
+		if(u < -1e-5f || u > 1.0f + 1e-5f) continue;
+		vec3 q = vec3::cross(tv, e1);
+		float v = vec3::dot(dir, q) * invdet;
+		if(v < -1e-5f || u + v > 1.0f + 1e-5f) continue;
+		float t = vec3::dot(e2, q) * invdet;
+		if(t > EPSILON && t < nearest)
+		{
+			nearest = t;
+			hit = true;
+		}
+	}
+	*distance = nearest;
+	return hit;
+}
+
+// Real-Time Collision Detection 5.1.5
+static vec3 closest_point_on_triangle(const vec3 &p, const vec3 &a, const vec3 &b, const vec3 &c)
+{
+	vec3 ab = b - a, ac = c - a, ap = p - a;
+	float d1 = vec3::dot(ab, ap), d2 = vec3::dot(ac, ap);
+	if(d1 <= 0.0f && d2 <= 0.0f) return a;
+	vec3 bp = p - b;
+	float d3 = vec3::dot(ab, bp), d4 = vec3::dot(ac, bp);
+	if(d3 >= 0.0f && d4 <= d3) return b;
+	float vc = d1*d4 - d3*d2;
+	if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+	vec3 cp = p - c;
+	float d5 = vec3::dot(ab, cp), d6 = vec3::dot(ac, cp);
+	if(d6 >= 0.0f && d5 <= d6) return c;
+	float vb = d5*d2 - d1*d6;
+	if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+	float va = d3*d6 - d5*d4;
+	if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	float denom = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+static float brute_distance_to_mesh(const CollisionMesh *mesh, const vec3 &p)
+{
+	float nearest = FLOAT_MAX;
+	for(u32 i=0; i<mesh->triangle_count; i++)
+	{
+		const u32 *tri = &mesh->indices[i*3];
+		vec3 c = closest_point_on_triangle(p, mesh->vertices[tri[0]], mesh->vertices[tri[1]], mesh->vertices[tri[2]]);
+		nearest = fminf(nearest, (c - p).len());
+	}
+	return nearest;
+}
+
+static void add_triangle(std::vector<vec3> *vertices, std::vector<u32> *indices, const vec3 &a, const vec3 &b, const vec3 &c)
+{
+	u32 first = (u32)vertices->size();
+	vertices->push_back(a);
+	vertices->push_back(b);
+	vertices->push_back(c);
+	indices->push_back(first);
+	indices->push_back(first + 1);
+	indices->push_back(first + 2);
+}
+
+static void check_bvh_mesh(const char *name, const std::vector<vec3> &vertices, const std::vector<u32> &indices, int query_count)
+{
+	CollisionMeshRef mesh = create_collision_mesh(vertices.data(), (u32)vertices.size(), indices.data(), (u32)indices.size());
+	ColliderRef collider = create_mesh_collider(mesh);
+	collider->update_transform();
+	vec3 min = mesh->bounds.get_min() - vec3(1,1,1);
+	vec3 max = mesh->bounds.get_max() + vec3(1,1,1);
+	float size = (max - min).len();
+
+	int ray_mismatches = 0, ray_hits = 0;
+	int sphere_mismatches = 0, sphere_hits = 0;
+	for(int i=0; i<query_count; i++)
+	{
+		vec3 pos(rand_range(min.x, max.x), rand_range(min.y, max.y), rand_range(min.z, max.z));
+		ray_t ray(pos, rand_in_sphere(1.0f).normalized() * rand_range(0.1f, size));
+		float expected;
+		bool expected_hit = brute_ray_vs_mesh(mesh.get(), ray, &expected);
+		RayHit hit = {};
+		bool result = collider->intersect_ray(ray, &hit);
+		if(result != expected_hit || (result && fabsf(hit.distance - expected) > 1e-3f * fmaxf(1.0f, expected))) ray_mismatches++;
+		if(expected_hit) ray_hits++;
+
+		// the overlap sphere reaches a little past the nearest triangle or stops short of it
+		float radius = rand_range(0.05f, 2.0f);
+		float distance = brute_distance_to_mesh(mesh.get(), pos);
+		if(fabsf(distance - radius) < 1e-3f) continue;
+		Collision collision = {};
+		result = collider->intersect_sphere(pos, radius, &collision);
+		if(result != (distance < radius) || (result && fabsf(collision.depth - (radius - distance)) > 1e-3f)) sphere_mismatches++;
+		if(distance < radius) sphere_hits++;
+	}
+	CHECK(ray_mismatches == 0, "bvh %s: %d of %d rays differ from the brute force pass", name, ray_mismatches, query_count);
+	CHECK(sphere_mismatches == 0, "bvh %s: %d of %d spheres differ from the brute force pass", name, sphere_mismatches, query_count);
+	printf("bvh %s: %u triangles, %d of %d rays hit, %d spheres overlap\n", name, mesh->triangle_count, ray_hits, query_count, sphere_hits);
+	free_collider(collider);
+}
+
+static void test_bvh(u32 seed)
+{
+	collision_init();
+	rand_set_seed(seed);
+	std::vector<vec3> vertices;
+	std::vector<u32> indices;
+
+	create_terrain(128, 0.5f, &vertices, &indices);
+	check_bvh_mesh("terrain", vertices, indices, 2000);
+
+	// triangles of all sizes thrown in a box
+	vertices.clear();
+	indices.clear();
+	for(int i=0; i<20000; i++)
+	{
+		vec3 p(rand_range(-40.0f, 40.0f), rand_range(-40.0f, 40.0f), rand_range(-40.0f, 40.0f));
+		float s = powf(10.0f, rand_range(-2.0f, 1.0f));
+		add_triangle(&vertices, &indices, p, p + rand_in_sphere(s), p + rand_in_sphere(s));
+	}
+	check_bvh_mesh("soup", vertices, indices, 2000);
+
+	// sizes and positions shrinking toward the origin, the splits peel off the largest triangles and the tree leans to one side
+	vertices.clear();
+	indices.clear();
+	for(int i=0; i<100; i++)
+	{
+		float s = 100.0f * powf(0.88f, (float)i);
+		float x = s * 2.0f;
+		add_triangle(&vertices, &indices, vec3(x, 0, 0), vec3(x + s, 0, 0), vec3(x, s * 0.1f * (i % 7 + 1), s));
+	}
+	check_bvh_mesh("nested", vertices, indices, 2000);
+
+	// stacked copies of a grid, the centroids of a column are all within a hair
+	vertices.clear();
+	indices.clear();
+	for(int layer=0; layer<64; layer++)
+	{
+		for(int x=0; x<16; x++)
+		{
+			for(int z=0; z<16; z++)
+			{
+				float y = layer * 1e-4f;
+				add_triangle(&vertices, &indices, vec3((float)x, y, (float)z), vec3((float)x, y, z + 1.0f), vec3(x + 1.0f, y, (float)z));
+			}
+		}
+	}
+	check_bvh_mesh("stacked", vertices, indices, 2000);
+
+	collision_uninit();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// capsule_box
+// overlap_box against capsules, the depth has to match the distance from the capsule segment to the box
+static float sampled_segment_box_distance(const vec3 &a, const vec3 &b, const vec3 &center, const vec3 *axes, const vec3 &half)
+{
+	auto distance = [&](float t)
+	{
+		vec3 d = a + (b - a) * t - center;
+		float sqrdist = 0.0f;
+		for(int i=0; i<3; i++)
+		{
+			float x = fabsf(vec3::dot(d, axes[i])) - (&half.x)[i];
+			if(x > 0.0f) sqrdist += x * x;
+		}
+		return sqrtf(sqrdist);
+	};
+
+	// dense samples, then a fine search around the best one
+	const int SAMPLES = 2000;
+	int best = 0;
+	for(int i=1; i<=SAMPLES; i++)
+	{
+		if(distance((float)i / SAMPLES) < distance((float)best / SAMPLES)) best = i;
+	}
+	float t0 = fmaxf(0.0f, (best - 1.0f) / SAMPLES);
+	float t1 = fminf(1.0f, (best + 1.0f) / SAMPLES);
+	for(int i=0; i<60; i++)
+	{
+		float m0 = t0 + (t1 - t0) / 3.0f;
+		float m1 = t1 - (t1 - t0) / 3.0f;
+		if(distance(m0) < distance(m1)) t1 = m1;
+		else t0 = m0;
+	}
+	return distance((t0 + t1) * 0.5f);
+}
+
+static void test_capsule_box(u32 seed)
+{
+	collision_init();
+	rand_set_seed(seed);
+
+	const int CASE_COUNT = 20000;
+	int mismatches = 0, overlaps = 0, tested = 0;
+	float worst = 0.0f;
+	for(int i=0; i<CASE_COUNT; i++)
+	{
+		float radius = rand_range(0.1f, 1.0f);
+		float height = rand_range(0.0f, 6.0f);
+		ColliderRef capsule = create_capsule_collider(vec3(), vec3(0,1,0), radius, height);
+		capsule->set_transform(rand_in_sphere(2.0f), quat::euler(rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f)));
+		capsule->update_transform();
+		vec3 a = capsule->world.multiply_point_3x4(vec3(0, height * 0.5f, 0));
+		vec3 b = capsule->world.multiply_point_3x4(vec3(0, -height * 0.5f, 0));
+
+		vec3 center = rand_in_sphere(5.0f);
+		vec3 size(rand_range(0.1f, 4.0f), rand_range(0.1f, 4.0f), rand_range(0.1f, 4.0f));
+		quat rotation = quat::euler(rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f));
+		vec3 axes[3] = {rotation * vec3(1,0,0), rotation * vec3(0,1,0), rotation * vec3(0,0,1)};
+		float distance = sampled_segment_box_distance(a, b, center, axes, size * 0.5f);
+
+		Collision collision = {};
+		bool result = capsule->intersect_box(center, size, rotation, &collision);
+		free_collider(capsule);
+
+		// the core segment in the box and the touching cases have no single depth to compare
+		if(distance < 1e-3f || fabsf(distance - radius) < 1e-3f) continue;
+		tested++;
+		bool expected = distance < radius;
+		if(expected) overlaps++;
+		float error = result ? fabsf(collision.depth - (radius - distance)) : 0.0f;
+		worst = fmaxf(worst, error);
+		if(result != expected || error > 1e-4f) mismatches++;
+	}
+	CHECK(mismatches == 0, "%d of %d capsule and box overlaps differ from the sampled distance, worst depth error %g", mismatches, tested, worst);
+	printf("capsule_box: %d cases, %d overlap, worst depth error %g\n", tested, overlaps, worst);
+	collision_uninit();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// primitives
+// sphere and box colliders against mesh colliders of the same shape, the box mesh is exact and the sphere mesh is
+// tessellated, so its results are compared within the sag of its facets
+struct ShapeComparison
+{
+	const char *name;
+	int tested = 0;
+	int hits = 0;
+	int mismatches = 0;
+	float worst = 0.0f;
+};
+
+// hit or miss and the distance or depth have to agree, a result within the tolerance of the end of the query or one
+// that only grazes the shape may go either way
+static void compare_results(ShapeComparison *cmp, float tolerance, bool grazing, bool a, float a_value, bool b, float b_value, float limit)
+{
+	cmp->tested++;
+	if(a && b)
+	{
+		cmp->hits++;
+		float error = fabsf(a_value - b_value);
+		cmp->worst = fmaxf(cmp->worst, error);
+		if(error > tolerance) cmp->mismatches++;
+	}
+	else if(a != b)
+	{
+		float value = a ? a_value : b_value;
+		if(!grazing && fabsf(value - limit) > tolerance) cmp->mismatches++;
+	}
+}
+
+static void check_comparison(const ShapeComparison &cmp)
+{
+	CHECK(cmp.mismatches == 0, "%s: %d of %d queries differ, worst error %g", cmp.name, cmp.mismatches, cmp.tested, cmp.worst);
+	printf("%s: %d queries, %d hit both, worst error %g\n", cmp.name, cmp.tested, cmp.hits, cmp.worst);
+}
+
+static void add_box_mesh(const vec3 &half, std::vector<vec3> *vertices, std::vector<u32> *indices)
+{
+	for(int i=0; i<8; i++)
+	{
+		vertices->push_back(vec3(i & 1 ? half.x : -half.x, i & 2 ? half.y : -half.y, i & 4 ? half.z : -half.z));
+	}
+	const u32 faces[6][4] = {{0,2,3,1}, {4,5,7,6}, {0,1,5,4}, {2,6,7,3}, {0,4,6,2}, {1,3,7,5}};
+	for(int i=0; i<6; i++)
+	{
+		u32 quad[6] = {faces[i][0], faces[i][1], faces[i][2], faces[i][0], faces[i][2], faces[i][3]};
+		indices->insert(indices->end(), quad, quad + 6);
+	}
+}
+
+static void add_sphere_mesh(float radius, int segments, std::vector<vec3> *vertices, std::vector<u32> *indices)
+{
+	for(int y=0; y<=segments; y++)
+	{
+		float v = PI * y / segments;
+		for(int x=0; x<=segments; x++)
+		{
+			float u = 2.0f * PI * x / segments;
+			vertices->push_back(vec3(sinf(v) * cosf(u), cosf(v), sinf(v) * sinf(u)) * radius);
+		}
+	}
+	for(int y=0; y<segments; y++)
+	{
+		for(int x=0; x<segments; x++)
+		{
+			u32 i = (u32)(y * (segments + 1) + x);
+			u32 quad[6] = {i, i + 1, i + segments + 2, i, i + segments + 2, i + segments + 1};
+			indices->insert(indices->end(), quad, quad + 6);
+		}
+	}
+}
+
+// random rays, casts and overlaps around the origin against both colliders
+// round_radius is the radius of a tessellated sphere, the queries that graze it are skipped since the facets move
+// the hit a long way along the ray there
+static void compare_colliders(const Collider *shape, const Collider *mesh, float tolerance, float round_radius, ShapeComparison *cmp, int query_count)
+{
+	for(int i=0; i<query_count; i++)
+	{
+		vec3 pos = rand_in_sphere(1.0f).normalized() * rand_range(3.0f, 6.0f);
+		vec3 target = rand_in_sphere(2.0f);
+		float length = rand_range(1.0f, 10.0f);
+		ray_t ray(pos, (target - pos).normalized() * length);
+		float radius = rand_range(0.05f, 1.0f);
+		vec3 dir = ray.dir.normalized();
+		float line_distance = (pos - dir * vec3::dot(pos, dir)).len();
+
+		// a hit at a shallow angle moves along the ray by the error over the cosine, one along the surface is a graze
+		// a ray starting in the shape misses the primitive and hits the mesh on its far side
+		RayHit a = {}, b = {};
+		bool ra, rb;
+		Collision start = {};
+		bool starts_inside = shape->intersect_sphere(pos, tolerance, &start);
+		if(!starts_inside && (round_radius == 0.0f || fabsf(line_distance - round_radius) > round_radius * 0.05f))
+		{
+			ra = shape->intersect_ray(ray, &a);
+			rb = mesh->intersect_ray(ray, &b);
+			float slope = fabsf(vec3::dot(ra ? a.normal : b.normal, dir));
+			compare_results(&cmp[0], tolerance / fmaxf(slope, 0.05f), slope < 0.05f, ra, a.distance, rb, b.distance, length);
+		}
+
+		// a cast starting in the shape hits the primitive at 0 and the mesh at its far side
+		a = {}; b = {};
+		bool grazing = round_radius > 0.0f && fabsf(line_distance - round_radius - radius) < (round_radius + radius) * 0.05f;
+		if(!grazing && !shape->intersect_sphere(pos, radius + tolerance, &start))
+		{
+			ra = shape->intersect_spherecast(ray, radius, &a);
+			rb = mesh->intersect_spherecast(ray, radius, &b);
+			float slope = fabsf(vec3::dot(ra ? a.normal : b.normal, dir));
+			compare_results(&cmp[1], tolerance / fmaxf(slope, 0.05f), slope < 0.05f, ra, a.distance, rb, b.distance, length);
+		}
+
+		// overlaps with the center outside, inside a mesh there is no surface to push out of
+		vec3 center = pos.normalized() * rand_range(0.5f, 4.0f);
+		RayHit inside = {};
+		if(mesh->intersect_ray(ray_t(center, center.normalized() * 10.0f), &inside) && vec3::dot(inside.normal, center) > 0.0f) continue;
+		Collision ca = {}, cb = {};
+		ra = shape->intersect_sphere(center, radius, &ca);
+		rb = mesh->intersect_sphere(center, radius, &cb);
+		compare_results(&cmp[2], tolerance, false, ra, ca.depth, rb, cb.depth, 0.0f);
+	}
+}
+
+static void test_primitives(u32 seed)
+{
+	collision_init();
+	rand_set_seed(seed);
+
+	ShapeComparison boxes[3] = {{"primitives box ray"}, {"primitives box spherecast"}, {"primitives box overlap"}};
+	for(int i=0; i<200; i++)
+	{
+		vec3 size(rand_range(0.2f, 4.0f), rand_range(0.2f, 4.0f), rand_range(0.2f, 4.0f));
+		quat rotation = quat::euler(rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f));
+		std::vector<vec3> vertices;
+		std::vector<u32> indices;
+		add_box_mesh(size * 0.5f, &vertices, &indices);
+		ColliderRef box = create_box_collider(vec3(), size);
+		ColliderRef mesh = create_mesh_collider(create_collision_mesh(vertices.data(), (u32)vertices.size(), indices.data(), (u32)indices.size()));
+		box->set_transform(vec3(), rotation);
+		mesh->set_transform(vec3(), rotation);
+		box->update_transform();
+		mesh->update_transform();
+		compare_colliders(box.get(), mesh.get(), 1e-3f, 0.0f, boxes, 100);
+		free_collider(box);
+		free_collider(mesh);
+	}
+	for(int i=0; i<3; i++) check_comparison(boxes[i]);
+
+	// the facets of a 96 segment sphere sink up to 0.11% of its radius in the middle of a quad, away from the grazing
+	// rays that moves the hits along the ray by up to 0.35% of the radius
+	ShapeComparison spheres[3] = {{"primitives sphere ray"}, {"primitives sphere spherecast"}, {"primitives sphere overlap"}};
+	for(int i=0; i<40; i++)
+	{
+		float radius = rand_range(0.2f, 2.0f);
+		std::vector<vec3> vertices;
+		std::vector<u32> indices;
+		add_sphere_mesh(radius, 96, &vertices, &indices);
+		ColliderRef sphere = create_sphere_collider(radius, vec3());
+		ColliderRef mesh = create_mesh_collider(create_collision_mesh(vertices.data(), (u32)vertices.size(), indices.data(), (u32)indices.size()));
+		sphere->update_transform();
+		mesh->update_transform();
+		compare_colliders(sphere.get(), mesh.get(), radius * 4e-3f, radius, spheres, 500);
+		free_collider(sphere);
+		free_collider(mesh);
+	}
+	for(int i=0; i<3; i++) check_comparison(spheres[i]);
+
+	// box meshes scaled by their collider against the box of the scaled size, uniform and non-uniform scales
+	// the box overlaps are compared with a mesh of the scaled vertices, the box primitive separates along other axes
+	// depenetrate_sphere has to push a sphere touching the scaled mesh out to where it touches the box
+	ShapeComparison scaled[5] = {{"primitives scaled mesh ray"}, {"primitives scaled mesh spherecast"}, {"primitives scaled mesh overlap"},
+		{"primitives scaled mesh box overlap"}, {"primitives scaled mesh depenetrate"}};
+	for(int i=0; i<200; i++)
+	{
+		vec3 size(rand_range(0.2f, 2.0f), rand_range(0.2f, 2.0f), rand_range(0.2f, 2.0f));
+		float s = rand_range(0.5f, 2.5f);
+		vec3 scale = i & 1 ? vec3(s, s, s) : vec3(rand_range(0.5f, 2.5f), rand_range(0.5f, 2.5f), rand_range(0.5f, 2.5f));
+		quat rotation = quat::euler(rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f));
+		std::vector<vec3> vertices, scaled_vertices;
+		std::vector<u32> indices, scaled_indices;
+		add_box_mesh(size * 0.5f, &vertices, &indices);
+		add_box_mesh(size * scale * 0.5f, &scaled_vertices, &scaled_indices);
+		ColliderRef box = create_box_collider(vec3(), size * scale);
+		ColliderRef mesh = create_mesh_collider(create_collision_mesh(vertices.data(), (u32)vertices.size(), indices.data(), (u32)indices.size()));
+		ColliderRef reference = create_mesh_collider(create_collision_mesh(scaled_vertices.data(), (u32)scaled_vertices.size(), scaled_indices.data(), (u32)scaled_indices.size()));
+		box->set_layer(1);
+		mesh->set_layer(2);
+		reference->set_layer(3);
+		mesh->scale = scale;
+		box->set_transform(vec3(), rotation);
+		mesh->set_transform(vec3(), rotation);
+		reference->set_transform(vec3(), rotation);
+		compare_colliders(box.get(), mesh.get(), 1e-3f, 0.0f, scaled, 20);
+
+		for(int k=0; k<20; k++)
+		{
+			vec3 center = rand_in_sphere(1.0f).normalized() * rand_range(0.5f, 4.0f);
+			vec3 box_size(rand_range(0.1f, 2.0f), rand_range(0.1f, 2.0f), rand_range(0.1f, 2.0f));
+			quat box_rotation = quat::euler(rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f));
+			Collision ca = {}, cb = {};
+			bool ra = mesh->intersect_box(center, box_size, box_rotation, &ca);
+			bool rb = reference->intersect_box(center, box_size, box_rotation, &cb);
+			compare_results(&scaled[3], 1e-3f, false, ra, ca.depth, rb, cb.depth, 0.0f);
+
+			// the center outside the box, the single contact of the box is the whole push
+			float radius = rand_range(0.05f, 1.0f);
+			Collision contact = {};
+			if(box->intersect_sphere(center, 0.0f, &contact) || !box->intersect_sphere(center, radius, &contact)) continue;
+			vec3 expected = center + contact.normal * contact.depth;
+			vec3 pushed = depenetrate_sphere(center, radius, 1u << 2);
+			float error = (pushed - expected).len();
+			scaled[4].tested++;
+			scaled[4].hits++;
+			scaled[4].worst = fmaxf(scaled[4].worst, error);
+			if(error > 1e-3f) scaled[4].mismatches++;
+		}
+		free_collider(box);
+		free_collider(mesh);
+		free_collider(reference);
+	}
+	for(int i=0; i<5; i++) check_comparison(scaled[i]);
+
+	collision_uninit();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// heightfield
+// a heightfield collider against a mesh collider of the same two triangles per cell, holes included
+static void test_heightfield(u32 seed)
+{
+	collision_init();
+	rand_set_seed(seed);
+
+	const u32 WIDTH = 64;
+	const u32 DEPTH = 48;
+	const float CELL = 0.75f;
+	const vec3 ORIGIN(-24.0f, 0.0f, -18.0f);
+	std::vector<float> heights((WIDTH + 1) * (DEPTH + 1));
+	for(u32 z=0; z<=DEPTH; z++)
+	{
+		for(u32 x=0; x<=WIDTH; x++)
+		{
+			heights[z * (WIDTH + 1) + x] = sinf(x * 0.37f) * 2.0f + cosf(z * 0.29f) * 1.5f + rand_range(-0.3f, 0.3f);
+		}
+	}
+	for(int i=0; i<20; i++)
+	{
+		heights[rand_range(0, (int)heights.size())] = HEIGHTFIELD_HOLE;
+	}
+
+	// the cell triangles in the order the heightfield tests them
+	std::vector<vec3> vertices;
+	std::vector<u32> indices;
+	for(u32 z=0; z<DEPTH; z++)
+	{
+		for(u32 x=0; x<WIDTH; x++)
+		{
+			float h[4] = {heights[z * (WIDTH + 1) + x], heights[(z + 1) * (WIDTH + 1) + x], heights[z * (WIDTH + 1) + x + 1], heights[(z + 1) * (WIDTH + 1) + x + 1]};
+			if(h[0] == HEIGHTFIELD_HOLE || h[1] == HEIGHTFIELD_HOLE || h[2] == HEIGHTFIELD_HOLE || h[3] == HEIGHTFIELD_HOLE) continue;
+			vec3 v0 = ORIGIN + vec3(x * CELL, h[0], z * CELL);
+			vec3 v1 = ORIGIN + vec3(x * CELL, h[1], (z + 1) * CELL);
+			vec3 v2 = ORIGIN + vec3((x + 1) * CELL, h[2], z * CELL);
+			vec3 v3 = ORIGIN + vec3((x + 1) * CELL, h[3], (z + 1) * CELL);
+			add_triangle(&vertices, &indices, v0, v1, v2);
+			add_triangle(&vertices, &indices, v2, v1, v3);
+		}
+	}
+
+	ColliderRef field = create_heightfield_collider(create_collision_heightfield(heights.data(), WIDTH, DEPTH, CELL, ORIGIN));
+	ColliderRef mesh = create_mesh_collider(create_collision_mesh(vertices.data(), (u32)vertices.size(), indices.data(), (u32)indices.size()));
+	vec3 position(3.0f, -1.0f, 2.0f);
+	quat rotation = quat::euler(0, 30.0f, 0);
+
+	// unscaled, uniformly scaled and non-uniformly scaled, the last one sweeps and overlaps the triangles in world space
+	ShapeComparison cmp[4] = {{"heightfield ray"}, {"heightfield spherecast"}, {"heightfield overlap sphere"}, {"heightfield overlap box"}};
+	const float tolerance = 1e-3f;
+	const vec3 scales[3] = {vec3(1, 1, 1), vec3(1.5f, 1.5f, 1.5f), vec3(1.25f, 2.0f, 0.8f)};
+	for(const vec3 &scale : scales)
+	{
+		field->scale = scale;
+		mesh->scale = scale;
+		field->set_transform(position, rotation);
+		mesh->set_transform(position, rotation);
+		for(int i=0; i<7000; i++)
+		{
+			// the triangles are one sided for spherecasts, so the queries start above the surface
+			vec3 pos = position + rotation * (vec3(rand_range(-26.0f, 26.0f), rand_range(-4.0f, 8.0f), rand_range(-20.0f, 20.0f)) * scale);
+			float length = rand_range(0.5f, 30.0f);
+			ray_t ray(pos, rand_in_sphere(1.0f).normalized() * length);
+			float radius = rand_range(0.05f, 1.5f);
+			RayHit ground = {};
+			if(mesh->intersect_ray(ray_t(vec3(pos.x, 40.0f, pos.z), vec3(0, -80.0f, 0)), &ground) && pos.y < ground.point.y + radius) continue;
+
+			RayHit a = {}, b = {};
+			bool ra = field->intersect_ray(ray, &a);
+			bool rb = mesh->intersect_ray(ray, &b);
+			compare_results(&cmp[0], tolerance, false, ra, a.distance, rb, b.distance, length);
+
+			a = {}; b = {};
+			ra = field->intersect_spherecast(ray, radius, &a);
+			rb = mesh->intersect_spherecast(ray, radius, &b);
+			compare_results(&cmp[1], tolerance, false, ra, a.distance, rb, b.distance, length);
+
+			Collision ca = {}, cb = {};
+			ra = field->intersect_sphere(pos, radius, &ca);
+			rb = mesh->intersect_sphere(pos, radius, &cb);
+			compare_results(&cmp[2], tolerance, false, ra, ca.depth, rb, cb.depth, 0.0f);
+
+			vec3 size(rand_range(0.1f, 3.0f), rand_range(0.1f, 3.0f), rand_range(0.1f, 3.0f));
+			quat box_rotation = quat::euler(rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f), rand_range(0.0f, 360.0f));
+			ca = {}; cb = {};
+			ra = field->intersect_box(pos, size, box_rotation, &ca);
+			rb = mesh->intersect_box(pos, size, box_rotation, &cb);
+			compare_results(&cmp[3], tolerance, false, ra, ca.depth, rb, cb.depth, 0.0f);
+		}
+	}
+	for(int i=0; i<4; i++) check_comparison(cmp[i]);
+
+	free_collider(field);
+	free_collider(mesh);
+	collision_uninit();
+}
+
+
+struct CollisionTest
+{
+	const char *name;
+	void (*run)(u32 seed);
+};
+
+static const CollisionTest tests[] = {
+	{"threads", test_threads},
+	{"batch", test_batch},
+	{"bvh", test_bvh},
+	{"capsule_box", test_capsule_box},
+	{"primitives", test_primitives},
+	{"heightfield", test_heightfield},
+};
+
+int main(int argc, char *argv[])
+{
+	u32 seed = 1;
+	std::vector<const CollisionTest*> selected;
+	for(int i=1; i<argc; i++)
+	{
+		if(strcmp(argv[i], "-seed") == 0 && i+1 < argc){seed = (u32)atoi(argv[++i]); continue;}
+
+		const CollisionTest *test = nullptr;
+		for(const CollisionTest &t : tests)
+		{
+			if(strcmp(argv[i], t.name) == 0) test = &t;
+		}
+		if(test == nullptr)
+		{
+			printf("usage: collision_test [-seed n] [test ...]\ntests:");
+			for(const CollisionTest &t : tests) printf(" %s", t.name);
+			printf("\n");
+			return 1;
+		}
+		selected.push_back(test);
+	}
+	if(selected.empty())
+	{
+		for(const CollisionTest &t : tests) selected.push_back(&t);
+	}
+
+	for(const CollisionTest *test : selected)
+	{
+		test->run(seed);
+	}
+	if(failures > 0)
+	{
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
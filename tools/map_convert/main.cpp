@@ -0,0 +1,33 @@
+// Map file converter
+// rewrites a map file of any version in the current version, the foliage transforms are computed once here
+// usage: map_convert <input map> [output map]
+#include <stdio.h>
+#include "map_file.h"
+
+int main(int argc, char *argv[])
+{
+	if(argc < 2 || argc > 3)
+	{
+		printf("usage: map_convert <input map> [output map]\n");
+		return 1;
+	}
+	const char *input = argv[1];
+	const char *output = argc == 3 ? argv[2] : argv[1];
+
+	MapFile file;
+	if(!map_file_load(input, &file))
+	{
+		printf("failed to load %s\n", input);
+		return 1;
+	}
+	u32 version = file.version;
+	if(!map_file_save(output, file))
+	{
+		printf("failed to save %s\n", output);
+		return 1;
+	}
+
+	printf("%s (version %u) -> %s (version %u): model %s, %d foliage types, %d foliage\n", input, version, output, MAP_FILE_VERSION,
+		file.model_name, (int)file.foliage.groups.size(), (int)file.foliage.transforms.size());
+	return 0;
+}
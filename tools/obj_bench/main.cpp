@@ -0,0 +1,258 @@
+// OBJ parser benchmark
+// writes a terrain grid like an exported ground, or takes an obj file, and times obj_load against a fgets/sscanf reader
+// usage: obj_bench [-n faces] [-r repeats] [-tri] [-nonormal] [-o output obj] [input obj]
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "mathf.h"
+#include "obj_file.h"
+
+static double now_ms()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// a size x size quad grid with shared positions, uvs and smooth normals, optionally split into triangles
+static bool write_grid(const char *filename, int face_count, bool triangles, bool with_normals)
+{
+	FILE *fp = fopen(filename, "w");
+	if(fp == nullptr) return false;
+
+	int size = (int)ceilf(sqrtf((float)(triangles ? (face_count + 1) / 2 : face_count)));
+	float cell = 1.0f;
+	fprintf(fp, "# obj_bench grid %d x %d\no Ground\n", size, size);
+	for(int z=0; z<=size; z++)
+	{
+		for(int x=0; x<=size; x++)
+		{
+			float h = sinf(x * 0.05f) * 4.0f + cosf(z * 0.07f) * 3.0f;
+			fprintf(fp, "v %f %f %f\n", x * cell, h, z * cell);
+		}
+	}
+	for(int z=0; z<=size; z++)
+	{
+		for(int x=0; x<=size; x++)
+		{
+			fprintf(fp, "vt %f %f\n", (float)x / size, (float)z / size);
+		}
+	}
+	if(with_normals)
+	{
+		for(int z=0; z<=size; z++)
+		{
+			for(int x=0; x<=size; x++)
+			{
+				vec3 n = vec3(-cosf(x * 0.05f) * 0.2f, 1.0f, sinf(z * 0.07f) * 0.21f).normalized();
+				fprintf(fp, "vn %.4f %.4f %.4f\n", n.x, n.y, n.z);
+			}
+		}
+	}
+	fprintf(fp, "s 1\n");
+
+	int written = 0;
+	for(int z=0; z<size && written<face_count; z++)
+	{
+		for(int x=0; x<size && written<face_count; x++)
+		{
+			int c[4] = {z*(size+1) + x + 1, (z+1)*(size+1) + x + 1, (z+1)*(size+1) + x + 2, z*(size+1) + x + 2};
+			if(triangles)
+			{
+				const int tris[2][3] = {{0, 1, 2}, {0, 2, 3}};
+				for(int t=0; t<2 && written<face_count; t++)
+				{
+					fprintf(fp, "f");
+					for(int i=0; i<3; i++)
+					{
+						int k = c[tris[t][i]];
+						if(with_normals) fprintf(fp, " %d/%d/%d", k, k, k);
+						else fprintf(fp, " %d/%d", k, k);
+					}
+					fprintf(fp, "\n");
+					written++;
+				}
+			}
+			else
+			{
+				fprintf(fp, "f");
+				for(int i=0; i<4; i++)
+				{
+					if(with_normals) fprintf(fp, " %d/%d/%d", c[i], c[i], c[i]);
+					else fprintf(fp, " %d/%d", c[i], c[i]);
+				}
+				fprintf(fp, "\n");
+				written++;
+			}
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+// the line reader the engine used before obj_load, v/vt/vn triangles and quads, every corner is a new vertex
+static bool load_sscanf(const char *filename, std::vector<Vertex> *vertices, std::vector<u32> *indices)
+{
+	FILE *fp = fopen(filename, "r");
+	if(fp == nullptr) return false;
+
+	std::vector<vec3> positions;
+	std::vector<vec2> uvs;
+	std::vector<vec3> normals;
+	vertices->clear();
+	indices->clear();
+	char line[1024];
+	char type[32];
+	while(fgets(line, sizeof(line), fp) != nullptr)
+	{
+		if(sscanf(line, "%31s", type) != 1) continue;
+		if(strcmp(type, "v") == 0)
+		{
+			vec3 v;
+			sscanf(line, "%s %f %f %f", type, &v.x, &v.y, &v.z);
+			positions.push_back(v);
+		}
+		else if(strcmp(type, "vt") == 0)
+		{
+			vec2 uv;
+			sscanf(line, "%s %f %f", type, &uv.x, &uv.y);
+			uvs.push_back(uv);
+		}
+		else if(strcmp(type, "vn") == 0)
+		{
+			vec3 n;
+			sscanf(line, "%s %f %f %f", type, &n.x, &n.y, &n.z);
+			normals.push_back(n);
+		}
+		else if(strcmp(type, "f") == 0)
+		{
+			int v[4], t[4], n[4];
+			int count = sscanf(line, "%s %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d", type, &v[0], &t[0], &n[0], &v[1], &t[1], &n[1], &v[2], &t[2], &n[2], &v[3], &t[3], &n[3]);
+			int corners = (count - 1) / 3;
+			if(corners < 3) continue;	// the old reader rejected faces without normals
+			u32 offset = (u32)vertices->size();
+			for(int i=0; i<corners; i++)
+			{
+				Vertex vertex = {};
+				vertex.position = positions[v[i] - 1];
+				vertex.uv = uvs[t[i] - 1];
+				vertex.normal = normals[n[i] - 1];
+				vertex.color = vec4(1, 1, 1, 1);
+				vertices->push_back(vertex);
+			}
+			indices->push_back(offset); indices->push_back(offset + 1); indices->push_back(offset + 2);
+			if(corners == 4)
+			{
+				indices->push_back(offset); indices->push_back(offset + 2); indices->push_back(offset + 3);
+			}
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+static double checksum(const std::vector<Vertex> &vertices, const std::vector<u32> &indices)
+{
+	double sum = 0.0;
+	for(size_t i=0; i<indices.size(); i++)
+	{
+		const Vertex &v = vertices[indices[i]];
+		sum += v.position.x + v.position.y * 0.5 + v.position.z * 0.25 + v.uv.x + v.normal.y;
+	}
+	return sum;
+}
+
+int main(int argc, char *argv[])
+{
+	int face_count = 1000000;
+	int repeats = 3;
+	bool triangles = false;
+	bool with_normals = true;
+	const char *output = "obj_bench.obj";
+	const char *input = nullptr;
+	for(int i=1; i<argc; i++)
+	{
+		if(strcmp(argv[i], "-n") == 0 && i+1 < argc){face_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-r") == 0 && i+1 < argc){repeats = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-tri") == 0){triangles = true;}
+		else if(strcmp(argv[i], "-nonormal") == 0){with_normals = false;}
+		else if(strcmp(argv[i], "-o") == 0 && i+1 < argc){output = argv[++i];}
+		else if(argv[i][0] != '-' && input == nullptr){input = argv[i];}
+		else
+		{
+			printf("usage: obj_bench [-n faces] [-r repeats] [-tri] [-nonormal] [-o output obj] [input obj]\n");
+			return 1;
+		}
+	}
+	if(face_count <= 0 || repeats <= 0)
+	{
+		printf("usage: obj_bench [-n faces] [-r repeats] [-tri] [-nonormal] [-o output obj] [input obj]\n");
+		return 1;
+	}
+
+	if(input == nullptr)
+	{
+		double start = now_ms();
+		if(!write_grid(output, face_count, triangles, with_normals))
+		{
+			printf("failed to write %s\n", output);
+			return 1;
+		}
+		printf("wrote %s in %.0f ms\n", output, now_ms() - start);
+		input = output;
+	}
+
+	FILE *fp = fopen(input, "rb");
+	if(fp == nullptr)
+	{
+		printf("failed to open %s\n", input);
+		return 1;
+	}
+	fseek(fp, 0, SEEK_END);
+	double megabytes = ftell(fp) / (1024.0 * 1024.0);
+	fclose(fp);
+
+	std::vector<Vertex> vertices;
+	std::vector<u32> indices;
+	double obj_time = 1e30;
+	for(int r=0; r<repeats; r++)
+	{
+		double start = now_ms();
+		if(!obj_load(input, &vertices, &indices))
+		{
+			printf("failed to load %s\n", input);
+			return 1;
+		}
+		obj_time = fmin(obj_time, now_ms() - start);
+	}
+	u64 triangle_count = indices.size() / 3;
+	u64 vertex_count = vertices.size();
+	double obj_checksum = checksum(vertices, indices);
+
+	std::vector<Vertex> old_vertices;
+	std::vector<u32> old_indices;
+	double old_time = 1e30;
+	for(int r=0; r<repeats; r++)
+	{
+		double start = now_ms();
+		load_sscanf(input, &old_vertices, &old_indices);
+		old_time = fmin(old_time, now_ms() - start);
+	}
+
+	printf("%s: %.1f MB, %llu triangles, best of %d\n", input, megabytes, triangle_count, repeats);
+	printf("obj_load   %8.1f ms  %6.1f MB/s  %llu vertices, %llu bytes\n", obj_time, megabytes * 1000.0 / obj_time,
+		vertex_count, (u64)(vertices.size() * sizeof(Vertex) + indices.size() * sizeof(u32)));
+	if(old_indices.size() == indices.size())
+	{
+		printf("sscanf     %8.1f ms  %6.1f MB/s  %llu vertices, %llu bytes\n", old_time, megabytes * 1000.0 / old_time,
+			(u64)old_vertices.size(), (u64)(old_vertices.size() * sizeof(Vertex) + old_indices.size() * sizeof(u32)));
+		printf("checksum %.6f, sscanf %.6f\n", obj_checksum, checksum(old_vertices, old_indices));
+	}
+	else
+	{
+		printf("sscanf     %8.1f ms  %6.1f MB/s  %llu of the triangles, it needs v/vt/vn triangles or quads\n", old_time, megabytes * 1000.0 / old_time, (u64)(old_indices.size() / 3));
+		printf("checksum %.6f\n", obj_checksum);
+	}
+	return 0;
+}
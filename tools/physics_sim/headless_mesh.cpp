@@ -0,0 +1,36 @@
+// CPU only Mesh for the headless build, the vertices are kept for the collision and nothing is uploaded. the rest of
+// Mesh is shared with the game in mesh.cpp
+#include <string.h>
+#include "gpu.h"
+
+void Mesh::create(const Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count, int index)
+{
+	free_submesh(index);
+	if(index < 0) return;
+	if(submeshes.size() <= (size_t)index)
+	{
+		submeshes.resize(index+1);
+	}
+
+	Submesh submesh = {};
+	submesh.vertices = new Vertex[vertex_count];
+	memcpy(submesh.vertices, vertices, sizeof(Vertex) * vertex_count);
+	submesh.vertex_count = vertex_count;
+	submesh.indices = new u32[index_count];
+	memcpy(submesh.indices, indices, sizeof(u32) * index_count);
+	submesh.index_count = index_count;
+	submesh.index_size = vertex_count <= 0x10000 ? sizeof(u16) : sizeof(u32);
+	submesh.aabb = mesh_calc_bounds(vertices, vertex_count);
+	submeshes[index] = submesh;
+}
+
+void Mesh::free_submesh(int index)
+{
+	Submesh *submesh = get_submesh(index);
+	if(submesh == nullptr)
+		return;
+
+	delete[] submesh->vertices;
+	delete[] submesh->indices;
+	*submesh = {};
+}
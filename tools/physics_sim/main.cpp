@@ -0,0 +1,314 @@
+// Headless ball physics simulator
+// loads the collision of a map file, shoots balls and steps them with the game's ball physics at a fixed dt
+// usage: physics_sim <map file> [-n shots] [-s shot file] [-dt step] [-t max time] [-seed n] [-o trajectory.csv] [-every n] [-stats] [-mesh]
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "mathf.h"
+#include "gpu.h"
+#include "collision.h"
+#define SAML_IMPLEMENTATION	// impl.cpp is not linked, it pulls in miniaudio
+#include "external/saml.hpp"
+#include "common.h"
+#include "map.h"
+#include "ball_physics.h"
+#include "foliage_system.h"
+#include "map_file.h"
+#include "obj_file.h"
+
+// power and angle of the golf clubs in init_common
+static const struct {float power; float angle;} clubs[] = {{40.0f, 25.0f}, {30.0f, 35.0f}, {20.0f, 50.0f}, {15.0f, 0.0f}};
+
+struct Shot
+{
+	vec3 position;
+	vec3 velocity;
+};
+
+static struct physics_sim_ctx
+{
+	MeshRef ground_mesh;
+	std::vector<ColliderRef> colliders;
+	vec3 hole;
+	TeeingArea teeing_area;
+	int foliage_count;
+	bool mesh_ground;	// the terrain as a triangle mesh instead of a heightfield, for timing the mesh path
+} ctx = {};
+
+static double now_ms()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the ground mesh, read with the game's obj reader
+static MeshRef load_obj_mesh(const char *filename)
+{
+	std::vector<Vertex> vertices;
+	std::vector<u32> indices;
+	if(!obj_load(filename, &vertices, &indices)) return nullptr;
+	return std::make_shared<Mesh>(vertices.data(), (u32)vertices.size(), indices.data(), (u32)indices.size());
+}
+
+struct MapLoadJobs
+{
+	std::string mesh_name;
+	CollisionMeshRef collision_mesh;
+	CollisionHeightfieldRef heightfield;
+};
+
+static void ground_job(MapLoadJobs *jobs)
+{
+	ctx.ground_mesh = load_obj_mesh(jobs->mesh_name.c_str());
+	if(ctx.ground_mesh == nullptr) return;
+
+	jobs->collision_mesh = create_collision_mesh(ctx.ground_mesh->get_vertices(), ctx.ground_mesh->get_vertex_count(), ctx.ground_mesh->get_indices(), ctx.ground_mesh->get_index_count());
+	if(!ctx.mesh_ground)
+	{
+		jobs->heightfield = create_collision_heightfield(jobs->collision_mesh, GROUND_CELL_SIZE, (int)std::thread::hardware_concurrency());
+	}
+}
+
+// loads the colliders of a map file the same way as map_load, the models are not loaded
+static bool load_map(const char *filename)
+{
+	MapFile file;
+	if(!map_file_load(filename, &file)) return false;
+	ctx.hole = file.hole;
+	ctx.teeing_area = file.teeing_area;
+
+	// the mesh file of the map model, loaded right here, the game loads it on a worker thread
+	MapLoadJobs jobs = {};
+	saml::Value res = saml::parse_file("data/res.txt");
+	jobs.mesh_name = res["models"][file.model_name].get_string("mesh");
+	if(jobs.mesh_name.empty()) jobs.mesh_name = file.model_name;
+	ground_job(&jobs);
+
+	if(ctx.ground_mesh == nullptr)
+	{
+		printf("failed to load the map model %s\n", file.model_name);
+		return false;
+	}
+
+	ColliderRef ground = jobs.heightfield ? create_heightfield_collider(jobs.heightfield) : create_mesh_collider(jobs.collision_mesh);
+	ground->set_layer((u32)CollisionLayer::Ground);
+	ctx.colliders.push_back(ground);
+
+	// sea
+	float s = SEA_SIZE * 0.5f;
+	vec3 sea[6] = {vec3(-s,0,-s), vec3(-s,0,s), vec3(s,0,-s), vec3(s,0,-s), vec3(-s,0,s), vec3(s,0,s)};
+	ColliderRef sea_collider = create_mesh_collider(sea, 6);
+	sea_collider->set_layer((u32)CollisionLayer::Ground);
+	ctx.colliders.push_back(sea_collider);
+
+	// foliage, the colliders foliage_init gives the types
+	ctx.foliage_count = (int)file.foliage.transforms.size();
+	for(size_t i=0; i<file.foliage.groups.size(); i++)
+	{
+		const FoliageData::Group &group = file.foliage.groups[i];
+		FoliageColliderDesc desc;
+		if(!foliage_collider_desc(group.type, &desc)) continue;
+
+		for(u32 k=0; k<group.count; k++)
+		{
+			ColliderRef c = create_foliage_collider(desc, file.foliage.transforms[group.first + k].pos);
+			c->user_data.type = (int)ColliderUserDataType::FoliageObject;
+			ctx.colliders.push_back(c);
+		}
+	}
+	return true;
+}
+
+// the ball is placed in front of the teeing area like GameScene::init
+static vec3 get_tee_position()
+{
+	quat rotation = quat::euler(vec3(0, ctx.teeing_area.angle, 0));
+	vec3 pos = ctx.teeing_area.position + rotation.forward() * 4.0f;
+	RayHit hitinfo;
+	if(raycast(ray_t(pos + vec3(0,1,0), vec3(0,-2,0)), &hitinfo))
+	{
+		return hitinfo.point + vec3(0,0.05f,0);
+	}
+	return pos + vec3(0,0.1f,0);
+}
+
+// random shots from the tee with the clubs, aimed within 45 degrees of the teeing area
+static void create_random_shots(int count, std::vector<Shot> *shots)
+{
+	vec3 tee = get_tee_position();
+	for(int i=0; i<count; i++)
+	{
+		int club = (int)(rand_get() * 4.0f) % 4;
+		float yaw = ctx.teeing_area.angle + rand_range(-45.0f, 45.0f);
+		vec3 dir = quat::euler(vec3(0, yaw, 0)) * vec3(0,0,1);
+		vec3 right = vec3::cross(dir, vec3(0,1,0));
+		dir = quat::axis_angle(right, clubs[club].angle) * dir;
+
+		Shot shot;
+		shot.position = tee;
+		shot.velocity = dir * clubs[club].power * rand_range(0.3f, 1.0f);
+		shots->push_back(shot);
+	}
+}
+
+// "vx vy vz" shoots from the tee, "px py pz vx vy vz" from the given position
+static bool load_shots(const char *filename, std::vector<Shot> *shots)
+{
+	FILE *fp = fopen(filename, "r");
+	if(!fp) return false;
+
+	vec3 tee = get_tee_position();
+	char line[256];
+	while(fgets(line, sizeof(line), fp) != nullptr)
+	{
+		float v[6];
+		int n = sscanf(line, "%f %f %f %f %f %f", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+		if(n == 3)
+		{
+			shots->push_back({tee, vec3(v[0], v[1], v[2])});
+		}
+		else if(n == 6)
+		{
+			shots->push_back({vec3(v[0], v[1], v[2]), vec3(v[3], v[4], v[5])});
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *map_file = nullptr;
+	const char *shot_file = nullptr;
+	const char *output_file = nullptr;
+	int shot_count = 100;
+	float dt = 1.0f / 120.0f;
+	float max_time = 20.0f;
+	int every = 1;
+	u32 seed = 1;
+	bool stats = false;
+	for(int i=1; i<argc; i++)
+	{
+		if(strcmp(argv[i], "-n") == 0 && i+1 < argc){shot_count = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-s") == 0 && i+1 < argc){shot_file = argv[++i];}
+		else if(strcmp(argv[i], "-dt") == 0 && i+1 < argc){dt = (float)atof(argv[++i]);}
+		else if(strcmp(argv[i], "-t") == 0 && i+1 < argc){max_time = (float)atof(argv[++i]);}
+		else if(strcmp(argv[i], "-seed") == 0 && i+1 < argc){seed = (u32)atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-o") == 0 && i+1 < argc){output_file = argv[++i];}
+		else if(strcmp(argv[i], "-every") == 0 && i+1 < argc){every = atoi(argv[++i]);}
+		else if(strcmp(argv[i], "-stats") == 0){stats = true;}
+		else if(strcmp(argv[i], "-mesh") == 0){ctx.mesh_ground = true;}
+		else {map_file = argv[i];}
+	}
+	if(map_file == nullptr || dt <= 0.0f || every <= 0)
+	{
+		printf("usage: physics_sim <map file> [-n shots] [-s shot file] [-dt step] [-t max time] [-seed n] [-o trajectory.csv] [-every n] [-stats] [-mesh]\n");
+		return 1;
+	}
+
+	collision_init();
+	ball_physics_init_layers();
+
+	double load_start = now_ms();
+	if(!load_map(map_file))
+	{
+		printf("failed to load %s\n", map_file);
+		return 1;
+	}
+	collision_build_static();
+	double load_time = now_ms() - load_start;
+
+	std::vector<Shot> shots;
+	rand_set_seed(seed);
+	if(shot_file)
+	{
+		if(!load_shots(shot_file, &shots))
+		{
+			printf("failed to load %s\n", shot_file);
+			return 1;
+		}
+	}
+	else
+	{
+		create_random_shots(shot_count, &shots);
+	}
+
+	FILE *out = nullptr;
+	if(output_file)
+	{
+		out = fopen(output_file, "w");
+		if(!out)
+		{
+			printf("failed to open %s\n", output_file);
+			return 1;
+		}
+		fprintf(out, "shot,time,x,y,z,vx,vy,vz\n");
+	}
+
+	// the whole simulation is collected as a single frame of collision statistics
+	collision_stats_enable(stats);
+	collision_stats_new_frame();
+
+	// a shot ends when the ball rests, sinks or runs out of time
+	int max_steps = (int)ceilf(max_time / dt);
+	u64 total_steps = 0;
+	int holed = 0;
+	double checksum = 0.0;
+	double sim_start = now_ms();
+	for(int i=0; i<(int)shots.size(); i++)
+	{
+		BallBody body = {shots[i].position, shots[i].velocity, quat::identity()};
+		int step = 0;
+		for(; step<max_steps; step++)
+		{
+			if(out && step % every == 0)
+			{
+				fprintf(out, "%d,%.4f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f\n", i, step*dt,
+					body.position.x, body.position.y, body.position.z, body.velocity.x, body.velocity.y, body.velocity.z);
+			}
+
+			ball_physics_step(&body, dt);
+			if(ball_physics_in_hole(body, ctx.hole))
+			{
+				holed++;
+				break;
+			}
+			if(body.velocity.len() < 0.01f) break;
+		}
+		if(out)
+		{
+			fprintf(out, "%d,%.4f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f\n", i, step*dt,
+				body.position.x, body.position.y, body.position.z, body.velocity.x, body.velocity.y, body.velocity.z);
+		}
+		total_steps += step;
+		checksum += body.position.x + body.position.y + body.position.z;
+	}
+	double sim_time = now_ms() - sim_start;
+	collision_stats_new_frame();
+	if(out) fclose(out);
+
+	printf("map %s: %d colliders, %d foliage, loaded in %.2f ms\n", map_file, (int)ctx.colliders.size(), ctx.foliage_count, load_time);
+	printf("shots %d, steps %llu, holed %d, dt %.5f\n", (int)shots.size(), (unsigned long long)total_steps, holed, dt);
+	printf("simulated in %.2f ms, %.3f us/step\n", sim_time, total_steps > 0 ? sim_time * 1000.0 / total_steps : 0.0);
+	printf("checksum %.6f\n", checksum);
+	if(stats)
+	{
+		const CollisionStats *s = collision_get_stats();
+		bounds_t world = collision_get_world_bounds();
+		printf("collision world %.1f x %.1f at (%.1f, %.1f), depth %u\n", world.extents.x * 2.0f, world.extents.z * 2.0f, world.center.x, world.center.z, collision_get_world_level());
+		printf("%-16s %10s %12s %12s %12s %10s %10s\n", "query", "count", "nodes", "candidates", "tests", "hits", "ms");
+		for(int i=0; i<(int)CollisionQueryType::COUNT; i++)
+		{
+			const CollisionQueryStats &q = s->types[i];
+			if(q.queries == 0) continue;
+			printf("%-16s %10u %12u %12u %12u %10u %10.2f\n", collision_query_type_name((CollisionQueryType)i), q.queries, q.nodes, q.candidates, q.tests, q.hits, q.time);
+		}
+	}
+
+	ctx.colliders.clear();
+	ctx.ground_mesh = nullptr;
+	collision_uninit();
+	return 0;
+}